@@ -40,13 +40,7 @@
 #include <string.h>
 #include <gune/alist.h>
 
-/** \brief Association list entry (stored in the linked list) */
-typedef struct alist_entry {
-	gendata key;		/**< Key, used for identification of entries */
-	gendata value;		/**< The entry itself */
-} alist_entry_t, * alist_entry;
-
-static alist alist_insert_internal(alist, gendata, gendata, eq_func,
+static alist alist_insert_internal(alist, hashval, gendata, gendata, eq_func,
 				   free_func, free_func, int);
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
@@ -67,8 +61,10 @@ alist_create(void)
 {
 	alist_t *al;
 
-	if ((al = malloc(sizeof(alist_t))) != NULL)
+	if ((al = malloc(sizeof(alist_t))) != NULL) {
 		al->list = sll_create();
+		al->count = 0;
+	}
 
 	return (alist)al;
 }
@@ -121,15 +117,16 @@ alist_destroy(alist al, free_func free_key, free_func free_value)
 
 
 /*
- * Internal function which alist_insert and alist_insert_uniq call.
- * Argument list is the same as these two functions, except for an extra
+ * Internal function which all insertion functions call.
+ * Argument list is the same as alist_insert_hashed, except for an extra
  * integer tacked onto the end.  This integer is nonzero if existing
  * key entries are not allowed.  If existing key entries are allowed, the
- * value of that key is overwritten.
+ * key and value of that entry are overwritten.
  */
 static alist
-alist_insert_internal(alist al, gendata key, gendata value, eq_func eq,
-		      free_func free_key, free_func free_value, int uniq)
+alist_insert_internal(alist al, hashval hash, gendata key, gendata value,
+		      eq_func eq, free_func free_key, free_func free_value,
+		      int uniq)
 {
 	sll new_head;
 	alist_entry e;
@@ -147,7 +144,7 @@ alist_insert_internal(alist al, gendata key, gendata value, eq_func eq,
 	 */
 	while (!sll_empty(l)) {
 		e = sll_get_data(l).ptr;
-		if (eq(key, e->key)) {
+		if (e->hash == hash && eq(key, e->key)) {
 			/* Duplicates not allowed? */
 			if (uniq) {
 				errno = EINVAL;
@@ -159,6 +156,7 @@ alist_insert_internal(alist al, gendata key, gendata value, eq_func eq,
 				free_key(e->key.ptr);
 			if (free_value != NULL)
 				free_value(e->value.ptr);
+			e->key = key;
 			e->value = value;
 			e_data.ptr = e;
 			sll_set_data(l, e_data);
@@ -171,6 +169,7 @@ alist_insert_internal(alist al, gendata key, gendata value, eq_func eq,
 	if ((e = malloc(sizeof(alist_entry_t))) == NULL)
 		return NULL;
 
+	e->hash = hash;
 	e->key = key;
 	e->value = value;
 	e_data.ptr = e;
@@ -182,6 +181,7 @@ alist_insert_internal(alist al, gendata key, gendata value, eq_func eq,
 	}
 
 	al->list = new_head;
+	++al->count;
 	return al;
 }
 
@@ -215,7 +215,46 @@ alist
 alist_insert(alist al, gendata key, gendata value, eq_func eq,
 	     free_func free_key, free_func free_value)
 {
-	return alist_insert_internal(al, key, value, eq,
+	return alist_insert_internal(al, 0, key, value, eq,
+				     free_key, free_value, 0);
+}
+
+
+/**
+ * \brief Add a (key, value) pair with a known hash to a linked list (with
+ *  replace)
+ *
+ * This is like alist_insert, but the full hash value of the key is stored
+ * with the entry.  Keys are only compared with \p eq if their hash values
+ * are equal, so most comparisons of expensive keys (like strings) are
+ * skipped.  The entries of an alist should either all be inserted with
+ * a hash, or none of them.  Entries inserted without a hash have hash 0.
+ *
+ * \param al	      The association list to insert the data in.
+ * \param hash        The full hash value of the key.
+ * \param key	      The key of the data.
+ * \param value	      The data to insert.
+ * \param eq          The equals predicate for two keys.
+ * \param free_key    The function used to free the old key's data if it
+ *		       needs to be replaced, or \c NULL if the data does not
+ *		       need to be freed.
+ * \param free_value  The function used to free the old value's data if it
+ *		       needs to be replaced, or \c NULL if the data does not
+ *		       need to be freed.
+ *
+ * \return  The original alist, or \c NULL if the data could not be inserted.
+ *          Original alist is still valid in case of error.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa alist_insert alist_lookup_hashed alist_delete_hashed
+ */
+alist
+alist_insert_hashed(alist al, hashval hash, gendata key, gendata value,
+		    eq_func eq, free_func free_key, free_func free_value)
+{
+	return alist_insert_internal(al, hash, key, value, eq,
 				     free_key, free_value, 0);
 }
 
@@ -244,7 +283,37 @@ alist_insert(alist al, gendata key, gendata value, eq_func eq,
 alist
 alist_insert_uniq(alist al, gendata key, gendata value, eq_func eq)
 {
-	return alist_insert_internal(al, key, value, eq, NULL, NULL, 1);
+	return alist_insert_internal(al, 0, key, value, eq, NULL, NULL, 1);
+}
+
+
+/**
+ * \brief Add a (key, value) pair with a known hash to a linked list (no
+ *  replace)
+ *
+ * This is like alist_insert_uniq, but the full hash value of the key is
+ * stored with the entry.  See alist_insert_hashed.
+ *
+ * \param al	      The association list to insert the data in.
+ * \param hash        The full hash value of the key.
+ * \param key	      The key of the data.
+ * \param value	      The data to insert.
+ * \param eq          The equals predicate for two keys.
+ *
+ * \return  The original alist, or \p NULL if the data could not be inserted.
+ *          Original alist is still valid in case of error.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key is already in the list.
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa alist_insert_uniq alist_insert_hashed
+ */
+alist
+alist_insert_uniq_hashed(alist al, hashval hash, gendata key, gendata value,
+			 eq_func eq)
+{
+	return alist_insert_internal(al, hash, key, value, eq, NULL, NULL, 1);
 }
 
 
@@ -267,6 +336,35 @@ alist_insert_uniq(alist al, gendata key, gendata value, eq_func eq)
  */
 alist
 alist_lookup(alist al, gendata key, eq_func eq, gendata *data)
+{
+	return alist_lookup_hashed(al, 0, key, eq, data);
+}
+
+
+/**
+ * \brief Look up an element with a known hash in the association list.
+ *
+ * This is like alist_lookup, but \p eq is only called on entries which
+ * were inserted with the same hash.  See alist_insert_hashed.
+ *
+ * \param al    The association list which contains the element.
+ * \param hash  The full hash value of the key.
+ * \param key   The key to the element.
+ * \param eq    The equals predicate for two keys.
+ * \param data  A pointer to the location where the element is stored, if
+ *               it was found.
+ *
+ * \return  The alist if the key was found, or \c NULL if the key could not be
+ *          found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ *
+ * \sa alist_lookup alist_insert_hashed
+ */
+alist
+alist_lookup_hashed(alist al, hashval hash, gendata key, eq_func eq,
+		    gendata *data)
 {
 	sll l;
 	alist_entry e;
@@ -278,7 +376,7 @@ alist_lookup(alist al, gendata key, eq_func eq, gendata *data)
 
 	while (!sll_empty(l)) {
 		e = sll_get_data(l).ptr;
-		if (eq(key, e->key)) {
+		if (e->hash == hash && eq(key, e->key)) {
 			*data = e->value;
 			return al;
 		}
@@ -312,6 +410,36 @@ alist_lookup(alist al, gendata key, eq_func eq, gendata *data)
 alist
 alist_delete(alist al, gendata key, eq_func eq, free_func free_key,
 	     free_func free_value)
+{
+	return alist_delete_hashed(al, 0, key, eq, free_key, free_value);
+}
+
+
+/**
+ * \brief Delete an element with a known hash from the association list.
+ *
+ * This is like alist_delete, but \p eq is only called on entries which
+ * were inserted with the same hash.  See alist_insert_hashed.
+ *
+ * \param al          The association list which contains the element to delete.
+ * \param hash        The full hash value of the key.
+ * \param key         The key to the element to delete.
+ * \param eq          The equals predicate for two keys.
+ * \param free_key    The function which is used to free the key data, or
+ *			\c NULL if no action should be taken on the key data.
+ * \param free_value  The function which is used to free the value data, or
+ *			\c NULL if no action should be taken on the value data.
+ *
+ * \return  The alist, or \c NULL if the key could not be found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ *
+ * \sa alist_delete alist_insert_hashed
+ */
+alist
+alist_delete_hashed(alist al, hashval hash, gendata key, eq_func eq,
+		    free_func free_key, free_func free_value)
 {
 	sll l, n;
 	alist_entry e;
@@ -331,13 +459,14 @@ alist_delete(alist al, gendata key, eq_func eq, free_func free_key,
 	 *  be easier, but it's not convenience we are after in here.
 	 */
 	e = sll_get_data(l).ptr;
-	if (eq(key, e->key)) {
+	if (e->hash == hash && eq(key, e->key)) {
 		if (free_key != NULL)
 			free_key(e->key.ptr);
 		if (free_value != NULL)
 			free_value(e->value.ptr);
 		/* We are removing the first entry from the list! */
 		al->list = sll_remove_head(l, free);
+		--al->count;
 		return al;
 	}
 
@@ -346,12 +475,13 @@ alist_delete(alist al, gendata key, eq_func eq, free_func free_key,
 
 	while (!sll_empty(n)) {
 		e = sll_get_data(n).ptr;
-		if (eq(key, e->key)) {
+		if (e->hash == hash && eq(key, e->key)) {
 			if (free_key != NULL)
 				free_key(e->key.ptr);
 			if (free_value != NULL)
 				free_value(e->value.ptr);
 			sll_remove_next(l, free);
+			--al->count;
 			return al;
 		}
 		l = sll_next(l);
@@ -380,6 +510,22 @@ alist_empty(alist al)
 }
 
 
+/**
+ * \brief Return the number of pairs in an association list.
+ *
+ * \param al  The association list to count.
+ *
+ * \return  The number of (key, value) pairs in the list.
+ */
+unsigned int
+alist_count(alist al)
+{
+	assert(al != NULL);
+
+	return al->count;
+}
+
+
 /**
  * \brief Walk through all elements of an alist.
  *
@@ -458,8 +604,8 @@ alist_merge(alist base, alist rest, eq_func eq, free_func free_key,
 
 	while (!sll_empty(l)) {
 		e = sll_get_data(l).ptr;
-		base = alist_insert(base, e->key, e->value, eq,
-				    free_key, free_value);
+		base = alist_insert_hashed(base, e->hash, e->key, e->value,
+					   eq, free_key, free_value);
 
 		/*
 		 * HACK: We are cheating here, since we're assuming the alist
@@ -511,7 +657,7 @@ alist_merge(alist base, alist rest, eq_func eq, free_func free_key,
 alist
 alist_merge_uniq(alist base, alist rest, eq_func eq)
 {
-	sll l;
+	sll l, prev;
 	alist_entry e;
 	alist base_tmp;
 
@@ -519,21 +665,71 @@ alist_merge_uniq(alist base, alist rest, eq_func eq)
 	assert(rest != NULL);
 
 	l = rest->list;
+	prev = NULL;
 
 	while (!sll_empty(l)) {
 		e = sll_get_data(l).ptr;
-		base_tmp = alist_insert_uniq(base, e->key, e->value, eq);
+		base_tmp = alist_insert_uniq_hashed(base, e->hash, e->key,
+						    e->value, eq);
 
 		if (base_tmp == NULL) {
 			if (errno == ENOMEM)
 				return NULL;
-			else
-				l = sll_next(l);
+			/* Duplicate key, so the entry stays in rest */
+			prev = l;
+			l = sll_next(l);
 		} else {
 			base = base_tmp;
-			l = sll_remove_head(l, free);
+			/*
+			 * The entry was copied into base, so unlink it from
+			 * rest.  Any entries we skipped earlier stay linked.
+			 */
+			if (prev == NULL) {
+				l = sll_remove_head(l, free);
+				rest->list = l;
+			} else {
+				sll_remove_next(prev, free);
+				l = sll_next(prev);
+			}
+			--rest->count;
 		}
 	}
 
 	return base;
 }
+
+
+/**
+ * \brief Move the first pair of an association list to another list.
+ *
+ * The pair is relinked, not copied, so this never allocates memory.
+ * No check is made whether the key already exists in \p dst, so this is
+ * only safe when the caller knows the keys in both lists are distinct.
+ * (like when redistributing the pairs of a hash table)
+ *
+ * \param dst  The association list to move the pair to.
+ * \param src  The nonempty association list to move the pair from.
+ *
+ * \return  The \p dst alist.
+ *
+ * \sa alist_insert alist_merge
+ */
+alist
+alist_move_head(alist dst, alist src)
+{
+	sll l;
+
+	assert(dst != NULL);
+	assert(src != NULL);
+	assert(!sll_empty(src->list));
+
+	l = src->list;
+	src->list = l->next;
+	--src->count;
+
+	l->next = dst->list;
+	dst->list = l;
+	++dst->count;
+
+	return dst;
+}
@@ -44,9 +44,17 @@
 extern "C" {
 #endif
 
+/** \brief Association list entry (stored in the linked list) */
+typedef struct alist_entry {
+	hashval hash;		/**< Full hash value of the key, or 0 */
+	gendata key;		/**< Key, used for identification of entries */
+	gendata value;		/**< The entry itself */
+} alist_entry_t, * alist_entry;
+
 /** \brief Association list implementation */
 typedef struct alist_t {
 	sll list;			/**< The list of (key, value) pairs */
+	unsigned int count;		/**< The number of pairs in the list */
 } alist_t, * alist;
 
 alist alist_create(void);
@@ -55,12 +63,20 @@ alist alist_insert(alist, gendata, gendata, eq_func, free_func, free_func);
 alist alist_insert_uniq(alist, gendata, gendata, eq_func);
 alist alist_lookup(alist, gendata, eq_func, gendata *);
 alist alist_delete(alist, gendata, eq_func, free_func, free_func);
+alist alist_insert_hashed(alist, hashval, gendata, gendata, eq_func,
+			  free_func, free_func);
+alist alist_insert_uniq_hashed(alist, hashval, gendata, gendata, eq_func);
+alist alist_lookup_hashed(alist, hashval, gendata, eq_func, gendata *);
+alist alist_delete_hashed(alist, hashval, gendata, eq_func, free_func,
+			  free_func);
 int alist_empty(alist);
+unsigned int alist_count(alist);
 void alist_walk(alist, assoc_func, gendata);
 
 /* Convenience functions */
 alist alist_merge(alist, alist, eq_func, free_func, free_func);
 alist alist_merge_uniq(alist, alist, eq_func);
+alist alist_move_head(alist, alist);
 
 #ifdef __cplusplus
 }
@@ -34,15 +34,129 @@
  *
  * \file array.c
  */
+#ifdef GUNE_THREADS
+/* We need POSIX threads for parallel sorting */
+#define _POSIX_C_SOURCE	200112L
+#endif
+
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#ifdef GUNE_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
 #include <gune/error.h>
 #include <gune/array.h>
+#include <gune/misc.h>
 
 /** Compile-time option of initial array size */
 #define ARRAY_INITIAL_SIZE	16
 
+/** Compile-time option of the size below which sorting uses insertion sort */
+#define ARRAY_SORT_INSERTION	24
+
+/** Compile-time option of the size above which pivots are a ninther */
+#define ARRAY_SORT_NINTHER	128
+
+/** Compile-time option of how many moves may be wasted on a bad guess */
+#define ARRAY_SORT_PARTIAL	8
+
+/** Compile-time option of the size below which radix sorting is not used */
+#define ARRAY_RADIX_MIN		64
+
+/* The number of bits sorted on in each pass of the radix sort */
+#define ARRAY_RADIX_BITS	8
+#define ARRAY_RADIX_BUCKETS	(1 << ARRAY_RADIX_BITS)
+#define ARRAY_RADIX_PASSES						\
+	((sizeof(unsigned int) * CHAR_BIT + ARRAY_RADIX_BITS - 1) /	\
+	 ARRAY_RADIX_BITS)
+
+/*
+ * The radix sort key of an element.  Flipping the sign bit of a signed
+ * number makes negative numbers sort before positive ones.
+ */
+#define ARRAY_RADIX_KEY(d, sgn)						\
+	((sgn) ? (unsigned int)(d).num ^ ~(UINT_MAX >> 1) : (d).posnum)
+
+/** Compile-time option of the threads to use if the CPUs can't be counted */
+#define ARRAY_SORT_THREADS	4
+
+/** Compile-time option of the fewest elements per thread of a parallel sort */
+#define ARRAY_SORT_PARALLEL_MIN	16384
+
+/** Compile-time option of the number of samples per splitter */
+#define ARRAY_SORT_OVERSAMPLE	32
+
+#ifdef GUNE_THREADS
+/* The phases of a parallel sort */
+enum array_sort_phase {
+	ARRAY_SORT_COUNT,	/* Find the bucket of every element */
+	ARRAY_SORT_SCATTER,	/* Move the elements to their buckets */
+	ARRAY_SORT_BUCKETS	/* Sort the buckets */
+};
+
+/* The state of a parallel sort */
+struct array_sort_work {
+	gendata *data;		/* The elements to sort */
+	gendata *tmp;		/* Room to distribute the elements over */
+	unsigned char *bucket;	/* The bucket of every element */
+	unsigned int n;		/* The number of elements */
+	unsigned int nthreads;	/* The number of threads and of buckets */
+	cmp_func cmp;		/* The ordering, or NULL for a radix sort */
+	int sgn;		/* Whether a radix sort is on num or posnum */
+	/* The greatest element of every bucket but the last */
+	gendata splitter[ARRAY_SORT_MAX_THREADS - 1];
+	unsigned int key[ARRAY_SORT_MAX_THREADS - 1];	/* Their radix keys */
+	/*
+	 * The number of equal splitters from every splitter on, or 0 if the
+	 * one before it is equal too.  The elements which are equal to such
+	 * a run are spread over its buckets, and the buckets with a 0 only
+	 * get those elements, so they need no sorting.
+	 */
+	unsigned int run[ARRAY_SORT_MAX_THREADS];
+	/* The number of elements per thread and bucket, then their offsets */
+	unsigned int count[ARRAY_SORT_MAX_THREADS][ARRAY_SORT_MAX_THREADS];
+	/* The offset of every bucket */
+	unsigned int start[ARRAY_SORT_MAX_THREADS + 1];
+};
+
+/* What one thread of a parallel sort does */
+struct array_sort_job {
+	struct array_sort_work *w;
+	enum array_sort_phase phase;
+	unsigned int k;		/* The chunk or bucket to work on */
+};
+#endif
+
+static array array_realloc(array, unsigned int);
+static array array_make_room(array, unsigned int);
+static void array_insertion_sort(gendata *, unsigned int, cmp_func);
+static int array_partial_insertion_sort(gendata *, unsigned int, cmp_func);
+static void array_sort3(gendata *, unsigned int, unsigned int, unsigned int,
+			cmp_func);
+static void array_sift_down(gendata *, unsigned int, unsigned int, cmp_func);
+static void array_heapsort(gendata *, unsigned int, cmp_func);
+static unsigned int array_partition_left(gendata *, unsigned int, cmp_func);
+static unsigned int array_partition_right(gendata *, unsigned int, cmp_func,
+					  int *);
+static void array_pdqsort(gendata *, unsigned int, cmp_func, int, int);
+static void array_introsort(gendata *, unsigned int, cmp_func);
+static void array_radix(gendata *, gendata *, unsigned int, int);
+#ifdef GUNE_THREADS
+static unsigned int array_sort_bucket(struct array_sort_work *, gendata,
+				      unsigned int);
+static void *array_sort_worker(void *);
+static void array_sort_run(struct array_sort_work *, enum array_sort_phase);
+static int array_sort_threaded(gendata *, unsigned int, cmp_func, int,
+			       unsigned int, array_sort_stats_t *);
+#endif
+static array array_sort_parallel_internal(array, cmp_func, int, unsigned int,
+					  array_sort_stats_t *);
+
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 /**
@@ -121,6 +235,55 @@ array_size(array ar)
 }
 
 
+/*
+ * Change the capacity of an array to exactly capacity elements.
+ */
+static array
+array_realloc(array ar, unsigned int capacity)
+{
+	gendata *newptr;	/* Do not corrupt old array in case of error */
+	size_t bytes;
+
+	/* The number of bytes may not fit in a size_t on small machines */
+	bytes = (size_t)capacity * sizeof(gendata);
+	if (bytes / sizeof(gendata) != capacity) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	if ((newptr = realloc(ar->data, bytes)) == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	ar->data = newptr;
+	ar->capacity = capacity;
+
+	return ar;
+}
+
+
+/*
+ * Make sure an array has room for needed elements.  The capacity is at
+ * least doubled, so adding elements one by one takes amortised constant
+ * time, but a large request is met with a single reallocation.
+ */
+static array
+array_make_room(array ar, unsigned int needed)
+{
+	unsigned int capacity;
+
+	if (needed <= ar->capacity)
+		return ar;
+
+	if (ar->capacity > UINT_MAX / 2)
+		capacity = UINT_MAX;
+	else
+		capacity = MAX(ar->capacity * 2, ARRAY_INITIAL_SIZE);
+
+	return array_realloc(ar, MAX(capacity, needed));
+}
+
+
 /**
  * \brief Resize an array.
  *
@@ -142,24 +305,11 @@ array_size(array ar)
 array
 array_resize(array ar, unsigned int size)
 {
-	int newsize;		/* Do not corrupt old array in case of error */
-	gendata *newptr;
-
 	assert(ar != NULL);
 	assert(ar->data != NULL);
 
-	/*
-	 * Use buddy algorithm to resize data buffer if we resized beyond old
-	 *  size.
-	 */
-	if (size > ar->capacity) {
-		newsize = ar->capacity * 2;
-		if ((newptr = realloc(ar->data, newsize * sizeof(gendata)))
-		    == NULL)
-			return NULL;
-		ar->data = newptr;
-		ar->capacity = newsize;
-	}
+	if (array_make_room(ar, size) == NULL)
+		return NULL;
 
 	ar->size = size;
 
@@ -167,6 +317,37 @@ array_resize(array ar, unsigned int size)
 }
 
 
+/**
+ * \brief Make room in an array for a number of elements.
+ *
+ * Afterwards, the array can be grown to \p capacity elements without
+ * allocating memory.  Its size does not change.  Use this before adding
+ * many elements whose number is known in advance.
+ *
+ * \param ar        The array to make room in.
+ * \param capacity  The number of elements to make room for.
+ *
+ * \return  The array given as input, or \c NULL in case of error.
+ *           The old array is still valid if an error occurred.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa array_resize, array_compact, array_append_many
+ */
+array
+array_reserve(array ar, unsigned int capacity)
+{
+	assert(ar != NULL);
+	assert(ar->data != NULL);
+
+	if (capacity <= ar->capacity)
+		return ar;
+
+	return array_realloc(ar, capacity);
+}
+
+
 /**
  * \brief Get the value at an index in an array.
  *
@@ -335,12 +516,56 @@ array_shrink(array ar, int amount)
 array
 array_add(array ar, gendata value)
 {
-	ar = array_grow(ar, 1);
-	if (ar != NULL) {
-		assert(ar->data != NULL);
-		*(ar->data + ar->size - 1) = value;
+	assert(ar != NULL);
+	assert(ar->data != NULL);
+
+	if (ar->size == ar->capacity && array_make_room(ar, ar->size + 1)
+	    == NULL)
+		return NULL;
+
+	*(ar->data + ar->size++) = value;
+
+	return ar;
+}
+
+
+/**
+ * \brief Add a number of elements to the end of an array.
+ *
+ * This is the same as calling array_add on each of them, but the array is
+ * grown at most once and the elements are copied all at once.
+ *
+ * \param ar      The array to add the elements to.
+ * \param values  The values to add to the array.
+ * \param n       The number of values.
+ *
+ * \return    The supplied array, or \c NULL if an error occurred during
+ *            resize.  The old array is still valid.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa array_add, array_reserve
+ */
+array
+array_append_many(array ar, const gendata *values, unsigned int n)
+{
+	assert(ar != NULL);
+	assert(ar->data != NULL);
+	assert(values != NULL || n == 0);
+
+	if (n > UINT_MAX - ar->size) {
+		errno = ENOMEM;
+		return NULL;
 	}
 
+	if (array_make_room(ar, ar->size + n) == NULL)
+		return NULL;
+
+	if (n > 0)
+		memcpy(ar->data + ar->size, values, n * sizeof(gendata));
+	ar->size += n;
+
 	return ar;
 }
 
@@ -366,3 +591,861 @@ array_remove(array ar)
 {
 	return array_shrink(ar, 1);
 }
+
+
+/*
+ * Sort n elements with insertion sort.  This is the fastest way to sort
+ * a handful of elements, and it is stable.
+ */
+static void
+array_insertion_sort(gendata *a, unsigned int n, cmp_func cmp)
+{
+	unsigned int i, j;
+	gendata t;
+
+	for (i = 1; i < n; ++i) {
+		if (cmp(a[i], a[i - 1]) >= 0)
+			continue;
+
+		t = a[i];
+		j = i;
+		do {
+			a[j] = a[j - 1];
+			--j;
+		} while (j > 0 && cmp(t, a[j - 1]) < 0);
+		a[j] = t;
+	}
+}
+
+
+/*
+ * Sort n elements with insertion sort, but give up once more than a few
+ * elements had to be moved.  Returns nonzero if the elements got sorted.
+ */
+static int
+array_partial_insertion_sort(gendata *a, unsigned int n, cmp_func cmp)
+{
+	unsigned int i, j, moved = 0;
+	gendata t;
+
+	for (i = 1; i < n; ++i) {
+		if (moved > ARRAY_SORT_PARTIAL)
+			return 0;
+
+		if (cmp(a[i], a[i - 1]) >= 0)
+			continue;
+
+		t = a[i];
+		j = i;
+		do {
+			a[j] = a[j - 1];
+			--j;
+		} while (j > 0 && cmp(t, a[j - 1]) < 0);
+		a[j] = t;
+		moved += i - j;
+	}
+
+	return 1;
+}
+
+
+/*
+ * Order the elements at i, j and k.
+ */
+static void
+array_sort3(gendata *a, unsigned int i, unsigned int j, unsigned int k,
+	    cmp_func cmp)
+{
+	if (cmp(a[j], a[i]) < 0)
+		SWAP(gendata, a[i], a[j]);
+	if (cmp(a[k], a[j]) < 0) {
+		SWAP(gendata, a[j], a[k]);
+		if (cmp(a[j], a[i]) < 0)
+			SWAP(gendata, a[i], a[j]);
+	}
+}
+
+
+/*
+ * Move the element at i down the heap of n elements until both its
+ * children are smaller.
+ */
+static void
+array_sift_down(gendata *a, unsigned int i, unsigned int n, cmp_func cmp)
+{
+	unsigned int c;
+	gendata t;
+
+	t = a[i];
+	while (i < n / 2) {
+		c = 2 * i + 1;
+		if (c + 1 < n && cmp(a[c], a[c + 1]) < 0)
+			++c;
+		if (cmp(t, a[c]) >= 0)
+			break;
+		a[i] = a[c];
+		i = c;
+	}
+	a[i] = t;
+}
+
+
+/*
+ * Sort n elements with heapsort.  This is slower than quicksort on the
+ * average, but it is never quadratic.
+ */
+static void
+array_heapsort(gendata *a, unsigned int n, cmp_func cmp)
+{
+	unsigned int i;
+
+	for (i = n / 2; i-- > 0;)
+		array_sift_down(a, i, n, cmp);
+
+	for (i = n; i-- > 1;) {
+		SWAP(gendata, a[0], a[i]);
+		array_sift_down(a, 0, i, cmp);
+	}
+}
+
+
+/*
+ * Partition n elements around the pivot in a[0], moving the elements which
+ * are equal to the pivot to the left part.  This is only used when there
+ * is an element equal to the pivot just before a, so the pivot is the
+ * smallest element and the left part can be skipped altogether.  Returns
+ * the position the pivot ends up at.
+ */
+static unsigned int
+array_partition_left(gendata *a, unsigned int n, cmp_func cmp)
+{
+	unsigned int first = 0, last = n;
+	gendata pivot;
+
+	pivot = a[0];
+
+	/* a[0] is the pivot itself, so this scan stops */
+	while (cmp(pivot, a[--last]) < 0)
+		;
+
+	if (last + 1 == n)
+		while (first < last && cmp(pivot, a[++first]) >= 0)
+			;
+	else
+		while (cmp(pivot, a[++first]) >= 0)
+			;
+
+	while (first < last) {
+		SWAP(gendata, a[first], a[last]);
+		while (cmp(pivot, a[--last]) < 0)
+			;
+		while (cmp(pivot, a[++first]) >= 0)
+			;
+	}
+
+	a[0] = a[last];
+	a[last] = pivot;
+
+	return last;
+}
+
+
+/*
+ * Partition n elements around the pivot in a[0], moving the elements which
+ * are equal to the pivot to the right part.  Returns the position the
+ * pivot ends up at, and sets *already if no elements had to be swapped.
+ */
+static unsigned int
+array_partition_right(gendata *a, unsigned int n, cmp_func cmp, int *already)
+{
+	unsigned int first = 0, last = n;
+	gendata pivot;
+
+	pivot = a[0];
+
+	/*
+	 * The pivot was picked as a median, so there is an element at the
+	 * end which is not less than it, and this scan stops.
+	 */
+	while (cmp(a[++first], pivot) < 0)
+		;
+
+	/* Unless the scan above stopped at once, this one is guarded too */
+	if (first == 1)
+		while (first < last && cmp(a[--last], pivot) >= 0)
+			;
+	else
+		while (cmp(a[--last], pivot) >= 0)
+			;
+
+	*already = first >= last;
+
+	while (first < last) {
+		SWAP(gendata, a[first], a[last]);
+		while (cmp(a[++first], pivot) < 0)
+			;
+		while (cmp(a[--last], pivot) >= 0)
+			;
+	}
+
+	a[0] = a[first - 1];
+	a[first - 1] = pivot;
+
+	return first - 1;
+}
+
+
+/*
+ * Sort n elements with pattern-defeating quicksort.  This is an introsort:
+ * a quicksort which falls back to heapsort once it has made bad_allowed
+ * unbalanced partitions.  It sorts runs of equal elements in linear time,
+ * and when a partition needed no swaps it tries to finish the parts with
+ * insertion sort, which makes sorted and reversed input linear as well.
+ * leftmost is zero if there is an element before a which is not greater
+ * than any of the elements to sort.
+ */
+static void
+array_pdqsort(gendata *a, unsigned int n, cmp_func cmp, int bad_allowed,
+	      int leftmost)
+{
+	unsigned int s2, p, l, r;
+	int already;
+
+	for (;;) {
+		if (n < ARRAY_SORT_INSERTION) {
+			array_insertion_sort(a, n, cmp);
+			return;
+		}
+
+		/* Move the median of three or the ninther to a[0] */
+		s2 = n / 2;
+		if (n > ARRAY_SORT_NINTHER) {
+			array_sort3(a, 0, s2, n - 1, cmp);
+			array_sort3(a, 1, s2 - 1, n - 2, cmp);
+			array_sort3(a, 2, s2 + 1, n - 3, cmp);
+			array_sort3(a, s2 - 1, s2, s2 + 1, cmp);
+			SWAP(gendata, a[0], a[s2]);
+		} else {
+			array_sort3(a, s2, 0, n - 1, cmp);
+		}
+
+		/*
+		 * If the element before these is equal to the pivot, then so
+		 * are all elements which are not greater than the pivot.  They
+		 * need no further sorting.
+		 */
+		if (!leftmost && cmp(a[-1], a[0]) >= 0) {
+			p = array_partition_left(a, n, cmp);
+			a += p + 1;
+			n -= p + 1;
+			continue;
+		}
+
+		p = array_partition_right(a, n, cmp, &already);
+		l = p;
+		r = n - p - 1;
+
+		if (l < n / 8 || r < n / 8) {
+			if (--bad_allowed == 0) {
+				array_heapsort(a, n, cmp);
+				return;
+			}
+
+			/* Shuffle some elements to break up the pattern */
+			if (l >= ARRAY_SORT_INSERTION) {
+				SWAP(gendata, a[0], a[l / 4]);
+				SWAP(gendata, a[p - 1], a[p - l / 4]);
+				if (l > ARRAY_SORT_NINTHER) {
+					SWAP(gendata, a[1], a[l / 4 + 1]);
+					SWAP(gendata, a[2], a[l / 4 + 2]);
+					SWAP(gendata, a[p - 2],
+					     a[p - (l / 4 + 1)]);
+					SWAP(gendata, a[p - 3],
+					     a[p - (l / 4 + 2)]);
+				}
+			}
+			if (r >= ARRAY_SORT_INSERTION) {
+				SWAP(gendata, a[p + 1], a[p + 1 + r / 4]);
+				SWAP(gendata, a[n - 1], a[n - r / 4]);
+				if (r > ARRAY_SORT_NINTHER) {
+					SWAP(gendata, a[p + 2],
+					     a[p + 2 + r / 4]);
+					SWAP(gendata, a[p + 3],
+					     a[p + 3 + r / 4]);
+					SWAP(gendata, a[n - 2],
+					     a[n - (1 + r / 4)]);
+					SWAP(gendata, a[n - 3],
+					     a[n - (2 + r / 4)]);
+				}
+			}
+		} else if (already &&
+			   array_partial_insertion_sort(a, l, cmp) &&
+			   array_partial_insertion_sort(a + p + 1, r, cmp)) {
+			return;
+		}
+
+		/* Recurse into the smaller part, so the stack stays small */
+		if (l < r) {
+			array_pdqsort(a, l, cmp, bad_allowed, leftmost);
+			a += p + 1;
+			n = r;
+			leftmost = 0;
+		} else {
+			array_pdqsort(a + p + 1, r, cmp, bad_allowed, 0);
+			n = l;
+		}
+	}
+}
+
+
+/*
+ * Sort n elements with pattern-defeating quicksort, allowing it as many bad
+ * partitions as the logarithm of n.
+ */
+static void
+array_introsort(gendata *a, unsigned int n, cmp_func cmp)
+{
+	unsigned int m;
+	int bad_allowed = 0;
+
+	for (m = n; m > 1; m >>= 1)
+		++bad_allowed;
+
+	array_pdqsort(a, n, cmp, bad_allowed, 1);
+}
+
+
+/**
+ * \brief Sort the elements of an array.
+ *
+ * This uses pattern-defeating quicksort, which takes O(n log n) time even
+ * in the worst case, and linear time on input which is sorted, reversed
+ * or has only a few distinct elements.  It needs no extra memory.  The sort
+ * is not stable: equal elements may end up in any order.
+ *
+ * \param ar   The array to sort.
+ * \param cmp  The function which orders the elements.
+ *
+ * \return  The supplied array.
+ *
+ * \sa array_sort_num, array_sort_posnum, num_cmp, posnum_cmp, sym_cmp,
+ *     str_cmp
+ */
+array
+array_sort(array ar, cmp_func cmp)
+{
+	assert(ar != NULL);
+	assert(ar->data != NULL);
+	assert(cmp != NULL);
+
+	array_introsort(ar->data, ar->size, cmp);
+
+	return ar;
+}
+
+
+/*
+ * Sort n elements on their num (if sgn is nonzero) or posnum field with an
+ * LSD radix sort.  This needs no comparisons at all, and takes a pass over
+ * the data for each byte of the keys.  Passes on a byte which is the same
+ * in all keys are skipped, so small numbers are sorted in fewer passes.
+ * tmp is room for n elements to sort into, or NULL to allocate it here.
+ */
+static void
+array_radix(gendata *a, gendata *tmp, unsigned int n, int sgn)
+{
+	unsigned int count[ARRAY_RADIX_PASSES][ARRAY_RADIX_BUCKETS];
+	unsigned int i, d, k, prev, sum, shift;
+	gendata *src, *dst, *mem = NULL;
+	int sorted = 1;
+
+	if (n < ARRAY_RADIX_MIN) {
+		array_insertion_sort(a, n, sgn ? num_cmp : posnum_cmp);
+		return;
+	}
+
+	/* Count all digits in a single pass, and see if the work is done */
+	memset(count, 0, sizeof(count));
+	prev = ARRAY_RADIX_KEY(a[0], sgn);
+	for (i = 0; i < n; ++i) {
+		k = ARRAY_RADIX_KEY(a[i], sgn);
+		sorted &= prev <= k;
+		prev = k;
+		for (d = 0; d < ARRAY_RADIX_PASSES; ++d)
+			++count[d][(k >> (d * ARRAY_RADIX_BITS)) &
+				   (ARRAY_RADIX_BUCKETS - 1)];
+	}
+
+	if (sorted)
+		return;
+
+	/* Without room to sort into, sort in place instead */
+	if (tmp == NULL && (tmp = mem = malloc(n * sizeof(gendata))) == NULL) {
+		array_introsort(a, n, sgn ? num_cmp : posnum_cmp);
+		return;
+	}
+
+	src = a;
+	dst = tmp;
+	for (d = 0; d < ARRAY_RADIX_PASSES; ++d) {
+		shift = d * ARRAY_RADIX_BITS;
+		k = ARRAY_RADIX_KEY(src[0], sgn);
+		if (count[d][(k >> shift) & (ARRAY_RADIX_BUCKETS - 1)] == n)
+			continue;
+
+		/* Turn the counts into the positions of the buckets */
+		for (sum = 0, i = 0; i < ARRAY_RADIX_BUCKETS; ++i) {
+			k = count[d][i];
+			count[d][i] = sum;
+			sum += k;
+		}
+
+		for (i = 0; i < n; ++i) {
+			k = ARRAY_RADIX_KEY(src[i], sgn);
+			dst[count[d][(k >> shift) &
+				     (ARRAY_RADIX_BUCKETS - 1)]++] = src[i];
+		}
+		SWAP(gendata *, src, dst);
+	}
+
+	if (src != a)
+		memcpy(a, src, n * sizeof(gendata));
+	free(mem);
+}
+
+
+/**
+ * \brief Sort the elements of an array of signed integers.
+ *
+ * This sorts on the \c num field of the elements, like array_sort with
+ * num_cmp, but it uses a radix sort which needs no comparisons.  This is
+ * much faster on large arrays.
+ *
+ * \note
+ * The radix sort needs room for a copy of the elements.  If there is not
+ * enough memory for that, this falls back to array_sort.
+ *
+ * \param ar  The array to sort.
+ *
+ * \return  The supplied array.
+ *
+ * \sa array_sort, array_sort_posnum
+ */
+array
+array_sort_num(array ar)
+{
+	assert(ar != NULL);
+	assert(ar->data != NULL);
+
+	array_radix(ar->data, NULL, ar->size, 1);
+
+	return ar;
+}
+
+
+/**
+ * \brief Sort the elements of an array of unsigned integers.
+ *
+ * This sorts on the \c posnum field of the elements, like array_sort with
+ * posnum_cmp, but it uses a radix sort which needs no comparisons.
+ *
+ * \param ar  The array to sort.
+ *
+ * \return  The supplied array.
+ *
+ * \sa array_sort_num
+ */
+array
+array_sort_posnum(array ar)
+{
+	assert(ar != NULL);
+	assert(ar->data != NULL);
+
+	array_radix(ar->data, NULL, ar->size, 0);
+
+	return ar;
+}
+
+
+#ifdef GUNE_THREADS
+/*
+ * Find the bucket the element at index i belongs to: the number of
+ * splitters which are less than the element.  If the element is equal to
+ * a run of splitters, it goes to one of their buckets by its index
+ * instead.  Otherwise all elements equal to the run would end up in the
+ * first bucket, and with few distinct elements one thread would sort
+ * most of them.
+ */
+static unsigned int
+array_sort_bucket(struct array_sort_work *w, gendata x, unsigned int i)
+{
+	unsigned int lo = 0, len = w->nthreads - 1, half, k;
+
+	if (w->cmp != NULL) {
+		while (len > 0) {
+			half = len / 2;
+			if (w->cmp(w->splitter[lo + half], x) < 0) {
+				lo += half + 1;
+				len -= half + 1;
+			} else {
+				len = half;
+			}
+		}
+		if (w->run[lo] > 1 && w->cmp(w->splitter[lo], x) == 0)
+			lo += i % w->run[lo];
+	} else {
+		k = ARRAY_RADIX_KEY(x, w->sgn);
+		while (len > 0) {
+			half = len / 2;
+			if (w->key[lo + half] < k) {
+				lo += half + 1;
+				len -= half + 1;
+			} else {
+				len = half;
+			}
+		}
+		if (w->run[lo] > 1 && w->key[lo] == k)
+			lo += i % w->run[lo];
+	}
+
+	return lo;
+}
+
+
+/*
+ * Thread which does its part of one phase of a parallel sort.  In the first
+ * two phases, thread k works on the k-th chunk of the elements.  In the
+ * last one, it sorts bucket k.
+ */
+static void *
+array_sort_worker(void *arg)
+{
+	struct array_sort_job *job = arg;
+	struct array_sort_work *w = job->w;
+	unsigned int offset[ARRAY_SORT_MAX_THREADS];
+	unsigned int i, b, first, last, chunk;
+
+	chunk = w->n / w->nthreads;
+	first = job->k * chunk;
+	last = (job->k + 1 == w->nthreads) ? w->n : first + chunk;
+
+	switch (job->phase) {
+	case ARRAY_SORT_COUNT:
+		/* Count locally, other threads use the neighbouring counts */
+		memset(offset, 0, sizeof(offset));
+		for (i = first; i < last; ++i) {
+			b = array_sort_bucket(w, w->data[i], i);
+			w->bucket[i] = (unsigned char)b;
+			++offset[b];
+		}
+		for (b = 0; b < w->nthreads; ++b)
+			w->count[job->k][b] = offset[b];
+		break;
+
+	case ARRAY_SORT_SCATTER:
+		for (b = 0; b < w->nthreads; ++b)
+			offset[b] = w->count[job->k][b];
+		for (i = first; i < last; ++i)
+			w->tmp[offset[w->bucket[i]]++] = w->data[i];
+		break;
+
+	case ARRAY_SORT_BUCKETS:
+		first = w->start[job->k];
+		last = w->start[job->k + 1];
+		memcpy(w->data + first, w->tmp + first,
+		       (last - first) * sizeof(gendata));
+		if (w->run[job->k] == 0)
+			break;		/* All elements are equal */
+		if (w->cmp != NULL)
+			array_introsort(w->data + first, last - first, w->cmp);
+		else
+			array_radix(w->data + first, w->tmp + first,
+				    last - first, w->sgn);
+		break;
+	}
+
+	return NULL;
+}
+
+
+/*
+ * Run one phase of a parallel sort on all threads.
+ */
+static void
+array_sort_run(struct array_sort_work *w, enum array_sort_phase phase)
+{
+	struct array_sort_job job[ARRAY_SORT_MAX_THREADS];
+	pthread_t thread[ARRAY_SORT_MAX_THREADS];
+	int started[ARRAY_SORT_MAX_THREADS];
+	unsigned int k;
+
+	for (k = 0; k < w->nthreads; ++k) {
+		job[k].w = w;
+		job[k].phase = phase;
+		job[k].k = k;
+
+		/* If we can't start a thread, do its work ourselves */
+		started[k] = (pthread_create(&thread[k], NULL,
+					     array_sort_worker, &job[k]) == 0);
+		if (!started[k])
+			array_sort_worker(&job[k]);
+	}
+
+	for (k = 0; k < w->nthreads; ++k)
+		if (started[k])
+			pthread_join(thread[k], NULL);
+}
+
+
+/*
+ * Sort n elements with a parallel sample sort on nthreads threads.  The
+ * elements are divided over one bucket per thread by splitters picked from
+ * a sample, so the buckets are about the same size.  Then each thread
+ * sorts one bucket with the sequential sort.  The sizes of the buckets go
+ * in stats, if that isn't NULL.  Returns 0 if there is not enough memory.
+ */
+static int
+array_sort_threaded(gendata *a, unsigned int n, cmp_func cmp, int sgn,
+		    unsigned int nthreads, array_sort_stats_t *stats)
+{
+	struct array_sort_work *w;
+	unsigned int i, k, b, t, sum, len, nsamples;
+
+	if ((w = malloc(sizeof(struct array_sort_work))) == NULL)
+		return 0;
+	w->tmp = malloc(n * sizeof(gendata));
+	w->bucket = malloc(n);
+	if (w->tmp == NULL || w->bucket == NULL) {
+		free(w->tmp);
+		free(w->bucket);
+		free(w);
+		return 0;
+	}
+
+	w->data = a;
+	w->n = n;
+	w->nthreads = nthreads;
+	w->cmp = cmp;
+	w->sgn = sgn;
+
+	/*
+	 * Pick the splitters from a sorted sample.  Scrambled indices make
+	 * the sample representative, even if the input has a pattern.
+	 */
+	nsamples = nthreads * ARRAY_SORT_OVERSAMPLE;
+	for (i = 0; i < nsamples; ++i)
+		w->tmp[i] = a[hash_reduce(hash_mix(i), n)];
+	if (cmp == NULL)
+		cmp = sgn ? num_cmp : posnum_cmp;
+	array_introsort(w->tmp, nsamples, cmp);
+	for (b = 0; b + 1 < nthreads; ++b) {
+		w->splitter[b] = w->tmp[(b + 1) * ARRAY_SORT_OVERSAMPLE];
+		w->key[b] = ARRAY_RADIX_KEY(w->splitter[b], sgn);
+	}
+
+	/* With few distinct elements, many splitters are equal */
+	w->run[nthreads - 1] = 1;
+	for (len = 1, b = nthreads - 1; b-- > 0;) {
+		if (b + 2 < nthreads &&
+		    cmp(w->splitter[b], w->splitter[b + 1]) == 0) {
+			++len;
+			w->run[b + 1] = 0;
+		} else {
+			len = 1;
+		}
+		w->run[b] = len;
+	}
+
+	array_sort_run(w, ARRAY_SORT_COUNT);
+
+	/* Each thread puts its part of a bucket after those before it */
+	for (sum = 0, b = 0; b < nthreads; ++b) {
+		w->start[b] = sum;
+		for (t = 0; t < nthreads; ++t) {
+			k = w->count[t][b];
+			w->count[t][b] = sum;
+			sum += k;
+		}
+	}
+	w->start[nthreads] = n;
+
+	array_sort_run(w, ARRAY_SORT_SCATTER);
+	array_sort_run(w, ARRAY_SORT_BUCKETS);
+
+	if (stats != NULL) {
+		stats->nthreads = nthreads;
+		for (b = 0; b < nthreads; ++b)
+			stats->bucket[b] = w->start[b + 1] - w->start[b];
+	}
+
+	free(w->tmp);
+	free(w->bucket);
+	free(w);
+
+	return 1;
+}
+#endif /* GUNE_THREADS */
+
+
+/*
+ * Internal function which the parallel sorts call.  cmp is NULL for the
+ * radix sorts.  stats is where to report how the work was divided, or NULL.
+ */
+static array
+array_sort_parallel_internal(array ar, cmp_func cmp, int sgn,
+			     unsigned int nthreads, array_sort_stats_t *stats)
+{
+#ifdef GUNE_THREADS
+#ifdef _SC_NPROCESSORS_ONLN
+	long ncpus;
+#endif
+
+	if (nthreads == 0) {
+		nthreads = ARRAY_SORT_THREADS;
+#ifdef _SC_NPROCESSORS_ONLN
+		if ((ncpus = sysconf(_SC_NPROCESSORS_ONLN)) > 0)
+			nthreads = (unsigned int)MIN(ncpus,
+						     ARRAY_SORT_MAX_THREADS);
+#endif
+	}
+
+	/* Each thread must have enough work to be worth starting */
+	nthreads = MIN(nthreads, ARRAY_SORT_MAX_THREADS);
+	nthreads = MIN(nthreads, ar->size / ARRAY_SORT_PARALLEL_MIN);
+
+	if (nthreads > 1 &&
+	    array_sort_threaded(ar->data, ar->size, cmp, sgn, nthreads, stats))
+		return ar;
+#else
+	(void)nthreads;
+#endif
+
+	if (cmp != NULL)
+		array_introsort(ar->data, ar->size, cmp);
+	else
+		array_radix(ar->data, NULL, ar->size, sgn);
+
+	if (stats != NULL) {
+		stats->nthreads = 1;
+		stats->bucket[0] = ar->size;
+	}
+
+	return ar;
+}
+
+
+/**
+ * \brief Sort the elements of an array with several threads.
+ *
+ * This sorts like array_sort, but with a parallel sample sort.  The
+ * elements are divided over one bucket per thread, using a sample of them
+ * to make the buckets about the same size.  Then every thread sorts one
+ * bucket with array_sort's algorithm.  Arrays which are too small to give
+ * every thread enough work are sorted with fewer threads, or with
+ * array_sort.  So is every array if Gune was built without threads.
+ *
+ * \note
+ * The parallel sort needs room for a copy of the elements.  If there is not
+ * enough memory for that, this falls back to array_sort.
+ *
+ * \param ar        The array to sort.
+ * \param cmp       The function which orders the elements.  It is called by
+ *		      several threads at once.
+ * \param nthreads  The number of threads to use, or 0 to use one for each
+ *		      CPU.
+ *
+ * \return  The supplied array.
+ *
+ * \sa array_sort, array_sort_num_parallel, array_sort_posnum_parallel,
+ *     array_sort_parallel_stats
+ */
+array
+array_sort_parallel(array ar, cmp_func cmp, unsigned int nthreads)
+{
+	assert(ar != NULL);
+	assert(ar->data != NULL);
+	assert(cmp != NULL);
+
+	return array_sort_parallel_internal(ar, cmp, 0, nthreads, NULL);
+}
+
+
+/**
+ * \brief Sort the elements of an array with several threads, and report
+ * how the work was divided.
+ *
+ * This is array_sort_parallel, which also gives the number of threads it
+ * used and the number of elements each of them sorted.  This is useful to
+ * check whether the buckets came out about the same size, and to tune
+ * the number of threads.
+ *
+ * \param ar        The array to sort.
+ * \param cmp       The function which orders the elements.  It is called by
+ *		      several threads at once.
+ * \param nthreads  The number of threads to use, or 0 to use one for each
+ *		      CPU.
+ * \param stats     Where to store how the work was divided.  If the array
+ *		      was sorted by a single thread, its \c nthreads is 1.
+ *
+ * \return  The supplied array.
+ *
+ * \sa array_sort_parallel
+ */
+array
+array_sort_parallel_stats(array ar, cmp_func cmp, unsigned int nthreads,
+			  array_sort_stats_t *stats)
+{
+	assert(ar != NULL);
+	assert(ar->data != NULL);
+	assert(cmp != NULL);
+	assert(stats != NULL);
+
+	return array_sort_parallel_internal(ar, cmp, 0, nthreads, stats);
+}
+
+
+/**
+ * \brief Sort the elements of an array of signed integers with several
+ * threads.
+ *
+ * This is array_sort_parallel for array_sort_num: every thread sorts its
+ * bucket with a radix sort.
+ *
+ * \param ar        The array to sort.
+ * \param nthreads  The number of threads to use, or 0 to use one for each
+ *		      CPU.
+ *
+ * \return  The supplied array.
+ *
+ * \sa array_sort_num, array_sort_parallel
+ */
+array
+array_sort_num_parallel(array ar, unsigned int nthreads)
+{
+	assert(ar != NULL);
+	assert(ar->data != NULL);
+
+	return array_sort_parallel_internal(ar, NULL, 1, nthreads, NULL);
+}
+
+
+/**
+ * \brief Sort the elements of an array of unsigned integers with several
+ * threads.
+ *
+ * \param ar        The array to sort.
+ * \param nthreads  The number of threads to use, or 0 to use one for each
+ *		      CPU.
+ *
+ * \return  The supplied array.
+ *
+ * \sa array_sort_posnum, array_sort_num_parallel
+ */
+array
+array_sort_posnum_parallel(array ar, unsigned int nthreads)
+{
+	assert(ar != NULL);
+	assert(ar->data != NULL);
+
+	return array_sort_parallel_internal(ar, NULL, 0, nthreads, NULL);
+}
@@ -50,17 +50,37 @@ typedef struct array_t {
 	unsigned int capacity;	/**< The capacity (`real' size) of the array */
 } array_t, *array;
 
+/** Compile-time option of the most threads a parallel sort uses */
+#define ARRAY_SORT_MAX_THREADS	64
+
+/** \brief How a parallel sort divided its work */
+typedef struct array_sort_stats_t {
+	unsigned int nthreads;	/**< The number of threads which sorted */
+	/** The number of elements each thread sorted */
+	unsigned int bucket[ARRAY_SORT_MAX_THREADS];
+} array_sort_stats_t;
+
 array array_create(void);
 void array_destroy(array, free_func);
 unsigned int array_size(array);
 array array_resize(array, unsigned int);
+array array_reserve(array, unsigned int);
 gendata array_get_data(array, unsigned int);
 array array_set_data(array, unsigned int, gendata);
 array array_compact(array);
 array array_grow(array, int);
 array array_shrink(array, int);
 array array_add(array, gendata);
+array array_append_many(array, const gendata *, unsigned int);
 array array_remove(array);
+array array_sort(array, cmp_func);
+array array_sort_num(array);
+array array_sort_posnum(array);
+array array_sort_parallel(array, cmp_func, unsigned int);
+array array_sort_parallel_stats(array, cmp_func, unsigned int,
+				array_sort_stats_t *);
+array array_sort_num_parallel(array, unsigned int);
+array array_sort_posnum_parallel(array, unsigned int);
 
 #ifdef __cplusplus
 }
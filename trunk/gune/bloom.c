@@ -0,0 +1,276 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief Bloom filters implementation.
+ *
+ * \file bloom.c
+ * A Bloom filter remembers a set of hash values in a bit array, by setting
+ * k bits for every value.  Checking a value which was added always finds
+ * all its bits set.  Checking one which wasn't usually finds at least one
+ * of them clear, which proves it was never added.  The fraction of values
+ * for which that fails is the false positive rate.
+ *
+ * These filters are blocked: the bits of a hash value all lie in one block
+ * of BLOOM_BLOCK_BITS bits, which is a cache line on most machines.  This
+ * costs a little accuracy compared to spreading the bits over the whole
+ * array, but a check reads one cache line instead of k.
+ *
+ * The hash values are used as they are, so they should be well mixed, for
+ * example by hash_mix.  Values can't be removed from a filter, only all of
+ * them at once.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gune/bloom.h>
+
+/** The number of bits in a block, which is one cache line */
+#define BLOOM_BLOCK_BITS	512
+
+/** The number of bits in a word of the bit array */
+#define BLOOM_WORD_BITS		(CHAR_BIT * sizeof(unsigned long))
+
+/** The number of words in a block */
+#define BLOOM_BLOCK_WORDS	(BLOOM_BLOCK_BITS / BLOOM_WORD_BITS)
+
+/** The number of bytes in a block */
+#define BLOOM_BLOCK_BYTES	(BLOOM_BLOCK_BITS / CHAR_BIT)
+
+/** The most bits set per hash value */
+#define BLOOM_MAX_K		16
+
+static double bloom_log2(double);
+static unsigned long *bloom_block(bloom, hashval, unsigned long *);
+
+/*
+ * Internal function to calculate an approximation of the base 2 logarithm
+ * of a number of at least 1, which is close enough for sizing filters.
+ */
+static double
+bloom_log2(double x)
+{
+	double l = 0.0;
+
+	assert(x >= 1.0);
+
+	while (x >= 2.0) {
+		x /= 2.0;
+		l += 1.0;
+	}
+
+	/* Quadratic fit of log2 on [1, 2), exact at both ends */
+	x -= 1.0;
+	return l + x * (1.3466 - 0.3466 * x);
+}
+
+
+/*
+ * Internal function to find the block of a hash value.  The bits used for
+ * the positions within the block are stored in pos.
+ */
+static unsigned long *
+bloom_block(bloom b, hashval hash, unsigned long *pos)
+{
+	unsigned long nr;
+
+#if ULONG_MAX > 0xFFFFFFFFUL
+	nr = ((hash >> 32) * b->nblocks) >> 32;
+	*pos = hash & 0xFFFFFFFFUL;
+#else
+	nr = hash % b->nblocks;
+	/* The low bits of hash went into nr, so take them from a product */
+	*pos = (hash * 0x9E3779B1UL) >> 12;
+#endif
+
+	return b->bits + nr * BLOOM_BLOCK_WORDS;
+}
+
+
+/**
+ * \brief Create a new empty Bloom filter.
+ *
+ * \param n   The number of hash values the filter should hold.  When more
+ *		are added, the false positive rate goes up.
+ * \param fp  The false positive rate the filter should have when it holds
+ *		\p n values, between 0 and 1.  Halving this costs about 1.44
+ *		bits per value.
+ *
+ * \return  A new empty Bloom filter object, or \c NULL if an error occurred.
+ *
+ * \par Errno values:
+ * - \b EINVAL if \p fp is not between 0 and 1.
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa bloom_destroy
+ */
+bloom
+bloom_create(unsigned int n, double fp)
+{
+	bloom_t *b;
+	double bits, log_fp;
+	unsigned long addr;
+
+	if (fp <= 0.0 || fp >= 1.0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (n == 0)
+		n = 1;
+
+	/* The optimal filter sets log2(1/fp) bits using 1.44 times that */
+	log_fp = bloom_log2(1.0 / fp);
+	bits = 1.44 * log_fp * n;
+	if (bits / BLOOM_BLOCK_BITS >= UINT_MAX / BLOOM_BLOCK_BYTES) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	if ((b = malloc(sizeof(bloom_t))) == NULL)
+		return NULL;
+
+	b->nblocks = (unsigned int)(bits / BLOOM_BLOCK_BITS) + 1;
+	b->k = (unsigned int)(log_fp + 0.5);
+	if (b->k < 1)
+		b->k = 1;
+	if (b->k > BLOOM_MAX_K)
+		b->k = BLOOM_MAX_K;
+
+	/* Room to align the blocks to cache lines */
+	b->mem = malloc((b->nblocks + 1) * BLOOM_BLOCK_BYTES);
+	if (b->mem == NULL) {
+		free(b);
+		return NULL;
+	}
+
+	addr = (unsigned long)b->mem;
+	addr = (addr + BLOOM_BLOCK_BITS / CHAR_BIT - 1) &
+		~(unsigned long)(BLOOM_BLOCK_BITS / CHAR_BIT - 1);
+	b->bits = (unsigned long *)addr;
+
+	bloom_clear(b);
+
+	return (bloom)b;
+}
+
+
+/**
+ * \brief Free all memory allocated for a Bloom filter.
+ *
+ * \param b  The Bloom filter to destroy.
+ *
+ * \sa bloom_create
+ */
+void
+bloom_destroy(bloom b)
+{
+	assert(b != NULL);
+
+	free(b->mem);
+	free(b);
+}
+
+
+/**
+ * \brief Add a hash value to a Bloom filter.
+ *
+ * \param b     The Bloom filter to add the value to.
+ * \param hash  The hash value.
+ *
+ * \sa bloom_check
+ */
+void
+bloom_add(bloom b, hashval hash)
+{
+	unsigned long *block, pos, step;
+	unsigned int i, bit;
+
+	assert(b != NULL);
+
+	block = bloom_block(b, hash, &pos);
+
+	/* An odd step visits k different bits of the block */
+	step = ((pos >> 9) & (BLOOM_BLOCK_BITS - 1)) | 1;
+	for (i = 0; i < b->k; ++i) {
+		bit = (unsigned int)(pos + i * step) & (BLOOM_BLOCK_BITS - 1);
+		block[bit / BLOOM_WORD_BITS] |= 1UL << (bit % BLOOM_WORD_BITS);
+	}
+}
+
+
+/**
+ * \brief Check whether a hash value may have been added to a Bloom filter.
+ *
+ * \param b     The Bloom filter to check.
+ * \param hash  The hash value.
+ *
+ * \return  0 if the value was certainly never added, nonzero if it
+ *	     probably was.
+ *
+ * \sa bloom_add
+ */
+int
+bloom_check(bloom b, hashval hash)
+{
+	unsigned long *block, pos, step;
+	unsigned int i, bit;
+
+	assert(b != NULL);
+
+	block = bloom_block(b, hash, &pos);
+
+	step = ((pos >> 9) & (BLOOM_BLOCK_BITS - 1)) | 1;
+	for (i = 0; i < b->k; ++i) {
+		bit = (unsigned int)(pos + i * step) & (BLOOM_BLOCK_BITS - 1);
+		if ((block[bit / BLOOM_WORD_BITS] &
+		     (1UL << (bit % BLOOM_WORD_BITS))) == 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+
+/**
+ * \brief Remove all hash values from a Bloom filter.
+ *
+ * \param b  The Bloom filter to clear.
+ */
+void
+bloom_clear(bloom b)
+{
+	assert(b != NULL);
+
+	memset(b->bits, 0, (size_t)b->nblocks * BLOOM_BLOCK_BYTES);
+}
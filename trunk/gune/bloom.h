@@ -0,0 +1,64 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief Bloom filters interface.
+ *
+ * \file bloom.h
+ */
+#ifndef GUNE_BLOOM_H
+#define GUNE_BLOOM_H
+
+#include <gune/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Blocked Bloom filter implementation */
+typedef struct bloom_t {
+	unsigned long *bits;	/**< The blocks of bits, aligned on a block */
+	void *mem;		/**< The memory bits points into */
+	unsigned int nblocks;	/**< The number of blocks */
+	unsigned int k;		/**< The number of bits set per hash value */
+} bloom_t, *bloom;
+
+bloom bloom_create(unsigned int, double);
+void bloom_destroy(bloom);
+void bloom_add(bloom, hashval);
+int bloom_check(bloom, hashval);
+void bloom_clear(bloom);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GUNE_BLOOM_H */
@@ -0,0 +1,523 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief CLOCK caches implementation.
+ *
+ * \file ccache.c
+ * A CLOCK cache is a bounded cache like lru, which only approximates the
+ * least recently used policy.  Instead of moving entries to the front of a
+ * list on every use, its entries sit in a fixed place in an array of slots,
+ * and using an entry only sets the reference bit in its slot.  To evict an
+ * entry, a clock hand sweeps the slots, clearing the reference bits it
+ * comes across until it finds an entry whose bit was already clear.  Every
+ * bit the hand clears pays for one use, so eviction is constant time when
+ * amortized.
+ *
+ * This means a hit writes a single byte and touches no other entry, so
+ * caches which see many more hits than misses are cheaper to keep than
+ * with lru.  The price is that eviction is less precise: any entry which
+ * wasn't used since the hand last passed it may go, not just the oldest.
+ *
+ * The hash table maps keys onto slot numbers.  Free slots are chained
+ * through their values, and the array grows when none are left.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <gune/ccache.h>
+
+/** Slot number which marks the end of the free list */
+#define CCACHE_NONE		UINT_MAX
+
+/** The number of slots a new cache starts out with */
+#define CCACHE_DEFAULT_SLOTS	16
+
+static ccache ccache_grow(ccache);
+static void ccache_drop(ccache, unsigned int, eq_func);
+static void ccache_sweep(ccache, eq_func, unsigned int);
+static ccache_slot ccache_find(ccache, gendata, eq_func);
+
+/*
+ * Internal function to double the number of slots and put the new ones on
+ * the free list.
+ */
+static ccache
+ccache_grow(ccache c)
+{
+	ccache_slot slots;
+	unsigned int i, n;
+
+	n = c->nslots == 0 ? CCACHE_DEFAULT_SLOTS : c->nslots * 2;
+	if (n <= c->nslots || n >= CCACHE_NONE) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	if ((slots = realloc(c->slots, n * sizeof(ccache_slot_t))) == NULL)
+		return NULL;
+
+	/* Chain the new slots in order, so they're used front to back */
+	for (i = c->nslots; i < n; ++i) {
+		slots[i].full = 0;
+		slots[i].ref = 0;
+		slots[i].value.posnum = i + 1 < n ? i + 1 : c->free;
+	}
+
+	c->free = c->nslots;
+	c->slots = slots;
+	c->nslots = n;
+
+	return c;
+}
+
+
+/*
+ * Internal function to remove the entry in a slot from the cache, calling
+ * the free hooks on its key and value.
+ */
+static void
+ccache_drop(ccache c, unsigned int i, eq_func eq)
+{
+	ccache_slot s = c->slots + i;
+
+	/* Every full slot is in the index, so this can't fail */
+	ht_delete(c->index, s->key, eq, NULL, NULL);
+
+	c->used -= s->size;
+
+	if (c->free_key != NULL)
+		c->free_key(s->key.ptr);
+	if (c->free_value != NULL)
+		c->free_value(s->value.ptr);
+
+	s->full = 0;
+	s->ref = 0;
+	s->value.posnum = c->free;
+	c->free = i;
+}
+
+
+/*
+ * Internal function to move the clock hand until it finds an entry which
+ * wasn't used since the last time around, and evict that.  The entry in
+ * slot keep is passed over, so it can't be evicted.  There must be another
+ * entry in the cache.
+ */
+static void
+ccache_sweep(ccache c, eq_func eq, unsigned int keep)
+{
+	ccache_slot s;
+	unsigned int i;
+
+	for (;;) {
+		i = c->hand;
+		s = c->slots + i;
+		if (++c->hand == c->nslots)
+			c->hand = 0;
+
+		if (!s->full || i == keep)
+			continue;
+
+		if (s->ref) {
+			s->ref = 0;
+			continue;
+		}
+
+		ccache_drop(c, i, eq);
+		++c->stats.evictions;
+		return;
+	}
+}
+
+
+/*
+ * Internal function to look up the slot belonging to a key.  Returns NULL
+ * if there is no such slot.
+ */
+static ccache_slot
+ccache_find(ccache c, gendata key, eq_func eq)
+{
+	gendata i;
+
+	if (ht_lookup(c->index, key, eq, &i) == NULL)
+		return NULL;
+
+	return c->slots + i.posnum;
+}
+
+
+/**
+ * \brief Create a new empty CLOCK cache.
+ *
+ * \param capacity    The maximum number of entries, or the maximum total
+ *			size of the entries if \p size is not \c NULL.
+ * \param hash        The full-width hashing function to use on keys.
+ * \param size        The function which returns the size of an entry, or
+ *			\c NULL if every entry counts as one.
+ * \param free_key    The function used to free the key of an entry which
+ *			is dropped from the cache, or \c NULL if keys need not
+ *			be freed.
+ * \param free_value  The function used to free the value of an entry which
+ *			is dropped from the cache, or \c NULL if values need
+ *			not be freed.
+ *
+ * \return  A new empty CLOCK cache object, or \c NULL if an error occurred.
+ *
+ * \par Errno values:
+ * - \b EINVAL if \p capacity is 0.
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ccache_destroy, lru_create
+ */
+ccache
+ccache_create(size_t capacity, fullhash_func hash, lru_size_func size,
+	      free_func free_key, free_func free_value)
+{
+	ccache_t *c;
+
+	assert(hash != NULL);
+
+	if (capacity == 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if ((c = malloc(sizeof(ccache_t))) == NULL)
+		return NULL;
+
+	if ((c->index = ht_create_full(0, hash, HT_ROBINHOOD)) == NULL) {
+		free(c);
+		return NULL;
+	}
+
+	c->slots = NULL;
+	c->nslots = 0;
+	c->hand = 0;
+	c->free = CCACHE_NONE;
+	c->capacity = capacity;
+	c->used = 0;
+	c->size = size;
+	c->free_key = free_key;
+	c->free_value = free_value;
+	c->stats.hits = 0;
+	c->stats.misses = 0;
+	c->stats.evictions = 0;
+
+	return (ccache)c;
+}
+
+
+/**
+ * \brief Free all memory allocated for a CLOCK cache.
+ *
+ * The keys and values of the remaining entries are passed to the free
+ * functions the cache was created with.
+ *
+ * \param c  The CLOCK cache to destroy.
+ *
+ * \sa ccache_create
+ */
+void
+ccache_destroy(ccache c)
+{
+	unsigned int i;
+
+	assert(c != NULL);
+
+	for (i = 0; i < c->nslots; ++i) {
+		if (!c->slots[i].full)
+			continue;
+		if (c->free_key != NULL)
+			c->free_key(c->slots[i].key.ptr);
+		if (c->free_value != NULL)
+			c->free_value(c->slots[i].value.ptr);
+	}
+
+	ht_destroy(c->index, NULL, NULL);
+	free(c->slots);
+	free(c);
+}
+
+
+/**
+ * \brief Add a (key, value) pair to a CLOCK cache (with replace)
+ *
+ * Add an entry to the cache, or replace the entry with the same key.  The
+ *  entry is marked as used.  Afterwards, entries which weren't used
+ *  recently are evicted until the cache is within its capacity again.  The
+ *  free functions are called on the old key and value of a replaced entry,
+ *  unless they are the same as the new ones.
+ *
+ * \param c      The CLOCK cache to add the entry to.
+ * \param key    The key of the entry.
+ * \param value  The value of the entry.
+ * \param eq     The equals predicate for two keys.
+ *
+ * \return  The original CLOCK cache, or \c NULL if the entry could not be
+ *           added.  The cache is unchanged in case of error.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the entry is larger than the capacity of the cache.
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ccache_get, ccache_delete
+ */
+ccache
+ccache_put(ccache c, gendata key, gendata value, eq_func eq)
+{
+	ccache_slot s;
+	gendata i;
+	size_t size;
+
+	assert(c != NULL);
+	assert(eq != NULL);
+
+	size = c->size == NULL ? 1 : c->size(key, value);
+	if (size > c->capacity) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if ((s = ccache_find(c, key, eq)) != NULL) {
+		/* Store the new key in the index too, the old one goes away */
+		i.posnum = (unsigned int)(s - c->slots);
+		if (ht_insert(c->index, key, i, eq, NULL, NULL) == NULL)
+			return NULL;
+
+		if (c->free_key != NULL && s->key.ptr != key.ptr)
+			c->free_key(s->key.ptr);
+		if (c->free_value != NULL && s->value.ptr != value.ptr)
+			c->free_value(s->value.ptr);
+
+		c->used -= s->size;
+	} else {
+		if (c->free == CCACHE_NONE && ccache_grow(c) == NULL)
+			return NULL;
+
+		i.posnum = c->free;
+		if (ht_insert_uniq(c->index, key, i, eq) == NULL)
+			return NULL;
+
+		s = c->slots + i.posnum;
+		c->free = s->value.posnum;
+		s->full = 1;
+	}
+
+	s->key = key;
+	s->value = value;
+	s->size = size;
+	s->ref = 1;
+	c->used += size;
+
+	/* The new entry fits by itself, so there's always another to evict */
+	while (c->used > c->capacity)
+		ccache_sweep(c, eq, i.posnum);
+
+	return c;
+}
+
+
+/**
+ * \brief Look up a value in a CLOCK cache.
+ *
+ * The entry which is found is marked as used.  Every call counts as either
+ *  a hit or a miss in the statistics of the cache.
+ *
+ * \param c     The CLOCK cache to look in.
+ * \param key   The key of the entry.
+ * \param eq    The equals predicate for two keys.
+ * \param data  A pointer to the location where the value is stored, if
+ *		 found.
+ *
+ * \return  The CLOCK cache, or \c NULL if the key could not be found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ *
+ * \sa ccache_peek, ccache_put
+ */
+ccache
+ccache_get(ccache c, gendata key, eq_func eq, gendata *data)
+{
+	ccache_slot s;
+
+	assert(c != NULL);
+	assert(eq != NULL);
+	assert(data != NULL);
+
+	if ((s = ccache_find(c, key, eq)) == NULL) {
+		++c->stats.misses;
+		return NULL;
+	}
+
+	++c->stats.hits;
+	s->ref = 1;
+	*data = s->value;
+
+	return c;
+}
+
+
+/**
+ * \brief Look up a value in a CLOCK cache without using it.
+ *
+ * Unlike ccache_get, this changes neither the reference bit of the entry
+ *  nor the statistics of the cache.
+ *
+ * \param c     The CLOCK cache to look in.
+ * \param key   The key of the entry.
+ * \param eq    The equals predicate for two keys.
+ * \param data  A pointer to the location where the value is stored, if
+ *		 found.
+ *
+ * \return  The CLOCK cache, or \c NULL if the key could not be found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ *
+ * \sa ccache_get
+ */
+ccache
+ccache_peek(ccache c, gendata key, eq_func eq, gendata *data)
+{
+	ccache_slot s;
+
+	assert(c != NULL);
+	assert(eq != NULL);
+	assert(data != NULL);
+
+	if ((s = ccache_find(c, key, eq)) == NULL)
+		return NULL;
+
+	*data = s->value;
+
+	return c;
+}
+
+
+/**
+ * \brief Remove an entry from a CLOCK cache.
+ *
+ * The free functions are called on the key and value of the entry.  This
+ *  doesn't count as an eviction.
+ *
+ * \param c    The CLOCK cache to remove the entry from.
+ * \param key  The key of the entry.
+ * \param eq   The equals predicate for two keys.
+ *
+ * \return  The CLOCK cache, or \c NULL if the key could not be found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ *
+ * \sa ccache_put, ccache_evict
+ */
+ccache
+ccache_delete(ccache c, gendata key, eq_func eq)
+{
+	ccache_slot s;
+
+	assert(c != NULL);
+	assert(eq != NULL);
+
+	if ((s = ccache_find(c, key, eq)) == NULL)
+		return NULL;
+
+	ccache_drop(c, (unsigned int)(s - c->slots), eq);
+
+	return c;
+}
+
+
+/**
+ * \brief Evict an entry which wasn't used recently from a CLOCK cache.
+ *
+ * The free functions are called on the key and value of the entry.
+ *
+ * \param c   The CLOCK cache to evict an entry from.
+ * \param eq  The equals predicate for two keys.
+ *
+ * \return  The CLOCK cache, or \c NULL if it was empty.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the cache is empty.
+ *
+ * \sa ccache_delete
+ */
+ccache
+ccache_evict(ccache c, eq_func eq)
+{
+	assert(c != NULL);
+	assert(eq != NULL);
+
+	if (ht_empty(c->index)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	ccache_sweep(c, eq, CCACHE_NONE);
+
+	return c;
+}
+
+
+/**
+ * \brief The number of entries in a CLOCK cache.
+ *
+ * \param c  The CLOCK cache.
+ *
+ * \return  The number of entries.
+ */
+unsigned int
+ccache_count(ccache c)
+{
+	assert(c != NULL);
+
+	return ht_count(c->index);
+}
+
+
+/**
+ * \brief The statistics of a CLOCK cache.
+ *
+ * \param c  The CLOCK cache.
+ *
+ * \return  The number of hits, misses and evictions so far.
+ */
+lru_stats_t
+ccache_stats(ccache c)
+{
+	assert(c != NULL);
+
+	return c->stats;
+}
@@ -0,0 +1,90 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief CLOCK caches interface.
+ *
+ * \file ccache.h
+ */
+#ifndef GUNE_CCACHE_H
+#define GUNE_CCACHE_H
+
+#include <stddef.h>
+#include <gune/ht.h>
+#include <gune/lru.h>
+#include <gune/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief CLOCK cache element */
+typedef struct ccache_slot_t {
+	gendata key;		/**< Key, used for identification of entries */
+	gendata value;		/**< The entry itself, or the next free slot */
+	size_t size;		/**< The size of the entry */
+	unsigned char ref;	/**< Set when the entry is used */
+	unsigned char full;	/**< Set when the slot holds an entry */
+} ccache_slot_t, *ccache_slot;
+
+/** \brief CLOCK cache implementation */
+typedef struct ccache_t {
+	ht index;		/**< Maps keys onto their slot numbers */
+	ccache_slot slots;	/**< The slots, in clock order */
+	unsigned int nslots;	/**< The number of slots */
+	unsigned int hand;	/**< The slot eviction looks at next */
+	unsigned int free;	/**< The first free slot, or CCACHE_NONE */
+	size_t capacity;	/**< The maximum total size of the entries */
+	size_t used;		/**< The total size of the entries */
+	lru_size_func size;	/**< The size function, or NULL if every
+				     entry has size 1 */
+	free_func free_key;	/**< Frees keys of entries which are dropped */
+	free_func free_value;	/**< Frees values of entries which are
+				     dropped */
+	lru_stats_t stats;	/**< Counters of what happened so far */
+} ccache_t, *ccache;
+
+ccache ccache_create(size_t, fullhash_func, lru_size_func, free_func,
+		     free_func);
+void ccache_destroy(ccache);
+ccache ccache_put(ccache, gendata, gendata, eq_func);
+ccache ccache_get(ccache, gendata, eq_func, gendata *);
+ccache ccache_peek(ccache, gendata, eq_func, gendata *);
+ccache ccache_delete(ccache, gendata, eq_func);
+ccache ccache_evict(ccache, eq_func);
+unsigned int ccache_count(ccache);
+lru_stats_t ccache_stats(ccache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GUNE_CCACHE_H */
@@ -0,0 +1,410 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief Concurrent hash tables implementation.
+ *
+ * \file cht.c
+ * These hash tables can be used by many threads at once.  The table is
+ * split into stripes, each of which is an ordinary chained hash table with
+ * its own reader/writer lock.  The hash value of a key determines which
+ * stripe it lives in.  Lookups only take a read lock, so they never wait
+ * for each other, and operations on keys in different stripes never wait
+ * at all.  Every stripe grows and shrinks on its own, under its own lock,
+ * so there is no global lock anywhere.
+ */
+
+/* For pthread_rwlock_t, which is hidden in strict ANSI mode */
+#define _POSIX_C_SOURCE	200112L
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <gune/misc.h>
+#include <gune/cht.h>
+
+/** Compile-time option of the number of stripes if none is given */
+#define CHT_DEFAULT_STRIPES	16
+
+/** Compile-time option of the size of a cache line */
+#define CHT_CACHE_LINE		64
+
+struct cht_stripe {
+	pthread_rwlock_t lock;	/* Protects table */
+	ht table;		/* The entries of this stripe */
+	char pad[CHT_CACHE_LINE]; /* Keep stripes off each other's lines */
+};
+
+static struct cht_stripe *cht_stripe_of(cht, gendata);
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/*
+ * Find the stripe a key belongs to.  The stripe is taken from the low bits
+ * of the scrambled hash value, so it doesn't correlate with the key's
+ * bucket in the stripe's table (which is taken from the high bits).
+ */
+static struct cht_stripe *
+cht_stripe_of(cht t, gendata key)
+{
+	return t->stripes + (hash_mix(t->hash(key)) & (t->nstripes - 1));
+}
+
+
+/**
+ * \brief Create a new empty concurrent hash table.
+ *
+ * \param nstripes  The number of stripes, or 0 to use a sensible default.
+ *		     It is rounded up to a power of two.  More stripes allow
+ *		     more threads to modify the table at the same time.
+ * \param hash      The full-width hashing function to use on keys.
+ *
+ * \return  A new empty concurrent hash table object, or \c NULL if an error
+ *	     occurred.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ * - \b EAGAIN if the system lacks the resources to create the locks.
+ *
+ * \sa cht_destroy ht_create_full
+ */
+cht
+cht_create(unsigned int nstripes, fullhash_func hash)
+{
+	unsigned int i, n;
+	cht_t *t;
+	int err;
+
+	assert(hash != NULL);
+
+	if (nstripes == 0)
+		nstripes = CHT_DEFAULT_STRIPES;
+
+	for (n = 1; n < nstripes; n <<= 1)
+		;
+
+	if ((t = malloc(sizeof(cht_t))) == NULL)
+		return NULL;
+
+	if ((t->stripes = malloc(n * sizeof(struct cht_stripe))) == NULL) {
+		free(t);
+		return NULL;
+	}
+
+	for (i = 0; i < n; ++i) {
+		if ((t->stripes[i].table = ht_create_full(0, hash,
+							  HT_CHAINED)) == NULL)
+			break;
+		if ((err = pthread_rwlock_init(&t->stripes[i].lock,
+					       NULL)) != 0) {
+			ht_destroy(t->stripes[i].table, NULL, NULL);
+			errno = err;
+			break;
+		}
+	}
+
+	/* Undo the stripes that were set up */
+	if (i < n) {
+		err = errno;
+		while (i-- > 0) {
+			pthread_rwlock_destroy(&t->stripes[i].lock);
+			ht_destroy(t->stripes[i].table, NULL, NULL);
+		}
+		free(t->stripes);
+		free(t);
+		errno = err;
+		return NULL;
+	}
+
+	t->nstripes = n;
+	t->hash = hash;
+
+	return (cht)t;
+}
+
+
+/**
+ * \brief Free all memory allocated for a concurrent hash table.
+ *
+ * The table must not be in use by any other thread.
+ *
+ * \param t           The concurrent hash table to destroy.
+ * \param free_key    The function which is used to free the key data, or
+ *			\c NULL if no action should be taken on the key data.
+ * \param free_value  The function which is used to free the value data, or
+ *			\c NULL if no action should be taken on the value data.
+ *
+ * \sa cht_create
+ */
+void
+cht_destroy(cht t, free_func free_key, free_func free_value)
+{
+	unsigned int i;
+
+	assert(t != NULL);
+
+	for (i = 0; i < t->nstripes; ++i) {
+		pthread_rwlock_destroy(&t->stripes[i].lock);
+		ht_destroy(t->stripes[i].table, free_key, free_value);
+	}
+
+	free(t->stripes);
+	free(t);
+}
+
+
+/**
+ * \brief Add a (key, value) pair to a concurrent hash table (with replace)
+ *
+ * See ht_insert.  Only the stripe of the key is locked, for writing.
+ *
+ * \param t           The concurrent hash table to insert the data in.
+ * \param key         The key of the data.
+ * \param value       The data to insert.
+ * \param eq          The equals predicate for two keys.
+ * \param free_key    The function used to free the old key's data if it
+ *		       needs to be replaced, or \c NULL if the data does not
+ *		       need to be freed.
+ * \param free_value  The function used to free the old value's data if it
+ *		       needs to be replaced, or \c NULL if the data does not
+ *		       need to be freed.
+ *
+ * \return  The original concurrent hash table, or \c NULL if the data could
+ *           not be inserted.  Original table is still valid in case of error.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa cht_insert_uniq, cht_delete
+ */
+cht
+cht_insert(cht t, gendata key, gendata value, eq_func eq,
+	   free_func free_key, free_func free_value)
+{
+	struct cht_stripe *s;
+	ht res;
+
+	assert(t != NULL);
+
+	s = cht_stripe_of(t, key);
+	pthread_rwlock_wrlock(&s->lock);
+	res = ht_insert(s->table, key, value, eq, free_key, free_value);
+	pthread_rwlock_unlock(&s->lock);
+
+	return res == NULL ? NULL : t;
+}
+
+
+/**
+ * \brief Add a (key, value) pair to a concurrent hash table (no replace)
+ *
+ * See ht_insert_uniq.  Only the stripe of the key is locked, for writing.
+ *
+ * \param t           The concurrent hash table to insert the data in.
+ * \param key         The key of the data.
+ * \param value       The data to insert.
+ * \param eq          The equals predicate for two keys.
+ *
+ * \return  The original concurrent hash table, or \c NULL if the data could
+ *           not be inserted.  Original table is still valid in case of error.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key is already in the table.
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa cht_insert, cht_delete
+ */
+cht
+cht_insert_uniq(cht t, gendata key, gendata value, eq_func eq)
+{
+	struct cht_stripe *s;
+	ht res;
+
+	assert(t != NULL);
+
+	s = cht_stripe_of(t, key);
+	pthread_rwlock_wrlock(&s->lock);
+	res = ht_insert_uniq(s->table, key, value, eq);
+	pthread_rwlock_unlock(&s->lock);
+
+	return res == NULL ? NULL : t;
+}
+
+
+/**
+ * \brief Look up an element in a concurrent hash table.
+ *
+ * Only the stripe of the key is locked, for reading, so any number of
+ * lookups can run at the same time.  If Gune was built with \c HT_STATS
+ * defined, the stripe is locked for writing instead.
+ *
+ * \attention
+ * If the element is a pointer, another thread may delete (and free) it as
+ * soon as this function returns.  Preventing that is up to the caller.
+ *
+ * \param t     The concurrent hash table which contains the element.
+ * \param key   The key to the element.
+ * \param eq    The equals predicate for two keys.
+ * \param data  A pointer to the location where the element is stored, if
+ *               it was found.
+ *
+ * \return  The concurrent hash table, or \c NULL if the key could not be
+ *	     found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ */
+cht
+cht_lookup(cht t, gendata key, eq_func eq, gendata *data)
+{
+	struct cht_stripe *s;
+	ht res;
+
+	assert(t != NULL);
+
+	/*
+	 * NOTE: The stripe tables never rehash incrementally, so ht_lookup
+	 * doesn't move any entries and a read lock is enough.  With HT_STATS
+	 * it does count hits, misses and probes in the table, though, so
+	 * then we need the write lock.
+	 */
+	s = cht_stripe_of(t, key);
+#ifdef HT_STATS
+	pthread_rwlock_wrlock(&s->lock);
+#else
+	pthread_rwlock_rdlock(&s->lock);
+#endif
+	res = ht_lookup(s->table, key, eq, data);
+	pthread_rwlock_unlock(&s->lock);
+
+	return res == NULL ? NULL : t;
+}
+
+
+/**
+ * \brief Delete an element from a concurrent hash table.
+ *
+ * See ht_delete.  Only the stripe of the key is locked, for writing.
+ *
+ * \param t           The concurrent hash table which contains the element
+ *			to delete.
+ * \param key         The key to the element to delete.
+ * \param eq          The equals predicate for two keys.
+ * \param free_key    The function which is used to free the key data, or
+ *			\c NULL if no action should be taken on the key data.
+ * \param free_value  The function which is used to free the value data, or
+ *			\c NULL if no action should be taken on the value data.
+ *
+ * \return  The concurrent hash table, or \c NULL if the key could not be
+ *	     found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ *
+ * \sa cht_insert
+ */
+cht
+cht_delete(cht t, gendata key, eq_func eq, free_func free_key,
+	   free_func free_value)
+{
+	struct cht_stripe *s;
+	ht res;
+
+	assert(t != NULL);
+
+	s = cht_stripe_of(t, key);
+	pthread_rwlock_wrlock(&s->lock);
+	res = ht_delete(s->table, key, eq, free_key, free_value);
+	pthread_rwlock_unlock(&s->lock);
+
+	return res == NULL ? NULL : t;
+}
+
+
+/**
+ * \brief Return whether or not a concurrent hash table is empty.
+ *
+ * The stripes are checked one at a time, so if other threads are modifying
+ * the table, the answer may be outdated by the time it is returned.
+ *
+ * \param t  The concurrent hash table to check.
+ *
+ * \return  Non-zero if the table is empty, 0 if it is not.
+ */
+int
+cht_empty(cht t)
+{
+	unsigned int i;
+	int empty;
+
+	assert(t != NULL);
+
+	empty = 1;
+	for (i = 0; i < t->nstripes && empty; ++i) {
+		pthread_rwlock_rdlock(&t->stripes[i].lock);
+		empty = ht_empty(t->stripes[i].table);
+		pthread_rwlock_unlock(&t->stripes[i].lock);
+	}
+
+	return empty;
+}
+
+
+/**
+ * \brief Walk through all elements of a concurrent hash table.
+ *
+ * The stripes are walked one at a time, each while it is locked for
+ * writing.  The same restrictions as with ht_walk apply.
+ *
+ * \attention
+ * The walk function must not call any other function on the same table,
+ * because the stripe it would need may be locked.
+ *
+ * \param t     The concurrent hash table to walk
+ * \param walk  The function which will process the hash pairs
+ * \param data  Any data to pass to the function every time it is called.
+ */
+void
+cht_walk(cht t, assoc_func walk, gendata data)
+{
+	unsigned int i;
+
+	assert(t != NULL);
+	assert(walk != NULL);
+
+	for (i = 0; i < t->nstripes; ++i) {
+		pthread_rwlock_wrlock(&t->stripes[i].lock);
+		ht_walk(t->stripes[i].table, walk, data);
+		pthread_rwlock_unlock(&t->stripes[i].lock);
+	}
+}
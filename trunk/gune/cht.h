@@ -0,0 +1,71 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief Concurrent hash tables interface.
+ *
+ * \file cht.h
+ */
+#ifndef GUNE_CHT_H
+#define GUNE_CHT_H
+
+#include <gune/ht.h>
+#include <gune/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Lock stripe (only defined in the implementation) */
+struct cht_stripe;
+
+/** \brief Concurrent hash table implementation */
+typedef struct cht_t {
+	struct cht_stripe *stripes;	/**< The stripes, each with its own
+					     lock and part of the buckets */
+	unsigned int nstripes;	/**< The number of stripes (a power of two) */
+	fullhash_func hash;	/**< The hashing function to use */
+} cht_t, *cht;
+
+cht cht_create(unsigned int, fullhash_func);
+void cht_destroy(cht, free_func, free_func);
+cht cht_insert(cht, gendata, gendata, eq_func, free_func, free_func);
+cht cht_insert_uniq(cht, gendata, gendata, eq_func);
+cht cht_lookup(cht, gendata, eq_func, gendata *);
+cht cht_delete(cht, gendata, eq_func, free_func, free_func);
+int cht_empty(cht);
+void cht_walk(cht, assoc_func, gendata);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GUNE_CHT_H */
@@ -0,0 +1,499 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief Frozen hash tables implementation.
+ *
+ * \file fht.c
+ * A frozen hash table is made from an ordinary hash table which won't
+ * change anymore.  It uses a minimal perfect hash function: every key maps
+ * to a different slot, and there are exactly as many slots as keys.  So
+ * there are no chains and no empty slots, and a lookup costs one hash, one
+ * slot and at most one call of the equals predicate.  Slots keep the full
+ * hash value of their key, so most misses need no call at all.
+ *
+ * The perfect hash function is found with the CHD algorithm (Compress,
+ * Hash and Displace) by Belazzougui, Botelho and Dietzfelbinger.  The keys
+ * are divided over buckets of a few keys each.  Starting with the biggest
+ * bucket, every bucket gets the first displacement which puts all its keys
+ * in free slots.  Looking up a key means finding its bucket, and hashing it
+ * again together with the bucket's displacement.
+ *
+ * Keys with the same full hash value can never be separated this way, so
+ * all but one of them are stored in a small sorted array next to the slots.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gune/misc.h>
+#include <gune/fht.h>
+
+/** Compile-time option of the average number of keys per bucket */
+#define FHT_BUCKET_SIZE		4
+
+/** Compile-time option of how many seeds to try before giving up */
+#define FHT_MAX_ATTEMPTS	8
+
+/* The golden ratio, as a fraction of the hash value range */
+#if ULONG_MAX > 0xFFFFFFFFUL
+#define FHT_GOLDEN		0x9E3779B97F4A7C15UL
+#else
+#define FHT_GOLDEN		0x9E3779B9UL
+#endif
+
+/* An element while the table is being frozen */
+struct fht_entry {
+	gendata key;
+	gendata value;
+	hashval hash;		/* Full hash value of key */
+	hashval g;		/* Seeded hash value of key */
+	unsigned int pos;	/* Slot found for the entry */
+};
+
+/* A bucket while the table is being frozen */
+struct fht_bucket {
+	unsigned int first;	/* Index of the first entry of the bucket */
+	unsigned int size;	/* Number of entries in the bucket */
+	unsigned int nr;	/* Bucket number */
+};
+
+static hashval fht_hashval(fht, gendata);
+static unsigned int fht_pos(hashval, unsigned int, unsigned int);
+static int fht_entry_hash_cmp(const void *, const void *);
+static int fht_entry_bucket_cmp(const void *, const void *);
+static int fht_bucket_size_cmp(const void *, const void *);
+static int fht_place(fht, struct fht_entry *, unsigned int, struct fht_bucket *,
+		     unsigned char *);
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/*
+ * Calculate the hash value of a key exactly like the original table did,
+ * so the values it cached can be used to build the frozen table.
+ */
+static hashval
+fht_hashval(fht f, gendata key)
+{
+	if (f->keyedhash != NULL)
+		return f->keyedhash(key, &f->keyseed);
+
+	if (f->fullhash != NULL)
+		return hash_mix(f->fullhash(key));
+
+	assert(f->hash != NULL);
+
+	return hash_mix(f->hash(key, UINT_MAX));
+}
+
+
+/*
+ * Calculate the slot of a key with seeded hash value g in a bucket with
+ * displacement d.
+ */
+static unsigned int
+fht_pos(hashval g, unsigned int d, unsigned int count)
+{
+	return (unsigned int)(hash_mix(g + ((hashval)d + 1) * FHT_GOLDEN) %
+			      count);
+}
+
+
+/*
+ * Comparison functions for qsort.
+ */
+static int
+fht_entry_hash_cmp(const void *a, const void *b)
+{
+	const struct fht_entry *x = a, *y = b;
+
+	return (x->hash > y->hash) - (x->hash < y->hash);
+}
+
+
+static int
+fht_entry_bucket_cmp(const void *a, const void *b)
+{
+	const struct fht_entry *x = a, *y = b;
+
+	/* The bucket number is temporarily kept in pos */
+	return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+
+static int
+fht_bucket_size_cmp(const void *a, const void *b)
+{
+	const struct fht_bucket *x = a, *y = b;
+
+	/* Biggest first */
+	return (x->size < y->size) - (x->size > y->size);
+}
+
+
+/*
+ * Try to find displacements for all buckets with the seed in f->seed.
+ * Returns nonzero if it worked, in which case the entries have their
+ * slot numbers in pos and f->disp is filled in.
+ */
+static int
+fht_place(fht f, struct fht_entry *entries, unsigned int n,
+	  struct fht_bucket *buckets, unsigned char *taken)
+{
+	unsigned int i, j, b, d, limit;
+	struct fht_entry *e;
+
+	for (i = 0; i < n; ++i) {
+		entries[i].g = hash_mix(entries[i].hash ^ f->seed);
+		entries[i].pos = (unsigned int)(entries[i].g % f->nbuckets);
+	}
+
+	/* Group the entries by bucket, and sort the buckets by size */
+	qsort(entries, n, sizeof(struct fht_entry), fht_entry_bucket_cmp);
+	for (b = 0; b < f->nbuckets; ++b) {
+		buckets[b].nr = b;
+		buckets[b].size = 0;
+	}
+	for (i = n; i-- > 0; ) {
+		buckets[entries[i].pos].first = i;
+		++buckets[entries[i].pos].size;
+	}
+	qsort(buckets, f->nbuckets, sizeof(struct fht_bucket),
+	      fht_bucket_size_cmp);
+
+	memset(taken, 0, n);
+
+	/* The last keys have few free slots to go to */
+	limit = 16 * n + 256;
+
+	for (b = 0; b < f->nbuckets && buckets[b].size > 0; ++b) {
+		e = entries + buckets[b].first;
+
+		for (d = 0; d < limit; ++d) {
+			for (j = 0; j < buckets[b].size; ++j) {
+				e[j].pos = fht_pos(e[j].g, d, n);
+				if (taken[e[j].pos])
+					break;
+				taken[e[j].pos] = 1;
+			}
+			if (j == buckets[b].size)
+				break;
+
+			/* Undo the slots this attempt took */
+			while (j-- > 0)
+				taken[e[j].pos] = 0;
+		}
+
+		if (d == limit)
+			return 0;
+
+		f->disp[buckets[b].nr] = d;
+	}
+
+	return 1;
+}
+
+
+/**
+ * \brief Turn a hash table into a frozen hash table.
+ *
+ * A frozen hash table can't be changed, but looking up keys in it is
+ * faster and it uses much less memory.  It uses the same hashing function
+ * as the original table.  Building it takes a few passes over all keys.
+ *
+ * \param t  The hash table to freeze.  It is destroyed if the frozen table
+ *	      could be built; its keys and values are moved into the frozen
+ *	      table.  If an error occurs, it is left untouched.
+ *
+ * \return  A new frozen hash table, or \c NULL if an error occurred.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ * - \b EAGAIN if no perfect hash function could be found.  This is very
+ *	unlikely, unless the hashing function gives very few distinct values.
+ *
+ * \sa fht_destroy fht_lookup
+ */
+fht
+ht_freeze(ht t)
+{
+	struct fht_bucket *buckets = NULL;
+	struct fht_entry *entries = NULL;
+	unsigned char *taken = NULL;
+	unsigned int i, n, total, attempt;
+	ht_iter_t it;
+	fht_t *f;
+
+	assert(t != NULL);
+
+	if ((f = malloc(sizeof(fht_t))) == NULL)
+		return NULL;
+
+	f->hash = t->hash;
+	f->fullhash = t->fullhash;
+	f->keyedhash = t->keyedhash;
+	f->keyseed = t->seed;
+	f->slots = NULL;
+	f->disp = NULL;
+	f->extra = NULL;
+	f->count = f->nbuckets = f->nextra = 0;
+	f->seed = 0;
+
+	/* Allocate at least one of everything, so malloc never gets 0 */
+	if ((entries = malloc((t->count + 1) *
+			      sizeof(struct fht_entry))) == NULL)
+		goto fail;
+
+	/* The table cached the hash values, so no key is hashed again */
+	ht_iter_init(t, &it);
+	for (total = 0; ht_iter_next(&it, &entries[total].key,
+				     &entries[total].value); ++total)
+		entries[total].hash = it.hash;
+	assert(total == t->count);
+
+	/* Only the first of each run of equal hash values gets a slot */
+	qsort(entries, total, sizeof(struct fht_entry), fht_entry_hash_cmp);
+	for (i = 1; i < total; ++i)
+		if (entries[i].hash == entries[i - 1].hash)
+			++f->nextra;
+
+	if ((f->extra = malloc((f->nextra + 1) * sizeof(fht_extra_t))) == NULL)
+		goto fail;
+
+	f->nextra = 0;
+	for (i = n = 0; i < total; ++i) {
+		if (n == 0 || entries[i].hash != entries[n - 1].hash) {
+			entries[n++] = entries[i];
+		} else {
+			f->extra[f->nextra].hash = entries[i].hash;
+			f->extra[f->nextra].key = entries[i].key;
+			f->extra[f->nextra].value = entries[i].value;
+			++f->nextra;
+		}
+	}
+
+	f->count = n;
+	f->nbuckets = (n + FHT_BUCKET_SIZE - 1) / FHT_BUCKET_SIZE;
+
+	if ((f->slots = malloc((n + 1) * sizeof(fht_slot_t))) == NULL ||
+	    (f->disp = malloc((f->nbuckets + 1) *
+			      sizeof(unsigned int))) == NULL ||
+	    (buckets = malloc((f->nbuckets + 1) *
+			      sizeof(struct fht_bucket))) == NULL ||
+	    (taken = malloc(n + 1)) == NULL)
+		goto fail;
+
+	if (n > 0) {
+		for (attempt = 0; attempt < FHT_MAX_ATTEMPTS; ++attempt) {
+			f->seed = (hashval)attempt * FHT_GOLDEN;
+			if (fht_place(f, entries, n, buckets, taken))
+				break;
+		}
+
+		if (attempt == FHT_MAX_ATTEMPTS) {
+			errno = EAGAIN;
+			goto fail;
+		}
+	}
+
+	for (i = 0; i < n; ++i) {
+		f->slots[entries[i].pos].hash = entries[i].hash;
+		f->slots[entries[i].pos].key = entries[i].key;
+		f->slots[entries[i].pos].value = entries[i].value;
+	}
+
+	free(entries);
+	free(buckets);
+	free(taken);
+
+	/* The keys and values belong to the frozen table now */
+	ht_destroy(t, NULL, NULL);
+
+	return (fht)f;
+
+fail:
+	free(entries);
+	free(buckets);
+	free(taken);
+	fht_destroy(f, NULL, NULL);
+	return NULL;
+}
+
+
+/**
+ * \brief Free all memory allocated for a frozen hash table.
+ *
+ * \param f           The frozen hash table to destroy.
+ * \param free_key    The function which is used to free the key data, or
+ *			\c NULL if no action should be taken on the key data.
+ * \param free_value  The function which is used to free the value data, or
+ *			\c NULL if no action should be taken on the value data.
+ *
+ * \sa ht_freeze
+ */
+void
+fht_destroy(fht f, free_func free_key, free_func free_value)
+{
+	unsigned int i;
+
+	assert(f != NULL);
+
+	for (i = 0; i < f->count; ++i) {
+		if (free_key != NULL)
+			free_key(f->slots[i].key.ptr);
+		if (free_value != NULL)
+			free_value(f->slots[i].value.ptr);
+	}
+
+	for (i = 0; i < f->nextra; ++i) {
+		if (free_key != NULL)
+			free_key(f->extra[i].key.ptr);
+		if (free_value != NULL)
+			free_value(f->extra[i].value.ptr);
+	}
+
+	free(f->slots);
+	free(f->disp);
+	free(f->extra);
+	free(f);
+}
+
+
+/**
+ * \brief Look up an element in a frozen hash table.
+ *
+ * \param f     The frozen hash table which contains the element.
+ * \param key   The key to the element.
+ * \param eq    The equals predicate for two keys.
+ * \param data  A pointer to the location where the element is stored, if
+ *               it was found.
+ *
+ * \return  The frozen hash table, or \c NULL if the key could not be found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ */
+fht
+fht_lookup(fht f, gendata key, eq_func eq, gendata *data)
+{
+	unsigned int lo, hi, mid;
+	hashval hash, g;
+	fht_slot s;
+
+	assert(f != NULL);
+	assert(eq != NULL);
+
+	hash = fht_hashval(f, key);
+
+	if (f->count == 0)
+		goto notfound;
+
+	g = hash_mix(hash ^ f->seed);
+	s = f->slots + fht_pos(g, f->disp[g % f->nbuckets], f->count);
+
+	/*
+	 * Every key which was in the table has its hash value in a slot, so
+	 * a different hash value in the slot means the key isn't there.
+	 */
+	if (s->hash != hash)
+		goto notfound;
+
+	if (eq(key, s->key)) {
+		*data = s->value;
+		return f;
+	}
+
+	/* Find the first extra element with this hash value */
+	lo = 0;
+	hi = f->nextra;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (f->extra[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < f->nextra && f->extra[lo].hash == hash; ++lo) {
+		if (eq(key, f->extra[lo].key)) {
+			*data = f->extra[lo].value;
+			return f;
+		}
+	}
+
+notfound:
+	errno = EINVAL;
+	return NULL;
+}
+
+
+/**
+ * \brief Return the number of elements in a frozen hash table.
+ *
+ * \param f  The frozen hash table to count.
+ *
+ * \return  The number of (key, value) pairs in the table.
+ */
+unsigned int
+fht_count(fht f)
+{
+	assert(f != NULL);
+
+	return f->count + f->nextra;
+}
+
+
+/**
+ * \brief Walk through all elements of a frozen hash table.
+ *
+ * \attention
+ * The walk function may change the value, but not the key.
+ *
+ * \param f     The frozen hash table to walk
+ * \param walk  The function which will process the hash pairs
+ * \param data  Any data to pass to the function every time it is called.
+ */
+void
+fht_walk(fht f, assoc_func walk, gendata data)
+{
+	unsigned int i;
+
+	assert(f != NULL);
+	assert(walk != NULL);
+
+	for (i = 0; i < f->count; ++i)
+		walk(&f->slots[i].key, &f->slots[i].value, data);
+
+	for (i = 0; i < f->nextra; ++i)
+		walk(&f->extra[i].key, &f->extra[i].value, data);
+}
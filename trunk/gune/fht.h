@@ -0,0 +1,90 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief Frozen hash tables interface.
+ *
+ * \file fht.h
+ */
+#ifndef GUNE_FHT_H
+#define GUNE_FHT_H
+
+#include <gune/ht.h>
+#include <gune/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Frozen hash table slot */
+typedef struct fht_slot_t {
+	hashval hash;		/**< The key's (scrambled) hash value */
+	gendata key;		/**< Key, used for identification of entries */
+	gendata value;		/**< The entry itself */
+} fht_slot_t, *fht_slot;
+
+/** \brief Frozen hash table element which didn't get a slot of its own */
+typedef struct fht_extra_t {
+	hashval hash;		/**< The key's (scrambled) hash value */
+	gendata key;		/**< Key, used for identification of entries */
+	gendata value;		/**< The entry itself */
+} fht_extra_t, *fht_extra;
+
+/** \brief Frozen hash table implementation */
+typedef struct fht_t {
+	fht_slot slots;		/**< One slot per element, no empty ones */
+	unsigned int count;	/**< The number of slots */
+	unsigned int *disp;	/**< The displacement of every bucket */
+	unsigned int nbuckets;	/**< The number of buckets */
+	hashval seed;		/**< Seed which made all displacements work */
+	hash_func hash;		/**< The hashing function to use, or NULL */
+	fullhash_func fullhash;	/**< The full-width hashing function to use,
+				     or NULL */
+	keyedhash_func keyedhash; /**< The keyed hashing function to use, or
+				     NULL */
+	hashseed keyseed;	/**< The secret seed of keyedhash */
+	fht_extra extra;	/**< Elements whose hash value is the same as
+				     that of an element in the slots, sorted
+				     by hash value */
+	unsigned int nextra;	/**< The number of those elements */
+} fht_t, *fht;
+
+fht ht_freeze(ht);
+void fht_destroy(fht, free_func, free_func);
+fht fht_lookup(fht, gendata, eq_func, gendata *);
+unsigned int fht_count(fht);
+void fht_walk(fht, assoc_func, gendata);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GUNE_FHT_H */
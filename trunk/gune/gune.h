@@ -47,7 +47,15 @@
 #include <gune/stack.h>
 #include <gune/queue.h>
 #include <gune/array.h>
+#include <gune/vec.h>
+#include <gune/bloom.h>
 #include <gune/ht.h>
+#include <gune/smap.h>
+#include <gune/sht.h>
+#include <gune/fht.h>
+#include <gune/lru.h>
+#include <gune/ccache.h>
+#include <gune/ttl.h>
 #include <gune/version.h>
 #include <gune/misc.h>
 
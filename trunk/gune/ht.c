@@ -34,340 +34,2661 @@
  *
  * \file ht.c
  */
+#ifdef GUNE_THREADS
+/* We need POSIX threads for parallel merges */
+#define _POSIX_C_SOURCE	200112L
+#endif
+
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
+#include <string.h>
+#ifdef GUNE_THREADS
+#include <pthread.h>
+#endif
 #include <gune/error.h>
+#include <gune/misc.h>
 #include <gune/ht.h>
 
+/** Compile-time option of the number of buckets if no range is given */
+#define HT_DEFAULT_RANGE	17
+
+/** Compile-time option of the default maximum load factor */
+#define HT_DEFAULT_MAX_LOAD	1.0
+
+/** Compile-time option of the default minimum load factor */
+#define HT_DEFAULT_MIN_LOAD	0.125
+
+/** Compile-time option of the default maximum load factor (open addressing) */
+#define HT_DEFAULT_OA_MAX_LOAD	0.875
+
+/** Compile-time option of the number of keys ht_lookup_many works on at once */
+#define HT_LOOKUP_BATCH		16
+
+/** Compile-time option of the number of threads ht_merge uses */
+#define HT_MERGE_THREADS	4
+
+/** Compile-time option of the size both tables need for a parallel merge */
+#define HT_MERGE_PARALLEL_MIN	65536
+
+/** Compile-time option of the fewest entries a Bloom filter is sized for */
+#define HT_BLOOM_MIN		1024
+
+/* Only keep statistics if asked to, so they cost nothing otherwise */
+#ifdef HT_STATS
+#define HT_STAT(stmt)		stmt
+#else
+#define HT_STAT(stmt)
+#endif
+
+/* The number of buckets whose occupied bits fit in one word of the bitmap */
+#define HT_WORD_BITS		(CHAR_BIT * sizeof(unsigned long))
+
+/* The number of words in the occupied bitmap of range buckets */
+#define HT_BITMAP_WORDS(range)	(((range) + HT_WORD_BITS - 1) / HT_WORD_BITS)
+
+/* Hint that memory will be read soon.  It's fine if p is a bad pointer. */
+#ifdef __GNUC__
+#define HT_PREFETCH(p)		__builtin_prefetch(p)
+#else
+#define HT_PREFETCH(p)		((void)(p))
+#endif
+
+/* The state of (part of) a merge */
+struct ht_merge_work {
+	ht base;
+	ht rest;
+	eq_func eq;
+	free_func free_key;
+	free_func free_value;
+	int uniq;		/* Nonzero to keep existing keys */
+	int rehash;		/* Nonzero if the tables hash differently */
+	unsigned int first;	/* The first bucket of rest to merge */
+	unsigned int last;	/* The bucket after the last one to merge */
+	unsigned int added;	/* Elements added to base's buckets */
+	unsigned int removed;	/* Elements removed from rest's buckets */
+	int error;		/* The errno value of a failure, or 0 */
+};
+
+static ht ht_create_internal(unsigned int, hash_func, fullhash_func,
+			     keyedhash_func, ht_type);
+static int ht_same_hash(ht, ht);
+static alist *ht_create_buckets(unsigned int);
+static unsigned long *ht_create_bitmap(unsigned int);
+static void ht_set_occupied(unsigned long *, unsigned int, int);
+static void ht_update_occupied(ht, hashval, alist);
+static unsigned int ht_lowest_bit(unsigned long);
+static unsigned int ht_next_occupied(unsigned long *, unsigned int,
+				     unsigned int);
+static void ht_walk_buckets(alist *, unsigned long *, unsigned int,
+			    unsigned int, assoc_func, gendata);
+static hashval ht_bucket_start(unsigned int, unsigned int);
+#ifdef DEBUG
+static hashval ht_bucket_search(unsigned int, unsigned int);
+#endif
+static unsigned int ht_scan_buckets(alist *, unsigned int, hashval, hashval,
+				    assoc_func, gendata);
+static unsigned int ht_rh_scan(ht, unsigned int, hashval, assoc_func,
+			       gendata);
+static void ht_set_thresholds(ht);
+static void ht_auto_resize(ht);
+static hashval ht_hashval(ht, gendata);
+static alist ht_locate(ht, hashval);
+static void ht_rehash_start(ht, unsigned int);
+static void ht_rehash_steps(ht, unsigned int);
+static ht ht_rehash_finish(ht);
+static ht_slot ht_rh_create_slots(unsigned int);
+static void ht_rh_place(ht_slot, unsigned int, hashval, gendata, gendata);
+static ht_slot ht_rh_find(ht, gendata, hashval, eq_func);
+static ht ht_rh_insert(ht, hashval, gendata, gendata, eq_func,
+		       free_func, free_func, int);
+static void ht_rh_remove(ht, ht_slot);
+static ht ht_rh_resize(ht, unsigned int);
+static void ht_rh_walk(ht, assoc_func, gendata);
+static void ht_bloom_fill_buckets(ht, bloom, alist *, unsigned int, int);
+static void ht_bloom_fill(ht, ht, bloom);
+static ht ht_bloom_rebuild(ht, double);
+static void ht_bloom_note(ht, hashval);
 static ht ht_insert_internal(ht, gendata, gendata, eq_func,
 			     free_func, free_func, int);
+#ifdef HT_STATS
+static gendata *ht_stats_find(ht, hashval, gendata, eq_func);
+#endif
+static void ht_stats_buckets(ht_stats_t *, alist *, unsigned int);
+static void ht_reserve(ht, unsigned int);
+static void ht_reset_occupied(ht);
+static int ht_merge_one(struct ht_merge_work *, hashval, gendata, gendata);
+static int ht_merge_bucket(struct ht_merge_work *, alist);
+static int ht_merge_slots(struct ht_merge_work *);
+#ifdef GUNE_THREADS
+static unsigned int ht_first_bucket_from(hashval, unsigned int);
+static void *ht_merge_worker(void *);
+static int ht_merge_parallel(struct ht_merge_work *);
+#endif
+static ht ht_merge_internal(ht, ht, eq_func, free_func, free_func, int);
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*
+ * Allocate an array of range empty buckets.  Returns NULL if out of memory.
+ */
+static alist *
+ht_create_buckets(unsigned int range)
+{
+	alist *buckets;
+	unsigned int i, j;
+
+	/*
+	 * We could use a Gune array, but we're resizing all buckets at once
+	 * so we would just be introducing unnecessary overhead.
+	 */
+	if ((buckets = (alist *)malloc(range * sizeof(alist))) == NULL)
+		return NULL;
+
+	/*
+	 * Slightly inefficient, we could also use memset, but that's
+	 * making assumptions about the value of NULL.  Plus, this code should
+	 * not be the bottleneck of any sane program.
+	 */
+	for (i = 0; i < range; ++i) {
+		if ((*(buckets + i) = alist_create()) == NULL) {
+			/* Creation went wrong halfway?  Destroy all previous */
+			for (j = 0; j < i; ++j)
+				alist_destroy(*(buckets + j), NULL, NULL);
+
+			free(buckets);
+			return NULL;
+		}
+	}
+
+	return buckets;
+}
+
+
+/*
+ * Allocate an occupied bitmap for range buckets, with all bits clear.
+ * Returns NULL if out of memory.
+ *
+ * Chained tables keep one bit per bucket, which is set if the bucket has
+ * any entries.  This lets ht_walk skip a whole word's worth of empty
+ * buckets at once, so walking a big sparse table is cheap.
+ */
+static unsigned long *
+ht_create_bitmap(unsigned int range)
+{
+	return calloc(HT_BITMAP_WORDS(range), sizeof(unsigned long));
+}
+
+
+/*
+ * Set or clear the bit of bucket nr in an occupied bitmap.
+ */
+static void
+ht_set_occupied(unsigned long *bitmap, unsigned int nr, int occupied)
+{
+	unsigned long bit;
+
+	bit = 1UL << (nr % HT_WORD_BITS);
+	if (occupied)
+		bitmap[nr / HT_WORD_BITS] |= bit;
+	else
+		bitmap[nr / HT_WORD_BITS] &= ~bit;
+}
+
+
+/*
+ * Update the occupied bit of bucket al, after an entry with the given hash
+ * value has been added to or removed from it.  This finds the bucket the
+ * same way ht_locate does.
+ */
+static void
+ht_update_occupied(ht t, hashval hash, alist al)
+{
+	unsigned int bucketnr;
+
+	bucketnr = hash_reduce(hash, t->range);
+
+	if (bucketnr < t->rehash_pos)
+		ht_set_occupied(t->rehash_occupied,
+				hash_reduce(hash, t->rehash_range),
+				!alist_empty(al));
+	else
+		ht_set_occupied(t->occupied, bucketnr, !alist_empty(al));
+}
+
+
+/*
+ * Return the number of the lowest bit which is set in a nonzero word.
+ */
+static unsigned int
+ht_lowest_bit(unsigned long word)
+{
+#ifdef __GNUC__
+	return (unsigned int)__builtin_ctzl(word);
+#else
+	unsigned int nr;
+
+	for (nr = 0; (word & 1UL) == 0; ++nr)
+		word >>= 1;
+
+	return nr;
+#endif
+}
+
+
+/*
+ * Find the first occupied bucket from first up to (not including) last.
+ * Returns last if there is none.
+ */
+static unsigned int
+ht_next_occupied(unsigned long *bitmap, unsigned int first, unsigned int last)
+{
+	unsigned long word;
+	unsigned int w;
+
+	if (first >= last)
+		return last;
+
+	/* Buckets before first may not exist anymore */
+	w = first / HT_WORD_BITS;
+	word = bitmap[w] & (~0UL << (first % HT_WORD_BITS));
+
+	while (word == 0) {
+		if (++w >= HT_BITMAP_WORDS(last))
+			return last;
+		word = bitmap[w];
+	}
+
+	return (unsigned int)(w * HT_WORD_BITS) + ht_lowest_bit(word);
+}
+
+
+/*
+ * Walk the occupied buckets from first up to (not including) last.
+ */
+static void
+ht_walk_buckets(alist *buckets, unsigned long *bitmap, unsigned int first,
+		unsigned int last, assoc_func walk, gendata data)
+{
+	unsigned int nr;
+
+	for (nr = ht_next_occupied(bitmap, first, last); nr < last;
+	     nr = ht_next_occupied(bitmap, nr + 1, last))
+		alist_walk(buckets[nr], walk, data);
+}
+
+
+/*
+ * Find the lowest hash value which maps onto bucket nr (or a later one).
+ * Returns 0 if nr is beyond the last bucket.
+ *
+ * hash_reduce(h, range) is the high word of h times range, so this is
+ * nr << 32 divided by range, rounded up.  With 64-bit hash values only the
+ * high word of h counts, so the division gives that word.
+ */
+static hashval
+ht_bucket_start(unsigned int nr, unsigned int range)
+{
+	hashval start;
+
+	if (nr == 0 || nr >= range)
+		return 0;
+
+#if ULONG_MAX > 0xFFFFFFFFUL
+	start = ((((hashval)nr << 32) + range - 1) / range) << 32;
+#else
+	/* Without a 64-bit type, divide approximately and correct it */
+	start = (hashval)((double)nr * 4294967296.0 / (double)range);
+	while (start > 0 && hash_reduce(start - 1, range) >= nr)
+		--start;
+	while (hash_reduce(start, range) < nr)
+		++start;
+#endif
+#ifdef DEBUG
+	assert(start == ht_bucket_search(nr, range));
+#endif
+
+	return start;
+}
+
+
+#ifdef DEBUG
+/*
+ * Find the lowest hash value which maps onto bucket nr the slow way, by
+ * a binary search, to check ht_bucket_start.
+ */
+static hashval
+ht_bucket_search(unsigned int nr, unsigned int range)
+{
+	hashval lo, hi, mid;
+
+	/* hash_reduce is monotonic, and the highest hash maps to range - 1 */
+	lo = 0;
+	hi = ~(hashval)0;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (hash_reduce(mid, range) < nr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+#endif
+
+
+/*
+ * Visit the entries of a chained table with hash values from lo up to (not
+ * including) hi, or up to the highest hash value if hi is 0.  Returns the
+ * number of entries visited.
+ */
+static unsigned int
+ht_scan_buckets(alist *buckets, unsigned int range, hashval lo, hashval hi,
+		assoc_func walk, gendata data)
+{
+	unsigned int nr, last, n;
+	alist_entry e;
+	sll l, next;
+
+	n = 0;
+	last = (hi == 0) ? range - 1 : hash_reduce(hi - 1, range);
+
+	for (nr = hash_reduce(lo, range); nr <= last; ++nr) {
+		/* The walk may delete the current entry */
+		for (l = buckets[nr]->list; !sll_empty(l); l = next) {
+			next = sll_next(l);
+			e = sll_get_data(l).ptr;
+			if (e->hash >= lo && (hi == 0 || e->hash < hi)) {
+				walk(&e->key, &e->value, data);
+				++n;
+			}
+		}
+	}
+
+	return n;
+}
+
+
+/*
+ * Recalculate the element counts at which the table should be resized.
+ * This is done once per resize, so we don't need any floating point
+ * arithmetic on every insert or delete.
+ */
+static void
+ht_set_thresholds(ht t)
+{
+	if (t->max_load > 0.0 && t->max_load * t->range < (double)UINT_MAX)
+		t->grow_at = (unsigned int)(t->max_load * t->range);
+	else
+		t->grow_at = UINT_MAX;		/* Never grow */
+
+	t->shrink_at = (unsigned int)(t->min_load * t->range);
+}
+
+
+/*
+ * Grow or shrink the table if its load factor went out of bounds.
+ * A failed resize is not an error: the table is still perfectly valid, just
+ * a bit more crowded than we would like.  We retry at the next insert.
+ */
+static void
+ht_auto_resize(ht t)
+{
+	unsigned int range;
+	int saved_errno;
+
+	/*
+	 * Don't pull the buckets from under ht_walk's feet, and finish one
+	 * incremental rehash before starting the next.
+	 */
+	if (t->walking || t->rehash_buckets != NULL)
+		return;
+
+	if (t->count > t->grow_at && t->range <= (UINT_MAX - 1) / 2)
+		range = t->range * 2 + 1;
+	else if (t->count < t->shrink_at && t->range > t->min_range)
+		range = MAX((t->range - 1) / 2, t->min_range);
+	else
+		return;
+
+	/* Failing to resize is not an error, so it mustn't touch errno */
+	saved_errno = errno;
+	if (t->rehash_step > 0)
+		ht_rehash_start(t, range);
+	else
+		ht_resize(t, range);
+	errno = saved_errno;
+}
+
+
+/*
+ * Calculate the full hash value of a key.  Old-style hashing functions get
+ * the widest range possible, and we reduce the result to a bucket number
+ * ourselves.  This way, the hash value can be cached with every entry.
+ * The value is scrambled, because buckets are picked by its high bits and
+ * simple hashing functions tend to only vary the low ones.  Scrambling
+ * also keeps similar keys from building long clusters in open addressing
+ * tables.
+ */
+static hashval
+ht_hashval(ht t, gendata key)
+{
+	/* A keyed hash is already as good as it gets */
+	if (t->keyedhash != NULL)
+		return t->keyedhash(key, &t->seed);
+
+	if (t->fullhash != NULL)
+		return hash_mix(t->fullhash(key));
+
+	assert(t->hash != NULL);
+
+	return hash_mix(t->hash(key, UINT_MAX));
+}
+
+
+/*
+ * Check whether two tables give every key the same hash value, so their
+ * cached hash values can be moved from one to the other.
+ */
+static int
+ht_same_hash(ht t, ht u)
+{
+	if (t->hash != u->hash || t->fullhash != u->fullhash ||
+	    t->keyedhash != u->keyedhash)
+		return 0;
+
+	return (t->keyedhash == NULL || (t->seed.k[0] == u->seed.k[0] &&
+					 t->seed.k[1] == u->seed.k[1]));
+}
+
+
+/*
+ * Find the bucket in which a key with the given hash value is stored, or
+ * should be stored.
+ * While an incremental rehash is in progress, keys whose bucket has already
+ * been moved are found in the new buckets, all others in the old ones.
+ */
+static alist
+ht_locate(ht t, hashval hash)
+{
+	unsigned int bucketnr;
+
+	bucketnr = hash_reduce(hash, t->range);
+
+	/* Only nonzero while moving entries, not while creating buckets */
+	if (bucketnr < t->rehash_pos)
+		return *(t->rehash_buckets +
+			 hash_reduce(hash, t->rehash_range));
+
+	return *(t->buckets + bucketnr);
+}
+
+
+/*
+ * Start an incremental rehash of the table into range buckets.
+ * Just like ht_auto_resize, failure is not an error.  It is simply retried
+ * when the next resize is due.
+ */
+static void
+ht_rehash_start(ht t, unsigned int range)
+{
+	assert(t->rehash_buckets == NULL);
+
+	if ((t->rehash_buckets = malloc(range * sizeof(alist))) == NULL)
+		return;
+
+	if ((t->rehash_occupied = ht_create_bitmap(range)) == NULL) {
+		free(t->rehash_buckets);
+		t->rehash_buckets = NULL;
+		return;
+	}
+
+	t->rehash_range = range;
+	t->rehash_made = 0;
+	t->rehash_pos = 0;
+	HT_STAT(++t->stats->rehashes);
+}
+
+
+/*
+ * Perform a bounded amount of work on an incremental rehash in progress.
+ * This happens in two phases.  First, the new (empty) buckets are created,
+ * two per step because that is cheap.  Then the entries of one old bucket
+ * per step are moved to the new buckets.  When all buckets are done, the
+ * new buckets replace the old ones.
+ */
+static void
+ht_rehash_steps(ht t, unsigned int steps)
+{
+	unsigned int i;
+	alist_entry e;
+	alist al;
+	int saved_errno;
+
+	for (; steps > 0 && t->rehash_buckets != NULL; --steps) {
+		if (t->rehash_made < t->rehash_range) {
+			for (i = 0; i < 2 && t->rehash_made < t->rehash_range;
+			     ++i) {
+				/* Out of memory?  Try again next time. */
+				saved_errno = errno;
+				if ((al = alist_create()) == NULL) {
+					errno = saved_errno;
+					return;
+				}
+				*(t->rehash_buckets + t->rehash_made++) = al;
+			}
+			continue;
+		}
+
+		al = *(t->buckets + t->rehash_pos);
+		while (!alist_empty(al)) {
+			e = sll_get_data(al->list).ptr;
+			i = hash_reduce(e->hash, t->rehash_range);
+			alist_move_head(*(t->rehash_buckets + i), al);
+			ht_set_occupied(t->rehash_occupied, i, 1);
+		}
+		alist_destroy(al, NULL, NULL);
+		ht_set_occupied(t->occupied, t->rehash_pos, 0);
+		*(t->buckets + t->rehash_pos++) = NULL;
+
+		if (t->rehash_pos == t->range) {
+			free(t->buckets);
+			free(t->occupied);
+			t->buckets = t->rehash_buckets;
+			t->occupied = t->rehash_occupied;
+			t->range = t->rehash_range;
+			t->rehash_buckets = NULL;
+			t->rehash_occupied = NULL;
+			t->rehash_range = t->rehash_made = t->rehash_pos = 0;
+			ht_set_thresholds(t);
+		}
+	}
+}
+
+
+/*
+ * Complete an incremental rehash in progress, if any.
+ * Returns NULL if the new buckets could not be allocated, but the table
+ * is still valid in that case.
+ */
+static ht
+ht_rehash_finish(ht t)
+{
+	while (t->rehash_buckets != NULL) {
+		ht_rehash_steps(t, UINT_MAX);
+
+		/* No progress in the first phase means we're out of memory */
+		if (t->rehash_buckets != NULL &&
+		    t->rehash_made < t->rehash_range) {
+			errno = ENOMEM;
+			return NULL;
+		}
+	}
+
+	return t;
+}
+
+
+/*
+ * The functions below implement the open addressing engine (HT_ROBINHOOD).
+ * All entries are stored inline in one array of slots, and collisions
+ * are resolved with linear probing.  On insert, an entry which is further
+ * from its home slot than the entry it runs into takes that entry's slot
+ * (``robbing the rich''), so probe lengths stay short and even.
+ * A lookup can stop as soon as it runs into an entry which is closer to
+ * its home than the key would be at that point.  Deleting an entry shifts
+ * the entries after it back by one, so no tombstones are ever needed.
+ * The table always has at least one empty slot, which guarantees
+ * termination of all loops.
+ */
+
+/*
+ * Allocate an array of range empty slots.  Returns NULL if out of memory.
+ */
+static ht_slot
+ht_rh_create_slots(unsigned int range)
+{
+	ht_slot slots;
+	unsigned int i;
+
+	if ((slots = malloc(range * sizeof(ht_slot_t))) == NULL)
+		return NULL;
+
+	for (i = 0; i < range; ++i)
+		slots[i].psl = 0;
+
+	return slots;
+}
+
+
+/*
+ * Place an entry with the given hash value which is known not to be in the
+ * slots yet.  There must be an empty slot.
+ */
+static void
+ht_rh_place(ht_slot slots, unsigned int range, hashval hash,
+	    gendata key, gendata value)
+{
+	unsigned int pos;
+	ht_slot_t entry, tmp;
+
+	entry.key = key;
+	entry.value = value;
+	entry.hash = hash;
+	entry.psl = 1;
+	pos = hash_reduce(hash, range);
+
+	for (;;) {
+		if (slots[pos].psl == 0) {
+			slots[pos] = entry;
+			return;
+		}
+
+		/* Rob the rich, then go on placing the displaced entry */
+		if (slots[pos].psl < entry.psl) {
+			tmp = slots[pos];
+			slots[pos] = entry;
+			entry = tmp;
+		}
+
+		if (++pos == range)
+			pos = 0;
+		++entry.psl;
+	}
+}
+
+
+/*
+ * Find the slot containing key, which has the given hash value.
+ * Returns NULL if the key is not in the table.
+ */
+static ht_slot
+ht_rh_find(ht t, gendata key, hashval hash, eq_func eq)
+{
+	unsigned int psl;
+	ht_slot s;
+
+	s = t->slots + hash_reduce(hash, t->range);
+
+	for (psl = 1; ; ++psl) {
+		/* An empty slot or a richer entry means the key isn't here */
+		if (s->psl < psl)
+			return NULL;
+
+		/* Only call eq if the entry could possibly be the key */
+		if (s->hash == hash && eq(key, s->key))
+			return s;
+
+		if (++s == t->slots + t->range)
+			s = t->slots;
+	}
+}
+
+
+/*
+ * Open addressing version of ht_insert_internal.
+ */
+static ht
+ht_rh_insert(ht t, hashval hash, gendata key, gendata value, eq_func eq,
+	     free_func free_key, free_func free_value, int uniq)
+{
+	ht_slot s;
+
+	if ((s = ht_rh_find(t, key, hash, eq)) != NULL) {
+		/* Duplicates not allowed? */
+		if (uniq) {
+			errno = EINVAL;
+			return NULL;
+		}
+
+		/* Free old data */
+		if (free_key != NULL)
+			free_key(s->key.ptr);
+		if (free_value != NULL)
+			free_value(s->value.ptr);
+		s->key = key;
+		s->value = value;
+		return t;
+	}
+
+	/* Keep at least one slot empty, whatever the load factor says */
+	if (t->count + 1 >= t->range) {
+		if (t->range > (UINT_MAX - 1) / 2) {
+			errno = ENOMEM;
+			return NULL;
+		}
+		if (ht_rh_resize(t, t->range * 2 + 1) == NULL)
+			return NULL;
+	}
+
+	ht_rh_place(t->slots, t->range, hash, key, value);
+	++t->count;
+	ht_auto_resize(t);
+
+	return t;
+}
+
+
+/*
+ * Remove the entry in slot s, shifting back the entries after it until
+ * we hit an empty slot or an entry which is in its home slot.
+ */
+static void
+ht_rh_remove(ht t, ht_slot s)
+{
+	ht_slot next;
+
+	for (;;) {
+		next = s + 1;
+		if (next == t->slots + t->range)
+			next = t->slots;
+
+		if (next->psl <= 1)
+			break;
+
+		*s = *next;
+		--s->psl;
+		s = next;
+	}
+
+	s->psl = 0;
+	--t->count;
+}
+
+
+/*
+ * Open addressing version of ht_resize.  Since the slots cache the hash
+ * values, this never needs to call the hashing function.
+ */
+static ht
+ht_rh_resize(ht t, unsigned int range)
+{
+	ht_slot slots, s;
+
+	/* We need room for all entries, plus one empty slot */
+	if (range <= t->count) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if ((slots = ht_rh_create_slots(range)) == NULL)
+		return NULL;
+
+	for (s = t->slots; s < t->slots + t->range; ++s)
+		if (s->psl != 0)
+			ht_rh_place(slots, range, s->hash, s->key, s->value);
+
+	free(t->slots);
+	t->slots = slots;
+	t->range = range;
+	ht_set_thresholds(t);
+	HT_STAT(++t->stats->rehashes);
+
+	return t;
+}
+
+
+/*
+ * Open addressing version of ht_walk.
+ * We walk backwards, starting at an empty slot.  When the user deletes the
+ * current entry, the entries after it shift back one slot, but we have
+ * already visited those.  The shifting never goes beyond the empty slot we
+ * started at, so no entry can be moved from the unvisited to the visited
+ * part of the table, or vice versa.
+ */
+static void
+ht_rh_walk(ht t, assoc_func walk, gendata data)
+{
+	unsigned int i, pos;
+
+	for (pos = 0; t->slots[pos].psl != 0; ++pos)
+		;
+
+	for (i = 1; i < t->range; ++i) {
+		pos = (pos == 0) ? t->range - 1 : pos - 1;
+		if (t->slots[pos].psl != 0)
+			walk(&t->slots[pos].key, &t->slots[pos].value, data);
+	}
+}
+
+
+/*
+ * Open addressing part of ht_scan: visit the entries whose home slot is
+ * home and whose hash value is at least lo.  Returns the number of entries
+ * visited.
+ * Entries are kept in order of their home slots, so these entries are all
+ * next to each other, after the entries which belong to earlier slots.
+ * Just like ht_rh_walk, we visit them backwards so the walk function may
+ * delete the current entry.
+ */
+static unsigned int
+ht_rh_scan(ht t, unsigned int home, hashval lo, assoc_func walk,
+	   gendata data)
+{
+	unsigned int first, k, n;
+	ht_slot s;
+
+	/* Find the entries which are k slots from home, like we are */
+	first = UINT_MAX;
+	for (k = 0; ; ++k) {
+		s = t->slots + (home + k) % t->range;
+		if (s->psl == 0 || s->psl - 1 < k)
+			break;
+		if (s->psl - 1 == k && first == UINT_MAX)
+			first = k;
+	}
+
+	if (first == UINT_MAX)
+		return 0;
+
+	n = 0;
+	while (k-- > first) {
+		s = t->slots + (home + k) % t->range;
+		if (s->hash >= lo) {
+			walk(&s->key, &s->value, data);
+			++n;
+		}
+	}
+
+	return n;
+}
+
+
+/*
+ * Add the hash values t has for the keys in n buckets to a Bloom filter.
+ * If rehash is nonzero, the buckets are of a table with a different hashing
+ * function, so their cached hash values are of no use.
+ */
+static void
+ht_bloom_fill_buckets(ht t, bloom f, alist *buckets, unsigned int n,
+		      int rehash)
+{
+	alist_entry e;
+	unsigned int nr;
+	sll l;
+
+	for (nr = 0; nr < n; ++nr) {
+		for (l = buckets[nr]->list; !sll_empty(l); l = sll_next(l)) {
+			e = sll_get_data(l).ptr;
+			bloom_add(f, rehash ? ht_hashval(t, e->key) : e->hash);
+		}
+	}
+}
+
+
+/*
+ * Add the hash values t has for all keys of table from (which may be t
+ * itself) to a Bloom filter.
+ */
+static void
+ht_bloom_fill(ht t, ht from, bloom f)
+{
+	ht_slot s;
+	int rehash;
+
+	rehash = !ht_same_hash(t, from);
+
+	if (from->type == HT_ROBINHOOD) {
+		for (s = from->slots; s < (from->slots + from->range); ++s)
+			if (s->psl != 0)
+				bloom_add(f, rehash ? ht_hashval(t, s->key) :
+					  s->hash);
+		return;
+	}
+
+	/* Buckets which have already been rehashed are gone */
+	ht_bloom_fill_buckets(t, f, from->buckets + from->rehash_pos,
+			      from->range - from->rehash_pos, rehash);
+	if (from->rehash_buckets != NULL)
+		ht_bloom_fill_buckets(t, f, from->rehash_buckets,
+				      from->rehash_made, rehash);
+}
+
+
+/*
+ * Replace the Bloom filter of a table by a new one with the given false
+ * positive rate, sized for twice the current number of elements.  Returns
+ * NULL if out of memory, in which case the old filter is left alone.
+ */
+static ht
+ht_bloom_rebuild(ht t, double fp)
+{
+	unsigned int n;
+	bloom f;
+
+	n = (t->count > UINT_MAX / 2) ? UINT_MAX : t->count * 2;
+	if (n < HT_BLOOM_MIN)
+		n = HT_BLOOM_MIN;
+
+	if ((f = bloom_create(n, fp)) == NULL)
+		return NULL;
+
+	ht_bloom_fill(t, t, f);
+
+	if (t->filter != NULL)
+		bloom_destroy(t->filter);
+	t->filter = f;
+	t->filter_fp = fp;
+	t->filter_added = t->count;
+	t->filter_limit = n;
+
+	return t;
+}
+
+
+/*
+ * Add the hash value of a new element to the Bloom filter of a table, if
+ * it has one.  Deleted elements stay in the filter, so it is rebuilt once
+ * as many elements were added as it was sized for.  If that fails, the old
+ * filter is still correct, it just gives more false positives.
+ */
+static void
+ht_bloom_note(ht t, hashval hash)
+{
+	int saved_errno;
+
+	if (t->filter == NULL)
+		return;
+
+	bloom_add(t->filter, hash);
+	if (++t->filter_added <= t->filter_limit)
+		return;
+
+	saved_errno = errno;
+	if (ht_bloom_rebuild(t, t->filter_fp) == NULL) {
+		errno = saved_errno;
+		t->filter_limit = (t->filter_limit > UINT_MAX / 2) ?
+			UINT_MAX : t->filter_limit * 2;
+	}
+}
+
+
+/**
+ * \brief Create a new empty hash table.
+ *
+ * The table grows automatically when it fills up, and shrinks again
+ * (but never below \p range) when most of its elements are deleted.
+ * See ht_set_load_factor to tune this behaviour.
+ *
+ * The hashing function is called with a range of \c UINT_MAX.  The table
+ * reduces the result to a bucket number itself, and caches it with every
+ * entry.  Resizing never calls the hashing function, and the equals
+ * predicate is only called on keys with the same hash.
+ *
+ * \param range  The initial number of buckets, or 0 to use a sensible
+ *		  default.
+ * \param hash   The hashing function to use on keys.
+ *
+ * \return  A new empty hash table object, or \c NULL if an error occurred.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ht_destroy ht_set_load_factor ht_create_type ht_create_full
+ *     ht_create_keyed
+ */
+ht
+ht_create(unsigned int range, hash_func hash)
+{
+	return ht_create_type(range, hash, HT_CHAINED);
+}
+
+
+/**
+ * \brief Create a new empty hash table which uses a specific engine.
+ *
+ * All hash table functions work the same on all engines, but they have
+ * different performance characteristics:
+ * - \b HT_CHAINED stores the entries in an association list per bucket.
+ *	Inserts and deletes are cheap, and the table degrades gracefully
+ *	when it gets crowded.  This is what ht_create uses.
+ * - \b HT_ROBINHOOD stores the entries in one flat array of slots, using
+ *	open addressing with Robin Hood probing.  Lookups touch far fewer
+ *	cache lines and no memory is allocated per entry, but the table
+ *	always has to be resized before it is full.
+ *	Its default maximum load factor is 0.875.  The cached hash values are
+ *	scrambled, so simple hashing functions don't build long clusters.
+ *
+ * \param range  The initial number of buckets, or 0 to use a sensible
+ *		  default.
+ * \param hash   The hashing function to use on keys.
+ * \param type   The engine to use.
+ *
+ * \return  A new empty hash table object, or \c NULL if an error occurred.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ht_create ht_create_full ht_destroy
+ */
+ht
+ht_create_type(unsigned int range, hash_func hash, ht_type type)
+{
+	assert(hash != NULL);
+
+	return ht_create_internal(range, hash, NULL, NULL, type);
+}
+
+
+/**
+ * \brief Create a new empty hash table with a full-width hashing function.
+ *
+ * This is like ht_create_type, but the hashing function does not reduce its
+ * result to a range.  On most 64-bit platforms, this makes the hash values
+ * cached with the entries 64 bits wide, so keys with the same hash value
+ * (which get compared with the equals predicate) are much rarer.
+ *
+ * \param range  The initial number of buckets, or 0 to use a sensible
+ *		  default.
+ * \param hash   The full-width hashing function to use on keys.
+ * \param type   The engine to use.
+ *
+ * \return  A new empty hash table object, or \c NULL if an error occurred.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ht_create_type ht_destroy str_fullhash
+ */
+ht
+ht_create_full(unsigned int range, fullhash_func hash, ht_type type)
+{
+	assert(hash != NULL);
+
+	return ht_create_internal(range, NULL, hash, NULL, type);
+}
+
+
+/**
+ * \brief Create a new empty hash table with a keyed hashing function.
+ *
+ * This is like ht_create_full, but the table gets its own random seed for
+ * the hashing function.  Use it when the keys come from untrusted sources:
+ * without the seed nobody can predict which keys collide, so nobody can
+ * turn the table into one long list by feeding it colliding keys.
+ *
+ * \param range  The initial number of buckets, or 0 to use a sensible
+ *		  default.
+ * \param hash   The keyed hashing function to use on keys.
+ * \param type   The engine to use.
+ *
+ * \return  A new empty hash table object, or \c NULL if an error occurred.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ht_create_full ht_destroy str_keyedhash hash_seed
+ */
+ht
+ht_create_keyed(unsigned int range, keyedhash_func hash, ht_type type)
+{
+	ht t;
+
+	assert(hash != NULL);
+
+	if ((t = ht_create_internal(range, NULL, NULL, hash, type)) != NULL)
+		hash_seed(&t->seed);
+
+	return t;
+}
+
+
+/*
+ * Internal function which all creation functions call.  Exactly one of
+ * hash, fullhash and keyedhash should be non-NULL.
+ */
+static ht
+ht_create_internal(unsigned int range, hash_func hash, fullhash_func fullhash,
+		   keyedhash_func keyedhash, ht_type type)
+{
+	ht_t *t;
+
+	assert(type == HT_CHAINED || type == HT_ROBINHOOD);
+
+	if (range == 0)
+		range = HT_DEFAULT_RANGE;
+
+	if ((t = malloc(sizeof(ht_t))) == NULL)
+		return NULL;
+
+	t->type = type;
+	t->buckets = NULL;
+	t->occupied = NULL;
+	t->slots = NULL;
+
+	/*
+	 * The statistics go first, so that there are no buckets to destroy
+	 * if they can't be allocated.
+	 */
+	t->stats = NULL;
+#ifdef HT_STATS
+	if ((t->stats = calloc(1, sizeof(ht_stats_t))) == NULL) {
+		free(t);
+		return NULL;
+	}
+#endif
+
+	if (type == HT_ROBINHOOD) {
+		t->slots = ht_rh_create_slots(range);
+		t->max_load = HT_DEFAULT_OA_MAX_LOAD;
+	} else if ((t->occupied = ht_create_bitmap(range)) != NULL) {
+		t->buckets = ht_create_buckets(range);
+		t->max_load = HT_DEFAULT_MAX_LOAD;
+	}
+
+	if (t->buckets == NULL && t->slots == NULL) {
+		free(t->occupied);
+		free(t->stats);
+		free(t);
+		return NULL;
+	}
+
+	t->range = range;
+	t->hash = hash;
+	t->fullhash = fullhash;
+	t->keyedhash = keyedhash;
+	t->seed.k[0] = t->seed.k[1] = 0;
+	t->count = 0;
+	t->min_range = range;
+	t->min_load = HT_DEFAULT_MIN_LOAD;
+	t->walking = 0;
+	t->rehash_buckets = NULL;
+	t->rehash_occupied = NULL;
+	t->rehash_range = t->rehash_made = t->rehash_pos = 0;
+	t->rehash_step = 0;
+	t->filter = NULL;
+	t->filter_fp = 0.0;
+	t->filter_added = t->filter_limit = 0;
+	ht_set_thresholds(t);
+
+	return (ht)t;
+}
+
+
+/**
+ * \brief Set the load factors at which a hash table is resized.
+ *
+ * The load factor is the number of elements divided by the number of
+ * buckets.  When it rises above \p max_load the table is grown to about
+ * twice its range, when it drops below \p min_load it is shrunk to about
+ * half its range.  A table never shrinks below its initial range.
+ *
+ * \param t         The hash table to configure.
+ * \param min_load  The load factor below which to shrink, or 0 to never
+ *		      shrink the table.
+ * \param max_load  The load factor above which to grow, or 0 to never
+ *		      grow the table.
+ *
+ * \return  The hash table, or \c NULL if the load factors are invalid.
+ *
+ * \par Errno values:
+ * - \b EINVAL if a load factor is negative, or \p min_load is not
+ *	less than half of \p max_load.  (which would make the table grow and
+ *	shrink all the time)  Also if \p max_load is 1 or more for an open
+ *	addressing table.
+ *
+ * \sa ht_create ht_resize
+ */
+ht
+ht_set_load_factor(ht t, double min_load, double max_load)
+{
+	assert(t != NULL);
+
+	if (min_load < 0.0 || max_load < 0.0 ||
+	    (max_load > 0.0 && min_load * 2.0 >= max_load) ||
+	    (t->type != HT_CHAINED && max_load >= 1.0)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	t->min_load = min_load;
+	t->max_load = max_load;
+	ht_set_thresholds(t);
+	ht_auto_resize(t);
+
+	return t;
+}
+
+
+/**
+ * \brief Change the number of buckets of a hash table.
+ *
+ * All elements are redistributed over the new buckets.  This is done
+ * automatically when the table's load factor goes out of bounds, but it
+ * can be useful to call it by hand before inserting lots of elements.
+ *
+ * \note
+ * This always redistributes all elements at once, even if the table
+ * has been set to rehash incrementally.  An incremental rehash in progress
+ * is completed first.
+ *
+ * \param t      The hash table to resize.
+ * \param range  The new range of the key function.
+ *
+ * \return  The hash table, or \c NULL if an error occurred.  The table is
+ *	     left untouched in case of error.
+ *
+ * \par Errno values:
+ * - \b EINVAL if \p range is 0, or too small to hold all elements of an
+ *	open addressing table.
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ht_create ht_set_load_factor
+ */
+ht
+ht_resize(ht t, unsigned int range)
+{
+	unsigned int i, nr;
+	unsigned long *occupied;
+	alist *buckets;
+	alist_entry e;
+	alist al;
+
+	assert(t != NULL);
+
+	if (range == 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (t->type == HT_ROBINHOOD)
+		return ht_rh_resize(t, range);
+
+	if (ht_rehash_finish(t) == NULL)
+		return NULL;
+
+	if (range == t->range)
+		return t;
+
+	if ((occupied = ht_create_bitmap(range)) == NULL)
+		return NULL;
+
+	if ((buckets = ht_create_buckets(range)) == NULL) {
+		free(occupied);
+		return NULL;
+	}
+
+	/*
+	 * Relink all entries, so this can't fail halfway.  The entries carry
+	 * their hash values, so the hashing function isn't needed.
+	 */
+	for (i = 0; i < t->range; ++i) {
+		al = *(t->buckets + i);
+		while (!alist_empty(al)) {
+			e = sll_get_data(al->list).ptr;
+			nr = hash_reduce(e->hash, range);
+			alist_move_head(*(buckets + nr), al);
+			ht_set_occupied(occupied, nr, 1);
+		}
+		alist_destroy(al, NULL, NULL);
+	}
+
+	free(t->buckets);
+	free(t->occupied);
+	t->buckets = buckets;
+	t->occupied = occupied;
+	t->range = range;
+	ht_set_thresholds(t);
+	HT_STAT(++t->stats->rehashes);
+
+	return t;
+}
+
+
+/**
+ * \brief Set the amount of rehashing work done per hash table operation.
+ *
+ * Normally, when a hash table needs to grow or shrink, all its elements
+ * are redistributed at once.  For big tables this can take a noticeable
+ * amount of time, during which the insert or delete that triggered it
+ * blocks.  In incremental mode, the old buckets are kept around instead,
+ * and every ht_insert, ht_lookup and ht_delete rehashes a few buckets
+ * until all elements have moved.  Until then, both sets of buckets are
+ * consulted.
+ *
+ * \note
+ * Only chained tables can be rehashed incrementally.  For other tables,
+ * this setting is ignored.
+ *
+ * \param t     The hash table to configure.
+ * \param step  The number of buckets to rehash per operation, or 0 to
+ *		  always rehash the whole table at once (the default).
+ *
+ * \return  The hash table, or \c NULL if an error occurred.  When turning
+ *	     incremental mode off while a rehash is in progress, the rehash is
+ *	     completed first.  If that fails the table is left untouched.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ht_set_load_factor ht_resize
+ */
+ht
+ht_set_rehash_step(ht t, unsigned int step)
+{
+	assert(t != NULL);
+
+	if (t->type != HT_CHAINED)
+		return t;
+
+	if (step == 0 && ht_rehash_finish(t) == NULL)
+		return NULL;
+
+	t->rehash_step = step;
+
+	return t;
+}
+
+
+/**
+ * \brief Attach a Bloom filter to a hash table, or remove it.
+ *
+ * The filter holds the hash values of all keys in the table.  Lookups and
+ * deletions of most keys which aren't in the table then fail without
+ * looking at the buckets, or calling the equals predicate.  This is worth
+ * it for tables which see many misses, especially with long chains or
+ * expensive keys.  On hits it costs a little time, and the filter takes
+ * about 1.44 * log2(1/\p fp) bits per element.
+ *
+ * The filter is rebuilt automatically as elements are added.
+ *
+ * \param t   The hash table to configure.
+ * \param fp  The false positive rate of the filter, between 0 and 1, or 0
+ *	       to remove the filter.  This is the fraction of misses which
+ *	       still have to look at the buckets.
+ *
+ * \return  The hash table, or \c NULL if an error occurred.  The table is
+ *	     left untouched in case of error.
+ *
+ * \par Errno values:
+ * - \b EINVAL if \p fp is negative, or 1 or more.
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ht_lookup bloom_create
+ */
+ht
+ht_set_bloom(ht t, double fp)
+{
+	assert(t != NULL);
+
+	if (fp < 0.0 || fp >= 1.0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (fp == 0.0) {
+		if (t->filter != NULL)
+			bloom_destroy(t->filter);
+		t->filter = NULL;
+		return t;
+	}
+
+	return ht_bloom_rebuild(t, fp);
+}
+
+
+/**
+ * \brief Free all memory allocated for a hash table.
+ *
+ * The data within the table is freed by calling a user-supplied free function.
+ *
+ * \note
+ * If the same data is included multiple times in the table, the free function
+ * gets called that many times.
+ * This is currently impossible, unless really strange things have been
+ * going on. (like, say, a random hashing function)
+ *
+ * \param t           The hash table to destroy.
+ * \param free_key    The function which is used to free the key data, or
+ *			\c NULL if no action should be taken on the key data.
+ * \param free_value  The function which is used to free the value data, or
+ *			\c NULL if no action should be taken on the value data.
+ *
+ * \sa ht_create
+ */
+void
+ht_destroy(ht t, free_func free_key, free_func free_value)
+{
+	alist *al;
+	ht_slot s;
+
+	assert(t != NULL);
+
+	if (t->filter != NULL)
+		bloom_destroy(t->filter);
+	free(t->stats);
+
+	if (t->type == HT_ROBINHOOD) {
+		for (s = t->slots; s < (t->slots + t->range); ++s) {
+			if (s->psl == 0)
+				continue;
+			if (free_key != NULL)
+				free_key(s->key.ptr);
+			if (free_value != NULL)
+				free_value(s->value.ptr);
+		}
+
+		free(t->slots);
+		free(t);
+		return;
+	}
+
+	/* Buckets which have already been rehashed are gone */
+	for (al = t->buckets + t->rehash_pos; al < (t->buckets + t->range);
+	     ++al)
+		alist_destroy(*al, free_key, free_value);
+
+	free(t->buckets);
+	free(t->occupied);
+
+	if (t->rehash_buckets != NULL) {
+		for (al = t->rehash_buckets;
+		     al < (t->rehash_buckets + t->rehash_made); ++al)
+			alist_destroy(*al, free_key, free_value);
+
+		free(t->rehash_buckets);
+		free(t->rehash_occupied);
+	}
+
+	free(t);
+}
+
+
+/*
+ * Internal function which ht_insert and ht_insert_uniq call.
+ * Argument list is the same as these two functions, except for an extra
+ * integer tacked onto the end.  This integer is nonzero if existing
+ * key entries are not allowed.  If existing key entries are allowed, the
+ * value of that key is overwritten.
+ */
+static ht
+ht_insert_internal(ht t, gendata key, gendata value, eq_func eq,
+		   free_func free_key, free_func free_value, int uniq)
+{
+	unsigned int oldcount;
+	hashval hash;
+	alist al;
+
+	assert(t != NULL);
+	assert(eq != NULL);
+
+	if (t->type == HT_ROBINHOOD) {
+		hash = ht_hashval(t, key);
+		oldcount = t->count;
+		if (ht_rh_insert(t, hash, key, value, eq, free_key, free_value,
+				 uniq) == NULL)
+			return NULL;
+		if (t->count != oldcount)
+			ht_bloom_note(t, hash);
+		return t;
+	}
+
+	if (t->rehash_buckets != NULL && !t->walking)
+		ht_rehash_steps(t, t->rehash_step);
+
+	hash = ht_hashval(t, key);
+	al = ht_locate(t, hash);
+	oldcount = alist_count(al);
+	if (uniq)
+		al = alist_insert_uniq_hashed(al, hash, key, value, eq);
+	else
+		al = alist_insert_hashed(al, hash, key, value, eq,
+					 free_key, free_value);
+
+	if (al == NULL)
+		return NULL;
+
+	if (alist_count(al) != oldcount)
+		ht_bloom_note(t, hash);
+
+	/* Replacing an existing key doesn't change the count */
+	t->count += alist_count(al) - oldcount;
+	ht_update_occupied(t, hash, al);
+	ht_auto_resize(t);
+
+	return t;
+}
+
+
+/**
+ * \brief Add a (key, value) pair to a hash table (with replace)
+ *
+ * Add a data element to the hash table with the given key or replace an
+ *  existing element with the same key.
+ *
+ * \param t           The hash table to insert the data in.
+ * \param key         The key of the data.
+ * \param value       The data to insert.
+ * \param eq          The equals predicate for two keys.
+ * \param free_key    The function used to free the old key's data if it
+ *		       needs to be replaced, or \c NULL if the data does not
+ *		       need to be freed.
+ * \param free_value  The function used to free the old value's data if it
+ *		       needs to be replaced, or \c NULL if the data does not
+ *		       need to be freed.
+ *
+ * \return  The original hash table, or \c NULL if the data could not be
+ *           inserted.  Original hash table is still valid in case of error.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ht_insert_uniq, ht_delete
+ */
+ht
+ht_insert(ht t, gendata key, gendata value, eq_func eq,
+	  free_func free_key, free_func free_value)
+{
+	return ht_insert_internal(t, key, value, eq, free_key, free_value, 0);
+}
 
-/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 /**
- * \brief Create a new empty hash table.
+ * \brief Add a (key, value) pair to a hash table (no replace)
  *
- * \param range  The range of the key function (\f$ 0 \le x < range \f$).
- * \param hash   The hashing function to use on keys.
+ * Add a data element to the hash table with the given key.  If there already
+ * is an element with the same key in the table, it is regarded as an error.
  *
- * \return  A new empty hash table object, or \c NULL if an error occurred.
+ * \param t           The hash table to insert the data in.
+ * \param key         The key of the data.
+ * \param value       The data to insert.
+ * \param eq          The equals predicate for two keys.
+ *
+ * \return  The original hash table, or \c NULL if the data could not be
+ *           inserted.  Original hash table is still valid in case of error.
  *
  * \par Errno values:
+ * - \b EINVAL if the key is already in the table.
  * - \b ENOMEM if out of memory.
  *
- * \sa ht_destroy
+ * \sa ht_insert, ht_delete
  */
 ht
-ht_create(unsigned int range, hash_func hash)
+ht_insert_uniq(ht t, gendata key, gendata value, eq_func eq)
 {
-	ht_t *t;
-	unsigned int i, j;
+	return ht_insert_internal(t, key, value, eq, NULL, NULL, 1);
+}
 
-	assert(hash != NULL);
 
-	if ((t = malloc(sizeof(ht_t))) == NULL)
-		return NULL;
+/**
+ * \brief Look up an element in a hash table.
+ *
+ * \note
+ * In incremental rehash mode, this may move some elements around.
+ *
+ * \param t     The hashtable which contains the element.
+ * \param key   The key to the element.
+ * \param eq    The equals predicate for two keys.
+ * \param data  A pointer to the location where the element is stored, if
+ *               it was found.
+ *
+ * \return  The hash table, or \c NULL if the key could not be found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ */
+ht
+ht_lookup(ht t, gendata key, eq_func eq, gendata *data)
+{
+	hashval hash;
+#ifdef HT_STATS
+	gendata *v;
+#else
+	ht_slot s;
+#endif
 
-	t->range = range;
-	t->hash = hash;
+	assert(t != NULL);
+	assert(eq != NULL);
 
-	/*
-	 * We could use a Gune array, but we're not resizing so we would just
-	 * be introducing unnecessary overhead.
-	 */
-	if ((t->buckets = (alist *)malloc(range * sizeof(alist))) == NULL) {
-		free(t);
+	hash = ht_hashval(t, key);
+	if (t->filter != NULL && !bloom_check(t->filter, hash)) {
+		HT_STAT(++t->stats->misses);
+		HT_STAT(++t->stats->filtered);
+		HT_STAT(++t->stats->probes[0]);
+		errno = EINVAL;
 		return NULL;
 	}
 
-	/*
-	 * Slightly inefficient, we could also use memset, but that's
-	 * making assumptions about the value of NULL.  Plus, this code should
-	 * not be the bottleneck of any sane program.
-	 */
-	for (i = 0; i < range; ++i) {
-		if ((*(t->buckets + i) = alist_create()) == NULL) {
-			/* Creation went wrong halfway?  Destroy all previous */
-			for (j = 0; j < i; ++j)
-				alist_destroy(*(t->buckets + j), NULL, NULL);
+	if (t->rehash_buckets != NULL && !t->walking)
+		ht_rehash_steps(t, t->rehash_step);
 
-			free(t);
+#ifdef HT_STATS
+	if ((v = ht_stats_find(t, hash, key, eq)) == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	*data = *v;
+	return t;
+#else
+	if (t->type == HT_ROBINHOOD) {
+		s = ht_rh_find(t, key, hash, eq);
+		if (s == NULL) {
+			errno = EINVAL;
 			return NULL;
 		}
+		*data = s->value;
+		return t;
 	}
 
-	return (ht)t;
+	if (alist_lookup_hashed(ht_locate(t, hash), hash, key, eq, data)
+	    == NULL)
+		return NULL;
+
+	return t;
+#endif
+}
+
+
+#ifdef HT_STATS
+/*
+ * The search of ht_lookup when statistics are kept.  This finds the key
+ * like ht_rh_find or alist_lookup_hashed would, while counting the entries
+ * it looks at and the calls of eq.  Returns a pointer to the value of the
+ * key, or NULL if it isn't in the table.
+ */
+static gendata *
+ht_stats_find(ht t, hashval hash, gendata key, eq_func eq)
+{
+	gendata *v = NULL;
+	unsigned int probes, psl;
+	alist_entry e;
+	ht_slot s;
+	sll l;
+
+	if (t->type == HT_ROBINHOOD) {
+		s = t->slots + hash_reduce(hash, t->range);
+		for (psl = 1; s->psl >= psl; ++psl) {
+			if (s->hash == hash) {
+				++t->stats->eq_calls;
+				if (eq(key, s->key)) {
+					v = &s->value;
+					break;
+				}
+			}
+			if (++s == t->slots + t->range)
+				s = t->slots;
+		}
+		probes = psl - (v == NULL);
+	} else {
+		probes = 0;
+		for (l = ht_locate(t, hash)->list; !sll_empty(l);
+		     l = sll_next(l)) {
+			e = sll_get_data(l).ptr;
+			++probes;
+			if (e->hash == hash) {
+				++t->stats->eq_calls;
+				if (eq(key, e->key)) {
+					v = &e->value;
+					break;
+				}
+			}
+		}
+	}
+
+	if (v == NULL)
+		++t->stats->misses;
+	else
+		++t->stats->hits;
+	++t->stats->probes[MIN(probes, HT_STATS_HIST - 1)];
+
+	return v;
 }
+#endif
 
 
 /**
- * \brief Free all memory allocated for a hash table.
+ * \brief Look up many elements in a hash table at once.
  *
- * The data within the table is freed by calling a user-supplied free function.
+ * This gives the same results as calling ht_lookup on every key, but
+ * is faster on big tables.  The keys are handled in small batches.  All
+ * keys of a batch are hashed first, and the memory they need is prefetched
+ * one step of the chain at a time for all keys together, before any key is
+ * compared.  This way, the processor waits for many cache misses at once
+ * instead of one after the other.
  *
  * \note
- * If the same data is included multiple times in the table, the free function
- * gets called that many times.
- * This is currently impossible, unless really strange things have been
- * going on. (like, say, a random hashing function)
+ * In incremental rehash mode, this may move some elements around.
  *
- * \param t           The hash table to destroy.
+ * \param t      The hashtable which contains the elements.
+ * \param keys   The keys to look up.
+ * \param n      The number of keys.
+ * \param eq     The equals predicate for two keys.
+ * \param out    An array of \p n elements, in which the element belonging to
+ *		  every key that was found is stored.  Elements belonging to
+ *		  keys which were not found are left untouched.
+ * \param found  An array of \p n flags, which are set to 1 for every key
+ *		  that was found, and to 0 for every key that was not.
+ *
+ * \return  The number of keys that were found.
+ *
+ * \sa ht_lookup
+ */
+size_t
+ht_lookup_many(ht t, const gendata *keys, size_t n, eq_func eq,
+	       gendata *out, unsigned char *found)
+{
+	hashval hash[HT_LOOKUP_BATCH];
+	alist al[HT_LOOKUP_BATCH];
+	unsigned char maybe[HT_LOOKUP_BATCH];
+	size_t base, i, m, nfound;
+	ht_slot s;
+
+	assert(t != NULL);
+	assert(eq != NULL);
+	assert(n == 0 || (keys != NULL && out != NULL && found != NULL));
+
+	nfound = 0;
+
+	for (base = 0; base < n; base += m) {
+		m = n - base;
+		if (m > HT_LOOKUP_BATCH)
+			m = HT_LOOKUP_BATCH;
+
+		if (t->rehash_buckets != NULL && !t->walking)
+			ht_rehash_steps(t, t->rehash_step);
+
+		/* Keys which the filter rules out get no further */
+		for (i = 0; i < m; ++i) {
+			hash[i] = ht_hashval(t, keys[base + i]);
+			maybe[i] = (t->filter == NULL ||
+				    bloom_check(t->filter, hash[i]));
+			found[base + i] = 0;
+			HT_STAT(t->stats->filtered += !maybe[i]);
+		}
+
+		if (t->type == HT_ROBINHOOD) {
+			for (i = 0; i < m; ++i)
+				if (maybe[i])
+					HT_PREFETCH(t->slots +
+						    hash_reduce(hash[i],
+							      t->range));
+			for (i = 0; i < m; ++i) {
+				if (!maybe[i])
+					continue;
+				s = ht_rh_find(t, keys[base + i], hash[i], eq);
+				found[base + i] = (s != NULL);
+				if (s != NULL) {
+					out[base + i] = s->value;
+					++nfound;
+				}
+			}
+			continue;
+		}
+
+		/* Fetch the bucket pointers */
+		for (i = 0; i < m; ++i)
+			if (maybe[i])
+				HT_PREFETCH(t->buckets +
+					    hash_reduce(hash[i], t->range));
+
+		/* ...the alists they point to */
+		for (i = 0; i < m; ++i) {
+			if (maybe[i]) {
+				al[i] = ht_locate(t, hash[i]);
+				HT_PREFETCH(al[i]);
+			}
+		}
+
+		/* ...the first node of their lists */
+		for (i = 0; i < m; ++i)
+			if (maybe[i])
+				HT_PREFETCH(al[i]->list);
+
+		/* ...and the first entry, which is usually the only one */
+		for (i = 0; i < m; ++i)
+			if (maybe[i] && !sll_empty(al[i]->list))
+				HT_PREFETCH(sll_get_data(al[i]->list).ptr);
+
+		for (i = 0; i < m; ++i) {
+			if (maybe[i] &&
+			    alist_lookup_hashed(al[i], hash[i], keys[base + i],
+						eq, out + base + i) != NULL) {
+				found[base + i] = 1;
+				++nfound;
+			}
+		}
+	}
+
+	HT_STAT(t->stats->hits += nfound);
+	HT_STAT(t->stats->misses += n - nfound);
+
+	return nfound;
+}
+
+
+/**
+ * \brief Delete an element from the hash table.
+ *
+ * \param t           The hashtable which contains the element to delete.
+ * \param key         The key to the element to delete.
+ * \param eq          The equals predicate for two keys.
  * \param free_key    The function which is used to free the key data, or
  *			\c NULL if no action should be taken on the key data.
  * \param free_value  The function which is used to free the value data, or
  *			\c NULL if no action should be taken on the value data.
  *
- * \sa ht_create
+ * \return  The hash table, or \c NULL if the key could not be found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ *
+ * \sa ht_insert
  */
-void
-ht_destroy(ht t, free_func free_key, free_func free_value)
+ht
+ht_delete(ht t, gendata key, eq_func eq, free_func free_key,
+	  free_func free_value)
 {
-	alist *al;
+	hashval hash;
+	ht_slot s;
+	alist al;
 
 	assert(t != NULL);
+	assert(eq != NULL);
 
-	for (al = t->buckets; al < (t->buckets + t->range); ++al)
-		alist_destroy(*al, free_key, free_value);
+	hash = ht_hashval(t, key);
+	if (t->filter != NULL && !bloom_check(t->filter, hash)) {
+		errno = EINVAL;
+		return NULL;
+	}
 
-	free(t->buckets);
-	free(t);
+	if (t->type == HT_ROBINHOOD) {
+		s = ht_rh_find(t, key, hash, eq);
+		if (s == NULL) {
+			errno = EINVAL;
+			return NULL;
+		}
+		if (free_key != NULL)
+			free_key(s->key.ptr);
+		if (free_value != NULL)
+			free_value(s->value.ptr);
+		ht_rh_remove(t, s);
+		ht_auto_resize(t);
+		return t;
+	}
+
+	if (t->rehash_buckets != NULL && !t->walking)
+		ht_rehash_steps(t, t->rehash_step);
+
+	al = ht_locate(t, hash);
+	if (alist_delete_hashed(al, hash, key, eq, free_key, free_value)
+	    == NULL)
+		return NULL;
+
+	--t->count;
+	ht_update_occupied(t, hash, al);
+	ht_auto_resize(t);
+
+	return t;
 }
 
 
-/*
- * Internal function which ht_insert and ht_insert_uniq call.
- * Argument list is the same as these two functions, except for an extra
- * integer tacked onto the end.  This integer is nonzero if existing
- * key entries are not allowed.  If existing key entries are allowed, the
- * value of that key is overwritten.
+/**
+ * \brief Return whether or not a hash table is empty.
+ *
+ * \param t  The hash table to check.
+ *
+ * \return  Non-zero if the hash table is empty, 0 if it is not.
  */
-static ht
-ht_insert_internal(ht t, gendata key, gendata value, eq_func eq,
-		   free_func free_key, free_func free_value, int uniq)
+int
+ht_empty(ht t)
 {
-	unsigned int bucketnr;
-	alist al;
+	assert(t != NULL);
+
+	return t->count == 0;
+}
+
 
+/**
+ * \brief Return the number of elements in a hash table.
+ *
+ * \param t  The hash table to count.
+ *
+ * \return  The number of (key, value) pairs in the table.
+ */
+unsigned int
+ht_count(ht t)
+{
 	assert(t != NULL);
-	assert(t->hash != NULL);
-	assert(eq != NULL);
 
-	bucketnr = t->hash(key, t->range);
+	return t->count;
+}
 
-#ifdef BOUNDS_CHECKING
-	if (bucketnr >= t->range)
-		log_entry(WARN_ERROR, "Gune: ht_insert: Key hash (%u) "
-			  "out of range", bucketnr);
-#endif
 
-	al = *(t->buckets + bucketnr);
-	if (uniq)
-		al = alist_insert_uniq(al, key, value, eq);
+/*
+ * Add the chain lengths of n buckets to the statistics of ht_stats.
+ */
+static void
+ht_stats_buckets(ht_stats_t *stats, alist *buckets, unsigned int n)
+{
+	unsigned int nr, len;
+
+	for (nr = 0; nr < n; ++nr) {
+		len = alist_count(buckets[nr]);
+		if (len > 0)
+			++stats->used;
+		stats->max_chain = MAX(stats->max_chain, len);
+		++stats->chains[MIN(len, HT_STATS_HIST - 1)];
+	}
+	stats->range += n;
+}
+
+
+/**
+ * \brief Gather statistics of a hash table.
+ *
+ * This shows how well the hashing function spreads the keys.  The shape
+ * of the table is measured when this is called, which takes time in
+ * proportion to its range.  The counters of lookups, equals calls and
+ * resizes are only kept if Gune was built with \c HT_STATS defined,
+ * because they slow down every lookup.  Otherwise they are all 0.
+ *
+ * \note
+ * During an incremental rehash, the old buckets which are left and the new
+ * buckets which were made are counted together.
+ *
+ * \param t      The hash table to examine.
+ * \param stats  The location to store the statistics in.
+ *
+ * \return  The hash table.
+ *
+ * \sa ht_count
+ */
+ht
+ht_stats(ht t, ht_stats_t *stats)
+{
+	unsigned int d;
+	ht_slot s;
+
+	assert(t != NULL);
+	assert(stats != NULL);
+
+	if (t->stats != NULL)
+		*stats = *t->stats;
 	else
-		al = alist_insert(al, key, value, eq, free_key, free_value);
+		memset(stats, 0, sizeof(ht_stats_t));
+
+	stats->count = t->count;
+	stats->range = 0;
+	stats->used = 0;
+	stats->max_chain = 0;
+	memset(stats->chains, 0, sizeof(stats->chains));
+
+	if (t->type == HT_ROBINHOOD) {
+		for (s = t->slots; s < (t->slots + t->range); ++s) {
+			if (s->psl == 0)
+				continue;
+			d = s->psl - 1;
+			++stats->used;
+			stats->max_chain = MAX(stats->max_chain, d);
+			++stats->chains[MIN(d, HT_STATS_HIST - 1)];
+		}
+		stats->range = t->range;
+		return t;
+	}
+
+	/* Buckets which have already been rehashed are gone */
+	ht_stats_buckets(stats, t->buckets + t->rehash_pos,
+			 t->range - t->rehash_pos);
+	if (t->rehash_buckets != NULL)
+		ht_stats_buckets(stats, t->rehash_buckets, t->rehash_made);
+
+	return t;
+}
+
+
+/**
+ * \brief Walk through all elements of a hash table.
+ *
+ * Walk a hash table, using a user-specified function on the table's pairs.
+ *
+ * \attention
+ * While using this function, it is not allowed to remove entries other than
+ * the current entry.  It is allowed to change the contents of the key and
+ * value, as long as the key's hash will not be affected.
+ * The table is not resized until the walk has finished.  Inserting new
+ * keys into an open addressing table during a walk is not allowed either.
+ * Keys inserted into a chained table during a walk may or may not be
+ * visited.
+ *
+ * \note
+ * Chained tables skip empty buckets a machine word's worth at a time, so
+ * walking a big table with few elements is cheap.
+ *
+ * \param t     The hash table to walk
+ * \param walk  The function which will process the hash pairs
+ * \param data  Any data to pass to the function every time it is called.
+ */
+void
+ht_walk(ht t, assoc_func walk, gendata data)
+{
+	assert(t != NULL);
 
-	if (al == NULL)
-		t = NULL;
-	else
-		/* Strictly not needed */
-		*(t->buckets + bucketnr) = al;
+	/* Rehashing is suspended during the walk, so entries stay put */
+	++t->walking;
+	if (t->type == HT_ROBINHOOD) {
+		ht_rh_walk(t, walk, data);
+	} else {
+		ht_walk_buckets(t->buckets, t->occupied, t->rehash_pos,
+				t->range, walk, data);
+		if (t->rehash_buckets != NULL)
+			ht_walk_buckets(t->rehash_buckets, t->rehash_occupied,
+					0, t->rehash_made, walk, data);
+	}
+	--t->walking;
 
-	return t;
+	/* Catch up on any resizes we skipped because of deletions */
+	ht_auto_resize(t);
 }
 
 
 /**
- * \brief Add a (key, value) pair to a hash table (with replace)
+ * \brief Start iterating over the elements of a hash table.
  *
- * Add a data element to the hash table with the given key or replace an
- *  existing element with the same key.
+ * This visits the same elements as ht_walk, but the caller gets them one
+ * at a time from ht_iter_next, so it can stop or pause whenever it likes.
  *
- * \param t           The hash table to insert the data in.
- * \param key         The key of the data.
- * \param value       The data to insert.
- * \param eq          The equals predicate for two keys.
- * \param free_key    The function used to free the old key's data if it
- *		       needs to be replaced, or \c NULL if the data does not
- *		       need to be freed.
- * \param free_value  The function used to free the old value's data if it
- *		       needs to be replaced, or \c NULL if the data does not
- *		       need to be freed.
+ * \attention
+ * The same rules as for ht_walk apply while the iterator is in use: only
+ * the element which was returned last may be removed, and the table is not
+ * resized until the iterator is done.  So don't forget to call ht_iter_end
+ * when stopping before ht_iter_next has returned 0.
  *
- * \return  The original hash table, or \c NULL if the data could not be
- *           inserted.  Original hash table is still valid in case of error.
+ * \param t   The hash table to iterate over.
+ * \param it  The iterator to initialise.
  *
- * \par Errno values:
- * - \b ENOMEM if out of memory.
+ * \return  The iterator.
  *
- * \sa ht_insert_uniq, ht_delete
+ * \sa ht_iter_next ht_iter_end ht_walk ht_scan
  */
-ht
-ht_insert(ht t, gendata key, gendata value, eq_func eq,
-	  free_func free_key, free_func free_value)
+ht_iter
+ht_iter_init(ht t, ht_iter it)
 {
-	return ht_insert_internal(t, key, value, eq, free_key, free_value, 0);
+	unsigned int pos;
+
+	assert(t != NULL);
+	assert(it != NULL);
+
+	++t->walking;
+	it->table = t;
+	it->next = NULL;
+	it->rehash = 0;
+
+	if (t->type == HT_ROBINHOOD) {
+		/* Go backwards from an empty slot, like ht_rh_walk does */
+		for (pos = 0; t->slots[pos].psl != 0; ++pos)
+			;
+		it->pos = pos;
+		it->left = t->range - 1;
+	} else {
+		it->pos = t->rehash_pos;
+		it->left = 0;
+	}
+
+	return it;
 }
 
 
 /**
- * \brief Add a (key, value) pair to a hash table (no replace)
+ * \brief Get the next element from a hash table iterator.
  *
- * Add a data element to the hash table with the given key.  If there already
- * is an element with the same key in the table, it is regarded as an error.
- *
- * \param t           The hash table to insert the data in.
- * \param key         The key of the data.
- * \param value       The data to insert.
- * \param eq          The equals predicate for two keys.
+ * The hash value the table cached for the key is left in the \c hash
+ * field of the iterator, so it doesn't have to be calculated again.
  *
- * \return  The original hash table, or \c NULL if the data could not be
- *           inserted.  Original hash table is still valid in case of error.
+ * \param it     The iterator.
+ * \param key    A pointer to the location where the key is stored.
+ * \param value  A pointer to the location where the value is stored.
  *
- * \par Errno values:
- * - \b EINVAL if the key is already in the table.
- * - \b ENOMEM if out of memory.
+ * \return  Non-zero if an element was stored, 0 if there are no more
+ *	     elements.  In the latter case, the iterator has been ended.
  *
- * \sa ht_insert, ht_delete
+ * \sa ht_iter_init ht_iter_end
  */
-ht
-ht_insert_uniq(ht t, gendata key, gendata value, eq_func eq)
+int
+ht_iter_next(ht_iter it, gendata *key, gendata *value)
 {
-	return ht_insert_internal(t, key, value, eq, NULL, NULL, 1);
+	unsigned long *bitmap;
+	unsigned int nr, last;
+	alist_entry e;
+	alist *buckets;
+	ht t;
+
+	assert(it != NULL);
+
+	if ((t = it->table) == NULL)
+		return 0;
+
+	if (t->type == HT_ROBINHOOD) {
+		while (it->left > 0) {
+			--it->left;
+			it->pos = (it->pos == 0) ? t->range - 1 : it->pos - 1;
+			if (t->slots[it->pos].psl != 0) {
+				*key = t->slots[it->pos].key;
+				*value = t->slots[it->pos].value;
+				it->hash = t->slots[it->pos].hash;
+				return 1;
+			}
+		}
+		ht_iter_end(it);
+		return 0;
+	}
+
+	for (;;) {
+		/* The current entry may be deleted, so we're one ahead */
+		if (it->next != NULL && !sll_empty(it->next)) {
+			e = sll_get_data(it->next).ptr;
+			it->next = sll_next(it->next);
+			*key = e->key;
+			*value = e->value;
+			it->hash = e->hash;
+			return 1;
+		}
+
+		if (it->rehash) {
+			buckets = t->rehash_buckets;
+			bitmap = t->rehash_occupied;
+			last = t->rehash_made;
+		} else {
+			buckets = t->buckets;
+			bitmap = t->occupied;
+			last = t->range;
+		}
+
+		if ((nr = ht_next_occupied(bitmap, it->pos, last)) < last) {
+			it->next = buckets[nr]->list;
+			it->pos = nr + 1;
+		} else if (!it->rehash && t->rehash_buckets != NULL) {
+			/* Old buckets done, go on with the new ones */
+			it->rehash = 1;
+			it->pos = 0;
+		} else {
+			ht_iter_end(it);
+			return 0;
+		}
+	}
 }
 
 
 /**
- * \brief Look up an element in a hash table.
+ * \brief Stop iterating over a hash table.
  *
- * \param t     The hashtable which contains the element.
- * \param key   The key to the element.
- * \param eq    The equals predicate for two keys.
- * \param data  A pointer to the location where the element is stored, if
- *               it was found.
+ * This lets the table resize itself again.  Calling it more than once, or
+ * after ht_iter_next returned 0, is harmless.
  *
- * \return  The hash table, or \c NULL if the key could not be found.
+ * \param it  The iterator.
  *
- * \par Errno values:
- * - \b EINVAL if the key could not be found.
+ * \sa ht_iter_init ht_iter_next
  */
-ht
-ht_lookup(ht t, gendata key, eq_func eq, gendata *data)
+void
+ht_iter_end(ht_iter it)
 {
-	unsigned int bucketnr;
-	alist al;
-
-	assert(t != NULL);
-	assert(t->hash != NULL);
-	assert(eq != NULL);
+	ht t;
 
-	bucketnr = t->hash(key, t->range);
+	assert(it != NULL);
 
-#ifdef BOUNDS_CHECKING
-	if (bucketnr >= t->range)
-		log_entry(WARN_ERROR, "Gune: ht_lookup: Key hash (%u) "
-			  "out of range", bucketnr);
-#endif
+	if ((t = it->table) == NULL)
+		return;
 
-	al = *(t->buckets + bucketnr);
-	if (alist_lookup(al, key, eq, data) == NULL)
-		return NULL;
+	it->table = NULL;
+	--t->walking;
 
-	return t;
+	/* Catch up on any resizes we skipped */
+	ht_auto_resize(t);
 }
 
 
 /**
- * \brief Delete an element from the hash table.
+ * \brief Visit some elements of a hash table, starting at a cursor.
  *
- * \param t           The hashtable which contains the element to delete.
- * \param key         The key to the element to delete.
- * \param eq          The equals predicate for two keys.
- * \param free_key    The function which is used to free the key data, or
- *			\c NULL if no action should be taken on the key data.
- * \param free_value  The function which is used to free the value data, or
- *			\c NULL if no action should be taken on the value data.
+ * Every call visits at least \p batch elements (unless the table runs out)
+ * and returns a cursor to pass to the next call.  Start with a cursor of 0.
+ * When 0 is returned, all elements have been visited.
  *
- * \return  The hash table, or \c NULL if the key could not be found.
+ * Nothing is kept between calls, so the table may be changed in any way in
+ * between, and resized too.  Elements which are in the table during the
+ * whole scan are visited exactly once.  Elements which are inserted or
+ * deleted during the scan may or may not be visited.
  *
- * \par Errno values:
- * - \b EINVAL if the key could not be found.
+ * This works because elements are visited in order of their (scrambled)
+ * hash values, whatever the size of the table, and the cursor is simply
+ * the hash value to continue from.
  *
- * \sa ht_insert
+ * \attention
+ * During a call, the same rules as for ht_walk apply.
+ *
+ * \param t       The hash table to scan.
+ * \param cursor  0 to start a scan, or the result of the previous call.
+ * \param batch   The minimum number of elements to visit.  A few more
+ *		    may be visited, because all elements with the same
+ *		    bucket are visited together.
+ * \param walk    The function which will process the hash pairs.
+ * \param data    Any data to pass to the function every time it is called.
+ *
+ * \return  The cursor to continue from, or 0 if the scan is complete.
+ *
+ * \sa ht_walk ht_iter_init
  */
-ht
-ht_delete(ht t, gendata key, eq_func eq, free_func free_key,
-	  free_func free_value)
+hashval
+ht_scan(ht t, hashval cursor, unsigned int batch, assoc_func walk,
+	gendata data)
 {
-	unsigned int bucketnr;
-	alist al;
+	unsigned int nr, n;
+	hashval next;
 
 	assert(t != NULL);
-	assert(t->hash != NULL);
-	assert(eq != NULL);
+	assert(walk != NULL);
+
+	++t->walking;
+
+	n = 0;
+	nr = hash_reduce(cursor, t->range);
+	do {
+		next = ht_bucket_start(nr + 1, t->range);
+
+		if (t->type == HT_ROBINHOOD)
+			n += ht_rh_scan(t, nr, cursor, walk, data);
+		else if (nr < t->rehash_pos)
+			/* This bucket has been moved to the new buckets */
+			n += ht_scan_buckets(t->rehash_buckets,
+					     t->rehash_range, cursor, next,
+					     walk, data);
+		else
+			n += ht_scan_buckets(t->buckets, t->range, cursor,
+					     next, walk, data);
 
-	bucketnr = t->hash(key, t->range);
+		cursor = next;
+		++nr;
+	} while (cursor != 0 && n < batch);
 
-#ifdef BOUNDS_CHECKING
-	if (bucketnr >= t->range)
-		log_entry(WARN_ERROR, "Gune: ht_lookup: Key hash (%u) out "
-			  "of range", bucketnr);
-#endif
+	--t->walking;
+	ht_auto_resize(t);
 
-	al = *(t->buckets + bucketnr);
-	if (alist_delete(al, key, eq, free_key, free_value) == NULL)
-		return NULL;
+	return cursor;
+}
 
-	return t;
+
+/*
+ * Make room for n elements at once, so the table doesn't have to grow
+ * several times in a row.  Just like ht_auto_resize, failure is not an
+ * error.
+ */
+static void
+ht_reserve(ht t, unsigned int n)
+{
+	unsigned int range;
+	int saved_errno;
+
+	if (t->max_load == 0.0)
+		return;
+
+	range = t->range;
+	while ((double)n > t->max_load * range && range <= (UINT_MAX - 1) / 2)
+		range = range * 2 + 1;
+
+	saved_errno = errno;
+	if (range != t->range && ht_resize(t, range) == NULL)
+		errno = saved_errno;
 }
 
 
-/**
- * \brief Return whether or not a hash table is empty.
- *
- * \param t  The hash table to check.
- *
- * \return  Non-zero if the hash table is empty, 0 if it is not.
+/*
+ * Recalculate the occupied bitmap of a chained table from scratch.
  */
-int
-ht_empty(ht t)
+static void
+ht_reset_occupied(ht t)
 {
-	unsigned int i;
+	unsigned int nr;
+
+	for (nr = 0; nr < t->range; ++nr)
+		ht_set_occupied(t->occupied, nr, !alist_empty(t->buckets[nr]));
+}
 
-	assert(t != NULL);
 
-	for (i = 0; i < t->range; ++i)
-		if (!alist_empty(t->buckets[i]))
+/*
+ * Insert one element of the rest table into the base table, given the
+ * hash value it has in base.  Returns 1 if it was inserted (so it should
+ * be removed from rest), 0 if its key was already in base and we're
+ * merging uniquely, or -1 on error.
+ * Chained tables don't change their counts here, because several threads
+ * may be doing this at once.  The caller adds up the counts afterwards.
+ */
+static int
+ht_merge_one(struct ht_merge_work *w, hashval hash, gendata key,
+	     gendata value)
+{
+	unsigned int nr, oldcount;
+	alist al;
+	ht base;
+
+	base = w->base;
+
+	if (base->type == HT_ROBINHOOD) {
+		if (ht_rh_insert(base, hash, key, value, w->eq, w->free_key,
+				 w->free_value, w->uniq) != NULL)
+			return 1;
+	} else {
+		nr = hash_reduce(hash, base->range);
+		al = base->buckets[nr];
+		oldcount = alist_count(al);
+		if (w->uniq)
+			al = alist_insert_uniq_hashed(al, hash, key, value,
+						      w->eq);
+		else
+			al = alist_insert_hashed(al, hash, key, value, w->eq,
+						 w->free_key, w->free_value);
+		if (al != NULL) {
+			/* Replacing an existing key doesn't add anything */
+			w->added += alist_count(al) - oldcount;
+			ht_set_occupied(base->occupied, nr, 1);
+			return 1;
+		}
+	}
+
+	if (w->uniq && errno == EINVAL)
+		return 0;
+
+	w->error = errno;
+	return -1;
+}
+
+
+/*
+ * Merge one bucket of a chained rest table.  Entries which were merged are
+ * removed from the bucket, so it stays valid if something goes wrong.
+ * Entries with new keys are simply relinked into a bucket of a chained
+ * base table, which saves copying them.  Returns 0 on error.
+ */
+static int
+ht_merge_bucket(struct ht_merge_work *w, alist al)
+{
+	unsigned int nr;
+	alist_entry e;
+	alist_t kept;
+	gendata value;
+	hashval hash;
+	alist dst;
+	int moved;
+	ht base;
+
+	base = w->base;
+	kept.list = sll_create();
+	kept.count = 0;
+	moved = 0;
+
+	while (!alist_empty(al)) {
+		e = sll_get_data(al->list).ptr;
+		hash = w->rehash ? ht_hashval(base, e->key) : e->hash;
+
+		if (base->type == HT_CHAINED) {
+			nr = hash_reduce(hash, base->range);
+			dst = base->buckets[nr];
+			if (alist_lookup_hashed(dst, hash, e->key, w->eq,
+						&value) == NULL) {
+				e->hash = hash;
+				alist_move_head(dst, al);
+				ht_set_occupied(base->occupied, nr, 1);
+				++w->added;
+				++w->removed;
+				continue;
+			}
+
+			/* Replacing never needs to allocate, so can't fail */
+			if ((moved = !w->uniq))
+				alist_insert_hashed(dst, hash, e->key,
+						    e->value, w->eq,
+						    w->free_key,
+						    w->free_value);
+		} else if ((moved = ht_merge_one(w, hash, e->key,
+						 e->value)) < 0) {
+			break;
+		}
+
+		if (moved) {
+			al->list = sll_remove_head(al->list, free);
+			--al->count;
+			++w->removed;
+		} else {
+			/* Duplicate key, so the entry stays in rest */
+			alist_move_head(&kept, al);
+		}
+	}
+
+	while (!alist_empty(&kept))
+		alist_move_head(al, &kept);
+
+	return moved >= 0;
+}
+
+
+/*
+ * Merge an open addressing rest table.  Just like ht_rh_walk, we go
+ * backwards from an empty slot, so removing entries doesn't move any
+ * entries we haven't seen yet.  Returns 0 on error.
+ */
+static int
+ht_merge_slots(struct ht_merge_work *w)
+{
+	unsigned int i, pos;
+	hashval hash;
+	int moved;
+	ht_slot s;
+	ht rest;
+
+	rest = w->rest;
+	for (pos = 0; rest->slots[pos].psl != 0; ++pos)
+		;
+
+	for (i = 1; i < rest->range; ++i) {
+		pos = (pos == 0) ? rest->range - 1 : pos - 1;
+		s = rest->slots + pos;
+		if (s->psl == 0)
+			continue;
+
+		hash = w->rehash ? ht_hashval(w->base, s->key) : s->hash;
+		if ((moved = ht_merge_one(w, hash, s->key, s->value)) < 0)
 			return 0;
+		if (moved)
+			ht_rh_remove(rest, s);
+	}
 
 	return 1;
 }
 
 
-/**
- * \brief Walk through all elements of a hash table.
- *
- * Walk a hash table, using a user-specified function on the table's pairs.
- *
- * \attention
- * While using this function, it is not allowed to remove entries other than
- * the current entry.  It is allowed to change the contents of the key and
- * value, as long as the key's hash will not be affected.
- *
- * \param t     The hash table to walk
- * \param walk  The function which will process the hash pairs
- * \param data  Any data to pass to the function every time it is called.
+#ifdef GUNE_THREADS
+/*
+ * Find the first bucket which doesn't contain any hash values below hash.
  */
-void
-ht_walk(ht t, assoc_func walk, gendata data)
+static unsigned int
+ht_first_bucket_from(hashval hash, unsigned int range)
 {
-	unsigned int i;
+	unsigned int nr;
 
-	assert(t != NULL);
-	assert(t->buckets != NULL);
+	nr = hash_reduce(hash, range);
+	if (ht_bucket_start(nr, range) != hash)
+		++nr;
+
+	return nr;
+}
+
+
+/*
+ * Thread which merges its share of the buckets.
+ */
+static void *
+ht_merge_worker(void *arg)
+{
+	struct ht_merge_work *w = arg;
+	unsigned int nr;
+
+	for (nr = w->first; nr < w->last; ++nr)
+		if (!ht_merge_bucket(w, w->rest->buckets[nr]))
+			break;
+
+	return NULL;
+}
+
+
+/*
+ * Merge two chained tables with several threads.
+ * Every thread gets an interval of hash values, so it has buckets of base
+ * to itself.  The intervals start at a word of the occupied bitmap, so
+ * the threads never write the same word either.  A thread merges the
+ * buckets of rest which lie completely inside its interval.  That leaves
+ * at most one bucket of rest per boundary, which we do ourselves when all
+ * threads are done.  Returns 0 on error.
+ */
+static int
+ht_merge_parallel(struct ht_merge_work *w)
+{
+	struct ht_merge_work work[HT_MERGE_THREADS];
+	pthread_t thread[HT_MERGE_THREADS];
+	int started[HT_MERGE_THREADS];
+	hashval start[HT_MERGE_THREADS + 1];
+	unsigned int k, nr, share;
+	ht base, rest;
+
+	base = w->base;
+	rest = w->rest;
+
+	share = base->range / HT_MERGE_THREADS;
+	share -= share % (unsigned int)HT_WORD_BITS;
+	for (k = 0; k < HT_MERGE_THREADS; ++k)
+		start[k] = ht_bucket_start(k * share, base->range);
+	start[HT_MERGE_THREADS] = 0;	/* The end of the hash values */
+
+	for (k = 0; k < HT_MERGE_THREADS; ++k) {
+		work[k] = *w;
+		/*
+		 * Stop at the bucket which holds the first hash value of the
+		 * next thread, whether it starts there or straddles the
+		 * boundary.
+		 */
+		work[k].first = ht_first_bucket_from(start[k], rest->range);
+		work[k].last = (k + 1 == HT_MERGE_THREADS) ? rest->range :
+			hash_reduce(start[k + 1], rest->range);
+
+		/* If we can't start a thread, do its work ourselves */
+		started[k] = (pthread_create(&thread[k], NULL,
+					     ht_merge_worker, &work[k]) == 0);
+		if (!started[k])
+			ht_merge_worker(&work[k]);
+	}
+
+	for (k = 0; k < HT_MERGE_THREADS; ++k) {
+		if (started[k])
+			pthread_join(thread[k], NULL);
+		w->added += work[k].added;
+		w->removed += work[k].removed;
+		if (work[k].error != 0)
+			w->error = work[k].error;
+	}
 
-	for (i = 0; i < t->range; ++i)
-		alist_walk(t->buckets[i], walk, data);
+	if (w->error != 0)
+		return 0;
+
+	/* The buckets of rest which straddle two intervals */
+	for (k = 1; k < HT_MERGE_THREADS; ++k) {
+		nr = hash_reduce(start[k], rest->range);
+		if (ht_bucket_start(nr, rest->range) != start[k] &&
+		    !ht_merge_bucket(w, rest->buckets[nr]))
+			return 0;
+	}
+
+	return 1;
+}
+#endif /* GUNE_THREADS */
+
+
+/*
+ * Internal function which ht_merge and ht_merge_uniq call.  Afterwards,
+ * rest holds the elements which weren't merged.
+ */
+static ht
+ht_merge_internal(ht base, ht rest, eq_func eq, free_func free_key,
+		  free_func free_value, int uniq)
+{
+	struct ht_merge_work w;
+	unsigned int nr;
+	int ok, saved_errno;
+
+	assert(base != NULL);
+	assert(rest != NULL);
+	assert(base != rest);
+	assert(eq != NULL);
+
+	if (ht_rehash_finish(base) == NULL || ht_rehash_finish(rest) == NULL)
+		return NULL;
+
+	/*
+	 * The merge may be done by several threads, which can't share the
+	 * filter, so add the keys of rest up front.  Keys which don't end up
+	 * in base only cause false positives.
+	 */
+	if (base->filter != NULL) {
+		ht_bloom_fill(base, rest, base->filter);
+		if (rest->count > UINT_MAX - base->filter_added)
+			base->filter_added = UINT_MAX;
+		else
+			base->filter_added += rest->count;
+	}
+
+	ht_reserve(base, (rest->count > UINT_MAX - base->count) ? UINT_MAX :
+		   base->count + rest->count);
+
+	w.base = base;
+	w.rest = rest;
+	w.eq = eq;
+	w.free_key = free_key;
+	w.free_value = free_value;
+	w.uniq = uniq;
+	w.rehash = !ht_same_hash(base, rest);
+	w.added = w.removed = 0;
+	w.error = 0;
+
+	/* We made room already, so don't resize halfway */
+	++base->walking;
+
+	if (rest->type == HT_ROBINHOOD) {
+		ok = ht_merge_slots(&w);
+#ifdef GUNE_THREADS
+	} else if (base->type == HT_CHAINED && !w.rehash &&
+		   base->count >= HT_MERGE_PARALLEL_MIN &&
+		   rest->count >= HT_MERGE_PARALLEL_MIN &&
+		   base->range >= HT_MERGE_THREADS * HT_WORD_BITS) {
+		ok = ht_merge_parallel(&w);
+#endif
+	} else {
+		ok = 1;
+		for (nr = ht_next_occupied(rest->occupied, 0, rest->range);
+		     ok && nr < rest->range;
+		     nr = ht_next_occupied(rest->occupied, nr + 1,
+					   rest->range))
+			ok = ht_merge_bucket(&w, rest->buckets[nr]);
+	}
+
+	base->count += w.added;
+	if (rest->type == HT_CHAINED) {
+		rest->count -= w.removed;
+		ht_reset_occupied(rest);
+	}
+
+	--base->walking;
+	ht_auto_resize(base);
+
+	if (base->filter != NULL && base->filter_added > base->filter_limit) {
+		saved_errno = errno;
+		if (ht_bloom_rebuild(base, base->filter_fp) == NULL)
+			errno = saved_errno;
+	}
+
+	if (!ok) {
+		errno = w.error;
+		return NULL;
+	}
+
+	return base;
 }
 
 
@@ -376,68 +2697,42 @@ ht_walk(ht t, assoc_func walk, gendata data)
  *
  * Add all data elements from a hash table to another hash table,
  * replacing the value of all existing elements with the same key.
+ * The tables may have different ranges and engines.  If they use the same
+ * hashing function, the cached hash values are used, so it isn't called.
  *
- * \note
- * This function is \f$ O(n \cdot m) \f$ with \f$ n \f$ the length of
- * \p base and \f$ m \f$ the length of \p rest.
+ * When both tables are big chained tables, and Gune was built with
+ * threads, the work is divided over several threads.  So \p eq and the
+ * hashing and free functions should be safe to call from several threads
+ * at once.
  *
  * \param base	      The hash table to insert the data in.
  * \param rest        The hash table to be merged into \p base.
  * \param eq          The equals predicate for two keys.
- * \param free_key    The function used to free the \p rest list's key data,
- *		       or \c NULL if the data does not need to be freed.
+ * \param free_key    The function used to free the \p base key's data if it
+ *		       needs to be replaced, or \c NULL if the data does not
+ *		       need to be freed.
  * \param free_value  The function used to free the \p base value's data if it
  *		       needs to be replaced, or \c NULL if the data does not
  *		       need to be freed.
  *
  * \return  The \p base hash table, merged with \p rest, or NULL in case
- *	     of error.  If an error occurred, the \p base hash table is still
- *	     valid, but it is undefined which items from the \p rest table will
- *	     have been merged into the table and which haven't.  The \p rest
- *	     table will not be valid after the function has finished.
+ *	     of error.  On success, \p rest has been destroyed.  If an error
+ *	     occurred, both tables are still valid, and \p rest holds the
+ *	     elements which have not been merged yet.
  *
  * \par Errno values:
  * - \b ENOMEM if out of memory.
- * - \b EINVAL if the two hash tables do not have the same range.
  *
  * \sa ht_insert ht_delete ht_merge_uniq
  */
 ht
 ht_merge(ht base, ht rest, eq_func eq, free_func free_key, free_func free_value)
 {
-	unsigned int i;
-	alist al_tmp;
-
-	assert(base != NULL);
-	assert(rest != NULL);
-	assert(base->buckets != NULL);
-	assert(rest->buckets != NULL);
-
-	/* XXX: Maybe this requirement is too strict */
-	if (base->range != rest->range) {
-		errno = EINVAL;
+	if (ht_merge_internal(base, rest, eq, free_key, free_value, 0) == NULL)
 		return NULL;
-	}
-
-	for (i = 0; i < base->range; ++i) {
-		al_tmp = alist_merge(base->buckets[i], rest->buckets[i], eq,
-				     free_key, free_value);
-		if (al_tmp == NULL)
-			return NULL;
-		else
-			base->buckets[i] = al_tmp;
-	}
 
-	/*
-	 * NOTE: This is redundant in the current implementation of alist.
-	 * Also, we can't `destroy' the alist in the above loop, because
-	 * if we encounter an error, the hash table should still be valid.
-	 */
-	for (i = 0; i < rest->range; ++i)
-		alist_destroy(rest->buckets[i], free_key, free_value);
-     
-	free(rest->buckets);
-	free(rest);
+	/* All entries have moved to base */
+	ht_destroy(rest, NULL, NULL);
 
 	return base;
 }
@@ -449,10 +2744,7 @@ ht_merge(ht base, ht rest, eq_func eq, free_func free_key, free_func free_value)
  * Add all data elements from a hash table to another hash table with the
  * given key.  If a duplicate key is encountered, the entry is not inserted
  * into the \p base hash table.
- *
- * \note
- * This function is \f$ O(n \cdot m) \f$ with \f$ n \f$ the length of
- * \p base and \f$ m \f$ the length of \p rest.
+ * The same remarks as for ht_merge apply.
  *
  * \param base	      The hash table to insert the data in.
  * \param rest        The hash table to be merged into \p base.
@@ -463,40 +2755,22 @@ ht_merge(ht base, ht rest, eq_func eq, free_func free_key, free_func free_value)
  *	     valid, but it is undefined which items from the \p rest hash table
  *	     will have been merged into the table and which haven't.
  *	    The \p rest table will have been modified so it still contains
- *	     the entries which had matching keys in the \p base table.
+ *	     the entries which had matching keys in the \p base table (and
+ *	     in case of error, the entries not merged yet).
  *	    The \p rest hash table will thus still be valid.
  *
  * \par Errno values:
  * - \b ENOMEM if out of memory.
- * - \b EINVAL if the two hash tables do not have the same range.
  *
  * \sa ht_insert_uniq ht_delete ht_merge
  */
 ht
 ht_merge_uniq(ht base, ht rest, eq_func eq)
 {
-	unsigned int i;
-	alist al_tmp;
-
-	assert(base != NULL);
-	assert(rest != NULL);
-	assert(base->buckets != NULL);
-	assert(rest->buckets != NULL);
-
-	/* XXX: Maybe this requirement is too strict */
-	if (base->range != rest->range) {
-		errno = EINVAL;
+	if (ht_merge_internal(base, rest, eq, NULL, NULL, 1) == NULL)
 		return NULL;
-	}
 
-	for (i = 0; i < base->range; ++i) {
-		al_tmp = alist_merge_uniq(base->buckets[i],
-					  rest->buckets[i], eq);
-		if (al_tmp == NULL)
-			return NULL;
-		else
-			base->buckets[i] = al_tmp;
-	}
+	ht_auto_resize(rest);
 
 	return base;
 }
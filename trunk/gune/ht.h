@@ -37,32 +37,134 @@
 #ifndef GUNE_HT_H
 #define GUNE_HT_H
 
+#include <stddef.h>
 #include <gune/lists.h>
 #include <gune/alist.h>
+#include <gune/bloom.h>
 #include <gune/types.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/** \brief Hashing function type */
-typedef unsigned int (* hash_func) (gendata, unsigned int);
+/** \brief Hash table engines */
+typedef enum {
+	HT_CHAINED,		/**< Buckets of association lists */
+	HT_ROBINHOOD		/**< Open addressing with Robin Hood probing */
+} ht_type;
+
+/** The number of entries in the histograms of ht_stats_t */
+#define HT_STATS_HIST	16
+
+/**
+ * \brief Hash table statistics
+ *
+ * The counters of lookups are only kept if Gune was built with
+ * \c HT_STATS defined, otherwise they are always 0.
+ */
+typedef struct ht_stats_t {
+	unsigned int count;	/**< The number of elements */
+	unsigned int range;	/**< The number of buckets or slots */
+	unsigned int used;	/**< The number of nonempty buckets, or full
+				     slots */
+	unsigned int max_chain;	/**< The longest chain of a bucket, or the
+				     longest distance of an element from its
+				     home slot */
+	unsigned int chains[HT_STATS_HIST]; /**< The number of buckets with
+				     a chain of each length, or elements at
+				     each distance from their home slot.  The
+				     last entry counts all longer ones. */
+	unsigned long hits;	/**< Lookups which found their key */
+	unsigned long misses;	/**< Lookups which didn't */
+	unsigned long filtered;	/**< Misses ruled out by the Bloom filter */
+	unsigned long eq_calls;	/**< Calls of the equals predicate by
+				     ht_lookup */
+	unsigned long probes[HT_STATS_HIST]; /**< The number of ht_lookup
+				     calls which looked at each number of
+				     elements.  The last entry counts all
+				     higher numbers. */
+	unsigned long rehashes;	/**< The number of times the table was
+				     resized */
+} ht_stats_t;
+
+/** \brief Open addressing hash table slot */
+typedef struct ht_slot_t {
+	gendata key;		/**< Key, used for identification of entries */
+	gendata value;		/**< The entry itself */
+	hashval hash;		/**< The key's (scrambled) hash value */
+	unsigned int psl;	/**< Distance from the key's home slot plus one,
+				     or 0 if the slot is empty */
+} ht_slot_t, *ht_slot;
 
 /** \brief Hash table implementation */
 typedef struct ht_t {
+	ht_type type;		/**< The engine used to store the entries */
 	alist *buckets;		/**< The buckets to which hash values map */
+	unsigned long *occupied; /**< Bitmap of the nonempty buckets */
+	ht_slot slots;		/**< The slots to which hash values map */
 	unsigned int range;	/**< The number of buckets */
-	hash_func hash;		/**< The hashing function to use */
+	hash_func hash;		/**< The hashing function to use, or NULL */
+	fullhash_func fullhash;	/**< The full-width hashing function to use,
+				     or NULL */
+	keyedhash_func keyedhash; /**< The keyed hashing function to use, or
+				     NULL */
+	hashseed seed;		/**< The secret seed of keyedhash */
+	unsigned int count;	/**< The number of elements in the table */
+	unsigned int min_range;	/**< The table never shrinks below this */
+	double min_load;	/**< Shrink if the load drops below this */
+	double max_load;	/**< Grow if the load rises above this */
+	unsigned int grow_at;	/**< Precalculated element count to grow at */
+	unsigned int shrink_at;	/**< Precalculated element count to shrink at */
+	unsigned int walking;	/**< Nonzero while ht_walk is running */
+	alist *rehash_buckets;	/**< Buckets being rehashed into, or NULL */
+	unsigned long *rehash_occupied; /**< Bitmap of the nonempty
+					     rehash_buckets */
+	unsigned int rehash_range; /**< The number of rehash_buckets */
+	unsigned int rehash_made;  /**< The number of rehash_buckets created */
+	unsigned int rehash_pos;   /**< The number of buckets rehashed so far */
+	unsigned int rehash_step;  /**< Buckets to rehash per call (0 = all) */
+	bloom filter;		/**< Filter of the stored hashes, or NULL */
+	double filter_fp;	/**< The false positive rate of filter */
+	unsigned int filter_added; /**< Hash values added to filter */
+	unsigned int filter_limit; /**< Rebuild filter when more are added */
+	ht_stats_t *stats;	/**< Counters of lookups (only if built with
+				     HT_STATS), or NULL */
 } ht_t, *ht;
 
+/** \brief Hash table iterator */
+typedef struct ht_iter_t {
+	ht table;		/**< The table, or NULL if the iterator ended */
+	unsigned int pos;	/**< The next bucket or slot to look at */
+	unsigned int left;	/**< The number of slots left to look at */
+	int rehash;		/**< Nonzero if in the rehash_buckets */
+	sll next;		/**< The next node of the current bucket */
+	hashval hash;		/**< The (scrambled) hash value of the key
+				     ht_iter_next returned last */
+} ht_iter_t, *ht_iter;
+
 ht ht_create(unsigned int, hash_func);
+ht ht_create_type(unsigned int, hash_func, ht_type);
+ht ht_create_full(unsigned int, fullhash_func, ht_type);
+ht ht_create_keyed(unsigned int, keyedhash_func, ht_type);
+ht ht_set_load_factor(ht, double, double);
+ht ht_resize(ht, unsigned int);
+ht ht_set_rehash_step(ht, unsigned int);
+ht ht_set_bloom(ht, double);
+ht ht_stats(ht, ht_stats_t *);
 void ht_destroy(ht, free_func, free_func);
 ht ht_insert(ht, gendata, gendata, eq_func, free_func, free_func);
 ht ht_insert_uniq(ht, gendata, gendata, eq_func);
 ht ht_lookup(ht, gendata, eq_func, gendata *);
+size_t ht_lookup_many(ht, const gendata *, size_t, eq_func, gendata *,
+		      unsigned char *);
 ht ht_delete(ht, gendata, eq_func, free_func, free_func);
 int ht_empty(ht);
+unsigned int ht_count(ht);
 void ht_walk(ht, assoc_func, gendata);
+ht_iter ht_iter_init(ht, ht_iter);
+int ht_iter_next(ht_iter, gendata *, gendata *);
+void ht_iter_end(ht_iter);
+hashval ht_scan(ht, hashval, unsigned int, assoc_func, gendata);
 
 /* Convenience functions */
 ht ht_merge(ht, ht, eq_func, free_func, free_func);
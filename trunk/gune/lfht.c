@@ -0,0 +1,1018 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief Lock-free hash tables implementation.
+ *
+ * \file lfht.c
+ * These hash tables can be used by many threads at once without any locks,
+ * using the split-ordered lists of Ori Shalev and Nir Shavit.  All entries
+ * live in a single sorted linked list, which is modified with
+ * compare-and-swap operations as described by Maged Michael.  The list is
+ * sorted on the bit-reversed hash value of the keys, so the entries of
+ * bucket \e b, taken modulo any power of two, form one contiguous stretch.
+ * Every bucket in use has a dummy node where its stretch begins.  Growing
+ * the table just doubles the number of buckets in use; the new buckets get
+ * their dummy nodes lazily, inserted after the dummy of their parent bucket.
+ * No entry ever moves, so there is no lock or global pause anywhere.
+ *
+ * Memory of removed nodes is reclaimed with hazard pointers (also by
+ * Michael): every thread announces which nodes it is looking at, and
+ * removed nodes are only freed once no thread announces them.  This is
+ * also why the table frees keys and values itself, with the functions
+ * given when it was created.
+ *
+ * ANSI C has no atomic operations, so this module needs a compiler with
+ * the GCC __atomic builtins.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gune/misc.h>
+#include <gune/lfht.h>
+
+#ifndef __GNUC__
+#error "lfht needs the GCC __atomic builtins"
+#endif
+
+/** Compile-time option of the number of buckets if no range is given */
+#define LFHT_DEFAULT_RANGE	16
+
+/** Compile-time option of the average number of entries per bucket */
+#define LFHT_MAX_LOAD		2
+
+/** Compile-time option of how many removed nodes a thread collects before
+ *  trying to free them, on top of twice the number of hazard pointers */
+#define LFHT_RETIRE_MIN		32
+
+/* Hazard pointers per thread: two for the operations, two for walking */
+#define LFHT_HPS		4
+
+/* Visited nodes lfht_walk remembers on the stack before using the heap */
+#define LFHT_WALK_SEEN		8
+
+/* The most significant bit of a hash value */
+#define LFHT_HIGH_BIT	((hashval)1 << (sizeof(hashval) * CHAR_BIT - 1))
+
+/* The lowest bit of a next pointer marks its node as removed */
+#define LFHT_MARKED(p)	(((size_t)(p) & 1) != 0)
+#define LFHT_MARK(p)	((struct lfht_node *)((size_t)(p) | 1))
+#define LFHT_UNMARK(p)	((struct lfht_node *)((size_t)(p) & ~(size_t)1))
+
+#define LFHT_LOAD(p)	__atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define LFHT_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+
+struct lfht_node {
+	hashval so_key;		/* Bit-reversed hash; odd for entries, even
+				   for dummy nodes */
+	gendata key;
+	gendata value;
+	struct lfht_node *next;	/* The next node, possibly marked */
+	struct lfht_node *retired_next;	/* The next node waiting to be freed */
+};
+
+struct lfht_hp {
+	struct lfht_node *hp[LFHT_HPS];	/* Nodes this thread is looking at */
+	int active;			/* Nonzero while a thread owns this */
+	struct lfht_hp *next;		/* The next record of the table */
+	struct lfht_node *retired;	/* Removed nodes waiting to be freed */
+	unsigned int nretired;		/* The length of that list */
+};
+
+/* A place in the list, as found by lfht_find */
+struct lfht_pos {
+	struct lfht_node **prevp;	/* The pointer to cur */
+	struct lfht_node *cur;		/* The node found, or the one after
+					   where it should be */
+	struct lfht_node *next;		/* The node after cur, if it was found */
+};
+
+static int lfht_cas(struct lfht_node **, struct lfht_node *,
+		    struct lfht_node *);
+static hashval lfht_reverse(hashval);
+static unsigned int lfht_log2(unsigned int);
+static void lfht_hp_release(void *);
+static struct lfht_hp *lfht_hp_get(lfht);
+static void lfht_hp_clear(struct lfht_hp *);
+static void lfht_free_node(lfht, struct lfht_node *);
+static void lfht_scan(lfht, struct lfht_hp *);
+static void lfht_retire(lfht, struct lfht_hp *, struct lfht_node *);
+static int lfht_find(lfht, struct lfht_hp *, struct lfht_node *, hashval,
+		     gendata, eq_func, struct lfht_pos *);
+static struct lfht_node *lfht_bucket(lfht, struct lfht_hp *, unsigned int);
+static struct lfht_node *lfht_start(lfht, struct lfht_hp *, gendata,
+				    hashval *);
+static lfht lfht_insert_internal(lfht, gendata, gendata, eq_func, int);
+static int lfht_walk_seen(struct lfht_node **, unsigned int,
+			  struct lfht_node *);
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/*
+ * Atomically replace *p by new if it equals old.  Returns nonzero if
+ * it did.
+ */
+static int
+lfht_cas(struct lfht_node **p, struct lfht_node *old, struct lfht_node *new)
+{
+	return __atomic_compare_exchange_n(p, &old, new, 0, __ATOMIC_SEQ_CST,
+					   __ATOMIC_SEQ_CST);
+}
+
+
+/*
+ * Reverse the order of the bits of a hash value.
+ */
+static hashval
+lfht_reverse(hashval h)
+{
+#if ULONG_MAX > 0xFFFFFFFFUL
+	h = ((h >> 1) & 0x5555555555555555UL) | ((h & 0x5555555555555555UL) << 1);
+	h = ((h >> 2) & 0x3333333333333333UL) | ((h & 0x3333333333333333UL) << 2);
+	h = ((h >> 4) & 0x0F0F0F0F0F0F0F0FUL) | ((h & 0x0F0F0F0F0F0F0F0FUL) << 4);
+	h = ((h >> 8) & 0x00FF00FF00FF00FFUL) | ((h & 0x00FF00FF00FF00FFUL) << 8);
+	h = ((h >> 16) & 0x0000FFFF0000FFFFUL) |
+		((h & 0x0000FFFF0000FFFFUL) << 16);
+	h = (h >> 32) | (h << 32);
+#else
+	h = ((h >> 1) & 0x55555555UL) | ((h & 0x55555555UL) << 1);
+	h = ((h >> 2) & 0x33333333UL) | ((h & 0x33333333UL) << 2);
+	h = ((h >> 4) & 0x0F0F0F0FUL) | ((h & 0x0F0F0F0FUL) << 4);
+	h = ((h >> 8) & 0x00FF00FFUL) | ((h & 0x00FF00FFUL) << 8);
+	h = (h >> 16) | (h << 16);
+#endif
+
+	return h;
+}
+
+
+/*
+ * Return the index of the highest set bit of a nonzero number.
+ */
+static unsigned int
+lfht_log2(unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; n > 1; n >>= 1, ++i)
+		;
+
+	return i;
+}
+
+
+/*
+ * Give up a hazard pointer record when its thread exits.  Another thread
+ * can take it over, including the nodes still waiting to be freed.
+ */
+static void
+lfht_hp_release(void *p)
+{
+	struct lfht_hp *h = p;
+	unsigned int i;
+
+	for (i = 0; i < LFHT_HPS; ++i)
+		LFHT_STORE(&h->hp[i], NULL);
+	LFHT_STORE(&h->active, 0);
+}
+
+
+/*
+ * Get the hazard pointer record of the calling thread, taking over an
+ * abandoned one or creating a new one if it has none yet.
+ */
+static struct lfht_hp *
+lfht_hp_get(lfht t)
+{
+	struct lfht_hp *h, *head;
+	unsigned int i;
+	int inactive;
+	int err;
+
+	if ((h = pthread_getspecific(t->hp_key)) != NULL)
+		return h;
+
+	for (h = LFHT_LOAD(&t->hps); h != NULL; h = h->next) {
+		inactive = 0;
+		if (LFHT_LOAD(&h->active) == 0 &&
+		    __atomic_compare_exchange_n(&h->active, &inactive, 1, 0,
+						__ATOMIC_SEQ_CST,
+						__ATOMIC_SEQ_CST))
+			break;
+	}
+
+	if (h == NULL) {
+		if ((h = malloc(sizeof(struct lfht_hp))) == NULL)
+			return NULL;
+
+		for (i = 0; i < LFHT_HPS; ++i)
+			h->hp[i] = NULL;
+		h->active = 1;
+		h->retired = NULL;
+		h->nretired = 0;
+
+		/* Records are never unlinked, so this can't suffer from ABA */
+		head = LFHT_LOAD(&t->hps);
+		do {
+			h->next = head;
+		} while (!__atomic_compare_exchange_n(&t->hps, &head, h, 0,
+						      __ATOMIC_SEQ_CST,
+						      __ATOMIC_SEQ_CST));
+		__atomic_add_fetch(&t->nhps, 1, __ATOMIC_SEQ_CST);
+	}
+
+	if ((err = pthread_setspecific(t->hp_key, h)) != 0) {
+		LFHT_STORE(&h->active, 0);
+		errno = err;
+		return NULL;
+	}
+
+	return h;
+}
+
+
+/*
+ * Announce that the thread's current operation isn't looking at any nodes
+ * anymore.  The hazard pointers of a walk in progress are left alone.
+ */
+static void
+lfht_hp_clear(struct lfht_hp *h)
+{
+	LFHT_STORE(&h->hp[0], NULL);
+	LFHT_STORE(&h->hp[1], NULL);
+}
+
+
+/*
+ * Free a node which is not reachable anymore, with its key and value.
+ */
+static void
+lfht_free_node(lfht t, struct lfht_node *n)
+{
+	if (t->free_key != NULL)
+		t->free_key(n->key.ptr);
+	if (t->free_value != NULL)
+		t->free_value(n->value.ptr);
+	free(n);
+}
+
+
+/*
+ * Free all removed nodes of this thread which no thread is looking at.
+ */
+static void
+lfht_scan(lfht t, struct lfht_hp *h)
+{
+	struct lfht_node *n, *next, *keep;
+	struct lfht_hp *o;
+	unsigned int i;
+	int busy;
+
+	n = h->retired;
+	keep = NULL;
+	h->nretired = 0;
+
+	for (; n != NULL; n = next) {
+		next = n->retired_next;
+
+		busy = 0;
+		for (o = LFHT_LOAD(&t->hps); o != NULL && !busy; o = o->next)
+			for (i = 0; i < LFHT_HPS; ++i)
+				if (LFHT_LOAD(&o->hp[i]) == n)
+					busy = 1;
+
+		if (busy) {
+			n->retired_next = keep;
+			keep = n;
+			++h->nretired;
+		} else {
+			lfht_free_node(t, n);
+		}
+	}
+
+	h->retired = keep;
+}
+
+
+/*
+ * Free a node which has just been unlinked, as soon as it is safe.
+ */
+static void
+lfht_retire(lfht t, struct lfht_hp *h, struct lfht_node *n)
+{
+	n->retired_next = h->retired;
+	h->retired = n;
+
+	if (++h->nretired >= LFHT_RETIRE_MIN +
+	    2 * LFHT_HPS * LFHT_LOAD(&t->nhps))
+		lfht_scan(t, h);
+}
+
+
+/*
+ * Search the list, from the dummy node start onwards, for the node with
+ * split-order key so_key whose key is equal to key.  If eq is NULL, only the
+ * split-order keys are compared (this is used to find dummy nodes).
+ * Returns nonzero if the node was found.  In any case, pos is filled in
+ * with the place where the node is, or should be inserted.  Removed nodes
+ * which are passed are unlinked.  On return, the hazard pointers protect
+ * pos->cur and the node containing pos->prevp.
+ */
+static int
+lfht_find(lfht t, struct lfht_hp *h, struct lfht_node *start, hashval so_key,
+	  gendata key, eq_func eq, struct lfht_pos *pos)
+{
+	struct lfht_node **prevp, *cur, *next;
+
+again:
+	/* Dummy nodes are never removed, so start needs no protection */
+	prevp = &start->next;
+	cur = LFHT_LOAD(prevp);
+
+	for (;;) {
+		if (cur == NULL)
+			break;
+
+		/*
+		 * Announce we're looking at cur, then check it was still
+		 * linked when we did.  If it was, nobody will free it now.
+		 */
+		LFHT_STORE(&h->hp[0], cur);
+		if (LFHT_LOAD(prevp) != cur)
+			goto again;
+
+		next = LFHT_LOAD(&cur->next);
+		if (LFHT_MARKED(next)) {
+			/* Help unlinking a removed node */
+			if (!lfht_cas(prevp, cur, LFHT_UNMARK(next)))
+				goto again;
+			lfht_retire(t, h, cur);
+			cur = LFHT_UNMARK(next);
+			continue;
+		}
+
+		if (cur->so_key > so_key)
+			break;
+
+		if (cur->so_key == so_key && (eq == NULL || eq(key, cur->key))) {
+			pos->prevp = prevp;
+			pos->cur = cur;
+			pos->next = next;
+			return 1;
+		}
+
+		/* cur becomes the previous node; keep it protected */
+		LFHT_STORE(&h->hp[1], cur);
+		prevp = &cur->next;
+		cur = next;
+	}
+
+	pos->prevp = prevp;
+	pos->cur = cur;
+	pos->next = NULL;
+	return 0;
+}
+
+
+/*
+ * Return the dummy node of a bucket, creating it (and the dummy nodes of
+ * its parent buckets) if needed.  Returns NULL if out of memory.
+ */
+static struct lfht_node *
+lfht_bucket(lfht t, struct lfht_hp *h, unsigned int b)
+{
+	struct lfht_node **seg, **newseg, *d, *dummy;
+	struct lfht_pos pos;
+	unsigned int s, off, len;
+	gendata none;
+
+	/* Segment 0 holds buckets 0 and 1, segment s > 0 buckets 2^s.. */
+	s = (b < 2) ? 0 : lfht_log2(b);
+	off = (b < 2) ? b : b - (1U << s);
+	len = (s == 0) ? 2 : 1U << s;
+
+	if ((seg = LFHT_LOAD(&t->segments[s])) == NULL) {
+		if ((newseg = calloc(len, sizeof(struct lfht_node *))) == NULL)
+			return NULL;
+		seg = NULL;
+		if (__atomic_compare_exchange_n(&t->segments[s], &seg, newseg,
+						0, __ATOMIC_SEQ_CST,
+						__ATOMIC_SEQ_CST)) {
+			seg = newseg;
+		} else {
+			/* Another thread was first; seg is now its segment */
+			free(newseg);
+		}
+	}
+
+	if ((d = LFHT_LOAD(&seg[off])) != NULL)
+		return d;
+
+	/* Bucket 0 always exists, so this ends */
+	if ((d = lfht_bucket(t, h, b & ~(1U << lfht_log2(b)))) == NULL)
+		return NULL;
+
+	if ((dummy = malloc(sizeof(struct lfht_node))) == NULL)
+		return NULL;
+	dummy->so_key = lfht_reverse((hashval)b);
+	dummy->key.ptr = dummy->value.ptr = NULL;
+	none.ptr = NULL;
+
+	for (;;) {
+		if (lfht_find(t, h, d, dummy->so_key, none, NULL, &pos)) {
+			/* Another thread was first */
+			free(dummy);
+			dummy = pos.cur;
+			break;
+		}
+		dummy->next = pos.cur;
+		if (lfht_cas(pos.prevp, pos.cur, dummy))
+			break;
+	}
+
+	LFHT_STORE(&seg[off], dummy);
+	return dummy;
+}
+
+
+/*
+ * Return the dummy node of the bucket of a key, and its split-order key.
+ */
+static struct lfht_node *
+lfht_start(lfht t, struct lfht_hp *h, gendata key, hashval *so_key)
+{
+	hashval hash;
+
+	assert(t->hash != NULL);
+
+	hash = hash_mix(t->hash(key));
+	*so_key = lfht_reverse(hash | LFHT_HIGH_BIT);
+
+	return lfht_bucket(t, h, (unsigned int)hash &
+			   (LFHT_LOAD(&t->size) - 1));
+}
+
+
+/**
+ * \brief Create a new empty lock-free hash table.
+ *
+ * Since other threads may still be looking at elements which are removed
+ * from the table, the table frees removed keys and values itself, when it
+ * is safe to do so.  That's why the functions to free them are given here,
+ * instead of to lfht_insert and lfht_delete.
+ *
+ * \param range       The initial number of buckets, or 0 to use a sensible
+ *			default.  It is rounded up to a power of two.
+ * \param hash        The full-width hashing function to use on keys.
+ * \param free_key    The function which is used to free the key data, or
+ *			\c NULL if no action should be taken on the key data.
+ * \param free_value  The function which is used to free the value data, or
+ *			\c NULL if no action should be taken on the value data.
+ *
+ * \return  A new empty lock-free hash table object, or \c NULL if an error
+ *	     occurred.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ * - \b EAGAIN if the system lacks the resources for thread-specific data.
+ *
+ * \sa lfht_destroy
+ */
+lfht
+lfht_create(unsigned int range, fullhash_func hash, free_func free_key,
+	    free_func free_value)
+{
+	struct lfht_node *dummy;
+	unsigned int i;
+	lfht_t *t;
+	int err;
+
+	assert(hash != NULL);
+
+	if (range == 0)
+		range = LFHT_DEFAULT_RANGE;
+
+	if ((t = malloc(sizeof(lfht_t))) == NULL)
+		return NULL;
+
+	for (i = 0; i < LFHT_SEGMENTS; ++i)
+		t->segments[i] = NULL;
+
+	/* Bucket 0 is the head of the list, so it always exists */
+	if ((t->segments[0] = calloc(2, sizeof(struct lfht_node *))) == NULL ||
+	    (dummy = malloc(sizeof(struct lfht_node))) == NULL) {
+		free(t->segments[0]);
+		free(t);
+		return NULL;
+	}
+	dummy->so_key = 0;
+	dummy->key.ptr = dummy->value.ptr = NULL;
+	dummy->next = NULL;
+	t->segments[0][0] = dummy;
+
+	if ((err = pthread_key_create(&t->hp_key, lfht_hp_release)) != 0) {
+		free(dummy);
+		free(t->segments[0]);
+		free(t);
+		errno = err;
+		return NULL;
+	}
+
+	/* Leave the top bit of the hash for the split-order keys */
+	for (t->size = 2; t->size < range && t->size < (1U << 30);
+	     t->size <<= 1)
+		;
+	t->count = 0;
+	t->hash = hash;
+	t->free_key = free_key;
+	t->free_value = free_value;
+	t->hps = NULL;
+	t->nhps = 0;
+
+	return (lfht)t;
+}
+
+
+/**
+ * \brief Free all memory allocated for a lock-free hash table.
+ *
+ * The table must not be in use by any other thread.  The keys and values
+ * are freed with the functions given to lfht_create.
+ *
+ * \param t  The lock-free hash table to destroy.
+ *
+ * \sa lfht_create
+ */
+void
+lfht_destroy(lfht t)
+{
+	struct lfht_node *n, *next;
+	struct lfht_hp *h, *hnext;
+	unsigned int i;
+
+	assert(t != NULL);
+
+	pthread_key_delete(t->hp_key);
+
+	/* Removed nodes that are still linked are freed here too */
+	for (n = t->segments[0][0]; n != NULL; n = next) {
+		next = LFHT_UNMARK(n->next);
+		if (n->so_key & 1)
+			lfht_free_node(t, n);
+		else
+			free(n);
+	}
+
+	for (h = t->hps; h != NULL; h = hnext) {
+		hnext = h->next;
+		for (n = h->retired; n != NULL; n = next) {
+			next = n->retired_next;
+			lfht_free_node(t, n);
+		}
+		free(h);
+	}
+
+	for (i = 0; i < LFHT_SEGMENTS; ++i)
+		free(t->segments[i]);
+	free(t);
+}
+
+
+/*
+ * Internal function which lfht_insert and lfht_insert_uniq call.
+ * Argument list is the same as these two functions, except for an extra
+ * integer tacked onto the end.  This integer is nonzero if existing
+ * key entries are not allowed.  If existing key entries are allowed, the
+ * entry is replaced.
+ */
+static lfht
+lfht_insert_internal(lfht t, gendata key, gendata value, eq_func eq,
+		     int uniq)
+{
+	struct lfht_node *node, *start;
+	struct lfht_pos pos;
+	struct lfht_hp *h;
+	unsigned int size;
+
+	assert(t != NULL);
+	assert(eq != NULL);
+
+	if ((h = lfht_hp_get(t)) == NULL)
+		return NULL;
+
+	if ((node = malloc(sizeof(struct lfht_node))) == NULL)
+		return NULL;
+	node->key = key;
+	node->value = value;
+
+	if ((start = lfht_start(t, h, key, &node->so_key)) == NULL) {
+		free(node);
+		lfht_hp_clear(h);
+		return NULL;
+	}
+
+	for (;;) {
+		if (!lfht_find(t, h, start, node->so_key, key, eq, &pos)) {
+			node->next = pos.cur;
+			if (lfht_cas(pos.prevp, pos.cur, node))
+				break;
+			continue;
+		}
+
+		if (uniq) {
+			free(node);
+			lfht_hp_clear(h);
+			errno = EINVAL;
+			return NULL;
+		}
+
+		/*
+		 * Mark the old node removed and make the new node its
+		 * successor, in one step.  Anyone passing the old node now
+		 * finds the new one right after it.
+		 */
+		node->next = pos.next;
+		if (!lfht_cas(&pos.cur->next, pos.next, LFHT_MARK(node)))
+			continue;
+		if (lfht_cas(pos.prevp, pos.cur, node))
+			lfht_retire(t, h, pos.cur);
+		else
+			(void)lfht_find(t, h, start, node->so_key, key, eq,
+					&pos);
+		lfht_hp_clear(h);
+		return t;
+	}
+
+	lfht_hp_clear(h);
+
+	/* Use more buckets if they get too full.  Losing this race is fine. */
+	size = LFHT_LOAD(&t->size);
+	if (__atomic_add_fetch(&t->count, 1, __ATOMIC_SEQ_CST) / LFHT_MAX_LOAD
+	    > size && size < (1U << 30))
+		__atomic_compare_exchange_n(&t->size, &size, size * 2, 0,
+					    __ATOMIC_SEQ_CST,
+					    __ATOMIC_SEQ_CST);
+
+	return t;
+}
+
+
+/**
+ * \brief Add a (key, value) pair to a lock-free hash table (with replace)
+ *
+ * Add a data element to the hash table with the given key or replace an
+ * existing element with the same key.  The old key and value are freed
+ * with the functions given to lfht_create once no thread uses them.
+ *
+ * \param t      The lock-free hash table to insert the data in.
+ * \param key    The key of the data.
+ * \param value  The data to insert.
+ * \param eq     The equals predicate for two keys.
+ *
+ * \return  The original lock-free hash table, or \c NULL if the data could
+ *           not be inserted.  Original table is still valid in case of error.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa lfht_insert_uniq, lfht_delete
+ */
+lfht
+lfht_insert(lfht t, gendata key, gendata value, eq_func eq)
+{
+	return lfht_insert_internal(t, key, value, eq, 0);
+}
+
+
+/**
+ * \brief Add a (key, value) pair to a lock-free hash table (no replace)
+ *
+ * Add a data element to the hash table with the given key.  If there already
+ * is an element with the same key in the table, it is regarded as an error.
+ *
+ * \param t      The lock-free hash table to insert the data in.
+ * \param key    The key of the data.
+ * \param value  The data to insert.
+ * \param eq     The equals predicate for two keys.
+ *
+ * \return  The original lock-free hash table, or \c NULL if the data could
+ *           not be inserted.  Original table is still valid in case of error.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key is already in the table.
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa lfht_insert, lfht_delete
+ */
+lfht
+lfht_insert_uniq(lfht t, gendata key, gendata value, eq_func eq)
+{
+	return lfht_insert_internal(t, key, value, eq, 1);
+}
+
+
+/**
+ * \brief Look up an element in a lock-free hash table.
+ *
+ * This never waits for other threads.
+ *
+ * \attention
+ * If the element is a pointer, another thread may remove it as soon as
+ * this function returns.  It is only freed when the table frees it, but
+ * the table can't know when the caller is done with it.
+ *
+ * \param t     The lock-free hash table which contains the element.
+ * \param key   The key to the element.
+ * \param eq    The equals predicate for two keys.
+ * \param data  A pointer to the location where the element is stored, if
+ *               it was found.
+ *
+ * \return  The lock-free hash table, or \c NULL if the key could not be
+ *	     found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ * - \b ENOMEM if out of memory.  (the bucket had to be set up)
+ */
+lfht
+lfht_lookup(lfht t, gendata key, eq_func eq, gendata *data)
+{
+	struct lfht_node *start;
+	struct lfht_pos pos;
+	struct lfht_hp *h;
+	hashval so_key;
+	int found;
+
+	assert(t != NULL);
+	assert(eq != NULL);
+
+	if ((h = lfht_hp_get(t)) == NULL)
+		return NULL;
+
+	if ((start = lfht_start(t, h, key, &so_key)) == NULL) {
+		lfht_hp_clear(h);
+		return NULL;
+	}
+
+	if ((found = lfht_find(t, h, start, so_key, key, eq, &pos)) != 0)
+		*data = pos.cur->value;
+	lfht_hp_clear(h);
+
+	if (!found) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return t;
+}
+
+
+/**
+ * \brief Delete an element from a lock-free hash table.
+ *
+ * The key and value are freed with the functions given to lfht_create
+ * once no thread uses them.
+ *
+ * \param t    The lock-free hash table which contains the element to delete.
+ * \param key  The key to the element to delete.
+ * \param eq   The equals predicate for two keys.
+ *
+ * \return  The lock-free hash table, or \c NULL if the key could not be
+ *	     found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ * - \b ENOMEM if out of memory.  (the bucket had to be set up)
+ *
+ * \sa lfht_insert
+ */
+lfht
+lfht_delete(lfht t, gendata key, eq_func eq)
+{
+	struct lfht_node *start;
+	struct lfht_pos pos;
+	struct lfht_hp *h;
+	hashval so_key;
+
+	assert(t != NULL);
+	assert(eq != NULL);
+
+	if ((h = lfht_hp_get(t)) == NULL)
+		return NULL;
+
+	if ((start = lfht_start(t, h, key, &so_key)) == NULL) {
+		lfht_hp_clear(h);
+		return NULL;
+	}
+
+	for (;;) {
+		if (!lfht_find(t, h, start, so_key, key, eq, &pos)) {
+			lfht_hp_clear(h);
+			errno = EINVAL;
+			return NULL;
+		}
+
+		/* Marking the node is what removes it */
+		if (lfht_cas(&pos.cur->next, pos.next, LFHT_MARK(pos.next)))
+			break;
+	}
+
+	if (lfht_cas(pos.prevp, pos.cur, pos.next))
+		lfht_retire(t, h, pos.cur);
+	else
+		(void)lfht_find(t, h, start, so_key, key, eq, &pos);
+
+	lfht_hp_clear(h);
+	__atomic_sub_fetch(&t->count, 1, __ATOMIC_SEQ_CST);
+
+	return t;
+}
+
+
+/**
+ * \brief Return whether or not a lock-free hash table is empty.
+ *
+ * If other threads are modifying the table, the answer may be outdated by
+ * the time it is returned.
+ *
+ * \param t  The lock-free hash table to check.
+ *
+ * \return  Non-zero if the table is empty, 0 if it is not.
+ */
+int
+lfht_empty(lfht t)
+{
+	assert(t != NULL);
+
+	return LFHT_LOAD(&t->count) == 0;
+}
+
+
+/**
+ * \brief Walk through all elements of a lock-free hash table.
+ *
+ * The walk function gets copies of the keys and values, so changing them
+ * has no effect.  It may call any function on the table, except
+ * lfht_destroy.  Elements which are inserted or deleted by other threads
+ * during the walk may or may not be visited.
+ *
+ * \param t     The lock-free hash table to walk
+ * \param walk  The function which will process the hash pairs
+ * \param data  Any data to pass to the function every time it is called.
+ */
+void
+lfht_walk(lfht t, assoc_func walk, gendata data)
+{
+	struct lfht_node *buf[LFHT_WALK_SEEN], **seen, **p;
+	struct lfht_node **prevp, *start, *cur, *next;
+	struct lfht_hp *h;
+	unsigned int nseen, maxseen, lost, skip;
+	hashval last;
+	int skipping, started, visit;
+	gendata k, v;
+
+	assert(t != NULL);
+	assert(walk != NULL);
+
+	if ((h = lfht_hp_get(t)) == NULL)
+		return;
+
+	start = t->segments[0][0];
+	started = 0;
+	last = 0;
+	seen = buf;
+	maxseen = LFHT_WALK_SEEN;
+	nseen = 0;
+	lost = 0;
+
+	/*
+	 * This is lfht_find without a target, using the other two hazard
+	 * pointers so the walk function can use the table.  If we have to
+	 * start over, we skip what we've already visited.  Keys whose hashes
+	 * collide share a split-order key, so we remember which nodes with
+	 * the last one we visited.  The pointers are only compared, so it
+	 * doesn't matter if they have been freed in the meantime.  If we
+	 * can't remember any more of them, we count the rest instead.
+	 */
+again:
+	prevp = &start->next;
+	cur = LFHT_LOAD(prevp);
+	skipping = started;
+	skip = lost;
+
+	while (cur != NULL) {
+		LFHT_STORE(&h->hp[2], cur);
+		if (LFHT_LOAD(prevp) != cur)
+			goto again;
+
+		next = LFHT_LOAD(&cur->next);
+		if (LFHT_MARKED(next)) {
+			if (!lfht_cas(prevp, cur, LFHT_UNMARK(next)))
+				goto again;
+			lfht_retire(t, h, cur);
+			cur = LFHT_UNMARK(next);
+			continue;
+		}
+
+		if (skipping && cur->so_key > last)
+			skipping = 0;
+
+		visit = (cur->so_key & 1) != 0;
+		if (visit && skipping) {
+			if (cur->so_key != last ||
+			    lfht_walk_seen(seen, nseen, cur)) {
+				visit = 0;
+			} else if (skip > 0) {
+				--skip;
+				visit = 0;
+			}
+		}
+
+		if (visit) {
+			if (!started || cur->so_key != last) {
+				last = cur->so_key;
+				nseen = 0;
+				lost = 0;
+			}
+			if (nseen == maxseen && lost == 0) {
+				if (seen == buf)
+					p = malloc(2 * maxseen * sizeof(*p));
+				else
+					p = realloc(seen,
+						    2 * maxseen * sizeof(*p));
+				if (p != NULL) {
+					if (seen == buf)
+						memcpy(p, buf, sizeof(buf));
+					seen = p;
+					maxseen *= 2;
+				}
+			}
+			if (nseen < maxseen && lost == 0)
+				seen[nseen++] = cur;
+			else
+				++lost;
+
+			k = cur->key;
+			v = cur->value;
+			started = 1;
+			walk(&k, &v, data);
+		}
+
+		LFHT_STORE(&h->hp[3], cur);
+		prevp = &cur->next;
+		cur = next;
+	}
+
+	LFHT_STORE(&h->hp[2], NULL);
+	LFHT_STORE(&h->hp[3], NULL);
+
+	if (seen != buf)
+		free(seen);
+}
+
+
+/* Check whether lfht_walk has already visited a node */
+static int
+lfht_walk_seen(struct lfht_node **seen, unsigned int nseen,
+	       struct lfht_node *node)
+{
+	unsigned int i;
+
+	for (i = 0; i < nseen; ++i)
+		if (seen[i] == node)
+			return 1;
+
+	return 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief Lock-free hash tables interface.
+ *
+ * \file lfht.h
+ */
+#ifndef GUNE_LFHT_H
+#define GUNE_LFHT_H
+
+#include <pthread.h>
+#include <gune/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief The number of bucket segments; segment \e n has 2^n buckets */
+#define LFHT_SEGMENTS	32
+
+/** \brief List node (only defined in the implementation) */
+struct lfht_node;
+
+/** \brief Per-thread hazard pointer record (only defined in the
+ *  implementation) */
+struct lfht_hp;
+
+/** \brief Lock-free hash table implementation */
+typedef struct lfht_t {
+	struct lfht_node **segments[LFHT_SEGMENTS]; /**< The buckets, which
+						         point into the list */
+	unsigned int size;	/**< The number of buckets in use */
+	unsigned int count;	/**< The number of elements in the table */
+	fullhash_func hash;	/**< The hashing function to use */
+	free_func free_key;	/**< Frees keys of removed elements, or NULL */
+	free_func free_value;	/**< Frees values of removed elements, or NULL */
+	struct lfht_hp *hps;	/**< The hazard pointer records of all threads
+				     that have used the table */
+	unsigned int nhps;	/**< The number of hazard pointer records */
+	pthread_key_t hp_key;	/**< The calling thread's record */
+} lfht_t, *lfht;
+
+lfht lfht_create(unsigned int, fullhash_func, free_func, free_func);
+void lfht_destroy(lfht);
+lfht lfht_insert(lfht, gendata, gendata, eq_func);
+lfht lfht_insert_uniq(lfht, gendata, gendata, eq_func);
+lfht lfht_lookup(lfht, gendata, eq_func, gendata *);
+lfht lfht_delete(lfht, gendata, eq_func);
+int lfht_empty(lfht);
+void lfht_walk(lfht, assoc_func, gendata);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GUNE_LFHT_H */
@@ -0,0 +1,476 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief LRU caches implementation.
+ *
+ * \file lru.c
+ * An LRU cache is a hash table with a bounded capacity.  Its entries are
+ * kept in a doubly linked list in order of use, so looking up an entry can
+ * move it to the front, and adding an entry to a full cache can drop the
+ * least recently used one from the back, both in constant time.  The hash
+ * table maps keys onto list entries, so the entries are never searched.
+ *
+ * The capacity is either a number of entries, or a total size when a size
+ * function is given, in which case every entry counts as whatever that
+ * function says it takes (a number of bytes, for example).
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <gune/lru.h>
+
+static void lru_unlink(lru, lru_entry);
+static void lru_link_head(lru, lru_entry);
+static void lru_drop(lru, lru_entry, eq_func);
+static lru_entry lru_find(lru, gendata, eq_func);
+
+/*
+ * Internal function to take an entry out of the recency list.
+ */
+static void
+lru_unlink(lru c, lru_entry e)
+{
+	if (e->prev == NULL)
+		c->head = e->next;
+	else
+		e->prev->next = e->next;
+
+	if (e->next == NULL)
+		c->tail = e->prev;
+	else
+		e->next->prev = e->prev;
+}
+
+
+/*
+ * Internal function to put an entry at the front of the recency list.
+ */
+static void
+lru_link_head(lru c, lru_entry e)
+{
+	e->prev = NULL;
+	e->next = c->head;
+
+	if (c->head == NULL)
+		c->tail = e;
+	else
+		c->head->prev = e;
+
+	c->head = e;
+}
+
+
+/*
+ * Internal function to remove an entry from the cache, calling the free
+ * hooks on its key and value.
+ */
+static void
+lru_drop(lru c, lru_entry e, eq_func eq)
+{
+	/* Every entry in the list is in the index, so this can't fail */
+	ht_delete(c->index, e->key, eq, NULL, NULL);
+
+	lru_unlink(c, e);
+	c->used -= e->size;
+
+	if (c->free_key != NULL)
+		c->free_key(e->key.ptr);
+	if (c->free_value != NULL)
+		c->free_value(e->value.ptr);
+
+	free(e);
+}
+
+
+/*
+ * Internal function to look up the entry belonging to a key.  Returns NULL
+ * if there is no such entry.
+ */
+static lru_entry
+lru_find(lru c, gendata key, eq_func eq)
+{
+	gendata e;
+
+	if (ht_lookup(c->index, key, eq, &e) == NULL)
+		return NULL;
+
+	return (lru_entry)e.ptr;
+}
+
+
+/**
+ * \brief Create a new empty LRU cache.
+ *
+ * \param capacity    The maximum number of entries, or the maximum total
+ *			size of the entries if \p size is not \c NULL.
+ * \param hash        The full-width hashing function to use on keys.
+ * \param size        The function which returns the size of an entry, or
+ *			\c NULL if every entry counts as one.
+ * \param free_key    The function used to free the key of an entry which
+ *			is dropped from the cache, or \c NULL if keys need not
+ *			be freed.
+ * \param free_value  The function used to free the value of an entry which
+ *			is dropped from the cache, or \c NULL if values need
+ *			not be freed.
+ *
+ * \return  A new empty LRU cache object, or \c NULL if an error occurred.
+ *
+ * \par Errno values:
+ * - \b EINVAL if \p capacity is 0.
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa lru_destroy
+ */
+lru
+lru_create(size_t capacity, fullhash_func hash, lru_size_func size,
+	   free_func free_key, free_func free_value)
+{
+	lru_t *c;
+
+	assert(hash != NULL);
+
+	if (capacity == 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if ((c = malloc(sizeof(lru_t))) == NULL)
+		return NULL;
+
+	if ((c->index = ht_create_full(0, hash, HT_ROBINHOOD)) == NULL) {
+		free(c);
+		return NULL;
+	}
+
+	c->head = NULL;
+	c->tail = NULL;
+	c->capacity = capacity;
+	c->used = 0;
+	c->size = size;
+	c->free_key = free_key;
+	c->free_value = free_value;
+	c->stats.hits = 0;
+	c->stats.misses = 0;
+	c->stats.evictions = 0;
+
+	return (lru)c;
+}
+
+
+/**
+ * \brief Free all memory allocated for an LRU cache.
+ *
+ * The keys and values of the remaining entries are passed to the free
+ * functions the cache was created with.
+ *
+ * \param c  The LRU cache to destroy.
+ *
+ * \sa lru_create
+ */
+void
+lru_destroy(lru c)
+{
+	lru_entry e, next;
+
+	assert(c != NULL);
+
+	for (e = c->head; e != NULL; e = next) {
+		next = e->next;
+		if (c->free_key != NULL)
+			c->free_key(e->key.ptr);
+		if (c->free_value != NULL)
+			c->free_value(e->value.ptr);
+		free(e);
+	}
+
+	ht_destroy(c->index, NULL, NULL);
+	free(c);
+}
+
+
+/**
+ * \brief Add a (key, value) pair to an LRU cache (with replace)
+ *
+ * Add an entry to the cache, or replace the entry with the same key.  The
+ *  entry becomes the most recently used one.  Afterwards, least recently
+ *  used entries are evicted until the cache is within its capacity again.
+ *  The free functions are called on the old key and value of a replaced
+ *  entry, unless they are the same as the new ones.
+ *
+ * \param c      The LRU cache to add the entry to.
+ * \param key    The key of the entry.
+ * \param value  The value of the entry.
+ * \param eq     The equals predicate for two keys.
+ *
+ * \return  The original LRU cache, or \c NULL if the entry could not be
+ *           added.  The cache is unchanged in case of error.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the entry is larger than the capacity of the cache.
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa lru_get, lru_delete
+ */
+lru
+lru_put(lru c, gendata key, gendata value, eq_func eq)
+{
+	lru_entry e;
+	gendata ep;
+	size_t size;
+
+	assert(c != NULL);
+	assert(eq != NULL);
+
+	size = c->size == NULL ? 1 : c->size(key, value);
+	if (size > c->capacity) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if ((e = lru_find(c, key, eq)) != NULL) {
+		/* Store the new key in the index too, the old one goes away */
+		ep.ptr = e;
+		if (ht_insert(c->index, key, ep, eq, NULL, NULL) == NULL)
+			return NULL;
+
+		if (c->free_key != NULL && e->key.ptr != key.ptr)
+			c->free_key(e->key.ptr);
+		if (c->free_value != NULL && e->value.ptr != value.ptr)
+			c->free_value(e->value.ptr);
+
+		lru_unlink(c, e);
+		c->used -= e->size;
+	} else {
+		if ((e = malloc(sizeof(lru_entry_t))) == NULL)
+			return NULL;
+
+		ep.ptr = e;
+		if (ht_insert_uniq(c->index, key, ep, eq) == NULL) {
+			free(e);
+			return NULL;
+		}
+	}
+
+	e->key = key;
+	e->value = value;
+	e->size = size;
+	lru_link_head(c, e);
+	c->used += size;
+
+	/* The new entry fits by itself, so this never drops it */
+	while (c->used > c->capacity) {
+		lru_drop(c, c->tail, eq);
+		++c->stats.evictions;
+	}
+
+	return c;
+}
+
+
+/**
+ * \brief Look up a value in an LRU cache.
+ *
+ * The entry which is found becomes the most recently used one.  Every call
+ *  counts as either a hit or a miss in the statistics of the cache.
+ *
+ * \param c     The LRU cache to look in.
+ * \param key   The key of the entry.
+ * \param eq    The equals predicate for two keys.
+ * \param data  A pointer to the location where the value is stored, if
+ *		 found.
+ *
+ * \return  The LRU cache, or \c NULL if the key could not be found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ *
+ * \sa lru_peek, lru_put
+ */
+lru
+lru_get(lru c, gendata key, eq_func eq, gendata *data)
+{
+	lru_entry e;
+
+	assert(c != NULL);
+	assert(eq != NULL);
+	assert(data != NULL);
+
+	if ((e = lru_find(c, key, eq)) == NULL) {
+		++c->stats.misses;
+		return NULL;
+	}
+
+	++c->stats.hits;
+	if (e != c->head) {
+		lru_unlink(c, e);
+		lru_link_head(c, e);
+	}
+	*data = e->value;
+
+	return c;
+}
+
+
+/**
+ * \brief Look up a value in an LRU cache without using it.
+ *
+ * Unlike lru_get, this changes neither the order of the entries nor the
+ *  statistics of the cache.
+ *
+ * \param c     The LRU cache to look in.
+ * \param key   The key of the entry.
+ * \param eq    The equals predicate for two keys.
+ * \param data  A pointer to the location where the value is stored, if
+ *		 found.
+ *
+ * \return  The LRU cache, or \c NULL if the key could not be found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ *
+ * \sa lru_get
+ */
+lru
+lru_peek(lru c, gendata key, eq_func eq, gendata *data)
+{
+	lru_entry e;
+
+	assert(c != NULL);
+	assert(eq != NULL);
+	assert(data != NULL);
+
+	if ((e = lru_find(c, key, eq)) == NULL)
+		return NULL;
+
+	*data = e->value;
+
+	return c;
+}
+
+
+/**
+ * \brief Remove an entry from an LRU cache.
+ *
+ * The free functions are called on the key and value of the entry.  This
+ *  doesn't count as an eviction.
+ *
+ * \param c    The LRU cache to remove the entry from.
+ * \param key  The key of the entry.
+ * \param eq   The equals predicate for two keys.
+ *
+ * \return  The LRU cache, or \c NULL if the key could not be found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ *
+ * \sa lru_put, lru_evict
+ */
+lru
+lru_delete(lru c, gendata key, eq_func eq)
+{
+	lru_entry e;
+
+	assert(c != NULL);
+	assert(eq != NULL);
+
+	if ((e = lru_find(c, key, eq)) == NULL)
+		return NULL;
+
+	lru_drop(c, e, eq);
+
+	return c;
+}
+
+
+/**
+ * \brief Evict the least recently used entry from an LRU cache.
+ *
+ * The free functions are called on the key and value of the entry.
+ *
+ * \param c   The LRU cache to evict an entry from.
+ * \param eq  The equals predicate for two keys.
+ *
+ * \return  The LRU cache, or \c NULL if it was empty.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the cache is empty.
+ *
+ * \sa lru_delete
+ */
+lru
+lru_evict(lru c, eq_func eq)
+{
+	assert(c != NULL);
+	assert(eq != NULL);
+
+	if (c->tail == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	lru_drop(c, c->tail, eq);
+	++c->stats.evictions;
+
+	return c;
+}
+
+
+/**
+ * \brief The number of entries in an LRU cache.
+ *
+ * \param c  The LRU cache.
+ *
+ * \return  The number of entries.
+ */
+unsigned int
+lru_count(lru c)
+{
+	assert(c != NULL);
+
+	return ht_count(c->index);
+}
+
+
+/**
+ * \brief The statistics of an LRU cache.
+ *
+ * \param c  The LRU cache.
+ *
+ * \return  The number of hits, misses and evictions so far.
+ */
+lru_stats_t
+lru_stats(lru c)
+{
+	assert(c != NULL);
+
+	return c->stats;
+}
@@ -0,0 +1,96 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief LRU caches interface.
+ *
+ * \file lru.h
+ */
+#ifndef GUNE_LRU_H
+#define GUNE_LRU_H
+
+#include <stddef.h>
+#include <gune/ht.h>
+#include <gune/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Function which returns the size of a cache element */
+typedef size_t (* lru_size_func) (gendata, gendata);
+
+/** \brief LRU cache element */
+typedef struct lru_entry_t {
+	gendata key;		/**< Key, used for identification of entries */
+	gendata value;		/**< The entry itself */
+	size_t size;		/**< The size of the entry */
+	struct lru_entry_t *prev; /**< The more recently used entry, or NULL */
+	struct lru_entry_t *next; /**< The less recently used entry, or NULL */
+} lru_entry_t, *lru_entry;
+
+/** \brief LRU cache statistics */
+typedef struct lru_stats_t {
+	unsigned long hits;	 /**< Lookups which found their key */
+	unsigned long misses;	 /**< Lookups which didn't */
+	unsigned long evictions; /**< Entries dropped to make room */
+} lru_stats_t;
+
+/** \brief LRU cache implementation */
+typedef struct lru_t {
+	ht index;		/**< Maps keys onto their entries */
+	lru_entry head;		/**< The most recently used entry, or NULL */
+	lru_entry tail;		/**< The least recently used entry, or NULL */
+	size_t capacity;	/**< The maximum total size of the entries */
+	size_t used;		/**< The total size of the entries */
+	lru_size_func size;	/**< The size function, or NULL if every
+				     entry has size 1 */
+	free_func free_key;	/**< Frees keys of entries which are dropped */
+	free_func free_value;	/**< Frees values of entries which are
+				     dropped */
+	lru_stats_t stats;	/**< Counters of what happened so far */
+} lru_t, *lru;
+
+lru lru_create(size_t, fullhash_func, lru_size_func, free_func, free_func);
+void lru_destroy(lru);
+lru lru_put(lru, gendata, gendata, eq_func);
+lru lru_get(lru, gendata, eq_func, gendata *);
+lru lru_peek(lru, gendata, eq_func, gendata *);
+lru lru_delete(lru, gendata, eq_func);
+lru lru_evict(lru, eq_func);
+unsigned int lru_count(lru);
+lru_stats_t lru_stats(lru);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GUNE_LRU_H */
@@ -36,8 +36,41 @@
  * Loose odds and ends which don't really belong anywhere.
  */
 
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <time.h>
+#ifdef GUNE_THREADS
+#include <pthread.h>
+#endif
 #include <gune/misc.h>
 
+/* The number of bytes in a hash word, and rotating one left */
+#if ULONG_MAX > 0xFFFFFFFFUL
+#define HASH_WORD	8
+#define ROTL(x,n)	(((x) << (n)) | ((x) >> (64 - (n))))
+#else
+#define HASH_WORD	4
+#define ROTL(x,n)	(((x) << (n)) | ((x) >> (32 - (n))))
+#endif
+
+/* One round of SipHash, or of HalfSipHash if words are 32 bits */
+#if ULONG_MAX > 0xFFFFFFFFUL
+#define SIPROUND(v0,v1,v2,v3)	{					\
+	v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32);	\
+	v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2;				\
+	v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0;				\
+	v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32);	\
+}
+#else
+#define SIPROUND(v0,v1,v2,v3)	{					\
+	v0 += v1; v1 = ROTL(v1, 5); v1 ^= v0; v0 = ROTL(v0, 16);	\
+	v2 += v3; v3 = ROTL(v3, 8); v3 ^= v2;				\
+	v0 += v3; v3 = ROTL(v3, 7); v3 ^= v0;				\
+	v2 += v1; v1 = ROTL(v1, 13); v1 ^= v2; v2 = ROTL(v2, 16);	\
+}
+#endif
+
 /* ``Hmm... Must have created this in my sleep!'' -- Gune, Titan AE
  *
  * No seriously, we need a constant pointer that can be used in many spots.
@@ -130,23 +163,74 @@ sym_eq(gendata c1, gendata c2)
 }
 
 
+/**
+ * \brief Signed integer ordering function for sorting.
+ *
+ * \param n1  The number to compare to \p n2.
+ * \param n2  The number to compare to \p n1.
+ *
+ * \return  A negative number, zero or a positive number if \p n1 is less
+ *	     than, equal to or greater than \p n2.
+ *
+ * \sa array_sort, posnum_cmp, sym_cmp
+ */
+int
+num_cmp(gendata n1, gendata n2)
+{
+	return (n1.num > n2.num) - (n1.num < n2.num);
+}
+
+
+/**
+ * \brief Unsigned integer ordering function for sorting.
+ *
+ * \param n1  The number to compare to \p n2.
+ * \param n2  The number to compare to \p n1.
+ *
+ * \return  A negative number, zero or a positive number if \p n1 is less
+ *	     than, equal to or greater than \p n2.
+ *
+ * \sa array_sort, num_cmp, sym_cmp
+ */
+int
+posnum_cmp(gendata n1, gendata n2)
+{
+	return (n1.posnum > n2.posnum) - (n1.posnum < n2.posnum);
+}
+
+
+/**
+ * \brief Character ordering function for sorting.
+ *
+ * \param c1  The character to compare to \p c2.
+ * \param c2  The character to compare to \p c1.
+ *
+ * \return  A negative number, zero or a positive number if \p c1 is less
+ *	     than, equal to or greater than \p c2.
+ *
+ * \sa array_sort, num_cmp, posnum_cmp
+ */
+int
+sym_cmp(gendata c1, gendata c2)
+{
+	return (c1.sym > c2.sym) - (c1.sym < c2.sym);
+}
+
+
 /**
  * \brief Calculate hash from a pointer.
  *
- * The hash is calculated using just the pointer's raw integer value.
+ * The pointer's raw integer value is scrambled with hash_mix before it is
+ * reduced to the range, so aligned pointers (whose low bits are all zero)
+ * still spread over all buckets, whatever the range.
  *
  * \attention
  * Use of this function is not recommended.  If anything more is known about
  * the key's data it is highly recommended to write a more specific hashing
  * function.
  *
- * Also, the range may \b not be larger than the maximum value of a pointer
- * on the target machine.  In practice, this restriction will rarely matter.
- *
  * \param key    The pointer to hash.
- * \param range  The range of the hash table.  This should be a prime value
- *		  for this function to ensure all hash table buckets are
- *		  used equally much.
+ * \param range  The range of the hash table.
  *
  * \return  The hash of the supplied pointer, in the range
  *           \f$ [0..range-1] \f$.
@@ -156,30 +240,19 @@ sym_eq(gendata c1, gendata c2)
 unsigned int
 ptr_hash(gendata key, unsigned int range)
 {
-	/*
-	 * We don't really care if pointers aren't the same size as integers,
-	 * since we're counting modulo anyway.  So the pointers can get
-	 * truncated all they want.
-	 */
-	/* LINTED */
-	unsigned int p = (unsigned int)key.ptr;
-
-	return p % range;
+	return hash_reduce(hash_mix(ptr_fullhash(key)), range);
 }
 
 
 /**
  * \brief Calculate hash from a signed integer.
  *
- * \attention
- * The range may \b not be larger than the maximum value of a signed
- * integer on the target machine.  In practice, this restriction will
- * rarely matter.
+ * The number is scrambled with hash_mix before it is reduced to the
+ * range, so numbers which are all multiples of some stride still spread
+ * over all buckets, whatever the range.
  *
  * \param key    The number to hash.
- * \param range  The range of the hash table.  This should be a prime value
- *		  for this function to ensure all hash table buckets are
- *		  used equally much.
+ * \param range  The range of the hash table.
  *
  * \return  The hash of the supplied number, in the range
  *           \f$ [0..range-1] \f$.
@@ -189,22 +262,17 @@ ptr_hash(gendata key, unsigned int range)
 unsigned int
 num_hash(gendata key, unsigned int range)
 {
-	return (unsigned int)(key.num % range);
+	return hash_reduce(hash_mix(num_fullhash(key)), range);
 }
 
 
 /**
  * \brief Calculate hash from an unsigned integer.
  *
- * \attention
- * The range may \b not be larger than the maximum value of an unsigned
- * integer on the target machine.  In practice, this restriction will
- * rarely matter.
+ * This scrambles the number like num_hash does.
  *
  * \param key    The number to hash.
- * \param range  The range of the hash table.  This should be a prime value
- *		  for this function to ensure all hash table buckets are
- *		  used equally much.
+ * \param range  The range of the hash table.
  *
  * \return  The hash of the supplied number, in the range
  *           \f$ [0..range-1] \f$.
@@ -214,21 +282,17 @@ num_hash(gendata key, unsigned int range)
 unsigned int
 posnum_hash(gendata key, unsigned int range)
 {
-	return key.posnum % range;
+	return hash_reduce(hash_mix(posnum_fullhash(key)), range);
 }
 
 
 /**
  * \brief Calculate hash from a character (symbol).
  *
- * \attention
- * The range may \b not be larger than the maximum value of a character
- * on the target machine.  In general, characters are between 0 and 255.
+ * This scrambles the character like num_hash does.
  *
  * \param key    The number to hash.
- * \param range  The range of the hash table.  This should be a prime value
- *		  for this function to ensure all hash table buckets are
- *		  used equally much.
+ * \param range  The range of the hash table.
  *
  * \return  The hash of the supplied number, in the range
  *           \f$ [0..range-1] \f$.
@@ -238,5 +302,336 @@ posnum_hash(gendata key, unsigned int range)
 unsigned int
 sym_hash(gendata key, unsigned int range)
 {
-	return (unsigned int)key.sym % range;
+	return hash_reduce(hash_mix(sym_fullhash(key)), range);
+}
+
+
+/**
+ * \brief Calculate a full-width hash from a pointer.
+ *
+ * This and the other full-width hashes of numbers are not scrambled: the
+ * hash tables scramble every full hash value themselves.  Pass them through
+ * hash_mix before using them in any other way.
+ *
+ * \param key  The pointer to hash.
+ *
+ * \return  The pointer's raw integer value.
+ *
+ * \sa ptr_eq, ptr_hash
+ */
+hashval
+ptr_fullhash(gendata key)
+{
+	/* LINTED */
+	return (hashval)key.ptr;
+}
+
+
+/**
+ * \brief Calculate a full-width hash from a signed integer.
+ *
+ * \param key  The number to hash.
+ *
+ * \return  The number's value, as an unsigned number.
+ *
+ * \sa num_eq, num_hash
+ */
+hashval
+num_fullhash(gendata key)
+{
+	return (hashval)(unsigned int)key.num;
+}
+
+
+/**
+ * \brief Calculate a full-width hash from an unsigned integer.
+ *
+ * \param key  The number to hash.
+ *
+ * \return  The number's value.
+ *
+ * \sa posnum_eq, posnum_hash
+ */
+hashval
+posnum_fullhash(gendata key)
+{
+	return (hashval)key.posnum;
+}
+
+
+/**
+ * \brief Calculate a full-width hash from a character (symbol).
+ *
+ * \param key  The character to hash.
+ *
+ * \return  The character's value, as an unsigned number.
+ *
+ * \sa sym_eq, sym_hash
+ */
+hashval
+sym_fullhash(gendata key)
+{
+	return (hashval)(unsigned char)key.sym;
+}
+
+
+/**
+ * \brief Scramble the bits of a hash value.
+ *
+ * Every bit of the input affects every bit of the output, so keys with
+ * similar hashes (like consecutive numbers, or strings which only differ in
+ * their last character) end up far apart.  This is the finalizer of
+ * Austin Appleby's MurmurHash3, in its 64-bit variant if a \c hashval is
+ * that wide.  It is a bijection, so no collisions are introduced.
+ *
+ * \param h  The hash value to scramble.
+ *
+ * \return  The scrambled hash value.
+ */
+hashval
+hash_mix(hashval h)
+{
+#if ULONG_MAX > 0xFFFFFFFFUL
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDUL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53UL;
+	h ^= h >> 33;
+#else
+	h ^= h >> 16;
+	h *= 0x85EBCA6BUL;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35UL;
+	h ^= h >> 16;
+#endif
+
+	return h;
+}
+
+
+/**
+ * \brief Reduce a hash value to a range.
+ *
+ * This maps \p hash onto \f$ [0..range-1] \f$ by multiplying it with
+ * \p range and keeping the high word of the product, which is cheaper
+ * than a division.  Unlike a modulo, it keeps the order of hash values: 0
+ * gets the lowest ones, \p range - 1 the highest.  So every result covers
+ * an interval of hash values, which is what lets ht_scan keep its place
+ * across resizes.  It does mean only the high bits of \p hash matter, so
+ * it should be well mixed.
+ *
+ * \param hash   The hash value to reduce.
+ * \param range  The number of possible results.
+ *
+ * \return  The reduced hash value, in the range \f$ [0..range-1] \f$.
+ *
+ * \sa hash_mix
+ */
+unsigned int
+hash_reduce(hashval hash, unsigned int range)
+{
+#if ULONG_MAX > 0xFFFFFFFFUL
+	return (unsigned int)(((hash >> 32) * range) >> 32);
+#else
+	unsigned long a, b, c, d, mid;
+
+	/* The high word of a 32x32 bit product, from 16 bit halves */
+	a = hash >> 16;
+	b = hash & 0xFFFFUL;
+	c = (unsigned long)range >> 16;
+	d = (unsigned long)range & 0xFFFFUL;
+	mid = ((b * d) >> 16) + ((a * d) & 0xFFFFUL) + ((b * c) & 0xFFFFUL);
+
+	return (unsigned int)(a * c + ((a * d) >> 16) + ((b * c) >> 16) +
+			      (mid >> 16));
+#endif
+}
+
+
+/**
+ * \brief Calculate a keyed hash of a block of memory.
+ *
+ * This is SipHash-1-3 by Jean-Philippe Aumasson and Daniel J. Bernstein,
+ * or its HalfSipHash variant if a \c hashval is 32 bits wide.  Without
+ * knowing the seed it is infeasible to find keys whose hash values
+ * collide, so a hash table using it can't be flooded with colliding keys
+ * by whoever supplies them.  It is slower than an unkeyed hash, though.
+ *
+ * \param mem   The memory to hash.
+ * \param len   The number of bytes to hash.
+ * \param seed  The secret seed, usually made by hash_seed.
+ *
+ * \return  The hash of the bytes.
+ *
+ * \sa hash_seed, ptr_keyedhash, str_keyedhash
+ */
+hashval
+hash_sip(const void *mem, size_t len, const hashseed *seed)
+{
+	const unsigned char *p = mem;
+	unsigned long v0, v1, v2, v3, m;
+	size_t i, j;
+
+	assert(p != NULL || len == 0);
+	assert(seed != NULL);
+
+#if ULONG_MAX > 0xFFFFFFFFUL
+	v0 = seed->k[0] ^ 0x736F6D6570736575UL;
+	v1 = seed->k[1] ^ 0x646F72616E646F6DUL;
+	v2 = seed->k[0] ^ 0x6C7967656E657261UL;
+	v3 = seed->k[1] ^ 0x7465646279746573UL;
+#else
+	v0 = seed->k[0];
+	v1 = seed->k[1];
+	v2 = seed->k[0] ^ 0x6C796765UL;
+	v3 = seed->k[1] ^ 0x74656462UL;
+#endif
+
+	for (i = 0; i + HASH_WORD <= len; i += HASH_WORD) {
+		/* Words are read little-endian, whatever the machine */
+		for (m = 0, j = HASH_WORD; j > 0; --j)
+			m = (m << 8) | p[i + j - 1];
+		v3 ^= m;
+		SIPROUND(v0, v1, v2, v3);
+		v0 ^= m;
+	}
+
+	/* The last word holds the leftover bytes and the length */
+	m = (unsigned long)len << (HASH_WORD * 8 - 8);
+	for (j = len - i; j > 0; --j)
+		m |= (unsigned long)p[i + j - 1] << ((j - 1) * 8);
+	v3 ^= m;
+	SIPROUND(v0, v1, v2, v3);
+	v0 ^= m;
+
+	v2 ^= 0xFF;
+	SIPROUND(v0, v1, v2, v3);
+	SIPROUND(v0, v1, v2, v3);
+	SIPROUND(v0, v1, v2, v3);
+
+#if ULONG_MAX > 0xFFFFFFFFUL
+	return v0 ^ v1 ^ v2 ^ v3;
+#else
+	return v1 ^ v3;
+#endif
+}
+
+
+/**
+ * \brief Make a random seed for a keyed hashing function.
+ *
+ * The seed is read from \c /dev/urandom where that exists.  Otherwise it is
+ * made up of the time and some addresses, which is much easier to guess.
+ * Every call gives a different seed.
+ *
+ * \param seed  The seed to fill in.
+ *
+ * \return  \p seed.
+ *
+ * \sa hash_sip
+ */
+hashseed *
+hash_seed(hashseed *seed)
+{
+	static unsigned long calls = 0;
+#ifdef GUNE_THREADS
+	static pthread_mutex_t calls_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+	unsigned long n;
+	FILE *f;
+	int ok = 0;
+
+	assert(seed != NULL);
+
+	if ((f = fopen("/dev/urandom", "rb")) != NULL) {
+		ok = (fread(seed->k, sizeof(seed->k), 1, f) == 1);
+		fclose(f);
+	}
+
+	if (!ok) {
+		/* LINTED */
+		seed->k[0] = (unsigned long)time(NULL) ^ (unsigned long)seed;
+		seed->k[1] = (unsigned long)clock() ^ (unsigned long)&f;
+	}
+
+	/* Tables made at the same moment mustn't share a seed */
+#ifdef GUNE_THREADS
+	pthread_mutex_lock(&calls_lock);
+	n = ++calls;
+	pthread_mutex_unlock(&calls_lock);
+#else
+	n = ++calls;
+#endif
+	seed->k[0] = hash_mix(seed->k[0] ^ n);
+	seed->k[1] = hash_mix(seed->k[1] + hash_mix(n));
+
+	return seed;
+}
+
+
+/**
+ * \brief Calculate a keyed hash from a pointer.
+ *
+ * \param key   The pointer to hash.
+ * \param seed  The secret seed.
+ *
+ * \return  The keyed hash of the pointer's value.
+ *
+ * \sa ptr_eq, ptr_fullhash, hash_sip
+ */
+hashval
+ptr_keyedhash(gendata key, const hashseed *seed)
+{
+	return hash_sip(&key.ptr, sizeof(key.ptr), seed);
+}
+
+
+/**
+ * \brief Calculate a keyed hash from a signed integer.
+ *
+ * \param key   The number to hash.
+ * \param seed  The secret seed.
+ *
+ * \return  The keyed hash of the number.
+ *
+ * \sa num_eq, num_fullhash, hash_sip
+ */
+hashval
+num_keyedhash(gendata key, const hashseed *seed)
+{
+	return hash_sip(&key.num, sizeof(key.num), seed);
+}
+
+
+/**
+ * \brief Calculate a keyed hash from an unsigned integer.
+ *
+ * \param key   The number to hash.
+ * \param seed  The secret seed.
+ *
+ * \return  The keyed hash of the number.
+ *
+ * \sa posnum_eq, posnum_fullhash, hash_sip
+ */
+hashval
+posnum_keyedhash(gendata key, const hashseed *seed)
+{
+	return hash_sip(&key.posnum, sizeof(key.posnum), seed);
+}
+
+
+/**
+ * \brief Calculate a keyed hash from a character (symbol).
+ *
+ * \param key   The character to hash.
+ * \param seed  The secret seed.
+ *
+ * \return  The keyed hash of the character.
+ *
+ * \sa sym_eq, sym_fullhash, hash_sip
+ */
+hashval
+sym_keyedhash(gendata key, const hashseed *seed)
+{
+	return hash_sip(&key.sym, sizeof(key.sym), seed);
 }
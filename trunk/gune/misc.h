@@ -38,6 +38,7 @@
 #ifndef GUNE_MISC_H
 #define GUNE_MISC_H
 
+#include <stddef.h>
 #include <gune/types.h>
 
 /**
@@ -85,10 +86,25 @@ int ptr_eq(gendata, gendata);
 int num_eq(gendata, gendata);
 int posnum_eq(gendata, gendata);
 int sym_eq(gendata, gendata);
+int num_cmp(gendata, gendata);
+int posnum_cmp(gendata, gendata);
+int sym_cmp(gendata, gendata);
 unsigned int ptr_hash(gendata, unsigned int);
 unsigned int num_hash(gendata, unsigned int);
 unsigned int posnum_hash(gendata, unsigned int);
 unsigned int sym_hash(gendata, unsigned int);
+hashval ptr_fullhash(gendata);
+hashval num_fullhash(gendata);
+hashval posnum_fullhash(gendata);
+hashval sym_fullhash(gendata);
+hashval hash_mix(hashval);
+unsigned int hash_reduce(hashval, unsigned int);
+hashval hash_sip(const void *, size_t, const hashseed *);
+hashseed *hash_seed(hashseed *);
+hashval ptr_keyedhash(gendata, const hashseed *);
+hashval num_keyedhash(gendata, const hashseed *);
+hashval posnum_keyedhash(gendata, const hashseed *);
+hashval sym_keyedhash(gendata, const hashseed *);
 
 extern void * const CONST_PTR;
 
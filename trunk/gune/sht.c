@@ -0,0 +1,644 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief SIMD hash tables implementation.
+ *
+ * \file sht.c
+ * These hash tables use open addressing, with the slots organised in groups.
+ * Next to the slots there is an array of control bytes, one per slot, which
+ * holds a 7-bit tag taken from the key's hash, or a marker for an empty or
+ * deleted slot.  A lookup compares the tags of a whole group at once (with
+ * SSE2 if the compiler supports it), and only calls the equals predicate on
+ * slots with a matching tag.  This means almost all misses are resolved
+ * without calling it at all, which makes these tables a good choice for
+ * keys which are expensive to compare, like long strings.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <gune/misc.h>
+#include <gune/sht.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/** Control byte of an empty slot */
+#define SHT_EMPTY	0x80
+
+/** Control byte of a deleted slot */
+#define SHT_DELETED	0xFE
+
+/** The tag of a hash value, as stored in the control byte of a full slot */
+#define SHT_TAG(h)	((unsigned char)((h) & 0x7F))
+
+/** The start group of a hash value in a table with ngroups groups */
+#define SHT_GROUP(h, ngroups)	(((h) >> 7) & ((ngroups) - 1))
+
+/*
+ * Maximum load factor, as numerator and denominator.  Tables are grown
+ * when used slots (both full and deleted) exceed this fraction.
+ */
+#define SHT_MAX_LOAD_NUM	7
+#define SHT_MAX_LOAD_DEN	8
+
+static unsigned int sht_hash(sht, gendata);
+static unsigned int sht_first_bit(unsigned int);
+static unsigned int sht_match(const unsigned char *, unsigned char);
+static unsigned int sht_match_empty(const unsigned char *);
+static unsigned int sht_match_free(const unsigned char *);
+static unsigned int sht_find_free(const unsigned char *, unsigned int,
+				  unsigned int);
+static sht_slot sht_find(sht, gendata, unsigned int, eq_func);
+static unsigned int sht_groups_for(unsigned int);
+static sht sht_rehash(sht, unsigned int);
+static sht sht_insert_internal(sht, gendata, gendata, eq_func,
+			       free_func, free_func, int);
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*
+ * Hash a key.  The hashing function gets the widest range possible, and
+ * the result is scrambled because we take both the tag and the group from
+ * it.  Even a simple hash like num_hash will then give useful tags.
+ */
+static unsigned int
+sht_hash(sht t, gendata key)
+{
+	assert(t->hash != NULL);
+
+	return (unsigned int)hash_mix(t->hash(key, UINT_MAX));
+}
+
+
+/*
+ * Return the index of the lowest set bit of a nonzero mask.
+ */
+static unsigned int
+sht_first_bit(unsigned int mask)
+{
+#ifdef __GNUC__
+	return (unsigned int)__builtin_ctz(mask);
+#else
+	unsigned int i;
+
+	for (i = 0; (mask & 1) == 0; mask >>= 1, ++i)
+		;
+
+	return i;
+#endif
+}
+
+
+#ifdef __SSE2__
+
+/*
+ * Return a bit mask with a bit set for every control byte in the group
+ * which equals tag.
+ */
+static unsigned int
+sht_match(const unsigned char *ctrl, unsigned char tag)
+{
+	__m128i group;
+
+	group = _mm_loadu_si128((const __m128i *)(const void *)ctrl);
+	return (unsigned int)_mm_movemask_epi8(
+		_mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+}
+
+
+/*
+ * Return a bit mask with a bit set for every slot in the group which is
+ * empty or deleted.  Those are exactly the control bytes with the high bit
+ * set, which is what movemask extracts.
+ */
+static unsigned int
+sht_match_free(const unsigned char *ctrl)
+{
+	__m128i group;
+
+	group = _mm_loadu_si128((const __m128i *)(const void *)ctrl);
+	return (unsigned int)_mm_movemask_epi8(group);
+}
+
+#else /* !__SSE2__ */
+
+static unsigned int
+sht_match(const unsigned char *ctrl, unsigned char tag)
+{
+	unsigned int i, match = 0;
+
+	for (i = 0; i < SHT_GROUP_SIZE; ++i)
+		if (ctrl[i] == tag)
+			match |= 1U << i;
+
+	return match;
+}
+
+
+static unsigned int
+sht_match_free(const unsigned char *ctrl)
+{
+	unsigned int i, match = 0;
+
+	for (i = 0; i < SHT_GROUP_SIZE; ++i)
+		if (ctrl[i] & 0x80)
+			match |= 1U << i;
+
+	return match;
+}
+
+#endif /* __SSE2__ */
+
+
+/*
+ * Return a bit mask with a bit set for every empty slot in the group.
+ */
+static unsigned int
+sht_match_empty(const unsigned char *ctrl)
+{
+	return sht_match(ctrl, SHT_EMPTY);
+}
+
+
+/*
+ * Find the first free (empty or deleted) slot in the probe sequence of
+ * hash value h.  There must be one.
+ *
+ * The probe sequence visits the groups at triangular number offsets from
+ * the start group, which visits every group exactly once since the number
+ * of groups is a power of two.
+ */
+static unsigned int
+sht_find_free(const unsigned char *ctrl, unsigned int ngroups, unsigned int h)
+{
+	unsigned int g, i, match;
+
+	g = SHT_GROUP(h, ngroups);
+	for (i = 1; ; ++i) {
+		match = sht_match_free(ctrl + g * SHT_GROUP_SIZE);
+		if (match != 0)
+			return g * SHT_GROUP_SIZE + sht_first_bit(match);
+		g = (g + i) & (ngroups - 1);
+	}
+}
+
+
+/*
+ * Find the slot containing key, which has hash value h.
+ * Returns NULL if the key is not in the table.
+ */
+static sht_slot
+sht_find(sht t, gendata key, unsigned int h, eq_func eq)
+{
+	unsigned int g, i, match;
+	const unsigned char *ctrl;
+	sht_slot group;
+
+	g = SHT_GROUP(h, t->ngroups);
+	for (i = 1; i <= t->ngroups; ++i) {
+		ctrl = t->ctrl + g * SHT_GROUP_SIZE;
+		group = t->slots + g * SHT_GROUP_SIZE;
+
+		for (match = sht_match(ctrl, SHT_TAG(h)); match != 0;
+		     match &= match - 1)
+			if (eq(key, group[sht_first_bit(match)].key))
+				return group + sht_first_bit(match);
+
+		/*
+		 * If the group has an empty slot, the key would have been
+		 * put there instead of further down the probe sequence.
+		 */
+		if (sht_match_empty(ctrl) != 0)
+			return NULL;
+
+		g = (g + i) & (t->ngroups - 1);
+	}
+
+	return NULL;
+}
+
+
+/*
+ * Calculate the number of groups needed to hold count elements, leaving
+ * room to grow to about twice that before hitting the maximum load.
+ */
+static unsigned int
+sht_groups_for(unsigned int count)
+{
+	unsigned long ngroups = 1;
+
+	while (ngroups * SHT_GROUP_SIZE * SHT_MAX_LOAD_NUM <
+	       (unsigned long)count * 2 * SHT_MAX_LOAD_DEN)
+		ngroups *= 2;
+
+	return (unsigned int)ngroups;
+}
+
+
+/*
+ * Move all elements into a new array of slots of ngroups groups.
+ * This also cleans up all deleted markers.  Returns NULL if out of memory,
+ * in which case the table is left untouched.
+ */
+static sht
+sht_rehash(sht t, unsigned int ngroups)
+{
+	unsigned int i, pos, nslots;
+	unsigned char *ctrl;
+	sht_slot slots;
+	unsigned int h;
+
+	nslots = ngroups * SHT_GROUP_SIZE;
+
+	if ((ctrl = malloc(nslots)) == NULL)
+		return NULL;
+
+	if ((slots = malloc(nslots * sizeof(sht_slot_t))) == NULL) {
+		free(ctrl);
+		return NULL;
+	}
+
+	for (i = 0; i < nslots; ++i)
+		ctrl[i] = SHT_EMPTY;
+
+	for (i = 0; i < t->ngroups * SHT_GROUP_SIZE; ++i) {
+		if (t->ctrl[i] & 0x80)
+			continue;
+
+		h = sht_hash(t, t->slots[i].key);
+		pos = sht_find_free(ctrl, ngroups, h);
+		ctrl[pos] = SHT_TAG(h);
+		slots[pos] = t->slots[i];
+	}
+
+	free(t->ctrl);
+	free(t->slots);
+	t->ctrl = ctrl;
+	t->slots = slots;
+	t->ngroups = ngroups;
+	t->deleted = 0;
+
+	return t;
+}
+
+
+/**
+ * \brief Create a new empty SIMD hash table.
+ *
+ * \param range  The number of elements to make room for initially.  The
+ *		  table grows automatically when needed.
+ * \param hash   The hashing function to use on keys.  It is always called
+ *		  with a range of \c UINT_MAX, since the table needs as many
+ *		  bits of hash as it can get.
+ *
+ * \return  A new empty SIMD hash table object, or \c NULL if an error
+ *	     occurred.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa sht_destroy
+ */
+sht
+sht_create(unsigned int range, hash_func hash)
+{
+	sht_t *t;
+
+	assert(hash != NULL);
+
+	if ((t = malloc(sizeof(sht_t))) == NULL)
+		return NULL;
+
+	t->hash = hash;
+	t->count = 0;
+	t->ngroups = 0;
+	t->ctrl = NULL;
+	t->slots = NULL;
+
+	if (sht_rehash(t, sht_groups_for(range / 2)) == NULL) {
+		free(t);
+		return NULL;
+	}
+
+	return (sht)t;
+}
+
+
+/**
+ * \brief Free all memory allocated for a SIMD hash table.
+ *
+ * The data within the table is freed by calling a user-supplied free function.
+ *
+ * \param t           The SIMD hash table to destroy.
+ * \param free_key    The function which is used to free the key data, or
+ *			\c NULL if no action should be taken on the key data.
+ * \param free_value  The function which is used to free the value data, or
+ *			\c NULL if no action should be taken on the value data.
+ *
+ * \sa sht_create
+ */
+void
+sht_destroy(sht t, free_func free_key, free_func free_value)
+{
+	unsigned int i;
+
+	assert(t != NULL);
+
+	for (i = 0; i < t->ngroups * SHT_GROUP_SIZE; ++i) {
+		if (t->ctrl[i] & 0x80)
+			continue;
+		if (free_key != NULL)
+			free_key(t->slots[i].key.ptr);
+		if (free_value != NULL)
+			free_value(t->slots[i].value.ptr);
+	}
+
+	free(t->ctrl);
+	free(t->slots);
+	free(t);
+}
+
+
+/*
+ * Internal function which sht_insert and sht_insert_uniq call.
+ * Argument list is the same as these two functions, except for an extra
+ * integer tacked onto the end.  This integer is nonzero if existing
+ * key entries are not allowed.  If existing key entries are allowed, the
+ * value of that key is overwritten.
+ */
+static sht
+sht_insert_internal(sht t, gendata key, gendata value, eq_func eq,
+		    free_func free_key, free_func free_value, int uniq)
+{
+	unsigned int h, pos;
+	sht_slot s;
+
+	assert(t != NULL);
+	assert(eq != NULL);
+
+	h = sht_hash(t, key);
+
+	if ((s = sht_find(t, key, h, eq)) != NULL) {
+		/* Duplicates not allowed? */
+		if (uniq) {
+			errno = EINVAL;
+			return NULL;
+		}
+
+		/* Free old data */
+		if (free_key != NULL)
+			free_key(s->key.ptr);
+		if (free_value != NULL)
+			free_value(s->value.ptr);
+		s->key = key;
+		s->value = value;
+		return t;
+	}
+
+	/*
+	 * Deleted markers count as used, since they make probe sequences
+	 * longer.  If there are many of them, the rehash will clean them up
+	 * without growing the table.
+	 */
+	if ((unsigned long)(t->count + t->deleted + 1) * SHT_MAX_LOAD_DEN >
+	    (unsigned long)t->ngroups * SHT_GROUP_SIZE * SHT_MAX_LOAD_NUM) {
+		if (sht_rehash(t, sht_groups_for(t->count + 1)) == NULL)
+			return NULL;
+	}
+
+	pos = sht_find_free(t->ctrl, t->ngroups, h);
+	if (t->ctrl[pos] == SHT_DELETED)
+		--t->deleted;
+
+	t->ctrl[pos] = SHT_TAG(h);
+	t->slots[pos].key = key;
+	t->slots[pos].value = value;
+	++t->count;
+
+	return t;
+}
+
+
+/**
+ * \brief Add a (key, value) pair to a SIMD hash table (with replace)
+ *
+ * Add a data element to the table with the given key or replace an
+ *  existing element with the same key.
+ *
+ * \param t           The SIMD hash table to insert the data in.
+ * \param key         The key of the data.
+ * \param value       The data to insert.
+ * \param eq          The equals predicate for two keys.
+ * \param free_key    The function used to free the old key's data if it
+ *		       needs to be replaced, or \c NULL if the data does not
+ *		       need to be freed.
+ * \param free_value  The function used to free the old value's data if it
+ *		       needs to be replaced, or \c NULL if the data does not
+ *		       need to be freed.
+ *
+ * \return  The original table, or \c NULL if the data could not be
+ *           inserted.  Original table is still valid in case of error.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa sht_insert_uniq, sht_delete
+ */
+sht
+sht_insert(sht t, gendata key, gendata value, eq_func eq,
+	   free_func free_key, free_func free_value)
+{
+	return sht_insert_internal(t, key, value, eq, free_key, free_value, 0);
+}
+
+
+/**
+ * \brief Add a (key, value) pair to a SIMD hash table (no replace)
+ *
+ * Add a data element to the table with the given key.  If there already
+ * is an element with the same key in the table, it is regarded as an error.
+ *
+ * \param t           The SIMD hash table to insert the data in.
+ * \param key         The key of the data.
+ * \param value       The data to insert.
+ * \param eq          The equals predicate for two keys.
+ *
+ * \return  The original table, or \c NULL if the data could not be
+ *           inserted.  Original table is still valid in case of error.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key is already in the table.
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa sht_insert, sht_delete
+ */
+sht
+sht_insert_uniq(sht t, gendata key, gendata value, eq_func eq)
+{
+	return sht_insert_internal(t, key, value, eq, NULL, NULL, 1);
+}
+
+
+/**
+ * \brief Look up an element in a SIMD hash table.
+ *
+ * \param t     The SIMD hash table which contains the element.
+ * \param key   The key to the element.
+ * \param eq    The equals predicate for two keys.
+ * \param data  A pointer to the location where the element is stored, if
+ *               it was found.
+ *
+ * \return  The table, or \c NULL if the key could not be found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ */
+sht
+sht_lookup(sht t, gendata key, eq_func eq, gendata *data)
+{
+	sht_slot s;
+
+	assert(t != NULL);
+	assert(eq != NULL);
+
+	if ((s = sht_find(t, key, sht_hash(t, key), eq)) == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	*data = s->value;
+	return t;
+}
+
+
+/**
+ * \brief Delete an element from a SIMD hash table.
+ *
+ * \param t           The SIMD hash table which contains the element.
+ * \param key         The key to the element to delete.
+ * \param eq          The equals predicate for two keys.
+ * \param free_key    The function which is used to free the key data, or
+ *			\c NULL if no action should be taken on the key data.
+ * \param free_value  The function which is used to free the value data, or
+ *			\c NULL if no action should be taken on the value data.
+ *
+ * \return  The table, or \c NULL if the key could not be found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ *
+ * \sa sht_insert
+ */
+sht
+sht_delete(sht t, gendata key, eq_func eq, free_func free_key,
+	   free_func free_value)
+{
+	unsigned int pos;
+	sht_slot s;
+
+	assert(t != NULL);
+	assert(eq != NULL);
+
+	if ((s = sht_find(t, key, sht_hash(t, key), eq)) == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (free_key != NULL)
+		free_key(s->key.ptr);
+	if (free_value != NULL)
+		free_value(s->value.ptr);
+
+	/*
+	 * If the group still has an empty slot, no probe sequence ever went
+	 * past it, so we can mark the slot empty.  Otherwise, other keys may
+	 * be further down the sequence and we need to leave a marker.
+	 */
+	pos = (unsigned int)(s - t->slots);
+	if (sht_match_empty(t->ctrl + pos - pos % SHT_GROUP_SIZE) != 0) {
+		t->ctrl[pos] = SHT_EMPTY;
+	} else {
+		t->ctrl[pos] = SHT_DELETED;
+		++t->deleted;
+	}
+	--t->count;
+
+	return t;
+}
+
+
+/**
+ * \brief Return whether or not a SIMD hash table is empty.
+ *
+ * \param t  The SIMD hash table to check.
+ *
+ * \return  Non-zero if the table is empty, 0 if it is not.
+ */
+int
+sht_empty(sht t)
+{
+	assert(t != NULL);
+
+	return t->count == 0;
+}
+
+
+/**
+ * \brief Walk through all elements of a SIMD hash table.
+ *
+ * Walk a SIMD hash table, using a user-specified function on the table's
+ * pairs.
+ *
+ * \attention
+ * While using this function, it is not allowed to insert new entries or
+ * remove entries other than the current entry.  It is allowed to change the
+ * contents of the key and value, as long as the key's hash will not be
+ * affected.
+ *
+ * \param t     The SIMD hash table to walk
+ * \param walk  The function which will process the hash pairs
+ * \param data  Any data to pass to the function every time it is called.
+ */
+void
+sht_walk(sht t, assoc_func walk, gendata data)
+{
+	unsigned int i;
+
+	assert(t != NULL);
+	assert(walk != NULL);
+
+	for (i = 0; i < t->ngroups * SHT_GROUP_SIZE; ++i)
+		if (!(t->ctrl[i] & 0x80))
+			walk(&t->slots[i].key, &t->slots[i].value, data);
+}
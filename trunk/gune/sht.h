@@ -0,0 +1,79 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief SIMD hash tables interface.
+ *
+ * \file sht.h
+ */
+#ifndef GUNE_SHT_H
+#define GUNE_SHT_H
+
+#include <gune/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief The number of slots whose tags are compared at once */
+#define SHT_GROUP_SIZE	16
+
+/** \brief SIMD hash table slot */
+typedef struct sht_slot_t {
+	gendata key;		/**< Key, used for identification of entries */
+	gendata value;		/**< The entry itself */
+} sht_slot_t, *sht_slot;
+
+/** \brief SIMD hash table implementation */
+typedef struct sht_t {
+	unsigned char *ctrl;	/**< Per slot: a 7-bit tag of the key's hash,
+				     or an empty or deleted marker */
+	sht_slot slots;		/**< The slots, in groups of SHT_GROUP_SIZE */
+	unsigned int ngroups;	/**< The number of groups (a power of two) */
+	unsigned int count;	/**< The number of elements in the table */
+	unsigned int deleted;	/**< The number of deleted markers */
+	hash_func hash;		/**< The hashing function to use */
+} sht_t, *sht;
+
+sht sht_create(unsigned int, hash_func);
+void sht_destroy(sht, free_func, free_func);
+sht sht_insert(sht, gendata, gendata, eq_func, free_func, free_func);
+sht sht_insert_uniq(sht, gendata, gendata, eq_func);
+sht sht_lookup(sht, gendata, eq_func, gendata *);
+sht sht_delete(sht, gendata, eq_func, free_func, free_func);
+int sht_empty(sht);
+void sht_walk(sht, assoc_func, gendata);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GUNE_SHT_H */
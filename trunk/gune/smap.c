@@ -0,0 +1,714 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief Sorted maps implementation.
+ *
+ * \file smap.c
+ * A sorted map keeps its keys in a sorted array, and their values in
+ * another array in the same order.  This takes about half the memory of a
+ * hash table, lookups are binary searches and walking the map visits the
+ * keys in order, reading memory sequentially.  It suits maps which are
+ * read much more often than they are changed.
+ *
+ * Inserting into the middle of a sorted array means moving everything
+ * after it.  So, keys which are inserted one at a time go to a second,
+ * small sorted array first.  When that holds a few times the square root
+ * of the number of keys in the big one, it is merged into it in one pass.
+ * A lookup searches both arrays.  Inserting many keys at once sorts them and
+ * merges them in directly.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gune/misc.h>
+#include <gune/smap.h>
+
+/** Compile-time option of the fewest new keys which are merged at once */
+#define SMAP_NEW_MIN		32
+
+/**
+ * Compile-time option of how many times the square root of the number of
+ * keys are merged at once.  Merging less often costs longer moves within
+ * the new keys, but those are much cheaper than merging.
+ */
+#define SMAP_NEW_FACTOR		4
+
+/** Compile-time option of the length of the runs insertion sort makes */
+#define SMAP_SORT_RUN		16
+
+static unsigned int smap_lower_bound(cmp_func, const gendata *, unsigned int,
+				     gendata);
+static int smap_find(smap, gendata, array *, array *, unsigned int *);
+static void smap_merge_runs(const gendata *, const gendata *, unsigned int,
+			    const gendata *, const gendata *, unsigned int,
+			    gendata *, gendata *, cmp_func);
+static void smap_sort(gendata *, gendata *, gendata *, gendata *,
+		      unsigned int, cmp_func);
+static unsigned int smap_uniq(gendata *, gendata *, unsigned int, cmp_func,
+			      free_func, free_func);
+static smap smap_merge(smap, const gendata *, const gendata *, unsigned int,
+		       free_func, free_func);
+static smap smap_flush(smap);
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/**
+ * \brief Create a new empty sorted map.
+ *
+ * \param cmp  The function which orders the keys.
+ *
+ * \return  A new empty sorted map, or \c NULL if out of memory.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa smap_destroy
+ */
+smap
+smap_create(cmp_func cmp)
+{
+	smap_t *m;
+
+	assert(cmp != NULL);
+
+	if ((m = malloc(sizeof(smap_t))) == NULL)
+		return NULL;
+
+	m->keys = array_create();
+	m->values = array_create();
+	m->new_keys = array_create();
+	m->new_values = array_create();
+	if (m->keys == NULL || m->values == NULL || m->new_keys == NULL ||
+	    m->new_values == NULL) {
+		if (m->keys != NULL)
+			array_destroy(m->keys, NULL);
+		if (m->values != NULL)
+			array_destroy(m->values, NULL);
+		if (m->new_keys != NULL)
+			array_destroy(m->new_keys, NULL);
+		if (m->new_values != NULL)
+			array_destroy(m->new_values, NULL);
+		free(m);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	m->new_max = SMAP_NEW_MIN;
+	m->cmp = cmp;
+
+	return (smap)m;
+}
+
+
+/**
+ * \brief Free all memory allocated for a sorted map.
+ *
+ * \param m           The sorted map to destroy.
+ * \param free_key    The function which is used to free the key data, or
+ *			\c NULL if no action should be taken on the key data.
+ * \param free_value  The function which is used to free the value data, or
+ *			\c NULL if no action should be taken on the value data.
+ *
+ * \sa smap_create
+ */
+void
+smap_destroy(smap m, free_func free_key, free_func free_value)
+{
+	assert(m != NULL);
+
+	array_destroy(m->keys, free_key);
+	array_destroy(m->values, free_value);
+	array_destroy(m->new_keys, free_key);
+	array_destroy(m->new_values, free_value);
+	free(m);
+}
+
+
+/*
+ * Find the position of the first of n sorted keys which is not less than
+ * key.  The search halves the range without branching on the result of
+ * the comparisons, which the processor could not predict anyway.  Numbers
+ * ordered by num_cmp or posnum_cmp are compared without calling it.
+ */
+static unsigned int
+smap_lower_bound(cmp_func cmp, const gendata *keys, unsigned int n,
+		 gendata key)
+{
+	const gendata *base = keys;
+	unsigned int half;
+
+	if (n == 0)
+		return 0;
+
+	if (cmp == num_cmp) {
+		while (n > 1) {
+			half = n / 2;
+#ifdef __GNUC__
+			/* Fetch both places the next step may look at */
+			__builtin_prefetch(base + half / 2);
+			__builtin_prefetch(base + half + half / 2);
+#endif
+			base = (base[half].num < key.num) ? base + half : base;
+			n -= half;
+		}
+		return (unsigned int)(base - keys) + (base->num < key.num);
+	} else if (cmp == posnum_cmp) {
+		while (n > 1) {
+			half = n / 2;
+#ifdef __GNUC__
+			__builtin_prefetch(base + half / 2);
+			__builtin_prefetch(base + half + half / 2);
+#endif
+			base = (base[half].posnum < key.posnum) ? base + half :
+				base;
+			n -= half;
+		}
+		return (unsigned int)(base - keys) +
+			(base->posnum < key.posnum);
+	}
+
+	while (n > 1) {
+		half = n / 2;
+		base = (cmp(base[half], key) < 0) ? base + half : base;
+		n -= half;
+	}
+
+	return (unsigned int)(base - keys) + (cmp(*base, key) < 0);
+}
+
+
+/*
+ * Find a key in either array of a sorted map.  Returns nonzero if it was
+ * found, and sets *keys and *values to the arrays and *pos to its position
+ * in them.  Otherwise, *pos is where it belongs in new_keys.
+ */
+static int
+smap_find(smap m, gendata key, array *keys, array *values, unsigned int *pos)
+{
+	unsigned int i;
+
+	i = smap_lower_bound(m->cmp, m->keys->data, m->keys->size, key);
+	if (i < m->keys->size && m->cmp(m->keys->data[i], key) == 0) {
+		*keys = m->keys;
+		*values = m->values;
+		*pos = i;
+		return 1;
+	}
+
+	*keys = m->new_keys;
+	*values = m->new_values;
+	*pos = smap_lower_bound(m->cmp, m->new_keys->data, m->new_keys->size,
+				key);
+
+	return *pos < m->new_keys->size &&
+		m->cmp(m->new_keys->data[*pos], key) == 0;
+}
+
+
+/*
+ * Merge two sorted runs of keys a and b, with their values, into out.
+ * Of equal keys, those of a come first.
+ */
+static void
+smap_merge_runs(const gendata *ak, const gendata *av, unsigned int an,
+		const gendata *bk, const gendata *bv, unsigned int bn,
+		gendata *outk, gendata *outv, cmp_func cmp)
+{
+	unsigned int i = 0, j = 0, w = 0;
+
+	while (i < an && j < bn) {
+		if (cmp(bk[j], ak[i]) < 0) {
+			outk[w] = bk[j];
+			outv[w++] = bv[j++];
+		} else {
+			outk[w] = ak[i];
+			outv[w++] = av[i++];
+		}
+	}
+
+	memcpy(outk + w, ak + i, (an - i) * sizeof(gendata));
+	memcpy(outv + w, av + i, (an - i) * sizeof(gendata));
+	w += an - i;
+	memcpy(outk + w, bk + j, (bn - j) * sizeof(gendata));
+	memcpy(outv + w, bv + j, (bn - j) * sizeof(gendata));
+}
+
+
+/*
+ * Sort n keys and their values with a stable merge sort, using tmpk and
+ * tmpv as room for n more of each.  Short runs are made with insertion
+ * sort, and then merged bottom-up.
+ */
+static void
+smap_sort(gendata *keys, gendata *values, gendata *tmpk, gendata *tmpv,
+	  unsigned int n, cmp_func cmp)
+{
+	gendata *srck = keys, *srcv = values, *dstk = tmpk, *dstv = tmpv;
+	unsigned int i, j, lo, mid, hi, width;
+	gendata k, v;
+
+	for (lo = 0; lo < n; lo = hi) {
+		hi = (n - lo > SMAP_SORT_RUN) ? lo + SMAP_SORT_RUN : n;
+		for (i = lo + 1; i < hi; ++i) {
+			k = keys[i];
+			v = values[i];
+			for (j = i; j > lo && cmp(k, keys[j - 1]) < 0; --j) {
+				keys[j] = keys[j - 1];
+				values[j] = values[j - 1];
+			}
+			keys[j] = k;
+			values[j] = v;
+		}
+	}
+
+	for (width = SMAP_SORT_RUN; width < n; width *= 2) {
+		for (lo = 0; lo < n; lo = hi) {
+			mid = (n - lo > width) ? lo + width : n;
+			hi = (n - mid > width) ? mid + width : n;
+			smap_merge_runs(srck + lo, srcv + lo, mid - lo,
+					srck + mid, srcv + mid, hi - mid,
+					dstk + lo, dstv + lo, cmp);
+		}
+		SWAP(gendata *, srck, dstk);
+		SWAP(gendata *, srcv, dstv);
+
+		/* The next width would not fit */
+		if (width > UINT_MAX / 2)
+			break;
+	}
+
+	if (srck != keys) {
+		memcpy(keys, srck, n * sizeof(gendata));
+		memcpy(values, srcv, n * sizeof(gendata));
+	}
+}
+
+
+/*
+ * Remove all but the last of every run of equal keys from n sorted keys
+ * and their values, freeing the ones which are removed.  Returns the number
+ * of keys left.
+ */
+static unsigned int
+smap_uniq(gendata *keys, gendata *values, unsigned int n, cmp_func cmp,
+	  free_func free_key, free_func free_value)
+{
+	unsigned int i, w = 0;
+
+	for (i = 0; i < n; ++i) {
+		if (i + 1 < n && cmp(keys[i], keys[i + 1]) == 0) {
+			if (free_key != NULL)
+				free_key(keys[i].ptr);
+			if (free_value != NULL)
+				free_value(values[i].ptr);
+			continue;
+		}
+		keys[w] = keys[i];
+		values[w++] = values[i];
+	}
+
+	return w;
+}
+
+
+/*
+ * Merge n sorted, distinct keys and their values into the big array of a
+ * sorted map.  They replace the keys which are equal to them, and those
+ * are freed.  The merge starts at the end, so it can write its result into
+ * the array itself.  Afterwards, a few times the square root of the number
+ * of keys may be added one at a time before the next merge.
+ */
+static smap
+smap_merge(smap m, const gendata *keys, const gendata *values,
+	   unsigned int n, free_func free_key, free_func free_value)
+{
+	gendata *k, *v;
+	unsigned int i, j, w, r, size;
+	int c;
+
+	size = m->keys->size;
+	if (n > UINT_MAX - size) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	if (array_resize(m->keys, size + n) == NULL)
+		return NULL;
+	if (array_resize(m->values, size + n) == NULL) {
+		array_resize(m->keys, size);
+		return NULL;
+	}
+
+	k = m->keys->data;
+	v = m->values->data;
+	i = size;
+	j = n;
+	w = size + n;
+
+	/* While j > 0, w > i, so no key is overwritten before it is read */
+	while (j > 0) {
+		c = (i > 0) ? m->cmp(k[i - 1], keys[j - 1]) : -1;
+		if (c > 0) {
+			--i;
+			k[--w] = k[i];
+			v[w] = v[i];
+			continue;
+		}
+		if (c == 0) {
+			--i;
+			if (free_key != NULL)
+				free_key(k[i].ptr);
+			if (free_value != NULL)
+				free_value(v[i].ptr);
+		}
+		--j;
+		k[--w] = keys[j];
+		v[w] = values[j];
+	}
+
+	/* Close the gap the replaced keys left */
+	if (w > i) {
+		memmove(k + i, k + w, (size + n - w) * sizeof(gendata));
+		memmove(v + i, v + w, (size + n - w) * sizeof(gendata));
+		array_resize(m->keys, size + n - (w - i));
+		array_resize(m->values, size + n - (w - i));
+	}
+
+	for (r = 1; r <= m->keys->size / r; ++r)
+		;
+	m->new_max = MAX((r - 1) * SMAP_NEW_FACTOR, SMAP_NEW_MIN);
+
+	return m;
+}
+
+
+/*
+ * Merge the new keys of a sorted map into the big array.
+ */
+static smap
+smap_flush(smap m)
+{
+	if (smap_merge(m, m->new_keys->data, m->new_values->data,
+		       m->new_keys->size, NULL, NULL) == NULL)
+		return NULL;
+
+	array_resize(m->new_keys, 0);
+	array_resize(m->new_values, 0);
+
+	return m;
+}
+
+
+/**
+ * \brief Add a (key, value) pair to a sorted map (with replace)
+ *
+ * Add a data element to the sorted map with the given key or replace an
+ *  existing element with the same key.
+ *
+ * This takes O(sqrt(n)) time on the average: it moves at most the new
+ * keys which are kept apart, and every now and then they are merged into
+ * the others.
+ *
+ * \param m           The sorted map to insert the data in.
+ * \param key         The key of the data.
+ * \param value       The data to insert.
+ * \param free_key    The function used to free the old key's data if it
+ *		       needs to be replaced, or \c NULL if the data does not
+ *		       need to be freed.
+ * \param free_value  The function used to free the old value's data if it
+ *		       needs to be replaced, or \c NULL if the data does not
+ *		       need to be freed.
+ *
+ * \return  The original sorted map, or \c NULL if the data could not be
+ *           inserted.  Original sorted map is still valid in case of error.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa smap_insert_many, smap_delete
+ */
+smap
+smap_insert(smap m, gendata key, gendata value, free_func free_key,
+	    free_func free_value)
+{
+	array keys, values;
+	unsigned int pos, n;
+
+	assert(m != NULL);
+
+	if (smap_find(m, key, &keys, &values, &pos)) {
+		if (free_key != NULL)
+			free_key(keys->data[pos].ptr);
+		if (free_value != NULL)
+			free_value(values->data[pos].ptr);
+		keys->data[pos] = key;
+		values->data[pos] = value;
+		return m;
+	}
+
+	if (keys->size >= m->new_max) {
+		if (smap_flush(m) == NULL)
+			return NULL;
+		pos = 0;
+	}
+
+	n = keys->size;
+	if (array_resize(keys, n + 1) == NULL)
+		return NULL;
+	if (array_resize(values, n + 1) == NULL) {
+		array_resize(keys, n);
+		return NULL;
+	}
+
+	memmove(keys->data + pos + 1, keys->data + pos,
+		(n - pos) * sizeof(gendata));
+	memmove(values->data + pos + 1, values->data + pos,
+		(n - pos) * sizeof(gendata));
+	keys->data[pos] = key;
+	values->data[pos] = value;
+
+	return m;
+}
+
+
+/**
+ * \brief Add many (key, value) pairs to a sorted map at once (with replace)
+ *
+ * This has the same effect as calling smap_insert on each of the pairs in
+ * turn, so of equal keys the last one is kept.  The pairs are sorted and
+ * then merged with the map in one pass, which takes O(k log k + n) time
+ * for k pairs and a map of n elements.  Use it on an empty map to build a
+ * map from unsorted data.
+ *
+ * \param m           The sorted map to insert the data in.
+ * \param keys        The keys of the data.
+ * \param values      The data to insert, one for each key.
+ * \param n           The number of keys.
+ * \param free_key    The function used to free the old key's data if it
+ *		       needs to be replaced, or \c NULL if the data does not
+ *		       need to be freed.
+ * \param free_value  The function used to free the old value's data if it
+ *		       needs to be replaced, or \c NULL if the data does not
+ *		       need to be freed.
+ *
+ * \return  The original sorted map, or \c NULL if the data could not be
+ *           inserted.  Original sorted map is still valid in case of error.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa smap_insert
+ */
+smap
+smap_insert_many(smap m, const gendata *keys, const gendata *values,
+		 unsigned int n, free_func free_key, free_func free_value)
+{
+	gendata *mem, *k, *v;
+	unsigned int size;
+	size_t bytes;
+
+	assert(m != NULL);
+	assert((keys != NULL && values != NULL) || n == 0);
+
+	if (n == 0)
+		return m;
+
+	/* Room for a copy of the pairs, and for sorting that */
+	bytes = (size_t)n * 4 * sizeof(gendata);
+	if (bytes / (4 * sizeof(gendata)) != n ||
+	    (mem = malloc(bytes)) == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	k = mem;
+	v = mem + n;
+	memcpy(k, keys, n * sizeof(gendata));
+	memcpy(v, values, n * sizeof(gendata));
+
+	/*
+	 * Keys which were inserted one at a time go along too.  Make room
+	 * for all keys before freeing any duplicates, so the merge can't fail.
+	 */
+	size = m->keys->size + m->new_keys->size;
+	if (smap_flush(m) == NULL || n > UINT_MAX - size ||
+	    array_reserve(m->keys, size + n) == NULL ||
+	    array_reserve(m->values, size + n) == NULL) {
+		free(mem);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	smap_sort(k, v, v + n, v + 2 * (size_t)n, n, m->cmp);
+	n = smap_uniq(k, v, n, m->cmp, free_key, free_value);
+	smap_merge(m, k, v, n, free_key, free_value);
+	free(mem);
+
+	return m;
+}
+
+
+/**
+ * \brief Look up an element in a sorted map.
+ *
+ * \param m     The sorted map which contains the element.
+ * \param key   The key to the element.
+ * \param data  A pointer to the location where the element is stored, if
+ *               it was found.
+ *
+ * \return  The sorted map, or \c NULL if the key could not be found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ */
+smap
+smap_lookup(smap m, gendata key, gendata *data)
+{
+	array keys, values;
+	unsigned int pos;
+
+	assert(m != NULL);
+
+	if (!smap_find(m, key, &keys, &values, &pos)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	*data = values->data[pos];
+
+	return m;
+}
+
+
+/**
+ * \brief Delete an element from a sorted map.
+ *
+ * \note
+ * This moves all elements after the deleted one, so it takes time linear in
+ * the number of elements.
+ *
+ * \param m           The sorted map which contains the element to delete.
+ * \param key         The key to the element to delete.
+ * \param free_key    The function which is used to free the key data, or
+ *			\c NULL if no action should be taken on the key data.
+ * \param free_value  The function which is used to free the value data, or
+ *			\c NULL if no action should be taken on the value data.
+ *
+ * \return  The sorted map, or \c NULL if the key could not be found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ *
+ * \sa smap_insert
+ */
+smap
+smap_delete(smap m, gendata key, free_func free_key, free_func free_value)
+{
+	array keys, values;
+	unsigned int pos, n;
+
+	assert(m != NULL);
+
+	if (!smap_find(m, key, &keys, &values, &pos)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (free_key != NULL)
+		free_key(keys->data[pos].ptr);
+	if (free_value != NULL)
+		free_value(values->data[pos].ptr);
+
+	n = keys->size - pos - 1;
+	memmove(keys->data + pos, keys->data + pos + 1, n * sizeof(gendata));
+	memmove(values->data + pos, values->data + pos + 1,
+		n * sizeof(gendata));
+	array_shrink(keys, 1);
+	array_shrink(values, 1);
+
+	return m;
+}
+
+
+/**
+ * \brief Get the number of elements in a sorted map.
+ *
+ * \param m  The sorted map.
+ *
+ * \return  The number of elements in the map.
+ */
+unsigned int
+smap_count(smap m)
+{
+	assert(m != NULL);
+
+	return m->keys->size + m->new_keys->size;
+}
+
+
+/**
+ * \brief Walk a sorted map, in the order of its keys.
+ *
+ * \attention
+ * The walker function must not change the keys, or add or delete
+ * elements.
+ *
+ * \param m     The sorted map to walk.
+ * \param walk  The function which will be called on every element.
+ * \param data  Custom data which is passed to \p walk.
+ *
+ * \sa ht_walk
+ */
+void
+smap_walk(smap m, assoc_func walk, gendata data)
+{
+	unsigned int i = 0, j = 0;
+	array k, nk;
+
+	assert(m != NULL);
+	assert(walk != NULL);
+
+	k = m->keys;
+	nk = m->new_keys;
+
+	while (i < k->size || j < nk->size) {
+		if (j == nk->size ||
+		    (i < k->size && m->cmp(k->data[i], nk->data[j]) < 0)) {
+			walk(&k->data[i], &m->values->data[i], data);
+			++i;
+		} else {
+			walk(&nk->data[j], &m->new_values->data[j], data);
+			++j;
+		}
+	}
+}
@@ -0,0 +1,73 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief Sorted maps interface.
+ *
+ * \file smap.h
+ */
+#ifndef GUNE_SMAP_H
+#define GUNE_SMAP_H
+
+#include <gune/array.h>
+#include <gune/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Sorted map implementation */
+typedef struct smap_t {
+	array keys;		/**< The keys, sorted */
+	array values;		/**< The values, in the same order */
+	array new_keys;		/**< Recently inserted keys, sorted, which
+				     are not in keys */
+	array new_values;	/**< The values of new_keys */
+	unsigned int new_max;	/**< Merge new_keys into keys when there are
+				     this many */
+	cmp_func cmp;		/**< The ordering of the keys */
+} smap_t, *smap;
+
+smap smap_create(cmp_func);
+void smap_destroy(smap, free_func, free_func);
+smap smap_insert(smap, gendata, gendata, free_func, free_func);
+smap smap_insert_many(smap, const gendata *, const gendata *, unsigned int,
+		      free_func, free_func);
+smap smap_lookup(smap, gendata, gendata *);
+smap smap_delete(smap, gendata, free_func, free_func);
+unsigned int smap_count(smap);
+void smap_walk(smap, assoc_func, gendata);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GUNE_SMAP_H */
@@ -33,13 +33,37 @@
  * \brief String manipulation implementation.
  *
  * \file string.c
+ * The string hash reads its input a word at a time.  On machines with a
+ * 64-bit \c hashval it is a variant of Wang Yi's wyhash, which mixes two
+ * words at once with one wide multiplication.  Elsewhere it is Austin
+ * Appleby's MurmurHash3 (x86_32).  Both spread every input bit over the
+ * whole result, so the result can be reduced to a range by its high bits.
  */
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
+#include <gune/misc.h>
 #include <gune/string.h>
 
+#if ULONG_MAX > 0xFFFFFFFFUL
+/* The constants of wyhash */
+#define STR_WY0		0xA0761D6478BD642FUL
+#define STR_WY1		0xE7037ED1A0B428DBUL
+#define STR_WY2		0x8EBC6AF09C88C6E3UL
+#define STR_WY3		0x589965CC75374CC3UL
+
+#if defined(__GNUC__) && defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 str_wide;
+#endif
+
+static void str_mum(unsigned long *, unsigned long *);
+static unsigned long str_mix(unsigned long, unsigned long);
+static unsigned long str_read8(const unsigned char *);
+#endif
+static unsigned long str_read4(const unsigned char *);
+
 
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
@@ -133,6 +157,187 @@ str_cpy(const char *s)
 }
 
 
+#if ULONG_MAX > 0xFFFFFFFFUL
+/*
+ * Multiply two words into a double word, whose low and high halves replace
+ * them.
+ */
+static void
+str_mum(unsigned long *a, unsigned long *b)
+{
+#ifdef __SIZEOF_INT128__
+	str_wide r;
+
+	r = (str_wide)*a * *b;
+	*a = (unsigned long)r;
+	*b = (unsigned long)(r >> 64);
+#else
+	unsigned long ha, hb, la, lb, hi, lo, rm0, rm1, t;
+
+	ha = *a >> 32;
+	hb = *b >> 32;
+	la = *a & 0xFFFFFFFFUL;
+	lb = *b & 0xFFFFFFFFUL;
+	rm0 = ha * lb;
+	rm1 = hb * la;
+	lo = la * lb;
+	hi = ha * hb;
+
+	t = lo + (rm0 << 32);
+	hi += (t < lo);
+	lo = t + (rm1 << 32);
+	hi += (lo < t);
+	*a = lo;
+	*b = hi + (rm0 >> 32) + (rm1 >> 32);
+#endif
+}
+
+
+/*
+ * Mix two words into one, by xoring the halves of their product.
+ */
+static unsigned long
+str_mix(unsigned long a, unsigned long b)
+{
+	str_mum(&a, &b);
+
+	return a ^ b;
+}
+
+
+/*
+ * Read 8 bytes as a little-endian number.  A compiler recognises this as
+ * a single load on little-endian machines.
+ */
+static unsigned long
+str_read8(const unsigned char *p)
+{
+	return (unsigned long)p[0] | (unsigned long)p[1] << 8 |
+		(unsigned long)p[2] << 16 | (unsigned long)p[3] << 24 |
+		(unsigned long)p[4] << 32 | (unsigned long)p[5] << 40 |
+		(unsigned long)p[6] << 48 | (unsigned long)p[7] << 56;
+}
+#endif
+
+
+/*
+ * Read 4 bytes as a little-endian number.
+ */
+static unsigned long
+str_read4(const unsigned char *p)
+{
+	return (unsigned long)p[0] | (unsigned long)p[1] << 8 |
+		(unsigned long)p[2] << 16 | (unsigned long)p[3] << 24;
+}
+
+
+/**
+ * \brief Generate a full-width hash from a block of memory.
+ *
+ * The bytes are read a word at a time, and mixed well enough that the
+ * result doesn't need any further scrambling.  The same bytes give the same
+ * hash on any machine with the same size of \c hashval.
+ *
+ * \param mem  The memory to hash.
+ * \param len  The number of bytes to hash.
+ *
+ * \return  The hash of the bytes.
+ *
+ * \sa str_fullhash
+ */
+hashval
+str_hash_mem(const void *mem, size_t len)
+{
+	const unsigned char *p = mem;
+#if ULONG_MAX > 0xFFFFFFFFUL
+	unsigned long a, b, seed, see1, see2;
+	size_t i;
+
+	assert(p != NULL || len == 0);
+
+	seed = STR_WY0 ^ str_mix(STR_WY0, STR_WY1);
+
+	if (len <= 16) {
+		if (len >= 4) {
+			/* Two overlapping pairs of reads cover 4..16 bytes */
+			a = str_read4(p) << 32 |
+				str_read4(p + ((len >> 3) << 2));
+			b = str_read4(p + len - 4) << 32 |
+				str_read4(p + len - 4 - ((len >> 3) << 2));
+		} else if (len > 0) {
+			a = (unsigned long)p[0] << 16 |
+				(unsigned long)p[len >> 1] << 8 | p[len - 1];
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		i = len;
+		if (i > 48) {
+			/* Three independent lanes keep the multiplier busy */
+			see1 = see2 = seed;
+			do {
+				seed = str_mix(str_read8(p) ^ STR_WY1,
+					       str_read8(p + 8) ^ seed);
+				see1 = str_mix(str_read8(p + 16) ^ STR_WY2,
+					       str_read8(p + 24) ^ see1);
+				see2 = str_mix(str_read8(p + 32) ^ STR_WY3,
+					       str_read8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16) {
+			seed = str_mix(str_read8(p) ^ STR_WY1,
+				       str_read8(p + 8) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+		/* The last 16 bytes, which may overlap the ones before */
+		a = str_read8(p + i - 16);
+		b = str_read8(p + i - 8);
+	}
+
+	a ^= STR_WY1;
+	b ^= seed;
+	str_mum(&a, &b);
+
+	return str_mix(a ^ STR_WY0 ^ len, b ^ STR_WY1);
+#else
+	unsigned long h, k;
+	size_t i;
+
+	assert(p != NULL || len == 0);
+
+	h = 0;
+	for (i = 0; i + 4 <= len; i += 4) {
+		k = str_read4(p + i) * 0xCC9E2D51UL;
+		k = ((k << 15) | (k >> 17)) * 0x1B873593UL;
+		h ^= k;
+		h = ((h << 13) | (h >> 19)) * 5 + 0xE6546B64UL;
+	}
+
+	k = 0;
+	switch (len & 3) {
+	case 3:
+		k ^= (unsigned long)p[i + 2] << 16;
+		/* FALLTHROUGH */
+	case 2:
+		k ^= (unsigned long)p[i + 1] << 8;
+		/* FALLTHROUGH */
+	case 1:
+		k ^= p[i];
+		k *= 0xCC9E2D51UL;
+		k = ((k << 15) | (k >> 17)) * 0x1B873593UL;
+		h ^= k;
+	}
+
+	return hash_mix(h ^ (unsigned long)len);
+#endif
+}
+
+
 /**
  * \brief Generate hash from a string.
  *
@@ -141,25 +346,57 @@ str_cpy(const char *s)
  *
  * \return  The hash of the supplied string, in the range \f$ [0..range-1] \f$.
  *
- * \sa str_eq
+ * \sa str_fullhash str_eq
  */
 unsigned int
 str_hash(gendata key, unsigned int range)
 {
-	char *s = (char *)key.ptr;
-	unsigned int h = 0;				/* This is variable */
+	return hash_reduce(str_fullhash(key), range);
+}
 
-	assert(s != NULL);
 
-	/*
-	 * Refer to "Performance in Practice of String Hashing Functions"
-	 * by M.V. Ramakrishna & Justin Zobel for rationale on this particular
-	 * hashing function.
-	 */
-	while (*s != '\0')
-		h ^= ((h << 5) + (h >> 2) + *s++);	/* 5, 2 are variable */
+/**
+ * \brief Generate a full-width hash from a string.
+ *
+ * This is the same hashing function as str_hash, but not reduced to a
+ * range.  The length of the string is found with strlen, which the C
+ * library usually implements with vector instructions, and then the string
+ * is hashed with str_hash_mem.
+ *
+ * \param key  The string to hash.
+ *
+ * \return  The hash of the supplied string.
+ *
+ * \sa str_hash str_hash_mem str_eq
+ */
+hashval
+str_fullhash(gendata key)
+{
+	assert(key.ptr != NULL);
 
-	return h % range;
+	return str_hash_mem(key.ptr, strlen(key.ptr));
+}
+
+
+/**
+ * \brief Generate a keyed hash from a string.
+ *
+ * Use this instead of str_fullhash on strings which come from untrusted
+ * sources, so nobody can make them collide on purpose.
+ *
+ * \param key   The string to hash.
+ * \param seed  The secret seed.
+ *
+ * \return  The keyed hash of the supplied string.
+ *
+ * \sa str_fullhash str_eq hash_sip ht_create_keyed
+ */
+hashval
+str_keyedhash(gendata key, const hashseed *seed)
+{
+	assert(key.ptr != NULL);
+
+	return hash_sip(key.ptr, strlen(key.ptr), seed);
 }
 
 
@@ -180,3 +417,23 @@ str_eq(gendata s1, gendata s2)
 	assert(s2.ptr != NULL);
 	return !strcmp(s1.ptr, s2.ptr);
 }
+
+
+/**
+ * \brief String ordering function for sorting.
+ *
+ * \param s1  The string to compare to s2.
+ * \param s2  The string to compare to s1.
+ *
+ * \return  A negative number, zero or a positive number if \p s1 sorts
+ *	     before, the same as or after \p s2, like strcmp.
+ *
+ * \sa str_eq, array_sort
+ */
+int
+str_cmp(gendata s1, gendata s2)
+{
+	assert(s1.ptr != NULL);
+	assert(s2.ptr != NULL);
+	return strcmp(s1.ptr, s2.ptr);
+}
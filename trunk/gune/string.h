@@ -50,8 +50,12 @@ char *str_cat(const char *, const char *);
 char *str_n_cpy(char *, const char *, size_t);
 char *str_cpy(const char *);
 
+hashval str_hash_mem(const void *, size_t);
 unsigned int str_hash(gendata, unsigned int);
+hashval str_fullhash(gendata);
+hashval str_keyedhash(gendata, const hashseed *);
 int str_eq(gendata, gendata);
+int str_cmp(gendata, gendata);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,487 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief Expiring maps implementation.
+ *
+ * \file ttl.c
+ * An expiring map is a hash table whose entries each have a time at which
+ * they expire.  Times are plain numbers of ticks, so the caller decides how
+ * long a tick is.  Expired entries are never found by lookups, and they are
+ * removed from the map when the caller reaps it.
+ *
+ * To find the entries which expire without looking at all of them, every
+ * entry is also in a hierarchical timer wheel.  The first level has a slot
+ * for each of the next TTL_SLOTS ticks, the second level a slot for each of
+ * the next TTL_SLOTS runs of TTL_SLOTS ticks, and so on.  When the time
+ * reaches the start of the run of a slot on a higher level, its entries are
+ * cascaded down to the level below, so by the time they expire they are in
+ * the first level, in the slot of their tick.  Each entry is cascaded at
+ * most once per level, so reaping takes amortized constant time per entry.
+ * Entries which expire beyond the reach of the top level are put in its
+ * farthest slot, and get placed again when that slot is cascaded.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <gune/ttl.h>
+
+/** The number of ticks covered by one slot on a level */
+#define TTL_SPAN(level)		(1UL << ((level) * TTL_SLOT_BITS))
+
+/** The slot a time falls in on a level */
+#define TTL_SLOT(time, level)	\
+	(((time) >> ((level) * TTL_SLOT_BITS)) & (TTL_SLOTS - 1))
+
+static void ttl_place(ttl, ttl_entry);
+static void ttl_unlink(ttl, ttl_entry);
+static void ttl_drop(ttl, ttl_entry, eq_func);
+static void ttl_cascade(ttl, unsigned int);
+static ttl_entry ttl_find(ttl, gendata, eq_func);
+
+/*
+ * Internal function to put an entry in the slot of the wheel which belongs
+ * to its expiry time.
+ */
+static void
+ttl_place(ttl t, ttl_entry e)
+{
+	ttl_link_t *head;
+	unsigned long delta, when;
+	unsigned int level;
+
+	assert(e->expires >= t->now);
+
+	when = e->expires;
+	delta = when - t->now;
+	for (level = 0; level < TTL_LEVELS - 1; ++level)
+		if (delta < TTL_SPAN(level + 1))
+			break;
+
+	/* Too far ahead for the top level, so it gets placed again later */
+	if (level == TTL_LEVELS - 1 && delta >= TTL_SPAN(TTL_LEVELS))
+		when = t->now + TTL_SPAN(TTL_LEVELS) - 1;
+
+	head = &t->wheel[level][TTL_SLOT(when, level)];
+	e->level = level;
+	e->link.prev = head->prev;
+	e->link.next = head;
+	head->prev->next = &e->link;
+	head->prev = &e->link;
+	++t->level_count[level];
+}
+
+
+/*
+ * Internal function to take an entry out of its slot of the wheel.
+ */
+static void
+ttl_unlink(ttl t, ttl_entry e)
+{
+	e->link.prev->next = e->link.next;
+	e->link.next->prev = e->link.prev;
+	--t->level_count[e->level];
+}
+
+
+/*
+ * Internal function to remove an entry from the map, calling the free
+ * hooks on its key and value.
+ */
+static void
+ttl_drop(ttl t, ttl_entry e, eq_func eq)
+{
+	/* Every entry in the wheel is in the index, so this can't fail */
+	ht_delete(t->index, e->key, eq, NULL, NULL);
+
+	ttl_unlink(t, e);
+
+	if (t->free_key != NULL)
+		t->free_key(e->key.ptr);
+	if (t->free_value != NULL)
+		t->free_value(e->value.ptr);
+
+	free(e);
+}
+
+
+/*
+ * Internal function to move the entries in the current slot of a level
+ * down to the levels below.
+ */
+static void
+ttl_cascade(ttl t, unsigned int level)
+{
+	ttl_link_t *head, *l, *next;
+
+	head = &t->wheel[level][TTL_SLOT(t->now, level)];
+	l = head->next;
+	head->prev = head->next = head;
+
+	for (; l != head; l = next) {
+		next = l->next;
+		--t->level_count[level];
+		ttl_place(t, (ttl_entry)l);
+	}
+}
+
+
+/*
+ * Internal function to look up the entry belonging to a key.  Returns NULL
+ * if there is no such entry.
+ */
+static ttl_entry
+ttl_find(ttl t, gendata key, eq_func eq)
+{
+	gendata e;
+
+	if (ht_lookup(t->index, key, eq, &e) == NULL)
+		return NULL;
+
+	return (ttl_entry)e.ptr;
+}
+
+
+/**
+ * \brief Create a new empty expiring map.
+ *
+ * \param hash        The full-width hashing function to use on keys.
+ * \param now         The current time.
+ * \param free_key    The function used to free the key of an entry which
+ *			is dropped from the map, or \c NULL if keys need not
+ *			be freed.
+ * \param free_value  The function used to free the value of an entry which
+ *			is dropped from the map, or \c NULL if values need
+ *			not be freed.
+ *
+ * \return  A new empty expiring map object, or \c NULL if an error
+ *	     occurred.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ttl_destroy
+ */
+ttl
+ttl_create(fullhash_func hash, unsigned long now, free_func free_key,
+	   free_func free_value)
+{
+	ttl_t *t;
+	unsigned int i, j;
+
+	assert(hash != NULL);
+
+	if ((t = malloc(sizeof(ttl_t))) == NULL)
+		return NULL;
+
+	if ((t->index = ht_create_full(0, hash, HT_ROBINHOOD)) == NULL) {
+		free(t);
+		return NULL;
+	}
+
+	for (i = 0; i < TTL_LEVELS; ++i) {
+		for (j = 0; j < TTL_SLOTS; ++j)
+			t->wheel[i][j].prev = t->wheel[i][j].next =
+				&t->wheel[i][j];
+		t->level_count[i] = 0;
+	}
+
+	t->now = now;
+	t->free_key = free_key;
+	t->free_value = free_value;
+
+	return (ttl)t;
+}
+
+
+/**
+ * \brief Free all memory allocated for an expiring map.
+ *
+ * The keys and values of the remaining entries, expired or not, are passed
+ * to the free functions the map was created with.
+ *
+ * \param t  The expiring map to destroy.
+ *
+ * \sa ttl_create
+ */
+void
+ttl_destroy(ttl t)
+{
+	ttl_link_t *head, *l, *next;
+	unsigned int i, j;
+
+	assert(t != NULL);
+
+	for (i = 0; i < TTL_LEVELS; ++i) {
+		for (j = 0; j < TTL_SLOTS; ++j) {
+			head = &t->wheel[i][j];
+			for (l = head->next; l != head; l = next) {
+				next = l->next;
+				if (t->free_key != NULL)
+					t->free_key(((ttl_entry)l)->key.ptr);
+				if (t->free_value != NULL)
+					t->free_value(
+					    ((ttl_entry)l)->value.ptr);
+				free(l);
+			}
+		}
+	}
+
+	ht_destroy(t->index, NULL, NULL);
+	free(t);
+}
+
+
+/**
+ * \brief Add a (key, value) pair to an expiring map (with replace)
+ *
+ * Add an entry to the map which expires at the given time, or replace the
+ *  entry with the same key and its expiry time.  The free functions are
+ *  called on the old key and value of a replaced entry, unless they are
+ *  the same as the new ones.
+ *
+ * \param t        The expiring map to add the entry to.
+ * \param key      The key of the entry.
+ * \param value    The value of the entry.
+ * \param expires  The time at which the entry expires.  This must be later
+ *		    than the time the map was last reaped at.
+ * \param eq       The equals predicate for two keys.
+ *
+ * \return  The original expiring map, or \c NULL if the entry could not be
+ *           added.  The map is unchanged in case of error.
+ *
+ * \par Errno values:
+ * - \b EINVAL if \p expires is not later than the last reaping time.
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ttl_lookup, ttl_delete
+ */
+ttl
+ttl_insert(ttl t, gendata key, gendata value, unsigned long expires,
+	   eq_func eq)
+{
+	ttl_entry e;
+	gendata ep;
+
+	assert(t != NULL);
+	assert(eq != NULL);
+
+	if (expires <= t->now) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if ((e = ttl_find(t, key, eq)) != NULL) {
+		/* Store the new key in the index too, the old one goes away */
+		ep.ptr = e;
+		if (ht_insert(t->index, key, ep, eq, NULL, NULL) == NULL)
+			return NULL;
+
+		if (t->free_key != NULL && e->key.ptr != key.ptr)
+			t->free_key(e->key.ptr);
+		if (t->free_value != NULL && e->value.ptr != value.ptr)
+			t->free_value(e->value.ptr);
+
+		ttl_unlink(t, e);
+	} else {
+		if ((e = malloc(sizeof(ttl_entry_t))) == NULL)
+			return NULL;
+
+		ep.ptr = e;
+		if (ht_insert_uniq(t->index, key, ep, eq) == NULL) {
+			free(e);
+			return NULL;
+		}
+	}
+
+	e->key = key;
+	e->value = value;
+	e->expires = expires;
+	ttl_place(t, e);
+
+	return t;
+}
+
+
+/**
+ * \brief Look up a value in an expiring map.
+ *
+ * Entries which have expired by the given time are not found, even if the
+ *  map hasn't been reaped since.
+ *
+ * \param t     The expiring map to look in.
+ * \param key   The key of the entry.
+ * \param eq    The equals predicate for two keys.
+ * \param now   The current time.
+ * \param data  A pointer to the location where the value is stored, if
+ *		 found.
+ *
+ * \return  The expiring map, or \c NULL if the key could not be found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found, or its entry has expired.
+ *
+ * \sa ttl_insert
+ */
+ttl
+ttl_lookup(ttl t, gendata key, eq_func eq, unsigned long now, gendata *data)
+{
+	ttl_entry e;
+
+	assert(t != NULL);
+	assert(eq != NULL);
+	assert(data != NULL);
+
+	if ((e = ttl_find(t, key, eq)) == NULL)
+		return NULL;
+
+	if (e->expires <= now) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	*data = e->value;
+
+	return t;
+}
+
+
+/**
+ * \brief Remove an entry from an expiring map.
+ *
+ * The free functions are called on the key and value of the entry.
+ *
+ * \param t    The expiring map to remove the entry from.
+ * \param key  The key of the entry.
+ * \param eq   The equals predicate for two keys.
+ *
+ * \return  The expiring map, or \c NULL if the key could not be found.
+ *
+ * \par Errno values:
+ * - \b EINVAL if the key could not be found.
+ *
+ * \sa ttl_insert, ttl_reap
+ */
+ttl
+ttl_delete(ttl t, gendata key, eq_func eq)
+{
+	ttl_entry e;
+
+	assert(t != NULL);
+	assert(eq != NULL);
+
+	if ((e = ttl_find(t, key, eq)) == NULL)
+		return NULL;
+
+	ttl_drop(t, e, eq);
+
+	return t;
+}
+
+
+/**
+ * \brief Remove all expired entries from an expiring map.
+ *
+ * The free functions are called on the keys and values of the entries
+ *  which expired at or before the given time.  Runs of time in which
+ *  nothing can expire are skipped, so reaping rarely is no slower than
+ *  reaping often.
+ *
+ * \param t    The expiring map to reap.
+ * \param now  The current time.  If this is before the time the map was
+ *		last reaped at, nothing happens.
+ * \param eq   The equals predicate for two keys.
+ *
+ * \return  The number of entries which were removed.
+ *
+ * \sa ttl_delete
+ */
+unsigned int
+ttl_reap(ttl t, unsigned long now, eq_func eq)
+{
+	ttl_link_t *head;
+	unsigned long next;
+	unsigned int level, reaped = 0;
+
+	assert(t != NULL);
+	assert(eq != NULL);
+
+	while (t->now < now) {
+		for (level = 0; level < TTL_LEVELS; ++level)
+			if (t->level_count[level] > 0)
+				break;
+
+		if (level == TTL_LEVELS) {
+			t->now = now;
+			break;
+		}
+
+		/* Nothing happens before the next slot of this level */
+		next = (t->now | (TTL_SPAN(level) - 1)) + 1;
+		if (next > now) {
+			t->now = now;
+			break;
+		}
+		t->now = next;
+
+		for (level = 1; level < TTL_LEVELS; ++level) {
+			if ((t->now & (TTL_SPAN(level) - 1)) != 0)
+				break;
+			ttl_cascade(t, level);
+		}
+
+		/* All entries in this slot expire right now */
+		head = &t->wheel[0][TTL_SLOT(t->now, 0)];
+		while (head->next != head) {
+			ttl_drop(t, (ttl_entry)head->next, eq);
+			++reaped;
+		}
+	}
+
+	return reaped;
+}
+
+
+/**
+ * \brief The number of entries in an expiring map.
+ *
+ * \param t  The expiring map.
+ *
+ * \return  The number of entries, including those which expired since the
+ *	     map was last reaped.
+ */
+unsigned int
+ttl_count(ttl t)
+{
+	assert(t != NULL);
+
+	return ht_count(t->index);
+}
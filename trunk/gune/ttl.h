@@ -0,0 +1,94 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief Expiring maps interface.
+ *
+ * \file ttl.h
+ */
+#ifndef GUNE_TTL_H
+#define GUNE_TTL_H
+
+#include <gune/ht.h>
+#include <gune/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** The number of levels in the timer wheel */
+#define TTL_LEVELS	4
+
+/** The number of bits of time each level of the timer wheel covers */
+#define TTL_SLOT_BITS	6
+
+/** The number of slots in each level of the timer wheel */
+#define TTL_SLOTS	(1 << TTL_SLOT_BITS)
+
+/** \brief Link in the list of entries of a timer wheel slot */
+typedef struct ttl_link_t {
+	struct ttl_link_t *prev;	/**< The previous link */
+	struct ttl_link_t *next;	/**< The next link */
+} ttl_link_t;
+
+/** \brief Expiring map element */
+typedef struct ttl_entry_t {
+	ttl_link_t link;	/**< Link in the slot, must come first */
+	gendata key;		/**< Key, used for identification of entries */
+	gendata value;		/**< The entry itself */
+	unsigned long expires;	/**< The time at which the entry expires */
+	unsigned int level;	/**< The level of the wheel it is in */
+} ttl_entry_t, *ttl_entry;
+
+/** \brief Expiring map implementation */
+typedef struct ttl_t {
+	ht index;		/**< Maps keys onto their entries */
+	ttl_link_t wheel[TTL_LEVELS][TTL_SLOTS]; /**< The timer wheel */
+	unsigned int level_count[TTL_LEVELS]; /**< Entries per level */
+	unsigned long now;	/**< The time up to which entries are reaped */
+	free_func free_key;	/**< Frees keys of entries which are dropped */
+	free_func free_value;	/**< Frees values of entries which are
+				     dropped */
+} ttl_t, *ttl;
+
+ttl ttl_create(fullhash_func, unsigned long, free_func, free_func);
+void ttl_destroy(ttl);
+ttl ttl_insert(ttl, gendata, gendata, unsigned long, eq_func);
+ttl ttl_lookup(ttl, gendata, eq_func, unsigned long, gendata *);
+ttl ttl_delete(ttl, gendata, eq_func);
+unsigned int ttl_reap(ttl, unsigned long, eq_func);
+unsigned int ttl_count(ttl);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GUNE_TTL_H */
@@ -86,6 +86,52 @@ typedef void (*free_func) (void *);
  */
 typedef int (* eq_func) (gendata, gendata);
 
+/**
+ * \brief Ordering function type for sorting.
+ *
+ * Like \c strcmp, this returns a negative number, zero or a positive number
+ * when the first argument is less than, equal to or greater than the second.
+ */
+typedef int (* cmp_func) (gendata, gendata);
+
+/**
+ * \brief Hashing function type for hash tables.
+ */
+typedef unsigned int (* hash_func) (gendata, unsigned int);
+
+/**
+ * \brief Full-width hash value.
+ *
+ * This is at least 32 bits wide, and 64 bits on most 64-bit platforms.
+ * (ANSI C has no integer type which is guaranteed to be 64 bits)
+ */
+typedef unsigned long hashval;
+
+/**
+ * \brief Full-width hashing function type for hash tables.
+ *
+ * Unlike a \c hash_func, this does not reduce the hash value to a range.
+ * The hash table does that itself, so it can store the full hash value
+ * with every entry.
+ */
+typedef hashval (* fullhash_func) (gendata);
+
+/**
+ * \brief Secret seed of a keyed hashing function.
+ */
+typedef struct hashseed {
+	unsigned long k[2];	/**< The key bits (128 or 64 of them) */
+} hashseed;
+
+/**
+ * \brief Keyed hashing function type for hash tables.
+ *
+ * This is like a \c fullhash_func, but the hash value also depends on a
+ * secret seed.  This makes it infeasible for anyone who doesn't know the
+ * seed to pick keys that collide.
+ */
+typedef hashval (* keyedhash_func) (gendata, const hashseed *);
+
 /**
  * \brief Function for traveling through lists that have (key, value) pairs.
  */
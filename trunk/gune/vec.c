@@ -0,0 +1,2147 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief Typed vectors implementation.
+ *
+ * \file vec.c
+ * These vectors store their elements unboxed, one after the other, unlike
+ * an \c array which wraps every element in a \c gendata.  This takes less
+ * memory and lets the reductions (sum, minimum, maximum, count and find)
+ * work on many elements at once.  They use SSE2 if the compiler supports
+ * it, and plain loops otherwise.  Vectors of long integers only use SSE2
+ * for the sum, because it has no 64-bit comparisons.  The sums add up
+ * 64-bit lanes, so they only use SSE2 where a long has 64 bits as well.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gune/misc.h>
+#include <gune/vec.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+/* The kernels assume the integer sizes of all x86 compilers */
+#if INT_MAX == 0x7FFFFFFF && UCHAR_MAX == 0xFF
+#define VEC_SSE2
+#if ULONG_MAX > 0xFFFFFFFFUL
+#define VEC_SSE2_LONG
+#endif
+#endif
+#endif /* __SSE2__ */
+
+/** Compile-time option of the initial capacity of a vector */
+#define VEC_INITIAL_SIZE	16
+
+/* Unaligned loads and stores of 16 bytes */
+#define VEC_LOADU(p)	_mm_loadu_si128((const __m128i *)(const void *)(p))
+#define VEC_STOREU(p,x)	_mm_storeu_si128((__m128i *)(void *)(p), (x))
+
+/* Whether a op b holds */
+#define VEC_TEST(op, a, b)						\
+	((op) == VEC_LT ? (a) < (b) : (op) == VEC_LE ? (a) <= (b) :	\
+	 (op) == VEC_EQ ? (a) == (b) : (op) == VEC_NE ? (a) != (b) :	\
+	 (op) == VEC_GE ? (a) >= (b) : (a) > (b))
+
+#ifdef VEC_SSE2
+/*
+ * Lane masks picking which of x < y, x == y and x > y satisfy a vec_op.
+ * They are set up once per call, so that the compares below are straight
+ * line code the compiler can keep in the loops instead of a switch.
+ */
+typedef struct vec_sel {
+	__m128i lt, eq, gt;
+} vec_sel;
+
+/* All ones in the lanes of the signed integers x and y where x op y holds */
+#define VEC_CMP_EPI32(x, y, s)						\
+	_mm_or_si128(_mm_or_si128(					\
+		_mm_and_si128(_mm_cmpgt_epi32((y), (x)), (s)->lt),	\
+		_mm_and_si128(_mm_cmpeq_epi32((x), (y)), (s)->eq)),	\
+		_mm_and_si128(_mm_cmpgt_epi32((x), (y)), (s)->gt))
+#define VEC_CMP_EPI8(x, y, s)						\
+	_mm_or_si128(_mm_or_si128(					\
+		_mm_and_si128(_mm_cmpgt_epi8((y), (x)), (s)->lt),	\
+		_mm_and_si128(_mm_cmpeq_epi8((x), (y)), (s)->eq)),	\
+		_mm_and_si128(_mm_cmpgt_epi8((x), (y)), (s)->gt))
+#endif
+
+static void *vec_realloc(void *, unsigned int *, unsigned int, size_t, int);
+static long vec_long(unsigned long);
+#ifdef VEC_SSE2
+static unsigned int vec_first_bit(unsigned int);
+static unsigned int vec_popcount(unsigned int);
+static void vec_select(vec_sel *, vec_op);
+static __m128i vec_min_epi32(__m128i, __m128i);
+static __m128i vec_max_epi32(__m128i, __m128i);
+static int vec_cmp_pd(__m128d, __m128d, vec_op);
+#endif
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*
+ * Make room for needed elements of elsize bytes in data, which has room for
+ * *capacity of them.  Unless exact is nonzero the capacity is at least
+ * doubled, so adding elements one by one takes amortised constant time.
+ * Returns the new data, or NULL with errno set (data is left alone then).
+ */
+static void *
+vec_realloc(void *data, unsigned int *capacity, unsigned int needed,
+	    size_t elsize, int exact)
+{
+	unsigned int newcap;
+	size_t bytes;
+
+	if (data != NULL && needed <= *capacity)
+		return data;
+
+	newcap = needed;
+	if (!exact && *capacity > UINT_MAX / 2)
+		newcap = UINT_MAX;
+	else if (!exact)
+		newcap = MAX(newcap, MAX(*capacity * 2, VEC_INITIAL_SIZE));
+
+	/* Never ask for 0 bytes, and refuse sizes a size_t can't hold */
+	bytes = (size_t)MAX(newcap, 1) * elsize;
+	if (bytes / elsize != MAX(newcap, 1) ||
+	    (data = realloc(data, bytes)) == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	*capacity = newcap;
+
+	return data;
+}
+
+
+/*
+ * Convert an unsigned long to a long, wrapping around like two's complement
+ * arithmetic does.  A plain cast of an out of range value is
+ * implementation-defined, and signed overflow is undefined.
+ */
+static long
+vec_long(unsigned long x)
+{
+	if (x <= (unsigned long)LONG_MAX)
+		return (long)x;
+
+	return -(long)(~x) - 1;
+}
+
+
+#ifdef VEC_SSE2
+
+/*
+ * Return the index of the lowest set bit of a nonzero mask.
+ */
+static unsigned int
+vec_first_bit(unsigned int mask)
+{
+#ifdef __GNUC__
+	return (unsigned int)__builtin_ctz(mask);
+#else
+	unsigned int i;
+
+	for (i = 0; (mask & 1) == 0; mask >>= 1, ++i)
+		;
+
+	return i;
+#endif
+}
+
+
+/*
+ * Return the number of set bits in a mask.
+ */
+static unsigned int
+vec_popcount(unsigned int mask)
+{
+#ifdef __GNUC__
+	return (unsigned int)__builtin_popcount(mask);
+#else
+	unsigned int n;
+
+	for (n = 0; mask != 0; mask &= mask - 1)
+		++n;
+
+	return n;
+#endif
+}
+
+
+/*
+ * Set up the lane masks for op.
+ */
+static void
+vec_select(vec_sel *s, vec_op op)
+{
+	__m128i ones = _mm_set1_epi32(-1), zero = _mm_setzero_si128();
+
+	s->lt = (op == VEC_LT || op == VEC_LE || op == VEC_NE) ? ones : zero;
+	s->eq = (op == VEC_LE || op == VEC_EQ || op == VEC_GE) ? ones : zero;
+	s->gt = (op == VEC_GT || op == VEC_GE || op == VEC_NE) ? ones : zero;
+}
+
+
+/*
+ * The lane by lane minimum of four signed 32-bit integers (SSE2 has no
+ * instruction for this).
+ */
+static __m128i
+vec_min_epi32(__m128i x, __m128i y)
+{
+	__m128i gt = _mm_cmpgt_epi32(x, y);
+
+	return _mm_or_si128(_mm_and_si128(gt, y), _mm_andnot_si128(gt, x));
+}
+
+
+/*
+ * The lane by lane maximum of four signed 32-bit integers.
+ */
+static __m128i
+vec_max_epi32(__m128i x, __m128i y)
+{
+	__m128i gt = _mm_cmpgt_epi32(x, y);
+
+	return _mm_or_si128(_mm_and_si128(gt, x), _mm_andnot_si128(gt, y));
+}
+
+
+/*
+ * Compare two doubles, giving a bit mask with bit i set if lane i of x op y
+ * holds.  Like the C operators, every comparison with a NaN is false,
+ * except for VEC_NE.
+ */
+static int
+vec_cmp_pd(__m128d x, __m128d y, vec_op op)
+{
+	switch (op) {
+	case VEC_LT:
+		return _mm_movemask_pd(_mm_cmplt_pd(x, y));
+	case VEC_LE:
+		return _mm_movemask_pd(_mm_cmple_pd(x, y));
+	case VEC_EQ:
+		return _mm_movemask_pd(_mm_cmpeq_pd(x, y));
+	case VEC_NE:
+		return _mm_movemask_pd(_mm_cmpneq_pd(x, y));
+	case VEC_GE:
+		return _mm_movemask_pd(_mm_cmpge_pd(x, y));
+	default:
+		return _mm_movemask_pd(_mm_cmpgt_pd(x, y));
+	}
+}
+
+#endif /* VEC_SSE2 */
+
+
+/**
+ * \brief Create a new empty vector of signed integers.
+ *
+ * \param capacity  The number of elements to make room for, or 0 to use a
+ *		     sensible default.
+ *
+ * \return  A new empty vector, or \c NULL if an error occurred.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ivec_destroy uvec_create lvec_create dvec_create bvec_create
+ */
+ivec
+ivec_create(unsigned int capacity)
+{
+	ivec_t *v;
+
+	if ((v = malloc(sizeof(ivec_t))) == NULL)
+		return NULL;
+
+	v->size = v->capacity = 0;
+	if ((v->data = vec_realloc(NULL, &v->capacity, capacity == 0 ?
+				   VEC_INITIAL_SIZE : capacity,
+				   sizeof(int), 1)) == NULL) {
+		free(v);
+		return NULL;
+	}
+
+	return (ivec)v;
+}
+
+
+/**
+ * \brief Free all memory allocated for a vector.
+ *
+ * \param v  The vector to destroy.
+ *
+ * \sa ivec_create
+ */
+void
+ivec_destroy(ivec v)
+{
+	assert(v != NULL);
+
+	free(v->data);
+	free(v);
+}
+
+
+/**
+ * \brief Get the number of elements in a vector.
+ *
+ * \param v  The vector to get the size of.
+ *
+ * \return  The number of elements.
+ */
+unsigned int
+ivec_size(ivec v)
+{
+	assert(v != NULL);
+
+	return v->size;
+}
+
+
+/**
+ * \brief Make room in a vector for a number of elements.
+ *
+ * Afterwards, the vector can hold \p capacity elements without allocating
+ * memory.  Its size does not change.
+ *
+ * \param v         The vector to make room in.
+ * \param capacity  The number of elements to make room for.
+ *
+ * \return  The vector given as input, or \c NULL if an error occurred.
+ *	     The vector is unchanged then.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ivec_resize ivec_append
+ */
+ivec
+ivec_reserve(ivec v, unsigned int capacity)
+{
+	int *data;
+
+	assert(v != NULL);
+
+	if ((data = vec_realloc(v->data, &v->capacity, capacity,
+				sizeof(int), 1)) == NULL)
+		return NULL;
+	v->data = data;
+
+	return v;
+}
+
+
+/**
+ * \brief Resize a vector.
+ *
+ * Elements added this way have no defined value until they are set.
+ * Making the vector smaller does not free any memory.
+ *
+ * \param v     The vector to resize.
+ * \param size  The new size of the vector.
+ *
+ * \return  The vector given as input, or \c NULL if an error occurred.
+ *	     The vector is unchanged then.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ivec_reserve ivec_fill
+ */
+ivec
+ivec_resize(ivec v, unsigned int size)
+{
+	int *data;
+
+	assert(v != NULL);
+
+	if ((data = vec_realloc(v->data, &v->capacity, size,
+				sizeof(int), 0)) == NULL)
+		return NULL;
+	v->data = data;
+	v->size = size;
+
+	return v;
+}
+
+
+/**
+ * \brief Add an element to the end of a vector.
+ *
+ * \param v      The vector to add an element to.
+ * \param value  The value to add.
+ *
+ * \return  The vector given as input, or \c NULL if an error occurred.
+ *	     The vector is unchanged then.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ivec_append
+ */
+ivec
+ivec_push(ivec v, int value)
+{
+	int *data;
+
+	assert(v != NULL);
+
+	if (v->size == v->capacity) {
+		if (v->size == UINT_MAX) {
+			errno = ENOMEM;
+			return NULL;
+		}
+		if ((data = vec_realloc(v->data, &v->capacity, v->size + 1,
+					sizeof(int), 0)) == NULL)
+			return NULL;
+		v->data = data;
+	}
+
+	v->data[v->size++] = value;
+
+	return v;
+}
+
+
+/**
+ * \brief Add a number of elements to the end of a vector.
+ *
+ * The vector is grown at most once, and the elements are copied all at
+ * once.
+ *
+ * \param v       The vector to add the elements to.
+ * \param values  The values to add.
+ * \param n       The number of values.
+ *
+ * \return  The vector given as input, or \c NULL if an error occurred.
+ *	     The vector is unchanged then.
+ *
+ * \par Errno values:
+ * - \b ENOMEM if out of memory.
+ *
+ * \sa ivec_push ivec_reserve
+ */
+ivec
+ivec_append(ivec v, const int *values, unsigned int n)
+{
+	int *data;
+
+	assert(v != NULL);
+	assert(values != NULL || n == 0);
+
+	if (n > UINT_MAX - v->size) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	if ((data = vec_realloc(v->data, &v->capacity, v->size + n,
+				sizeof(int), 0)) == NULL)
+		return NULL;
+	v->data = data;
+
+	if (n > 0)
+		memcpy(v->data + v->size, values, n * sizeof(int));
+	v->size += n;
+
+	return v;
+}
+
+
+/**
+ * \brief Set all elements of a vector to a value.
+ *
+ * \param v      The vector to fill.
+ * \param value  The value to set the elements to.
+ *
+ * \sa ivec_resize
+ */
+void
+ivec_fill(ivec v, int value)
+{
+	unsigned int i;
+
+	assert(v != NULL);
+
+	/* Compilers turn this into vector stores by themselves */
+	for (i = 0; i < v->size; ++i)
+		v->data[i] = value;
+}
+
+
+/**
+ * \brief Add up the elements of a vector.
+ *
+ * \param v  The vector to add up.
+ *
+ * \return  The sum of the elements, or 0 if there are none.  It is a
+ *	     \c long, so it does not overflow as easily as an \c int.
+ *
+ * \sa ivec_min ivec_max
+ */
+long
+ivec_sum(ivec v)
+{
+	unsigned int i = 0;
+	long sum = 0;
+#ifdef VEC_SSE2_LONG
+	__m128i acc, x, sign;
+	long t[2];
+#endif
+
+	assert(v != NULL);
+
+#ifdef VEC_SSE2_LONG
+	acc = _mm_setzero_si128();
+	for (; i + 4 <= v->size; i += 4) {
+		/* Sign extend the elements to 64 bits */
+		x = VEC_LOADU(v->data + i);
+		sign = _mm_cmpgt_epi32(_mm_setzero_si128(), x);
+		acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(x, sign));
+		acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(x, sign));
+	}
+	VEC_STOREU(t, acc);
+	sum = t[0] + t[1];
+#endif
+	for (; i < v->size; ++i)
+		sum += v->data[i];
+
+	return sum;
+}
+
+
+/**
+ * \brief Find the smallest element of a vector.
+ *
+ * \param v    The vector to look in.
+ * \param min  A pointer to where the element is stored.
+ *
+ * \return  The vector given as input, or \c NULL if it is empty.
+ *
+ * \sa ivec_max ivec_sum
+ */
+ivec
+ivec_min(ivec v, int *min)
+{
+	unsigned int i = 0;
+	int m;
+#ifdef VEC_SSE2
+	__m128i acc;
+	int t[4];
+#endif
+
+	assert(v != NULL);
+	assert(min != NULL);
+
+	if (v->size == 0)
+		return NULL;
+
+	m = v->data[0];
+#ifdef VEC_SSE2
+	if (v->size >= 4) {
+		acc = VEC_LOADU(v->data);
+		for (i = 4; i + 4 <= v->size; i += 4)
+			acc = vec_min_epi32(acc, VEC_LOADU(v->data + i));
+		VEC_STOREU(t, acc);
+		m = MIN(MIN(t[0], t[1]), MIN(t[2], t[3]));
+	}
+#endif
+	for (; i < v->size; ++i)
+		m = MIN(m, v->data[i]);
+
+	*min = m;
+
+	return v;
+}
+
+
+/**
+ * \brief Find the largest element of a vector.
+ *
+ * \param v    The vector to look in.
+ * \param max  A pointer to where the element is stored.
+ *
+ * \return  The vector given as input, or \c NULL if it is empty.
+ *
+ * \sa ivec_min ivec_sum
+ */
+ivec
+ivec_max(ivec v, int *max)
+{
+	unsigned int i = 0;
+	int m;
+#ifdef VEC_SSE2
+	__m128i acc;
+	int t[4];
+#endif
+
+	assert(v != NULL);
+	assert(max != NULL);
+
+	if (v->size == 0)
+		return NULL;
+
+	m = v->data[0];
+#ifdef VEC_SSE2
+	if (v->size >= 4) {
+		acc = VEC_LOADU(v->data);
+		for (i = 4; i + 4 <= v->size; i += 4)
+			acc = vec_max_epi32(acc, VEC_LOADU(v->data + i));
+		VEC_STOREU(t, acc);
+		m = MAX(MAX(t[0], t[1]), MAX(t[2], t[3]));
+	}
+#endif
+	for (; i < v->size; ++i)
+		m = MAX(m, v->data[i]);
+
+	*max = m;
+
+	return v;
+}
+
+
+/**
+ * \brief Count the elements of a vector which compare to a value in some way.
+ *
+ * \param v      The vector to look in.
+ * \param op     How the elements should compare to \p value.  For example,
+ *		 with \c VEC_LT the elements less than \p value are counted.
+ * \param value  The value to compare the elements to.
+ *
+ * \return  The number of elements for which the comparison holds.
+ *
+ * \sa ivec_find
+ */
+unsigned int
+ivec_count(ivec v, vec_op op, int value)
+{
+	unsigned int i = 0, n = 0;
+#ifdef VEC_SSE2
+	__m128i acc, x, y;
+	vec_sel s;
+	unsigned int t[4];
+#endif
+
+	assert(v != NULL);
+
+#ifdef VEC_SSE2
+	vec_select(&s, op);
+	acc = _mm_setzero_si128();
+	y = _mm_set1_epi32(value);
+	for (; i + 4 <= v->size; i += 4) {
+		x = VEC_LOADU(v->data + i);
+		acc = _mm_sub_epi32(acc, VEC_CMP_EPI32(x, y, &s));
+	}
+	VEC_STOREU(t, acc);
+	n = t[0] + t[1] + t[2] + t[3];
+#endif
+	for (; i < v->size; ++i)
+		n += VEC_TEST(op, v->data[i], value);
+
+	return n;
+}
+
+
+/**
+ * \brief Find the first element of a vector which compares to a value in some
+ * way.
+ *
+ * \param v      The vector to look in.
+ * \param op     How the element should compare to \p value.
+ * \param value  The value to compare the elements to.
+ * \param from   The index to start looking at.
+ *
+ * \return  The index of the first element from \p from on for which the
+ *	     comparison holds, or the size of the vector if there is none.
+ *
+ * \sa ivec_count
+ */
+unsigned int
+ivec_find(ivec v, vec_op op, int value, unsigned int from)
+{
+	unsigned int i;
+#ifdef VEC_SSE2
+	__m128i x, y;
+	vec_sel s;
+	unsigned int m;
+#endif
+
+	assert(v != NULL);
+
+	if (from >= v->size)
+		return v->size;
+
+	i = from;
+#ifdef VEC_SSE2
+	vec_select(&s, op);
+	y = _mm_set1_epi32(value);
+	for (; i + 4 <= v->size; i += 4) {
+		x = VEC_LOADU(v->data + i);
+		m = (unsigned int)_mm_movemask_epi8(VEC_CMP_EPI32(x, y, &s));
+		if (m != 0)
+			return i + vec_first_bit(m) / 4;
+	}
+#endif
+	for (; i < v->size; ++i)
+		if (VEC_TEST(op, v->data[i], value))
+			return i;
+
+	return v->size;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/**
+ * \brief Create a new empty vector of unsigned integers.
+ *
+ * \sa ivec_create
+ */
+uvec
+uvec_create(unsigned int capacity)
+{
+	uvec_t *v;
+
+	if ((v = malloc(sizeof(uvec_t))) == NULL)
+		return NULL;
+
+	v->size = v->capacity = 0;
+	if ((v->data = vec_realloc(NULL, &v->capacity, capacity == 0 ?
+				   VEC_INITIAL_SIZE : capacity,
+				   sizeof(unsigned int), 1)) == NULL) {
+		free(v);
+		return NULL;
+	}
+
+	return (uvec)v;
+}
+
+
+/**
+ * \brief Free all memory allocated for a vector of unsigned integers.
+ *
+ * \sa ivec_destroy
+ */
+void
+uvec_destroy(uvec v)
+{
+	assert(v != NULL);
+
+	free(v->data);
+	free(v);
+}
+
+
+/**
+ * \brief Get the number of elements in a vector of unsigned integers.
+ *
+ * \sa ivec_size
+ */
+unsigned int
+uvec_size(uvec v)
+{
+	assert(v != NULL);
+
+	return v->size;
+}
+
+
+/**
+ * \brief Make room in a vector of unsigned integers for a number of elements.
+ *
+ * \sa ivec_reserve
+ */
+uvec
+uvec_reserve(uvec v, unsigned int capacity)
+{
+	unsigned int *data;
+
+	assert(v != NULL);
+
+	if ((data = vec_realloc(v->data, &v->capacity, capacity,
+				sizeof(unsigned int), 1)) == NULL)
+		return NULL;
+	v->data = data;
+
+	return v;
+}
+
+
+/**
+ * \brief Resize a vector of unsigned integers.
+ *
+ * \sa ivec_resize
+ */
+uvec
+uvec_resize(uvec v, unsigned int size)
+{
+	unsigned int *data;
+
+	assert(v != NULL);
+
+	if ((data = vec_realloc(v->data, &v->capacity, size,
+				sizeof(unsigned int), 0)) == NULL)
+		return NULL;
+	v->data = data;
+	v->size = size;
+
+	return v;
+}
+
+
+/**
+ * \brief Add an element to the end of a vector of unsigned integers.
+ *
+ * \sa ivec_push
+ */
+uvec
+uvec_push(uvec v, unsigned int value)
+{
+	unsigned int *data;
+
+	assert(v != NULL);
+
+	if (v->size == v->capacity) {
+		if (v->size == UINT_MAX) {
+			errno = ENOMEM;
+			return NULL;
+		}
+		if ((data = vec_realloc(v->data, &v->capacity, v->size + 1,
+					sizeof(unsigned int), 0)) == NULL)
+			return NULL;
+		v->data = data;
+	}
+
+	v->data[v->size++] = value;
+
+	return v;
+}
+
+
+/**
+ * \brief Add a number of elements to the end of a vector of unsigned integers.
+ *
+ * \sa ivec_append
+ */
+uvec
+uvec_append(uvec v, const unsigned int *values, unsigned int n)
+{
+	unsigned int *data;
+
+	assert(v != NULL);
+	assert(values != NULL || n == 0);
+
+	if (n > UINT_MAX - v->size) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	if ((data = vec_realloc(v->data, &v->capacity, v->size + n,
+				sizeof(unsigned int), 0)) == NULL)
+		return NULL;
+	v->data = data;
+
+	if (n > 0)
+		memcpy(v->data + v->size, values, n * sizeof(unsigned int));
+	v->size += n;
+
+	return v;
+}
+
+
+/**
+ * \brief Set all elements of a vector of unsigned integers to a value.
+ *
+ * \sa ivec_fill
+ */
+void
+uvec_fill(uvec v, unsigned int value)
+{
+	unsigned int i;
+
+	assert(v != NULL);
+
+	/* Compilers turn this into vector stores by themselves */
+	for (i = 0; i < v->size; ++i)
+		v->data[i] = value;
+}
+
+
+/**
+ * \brief Add up the elements of a vector of unsigned integers.
+ *
+ * \sa ivec_sum
+ */
+unsigned long
+uvec_sum(uvec v)
+{
+	unsigned int i = 0;
+	unsigned long sum = 0;
+#ifdef VEC_SSE2_LONG
+	__m128i acc, x, zero;
+	unsigned long t[2];
+#endif
+
+	assert(v != NULL);
+
+#ifdef VEC_SSE2_LONG
+	acc = zero = _mm_setzero_si128();
+	for (; i + 4 <= v->size; i += 4) {
+		/* Zero extend the elements to 64 bits */
+		x = VEC_LOADU(v->data + i);
+		acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(x, zero));
+		acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(x, zero));
+	}
+	VEC_STOREU(t, acc);
+	sum = t[0] + t[1];
+#endif
+	for (; i < v->size; ++i)
+		sum += v->data[i];
+
+	return sum;
+}
+
+
+/**
+ * \brief Find the smallest element of a vector of unsigned integers.
+ *
+ * \sa ivec_min
+ */
+uvec
+uvec_min(uvec v, unsigned int *min)
+{
+	unsigned int i = 0;
+	unsigned int m;
+#ifdef VEC_SSE2
+	__m128i acc, bias, x;
+	unsigned int t[4];
+#endif
+
+	assert(v != NULL);
+	assert(min != NULL);
+
+	if (v->size == 0)
+		return NULL;
+
+	m = v->data[0];
+#ifdef VEC_SSE2
+	if (v->size >= 4) {
+		/* Flip the sign bits, so signed comparisons order them */
+		bias = _mm_set1_epi32(INT_MIN);
+		acc = _mm_xor_si128(bias, VEC_LOADU(v->data));
+		for (i = 4; i + 4 <= v->size; i += 4) {
+			x = _mm_xor_si128(bias, VEC_LOADU(v->data + i));
+			acc = vec_min_epi32(acc, x);
+		}
+		VEC_STOREU(t, _mm_xor_si128(bias, acc));
+		m = MIN(MIN(t[0], t[1]), MIN(t[2], t[3]));
+	}
+#endif
+	for (; i < v->size; ++i)
+		m = MIN(m, v->data[i]);
+
+	*min = m;
+
+	return v;
+}
+
+
+/**
+ * \brief Find the largest element of a vector of unsigned integers.
+ *
+ * \sa ivec_max
+ */
+uvec
+uvec_max(uvec v, unsigned int *max)
+{
+	unsigned int i = 0;
+	unsigned int m;
+#ifdef VEC_SSE2
+	__m128i acc, bias, x;
+	unsigned int t[4];
+#endif
+
+	assert(v != NULL);
+	assert(max != NULL);
+
+	if (v->size == 0)
+		return NULL;
+
+	m = v->data[0];
+#ifdef VEC_SSE2
+	if (v->size >= 4) {
+		/* Flip the sign bits, so signed comparisons order them */
+		bias = _mm_set1_epi32(INT_MIN);
+		acc = _mm_xor_si128(bias, VEC_LOADU(v->data));
+		for (i = 4; i + 4 <= v->size; i += 4) {
+			x = _mm_xor_si128(bias, VEC_LOADU(v->data + i));
+			acc = vec_max_epi32(acc, x);
+		}
+		VEC_STOREU(t, _mm_xor_si128(bias, acc));
+		m = MAX(MAX(t[0], t[1]), MAX(t[2], t[3]));
+	}
+#endif
+	for (; i < v->size; ++i)
+		m = MAX(m, v->data[i]);
+
+	*max = m;
+
+	return v;
+}
+
+
+/**
+ * \brief Count the elements of a vector of unsigned integers which compare to
+ * a value in some way.
+ *
+ * \sa ivec_count
+ */
+unsigned int
+uvec_count(uvec v, vec_op op, unsigned int value)
+{
+	unsigned int i = 0, n = 0;
+#ifdef VEC_SSE2
+	__m128i acc, bias, x, y;
+	vec_sel s;
+	unsigned int t[4];
+#endif
+
+	assert(v != NULL);
+
+#ifdef VEC_SSE2
+	vec_select(&s, op);
+	acc = _mm_setzero_si128();
+	bias = _mm_set1_epi32(INT_MIN);
+	y = _mm_xor_si128(bias, _mm_set1_epi32((int)value));
+	for (; i + 4 <= v->size; i += 4) {
+		x = _mm_xor_si128(bias, VEC_LOADU(v->data + i));
+		acc = _mm_sub_epi32(acc, VEC_CMP_EPI32(x, y, &s));
+	}
+	VEC_STOREU(t, acc);
+	n = t[0] + t[1] + t[2] + t[3];
+#endif
+	for (; i < v->size; ++i)
+		n += VEC_TEST(op, v->data[i], value);
+
+	return n;
+}
+
+
+/**
+ * \brief Find the first element of a vector of unsigned integers which
+ * compares to a value in some way.
+ *
+ * \sa ivec_find
+ */
+unsigned int
+uvec_find(uvec v, vec_op op, unsigned int value, unsigned int from)
+{
+	unsigned int i;
+#ifdef VEC_SSE2
+	__m128i bias, x, y;
+	vec_sel s;
+	unsigned int m;
+#endif
+
+	assert(v != NULL);
+
+	if (from >= v->size)
+		return v->size;
+
+	i = from;
+#ifdef VEC_SSE2
+	vec_select(&s, op);
+	bias = _mm_set1_epi32(INT_MIN);
+	y = _mm_xor_si128(bias, _mm_set1_epi32((int)value));
+	for (; i + 4 <= v->size; i += 4) {
+		x = _mm_xor_si128(bias, VEC_LOADU(v->data + i));
+		m = (unsigned int)_mm_movemask_epi8(VEC_CMP_EPI32(x, y, &s));
+		if (m != 0)
+			return i + vec_first_bit(m) / 4;
+	}
+#endif
+	for (; i < v->size; ++i)
+		if (VEC_TEST(op, v->data[i], value))
+			return i;
+
+	return v->size;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/**
+ * \brief Create a new empty vector of long integers.
+ *
+ * \sa ivec_create
+ */
+lvec
+lvec_create(unsigned int capacity)
+{
+	lvec_t *v;
+
+	if ((v = malloc(sizeof(lvec_t))) == NULL)
+		return NULL;
+
+	v->size = v->capacity = 0;
+	if ((v->data = vec_realloc(NULL, &v->capacity, capacity == 0 ?
+				   VEC_INITIAL_SIZE : capacity,
+				   sizeof(long), 1)) == NULL) {
+		free(v);
+		return NULL;
+	}
+
+	return (lvec)v;
+}
+
+
+/**
+ * \brief Free all memory allocated for a vector of long integers.
+ *
+ * \sa ivec_destroy
+ */
+void
+lvec_destroy(lvec v)
+{
+	assert(v != NULL);
+
+	free(v->data);
+	free(v);
+}
+
+
+/**
+ * \brief Get the number of elements in a vector of long integers.
+ *
+ * \sa ivec_size
+ */
+unsigned int
+lvec_size(lvec v)
+{
+	assert(v != NULL);
+
+	return v->size;
+}
+
+
+/**
+ * \brief Make room in a vector of long integers for a number of elements.
+ *
+ * \sa ivec_reserve
+ */
+lvec
+lvec_reserve(lvec v, unsigned int capacity)
+{
+	long *data;
+
+	assert(v != NULL);
+
+	if ((data = vec_realloc(v->data, &v->capacity, capacity,
+				sizeof(long), 1)) == NULL)
+		return NULL;
+	v->data = data;
+
+	return v;
+}
+
+
+/**
+ * \brief Resize a vector of long integers.
+ *
+ * \sa ivec_resize
+ */
+lvec
+lvec_resize(lvec v, unsigned int size)
+{
+	long *data;
+
+	assert(v != NULL);
+
+	if ((data = vec_realloc(v->data, &v->capacity, size,
+				sizeof(long), 0)) == NULL)
+		return NULL;
+	v->data = data;
+	v->size = size;
+
+	return v;
+}
+
+
+/**
+ * \brief Add an element to the end of a vector of long integers.
+ *
+ * \sa ivec_push
+ */
+lvec
+lvec_push(lvec v, long value)
+{
+	long *data;
+
+	assert(v != NULL);
+
+	if (v->size == v->capacity) {
+		if (v->size == UINT_MAX) {
+			errno = ENOMEM;
+			return NULL;
+		}
+		if ((data = vec_realloc(v->data, &v->capacity, v->size + 1,
+					sizeof(long), 0)) == NULL)
+			return NULL;
+		v->data = data;
+	}
+
+	v->data[v->size++] = value;
+
+	return v;
+}
+
+
+/**
+ * \brief Add a number of elements to the end of a vector of long integers.
+ *
+ * \sa ivec_append
+ */
+lvec
+lvec_append(lvec v, const long *values, unsigned int n)
+{
+	long *data;
+
+	assert(v != NULL);
+	assert(values != NULL || n == 0);
+
+	if (n > UINT_MAX - v->size) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	if ((data = vec_realloc(v->data, &v->capacity, v->size + n,
+				sizeof(long), 0)) == NULL)
+		return NULL;
+	v->data = data;
+
+	if (n > 0)
+		memcpy(v->data + v->size, values, n * sizeof(long));
+	v->size += n;
+
+	return v;
+}
+
+
+/**
+ * \brief Set all elements of a vector of long integers to a value.
+ *
+ * \sa ivec_fill
+ */
+void
+lvec_fill(lvec v, long value)
+{
+	unsigned int i;
+
+	assert(v != NULL);
+
+	/* Compilers turn this into vector stores by themselves */
+	for (i = 0; i < v->size; ++i)
+		v->data[i] = value;
+}
+
+
+/**
+ * \brief Add up the elements of a vector of long integers.
+ *
+ * If the sum overflows, it wraps around.
+ *
+ * \sa ivec_sum
+ */
+long
+lvec_sum(lvec v)
+{
+	unsigned int i = 0;
+	long sum = 0;
+#ifdef VEC_SSE2_LONG
+	__m128i acc;
+	unsigned long t[2];
+#endif
+
+	assert(v != NULL);
+
+#ifdef VEC_SSE2_LONG
+	acc = _mm_setzero_si128();
+	for (; i + 2 <= v->size; i += 2)
+		acc = _mm_add_epi64(acc, VEC_LOADU(v->data + i));
+	VEC_STOREU(t, acc);
+	sum = vec_long(t[0] + t[1]);
+#endif
+	for (; i < v->size; ++i)
+		sum = vec_long((unsigned long)sum +
+			       (unsigned long)v->data[i]);
+
+	return sum;
+}
+
+
+/**
+ * \brief Find the smallest element of a vector of long integers.
+ *
+ * \sa ivec_min
+ */
+lvec
+lvec_min(lvec v, long *min)
+{
+	unsigned int i = 0;
+	long m;
+
+	assert(v != NULL);
+	assert(min != NULL);
+
+	if (v->size == 0)
+		return NULL;
+
+	m = v->data[0];
+	for (; i < v->size; ++i)
+		m = MIN(m, v->data[i]);
+
+	*min = m;
+
+	return v;
+}
+
+
+/**
+ * \brief Find the largest element of a vector of long integers.
+ *
+ * \sa ivec_max
+ */
+lvec
+lvec_max(lvec v, long *max)
+{
+	unsigned int i = 0;
+	long m;
+
+	assert(v != NULL);
+	assert(max != NULL);
+
+	if (v->size == 0)
+		return NULL;
+
+	m = v->data[0];
+	for (; i < v->size; ++i)
+		m = MAX(m, v->data[i]);
+
+	*max = m;
+
+	return v;
+}
+
+
+/**
+ * \brief Count the elements of a vector of long integers which compare to a
+ * value in some way.
+ *
+ * \sa ivec_count
+ */
+unsigned int
+lvec_count(lvec v, vec_op op, long value)
+{
+	unsigned int i = 0, n = 0;
+
+	assert(v != NULL);
+
+	for (; i < v->size; ++i)
+		n += VEC_TEST(op, v->data[i], value);
+
+	return n;
+}
+
+
+/**
+ * \brief Find the first element of a vector of long integers which compares to
+ * a value in some way.
+ *
+ * \sa ivec_find
+ */
+unsigned int
+lvec_find(lvec v, vec_op op, long value, unsigned int from)
+{
+	unsigned int i;
+
+	assert(v != NULL);
+
+	if (from >= v->size)
+		return v->size;
+
+	i = from;
+	for (; i < v->size; ++i)
+		if (VEC_TEST(op, v->data[i], value))
+			return i;
+
+	return v->size;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/**
+ * \brief Create a new empty vector of floating point numbers.
+ *
+ * \sa ivec_create
+ */
+dvec
+dvec_create(unsigned int capacity)
+{
+	dvec_t *v;
+
+	if ((v = malloc(sizeof(dvec_t))) == NULL)
+		return NULL;
+
+	v->size = v->capacity = 0;
+	if ((v->data = vec_realloc(NULL, &v->capacity, capacity == 0 ?
+				   VEC_INITIAL_SIZE : capacity,
+				   sizeof(double), 1)) == NULL) {
+		free(v);
+		return NULL;
+	}
+
+	return (dvec)v;
+}
+
+
+/**
+ * \brief Free all memory allocated for a vector of floating point numbers.
+ *
+ * \sa ivec_destroy
+ */
+void
+dvec_destroy(dvec v)
+{
+	assert(v != NULL);
+
+	free(v->data);
+	free(v);
+}
+
+
+/**
+ * \brief Get the number of elements in a vector of floating point numbers.
+ *
+ * \sa ivec_size
+ */
+unsigned int
+dvec_size(dvec v)
+{
+	assert(v != NULL);
+
+	return v->size;
+}
+
+
+/**
+ * \brief Make room in a vector of floating point numbers for a number of
+ * elements.
+ *
+ * \sa ivec_reserve
+ */
+dvec
+dvec_reserve(dvec v, unsigned int capacity)
+{
+	double *data;
+
+	assert(v != NULL);
+
+	if ((data = vec_realloc(v->data, &v->capacity, capacity,
+				sizeof(double), 1)) == NULL)
+		return NULL;
+	v->data = data;
+
+	return v;
+}
+
+
+/**
+ * \brief Resize a vector of floating point numbers.
+ *
+ * \sa ivec_resize
+ */
+dvec
+dvec_resize(dvec v, unsigned int size)
+{
+	double *data;
+
+	assert(v != NULL);
+
+	if ((data = vec_realloc(v->data, &v->capacity, size,
+				sizeof(double), 0)) == NULL)
+		return NULL;
+	v->data = data;
+	v->size = size;
+
+	return v;
+}
+
+
+/**
+ * \brief Add an element to the end of a vector of floating point numbers.
+ *
+ * \sa ivec_push
+ */
+dvec
+dvec_push(dvec v, double value)
+{
+	double *data;
+
+	assert(v != NULL);
+
+	if (v->size == v->capacity) {
+		if (v->size == UINT_MAX) {
+			errno = ENOMEM;
+			return NULL;
+		}
+		if ((data = vec_realloc(v->data, &v->capacity, v->size + 1,
+					sizeof(double), 0)) == NULL)
+			return NULL;
+		v->data = data;
+	}
+
+	v->data[v->size++] = value;
+
+	return v;
+}
+
+
+/**
+ * \brief Add a number of elements to the end of a vector of floating point
+ * numbers.
+ *
+ * \sa ivec_append
+ */
+dvec
+dvec_append(dvec v, const double *values, unsigned int n)
+{
+	double *data;
+
+	assert(v != NULL);
+	assert(values != NULL || n == 0);
+
+	if (n > UINT_MAX - v->size) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	if ((data = vec_realloc(v->data, &v->capacity, v->size + n,
+				sizeof(double), 0)) == NULL)
+		return NULL;
+	v->data = data;
+
+	if (n > 0)
+		memcpy(v->data + v->size, values, n * sizeof(double));
+	v->size += n;
+
+	return v;
+}
+
+
+/**
+ * \brief Set all elements of a vector of floating point numbers to a value.
+ *
+ * \sa ivec_fill
+ */
+void
+dvec_fill(dvec v, double value)
+{
+	unsigned int i;
+
+	assert(v != NULL);
+
+	/* Compilers turn this into vector stores by themselves */
+	for (i = 0; i < v->size; ++i)
+		v->data[i] = value;
+}
+
+
+/**
+ * \brief Add up the elements of a vector of floating point numbers.
+ *
+ * \attention
+ * The elements are not added in order, so the result may differ slightly
+ * from adding them up one by one.
+ *
+ * \sa ivec_sum
+ */
+double
+dvec_sum(dvec v)
+{
+	unsigned int i = 0;
+	double sum = 0;
+#ifdef VEC_SSE2
+	__m128d acc0, acc1;
+	double t[2];
+#endif
+
+	assert(v != NULL);
+
+#ifdef VEC_SSE2
+	/* Two accumulators, so the additions don't wait for each other */
+	acc0 = acc1 = _mm_setzero_pd();
+	for (; i + 4 <= v->size; i += 4) {
+		acc0 = _mm_add_pd(acc0, _mm_loadu_pd(v->data + i));
+		acc1 = _mm_add_pd(acc1, _mm_loadu_pd(v->data + i + 2));
+	}
+	_mm_storeu_pd(t, _mm_add_pd(acc0, acc1));
+	sum = t[0] + t[1];
+#endif
+	for (; i < v->size; ++i)
+		sum += v->data[i];
+
+	return sum;
+}
+
+
+/**
+ * \brief Find the smallest element of a vector of floating point numbers.
+ *
+ * If there are any NaNs, the result is unspecified.
+ *
+ * \sa ivec_min
+ */
+dvec
+dvec_min(dvec v, double *min)
+{
+	unsigned int i = 0;
+	double m;
+#ifdef VEC_SSE2
+	__m128d acc;
+	double t[2];
+#endif
+
+	assert(v != NULL);
+	assert(min != NULL);
+
+	if (v->size == 0)
+		return NULL;
+
+	m = v->data[0];
+#ifdef VEC_SSE2
+	if (v->size >= 2) {
+		acc = _mm_loadu_pd(v->data);
+		for (i = 2; i + 2 <= v->size; i += 2)
+			acc = _mm_min_pd(acc, _mm_loadu_pd(v->data + i));
+		_mm_storeu_pd(t, acc);
+		m = MIN(t[0], t[1]);
+	}
+#endif
+	for (; i < v->size; ++i)
+		m = MIN(m, v->data[i]);
+
+	*min = m;
+
+	return v;
+}
+
+
+/**
+ * \brief Find the largest element of a vector of floating point numbers.
+ *
+ * If there are any NaNs, the result is unspecified.
+ *
+ * \sa ivec_max
+ */
+dvec
+dvec_max(dvec v, double *max)
+{
+	unsigned int i = 0;
+	double m;
+#ifdef VEC_SSE2
+	__m128d acc;
+	double t[2];
+#endif
+
+	assert(v != NULL);
+	assert(max != NULL);
+
+	if (v->size == 0)
+		return NULL;
+
+	m = v->data[0];
+#ifdef VEC_SSE2
+	if (v->size >= 2) {
+		acc = _mm_loadu_pd(v->data);
+		for (i = 2; i + 2 <= v->size; i += 2)
+			acc = _mm_max_pd(acc, _mm_loadu_pd(v->data + i));
+		_mm_storeu_pd(t, acc);
+		m = MAX(t[0], t[1]);
+	}
+#endif
+	for (; i < v->size; ++i)
+		m = MAX(m, v->data[i]);
+
+	*max = m;
+
+	return v;
+}
+
+
+/**
+ * \brief Count the elements of a vector of floating point numbers which
+ * compare to a value in some way.
+ *
+ * \sa ivec_count
+ */
+unsigned int
+dvec_count(dvec v, vec_op op, double value)
+{
+	unsigned int i = 0, n = 0;
+#ifdef VEC_SSE2
+	__m128d y;
+	unsigned int m;
+#endif
+
+	assert(v != NULL);
+
+#ifdef VEC_SSE2
+	y = _mm_set1_pd(value);
+	for (; i + 2 <= v->size; i += 2) {
+		m = (unsigned int)vec_cmp_pd(_mm_loadu_pd(v->data + i), y,
+					     op);
+		n += (m & 1) + (m >> 1);
+	}
+#endif
+	for (; i < v->size; ++i)
+		n += VEC_TEST(op, v->data[i], value);
+
+	return n;
+}
+
+
+/**
+ * \brief Find the first element of a vector of floating point numbers which
+ * compares to a value in some way.
+ *
+ * \sa ivec_find
+ */
+unsigned int
+dvec_find(dvec v, vec_op op, double value, unsigned int from)
+{
+	unsigned int i;
+#ifdef VEC_SSE2
+	__m128d y;
+	int m;
+#endif
+
+	assert(v != NULL);
+
+	if (from >= v->size)
+		return v->size;
+
+	i = from;
+#ifdef VEC_SSE2
+	y = _mm_set1_pd(value);
+	for (; i + 2 <= v->size; i += 2) {
+		m = vec_cmp_pd(_mm_loadu_pd(v->data + i), y, op);
+		if (m != 0)
+			return i + ((m & 1) ? 0 : 1);
+	}
+#endif
+	for (; i < v->size; ++i)
+		if (VEC_TEST(op, v->data[i], value))
+			return i;
+
+	return v->size;
+}
+
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/**
+ * \brief Create a new empty vector of bytes.
+ *
+ * \sa ivec_create
+ */
+bvec
+bvec_create(unsigned int capacity)
+{
+	bvec_t *v;
+
+	if ((v = malloc(sizeof(bvec_t))) == NULL)
+		return NULL;
+
+	v->size = v->capacity = 0;
+	if ((v->data = vec_realloc(NULL, &v->capacity, capacity == 0 ?
+				   VEC_INITIAL_SIZE : capacity,
+				   sizeof(unsigned char), 1)) == NULL) {
+		free(v);
+		return NULL;
+	}
+
+	return (bvec)v;
+}
+
+
+/**
+ * \brief Free all memory allocated for a vector of bytes.
+ *
+ * \sa ivec_destroy
+ */
+void
+bvec_destroy(bvec v)
+{
+	assert(v != NULL);
+
+	free(v->data);
+	free(v);
+}
+
+
+/**
+ * \brief Get the number of elements in a vector of bytes.
+ *
+ * \sa ivec_size
+ */
+unsigned int
+bvec_size(bvec v)
+{
+	assert(v != NULL);
+
+	return v->size;
+}
+
+
+/**
+ * \brief Make room in a vector of bytes for a number of elements.
+ *
+ * \sa ivec_reserve
+ */
+bvec
+bvec_reserve(bvec v, unsigned int capacity)
+{
+	unsigned char *data;
+
+	assert(v != NULL);
+
+	if ((data = vec_realloc(v->data, &v->capacity, capacity,
+				sizeof(unsigned char), 1)) == NULL)
+		return NULL;
+	v->data = data;
+
+	return v;
+}
+
+
+/**
+ * \brief Resize a vector of bytes.
+ *
+ * \sa ivec_resize
+ */
+bvec
+bvec_resize(bvec v, unsigned int size)
+{
+	unsigned char *data;
+
+	assert(v != NULL);
+
+	if ((data = vec_realloc(v->data, &v->capacity, size,
+				sizeof(unsigned char), 0)) == NULL)
+		return NULL;
+	v->data = data;
+	v->size = size;
+
+	return v;
+}
+
+
+/**
+ * \brief Add an element to the end of a vector of bytes.
+ *
+ * \sa ivec_push
+ */
+bvec
+bvec_push(bvec v, unsigned char value)
+{
+	unsigned char *data;
+
+	assert(v != NULL);
+
+	if (v->size == v->capacity) {
+		if (v->size == UINT_MAX) {
+			errno = ENOMEM;
+			return NULL;
+		}
+		if ((data = vec_realloc(v->data, &v->capacity, v->size + 1,
+					sizeof(unsigned char), 0)) == NULL)
+			return NULL;
+		v->data = data;
+	}
+
+	v->data[v->size++] = value;
+
+	return v;
+}
+
+
+/**
+ * \brief Add a number of elements to the end of a vector of bytes.
+ *
+ * \sa ivec_append
+ */
+bvec
+bvec_append(bvec v, const unsigned char *values, unsigned int n)
+{
+	unsigned char *data;
+
+	assert(v != NULL);
+	assert(values != NULL || n == 0);
+
+	if (n > UINT_MAX - v->size) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	if ((data = vec_realloc(v->data, &v->capacity, v->size + n,
+				sizeof(unsigned char), 0)) == NULL)
+		return NULL;
+	v->data = data;
+
+	if (n > 0)
+		memcpy(v->data + v->size, values, n * sizeof(unsigned char));
+	v->size += n;
+
+	return v;
+}
+
+
+/**
+ * \brief Set all elements of a vector of bytes to a value.
+ *
+ * \sa ivec_fill
+ */
+void
+bvec_fill(bvec v, unsigned char value)
+{
+	assert(v != NULL);
+
+	memset(v->data, value, v->size);
+}
+
+
+/**
+ * \brief Add up the elements of a vector of bytes.
+ *
+ * \sa ivec_sum
+ */
+unsigned long
+bvec_sum(bvec v)
+{
+	unsigned int i = 0;
+	unsigned long sum = 0;
+#ifdef VEC_SSE2_LONG
+	__m128i acc;
+	unsigned long t[2];
+#endif
+
+	assert(v != NULL);
+
+#ifdef VEC_SSE2_LONG
+	/* Sums of absolute differences with 0 add up groups of 8 bytes */
+	acc = _mm_setzero_si128();
+	for (; i + 16 <= v->size; i += 16)
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(VEC_LOADU(v->data + i),
+						      _mm_setzero_si128()));
+	VEC_STOREU(t, acc);
+	sum = t[0] + t[1];
+#endif
+	for (; i < v->size; ++i)
+		sum += v->data[i];
+
+	return sum;
+}
+
+
+/**
+ * \brief Find the smallest element of a vector of bytes.
+ *
+ * \sa ivec_min
+ */
+bvec
+bvec_min(bvec v, unsigned char *min)
+{
+	unsigned int i = 0;
+	unsigned char m;
+#ifdef VEC_SSE2
+	__m128i acc;
+	unsigned char t[16];
+	unsigned int j;
+#endif
+
+	assert(v != NULL);
+	assert(min != NULL);
+
+	if (v->size == 0)
+		return NULL;
+
+	m = v->data[0];
+#ifdef VEC_SSE2
+	if (v->size >= 16) {
+		acc = VEC_LOADU(v->data);
+		for (i = 16; i + 16 <= v->size; i += 16)
+			acc = _mm_min_epu8(acc, VEC_LOADU(v->data + i));
+		VEC_STOREU(t, acc);
+		for (j = 0; j < 16; ++j)
+			m = MIN(m, t[j]);
+	}
+#endif
+	for (; i < v->size; ++i)
+		m = MIN(m, v->data[i]);
+
+	*min = m;
+
+	return v;
+}
+
+
+/**
+ * \brief Find the largest element of a vector of bytes.
+ *
+ * \sa ivec_max
+ */
+bvec
+bvec_max(bvec v, unsigned char *max)
+{
+	unsigned int i = 0;
+	unsigned char m;
+#ifdef VEC_SSE2
+	__m128i acc;
+	unsigned char t[16];
+	unsigned int j;
+#endif
+
+	assert(v != NULL);
+	assert(max != NULL);
+
+	if (v->size == 0)
+		return NULL;
+
+	m = v->data[0];
+#ifdef VEC_SSE2
+	if (v->size >= 16) {
+		acc = VEC_LOADU(v->data);
+		for (i = 16; i + 16 <= v->size; i += 16)
+			acc = _mm_max_epu8(acc, VEC_LOADU(v->data + i));
+		VEC_STOREU(t, acc);
+		for (j = 0; j < 16; ++j)
+			m = MAX(m, t[j]);
+	}
+#endif
+	for (; i < v->size; ++i)
+		m = MAX(m, v->data[i]);
+
+	*max = m;
+
+	return v;
+}
+
+
+/**
+ * \brief Count the elements of a vector of bytes which compare to a value in
+ * some way.
+ *
+ * \sa ivec_count
+ */
+unsigned int
+bvec_count(bvec v, vec_op op, unsigned char value)
+{
+	unsigned int i = 0, n = 0;
+#ifdef VEC_SSE2
+	__m128i bias, x, y;
+	vec_sel s;
+#endif
+
+	assert(v != NULL);
+
+#ifdef VEC_SSE2
+	vec_select(&s, op);
+	bias = _mm_set1_epi8((char)0x80);
+	y = _mm_xor_si128(bias, _mm_set1_epi8((char)value));
+	for (; i + 16 <= v->size; i += 16) {
+		x = _mm_xor_si128(bias, VEC_LOADU(v->data + i));
+		n += vec_popcount((unsigned int)_mm_movemask_epi8(
+			VEC_CMP_EPI8(x, y, &s)));
+	}
+#endif
+	for (; i < v->size; ++i)
+		n += VEC_TEST(op, v->data[i], value);
+
+	return n;
+}
+
+
+/**
+ * \brief Find the first element of a vector of bytes which compares to a value
+ * in some way.
+ *
+ * \sa ivec_find
+ */
+unsigned int
+bvec_find(bvec v, vec_op op, unsigned char value, unsigned int from)
+{
+	unsigned int i;
+#ifdef VEC_SSE2
+	__m128i bias, x, y;
+	vec_sel s;
+	unsigned int m;
+#endif
+
+	assert(v != NULL);
+
+	if (from >= v->size)
+		return v->size;
+
+	i = from;
+#ifdef VEC_SSE2
+	vec_select(&s, op);
+	bias = _mm_set1_epi8((char)0x80);
+	y = _mm_xor_si128(bias, _mm_set1_epi8((char)value));
+	for (; i + 16 <= v->size; i += 16) {
+		x = _mm_xor_si128(bias, VEC_LOADU(v->data + i));
+		m = (unsigned int)_mm_movemask_epi8(VEC_CMP_EPI8(x, y, &s));
+		if (m != 0)
+			return i + vec_first_bit(m);
+	}
+#endif
+	for (; i < v->size; ++i)
+		if (VEC_TEST(op, v->data[i], value))
+			return i;
+
+	return v->size;
+}
@@ -0,0 +1,165 @@
+/*
+ * $Id$
+ *
+ * Copyright (c) 2004 Peter Bex and Vincent Driessen
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the names of Peter Bex or Vincent Driessen nor the names of any
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY PETER BEX AND VINCENT DRIESSEN AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \brief Typed vectors interface.
+ *
+ * \file vec.h
+ */
+#ifndef GUNE_VEC_H
+#define GUNE_VEC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Comparison used to select elements in count and find */
+typedef enum {
+	VEC_LT,			/**< Elements less than the value */
+	VEC_LE,			/**< Elements less than or equal to the
+				     value */
+	VEC_EQ,			/**< Elements equal to the value */
+	VEC_NE,			/**< Elements not equal to the value */
+	VEC_GE,			/**< Elements greater than or equal to the
+				     value */
+	VEC_GT			/**< Elements greater than the value */
+} vec_op;
+
+/** \brief Vector of signed integers */
+typedef struct ivec_t {
+	int *data;		/**< The elements, one after the other */
+	unsigned int size;	/**< The number of elements */
+	unsigned int capacity;	/**< Room for this many elements */
+} ivec_t, *ivec;
+
+/** \brief Vector of unsigned integers */
+typedef struct uvec_t {
+	unsigned int *data;	/**< The elements, one after the other */
+	unsigned int size;	/**< The number of elements */
+	unsigned int capacity;	/**< Room for this many elements */
+} uvec_t, *uvec;
+
+/** \brief Vector of long integers */
+typedef struct lvec_t {
+	long *data;		/**< The elements, one after the other */
+	unsigned int size;	/**< The number of elements */
+	unsigned int capacity;	/**< Room for this many elements */
+} lvec_t, *lvec;
+
+/** \brief Vector of floating point numbers */
+typedef struct dvec_t {
+	double *data;		/**< The elements, one after the other */
+	unsigned int size;	/**< The number of elements */
+	unsigned int capacity;	/**< Room for this many elements */
+} dvec_t, *dvec;
+
+/** \brief Vector of bytes */
+typedef struct bvec_t {
+	unsigned char *data;	/**< The elements, one after the other */
+	unsigned int size;	/**< The number of elements */
+	unsigned int capacity;	/**< Room for this many elements */
+} bvec_t, *bvec;
+
+ivec ivec_create(unsigned int);
+void ivec_destroy(ivec);
+unsigned int ivec_size(ivec);
+ivec ivec_reserve(ivec, unsigned int);
+ivec ivec_resize(ivec, unsigned int);
+ivec ivec_push(ivec, int);
+ivec ivec_append(ivec, const int *, unsigned int);
+void ivec_fill(ivec, int);
+long ivec_sum(ivec);
+ivec ivec_min(ivec, int *);
+ivec ivec_max(ivec, int *);
+unsigned int ivec_count(ivec, vec_op, int);
+unsigned int ivec_find(ivec, vec_op, int, unsigned int);
+
+uvec uvec_create(unsigned int);
+void uvec_destroy(uvec);
+unsigned int uvec_size(uvec);
+uvec uvec_reserve(uvec, unsigned int);
+uvec uvec_resize(uvec, unsigned int);
+uvec uvec_push(uvec, unsigned int);
+uvec uvec_append(uvec, const unsigned int *, unsigned int);
+void uvec_fill(uvec, unsigned int);
+unsigned long uvec_sum(uvec);
+uvec uvec_min(uvec, unsigned int *);
+uvec uvec_max(uvec, unsigned int *);
+unsigned int uvec_count(uvec, vec_op, unsigned int);
+unsigned int uvec_find(uvec, vec_op, unsigned int, unsigned int);
+
+lvec lvec_create(unsigned int);
+void lvec_destroy(lvec);
+unsigned int lvec_size(lvec);
+lvec lvec_reserve(lvec, unsigned int);
+lvec lvec_resize(lvec, unsigned int);
+lvec lvec_push(lvec, long);
+lvec lvec_append(lvec, const long *, unsigned int);
+void lvec_fill(lvec, long);
+long lvec_sum(lvec);
+lvec lvec_min(lvec, long *);
+lvec lvec_max(lvec, long *);
+unsigned int lvec_count(lvec, vec_op, long);
+unsigned int lvec_find(lvec, vec_op, long, unsigned int);
+
+dvec dvec_create(unsigned int);
+void dvec_destroy(dvec);
+unsigned int dvec_size(dvec);
+dvec dvec_reserve(dvec, unsigned int);
+dvec dvec_resize(dvec, unsigned int);
+dvec dvec_push(dvec, double);
+dvec dvec_append(dvec, const double *, unsigned int);
+void dvec_fill(dvec, double);
+double dvec_sum(dvec);
+dvec dvec_min(dvec, double *);
+dvec dvec_max(dvec, double *);
+unsigned int dvec_count(dvec, vec_op, double);
+unsigned int dvec_find(dvec, vec_op, double, unsigned int);
+
+bvec bvec_create(unsigned int);
+void bvec_destroy(bvec);
+unsigned int bvec_size(bvec);
+bvec bvec_reserve(bvec, unsigned int);
+bvec bvec_resize(bvec, unsigned int);
+bvec bvec_push(bvec, unsigned char);
+bvec bvec_append(bvec, const unsigned char *, unsigned int);
+void bvec_fill(bvec, unsigned char);
+unsigned long bvec_sum(bvec);
+bvec bvec_min(bvec, unsigned char *);
+bvec bvec_max(bvec, unsigned char *);
+unsigned int bvec_count(bvec, vec_op, unsigned char);
+unsigned int bvec_find(bvec, vec_op, unsigned char, unsigned int);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GUNE_VEC_H */
@@ -29,15 +29,38 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#ifdef GUNE_THREADS
+/* For clock_gettime, which is hidden in strict ANSI mode */
+#define _POSIX_C_SOURCE	200112L
+#endif
+
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include <gune/gune.h>
 
+#ifdef GUNE_THREADS
+#include <pthread.h>
+#include <gune/cht.h>
+#include <gune/lfht.h>
+
+#define CHT_TEST_THREADS	4
+
+/* Items per table in a merge which uses threads (HT_MERGE_PARALLEL_MIN) */
+#define MERGE_PARALLEL_ITEMS	131072
+#endif
+
 #define DEFNUM			100
 #define DEFLOOPCOUNT		10
 #define COMPACTISE_MODULO	7
+#define DEFBENCHNUM		100000
+
+/* Number of calls to counting_str_eq */
+unsigned long eq_calls;
 
 void
 strcat_tester(char *s)
@@ -62,6 +85,15 @@ walker(gendata *key, gendata *value, gendata customdata)
 	assert(key->num == value->num);
 }
 
+
+/* Count the entries visited, in the int pointed to by customdata */
+void
+counting_walker(gendata *key, gendata *value, gendata customdata)
+{
+	assert(key->num == value->num);
+	++*(int *)customdata.ptr;
+}
+
 void
 stress_test_alist(int amt)
 {
@@ -97,19 +129,120 @@ stress_test_alist(int amt)
 		al = alist_delete(al, x, num_eq, NULL, NULL);
 	}
 	assert(alist_empty(al));
+
+	printf("Creating an association list with %d hashed items...\n", amt);
+	for (i = 0; i < amt; ++i) {
+		x.num = y.num = i;
+		al = alist_insert_uniq_hashed(al, num_fullhash(x), x, y,
+					      num_eq);
+		assert(alist_lookup_hashed(al, num_fullhash(x), x, num_eq,
+					   &y) != NULL);
+		assert(x.num == y.num);
+
+		/* Keys are only equal if their hashes are */
+		assert(alist_lookup_hashed(al, num_fullhash(x) + 1, x, num_eq,
+					   &y) == NULL);
+	}
+	assert(alist_count(al) == (unsigned int)amt);
+
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		al = alist_delete_hashed(al, num_fullhash(x), x, num_eq,
+					 NULL, NULL);
+	}
+	assert(alist_empty(al));
 	alist_destroy(al, NULL, NULL);
 }
 
 
+/* Walker which deletes every entry it visits from the table in customdata */
 void
-stress_test_ht(int amt)
+deleting_walker(gendata *key, gendata *value, gendata customdata)
+{
+	assert(key->num == value->num);
+	ht_delete(customdata.ptr, *key, num_eq, NULL, NULL);
+}
+
+
+/* Mark the keys below the size of the array pointed to by customdata */
+void
+scan_walker(gendata *key, gendata *value, gendata customdata)
+{
+	int *seen = customdata.ptr;
+
+	assert(key->num == value->num);
+	if (key->num < seen[0])
+		++seen[key->num + 1];
+}
+
+
+/*
+ * Scan a table holding the keys 0..amt-1 in small batches.  Between the
+ * batches, keys from amt on are inserted (if grow is nonzero) or deleted,
+ * so the table gets resized while it is being scanned.
+ */
+void
+scan_test(ht t, int amt, int grow)
+{
+	hashval cursor;
+	int *seen;
+	int i, extra;
+	gendata x, y;
+
+	seen = calloc(amt + 1, sizeof(int));
+	assert(seen != NULL);
+	seen[0] = amt;
+	y.ptr = seen;
+
+	extra = 0;
+	cursor = ht_scan(t, 0, 3, scan_walker, y);
+	while (cursor != 0) {
+		for (i = 0; i < 4; ++i, ++extra) {
+			x.num = amt + extra;
+			if (grow)
+				assert(ht_insert_uniq(t, x, x, num_eq) != NULL);
+			else
+				ht_delete(t, x, num_eq, NULL, NULL);
+		}
+		cursor = ht_scan(t, cursor, 3, scan_walker, y);
+	}
+
+	/* Keys which stayed in the table were seen exactly once */
+	for (i = 0; i < amt; ++i)
+		assert(seen[i + 1] == 1);
+
+	/* Delete the keys which the scan ended too early for */
+	if (!grow)
+		do
+			x.num = amt + extra++;
+		while (ht_delete(t, x, num_eq, NULL, NULL) != NULL);
+
+	free(seen);
+}
+
+
+/*
+ * Hash table test for a given engine, with a given number of buckets to
+ * rehash per operation.  If fullhash is NULL, num_hash is used.
+ */
+void
+stress_test_ht_type(int amt, ht_type type, unsigned int step,
+		    fullhash_func fullhash)
 {
 	ht t;
 	int i;
 	gendata x, y;
+	gendata *keys, *values;
+	unsigned char *found, *seen;
+	ht_iter_t it;
+	int n;
 
 	/* Just take a modulo somewhere around amt/4. */
-	t = ht_create((unsigned int)(amt / 4.0), num_hash);
+	if (fullhash == NULL)
+		t = ht_create_type((unsigned int)(amt / 4.0), num_hash, type);
+	else
+		t = ht_create_full((unsigned int)(amt / 4.0), fullhash, type);
+	t = ht_set_rehash_step(t, step);
 	assert(ht_empty(t));
 
 	printf("Creating a hash table with %d items...\n", amt);
@@ -121,11 +254,85 @@ stress_test_ht(int amt)
 
 		ht_lookup(t, x, num_eq, &y);
 		assert(x.num == y.num);
+
+		/* Older entries should survive any rehashing going on */
+		x.num = i / 2;
+		assert(ht_lookup(t, x, num_eq, &y) != NULL);
+		assert(x.num == y.num);
 	}
 
-	y.ptr = NULL;
+	/* The table should have grown along with its contents */
+	assert(ht_count(t) == (unsigned int)amt);
+
+	/* An incremental rehash may still be going on */
+	n = 0;
+	y.ptr = &n;
+	ht_walk(t, counting_walker, y);
+	assert(n == amt);
+
+	printf("Iterating over a hash table of %d items...\n", amt);
+	seen = calloc(amt + 1, 1);
+	assert(seen != NULL);
+	n = 0;
+	ht_iter_init(t, &it);
+	while (ht_iter_next(&it, &x, &y)) {
+		assert(x.num == y.num);
+		assert(x.num >= 0 && x.num < amt && !seen[x.num]);
+		seen[x.num] = 1;
+		++n;
+	}
+	assert(n == amt);
+	assert(!ht_iter_next(&it, &x, &y));
+	free(seen);
+
+	/* Stopping early */
+	ht_iter_init(t, &it);
+	assert(amt == 0 || ht_iter_next(&it, &x, &y));
+	ht_iter_end(&it);
+	ht_iter_end(&it);
+
+	printf("Scanning a hash table of %d items while resizing...\n", amt);
+	scan_test(t, amt, 1);
+	scan_test(t, amt, 0);
+	assert(ht_count(t) == (unsigned int)amt);
+	if (step == 0)
+		assert(t->count <= t->grow_at);
+
+	printf("Resizing a hash table of %d items...\n", amt);
+	/* Open addressing tables must have room for all items */
+	t = ht_resize(t, type == HT_CHAINED ? 7 : (unsigned int)amt + 7);
+	assert(t->range == (type == HT_CHAINED ? 7 : (unsigned int)amt + 7));
+	assert(t->rehash_buckets == NULL);
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		assert(ht_lookup(t, x, num_eq, &y) != NULL);
+		assert(x.num == y.num);
+	}
+
+	printf("Looking up %d items in one batch...\n", 2 * amt);
+	keys = malloc(2 * amt * sizeof(gendata));
+	values = malloc(2 * amt * sizeof(gendata));
+	found = malloc(2 * amt);
+	assert(keys != NULL && values != NULL && found != NULL);
+	/* Every even key is in the table, every odd key isn't */
+	for (i = 0; i < 2 * amt; ++i)
+		keys[i].num = (i % 2 == 0) ? i / 2 : -1 - i;
+	assert(ht_lookup_many(t, keys, 2 * amt, num_eq, values, found)
+	       == (size_t)amt);
+	for (i = 0; i < 2 * amt; ++i) {
+		assert(found[i] == (i % 2 == 0));
+		if (found[i])
+			assert(values[i].num == keys[i].num);
+	}
+	free(keys);
+	free(values);
+	free(found);
+
+	n = 0;
+	y.ptr = &n;
 	printf("Walking a hash table of %d items...\n", amt);
-	ht_walk(t, walker, y);
+	ht_walk(t, counting_walker, y);
+	assert(n == amt);
 
 	printf("Deleting %d items from the hash table...\n", amt);
 	for (i = 0; i < amt; ++i) {
@@ -137,258 +344,3451 @@ stress_test_ht(int amt)
 		t = ht_delete(t, x, num_eq, NULL, NULL);
 	}
 	assert(ht_empty(t));
+	/* ...and shrunk back again */
+	if (step == 0)
+		assert(t->range <= t->min_range);
+
+	printf("Emptying a hash table of %d items while walking it...\n", amt);
+	for (i = 0; i < amt; ++i) {
+		x.num = y.num = i;
+		t = ht_insert_uniq(t, x, y, num_eq);
+	}
+	y.ptr = t;
+	ht_walk(t, deleting_walker, y);
+	assert(ht_empty(t));
+
+	printf("Emptying a hash table of %d items while iterating...\n", amt);
+	for (i = 0; i < amt; ++i) {
+		x.num = y.num = i;
+		t = ht_insert_uniq(t, x, y, num_eq);
+	}
+	ht_iter_init(t, &it);
+	while (ht_iter_next(&it, &x, &y))
+		t = ht_delete(t, x, num_eq, NULL, NULL);
+	assert(ht_empty(t));
+
 	ht_destroy(t, NULL, NULL);
 }
 
 
+/*
+ * Walk a big table with only a few items, which are spread over the
+ * bitmap words of the buckets.
+ */
 void
-stress_test_array(int amt)
+stress_test_ht_sparse(int amt)
 {
-	array arr; /* matey! */
+	ht t;
+	int i, n;
+	gendata x, y;
+
+	t = ht_create_full(64 * (unsigned int)amt + 1, num_fullhash,
+			   HT_CHAINED);
+	for (i = 0; i < amt; ++i) {
+		x.num = y.num = i * 67;
+		t = ht_insert_uniq(t, x, y, num_eq);
+		assert(ht_count(t) == (unsigned int)i + 1);
+	}
+
+	n = 0;
+	y.ptr = &n;
+	ht_walk(t, counting_walker, y);
+	assert(n == amt);
+
+	/* Delete every other item and walk again */
+	for (i = 0; i < amt; i += 2) {
+		x.num = i * 67;
+		t = ht_delete(t, x, num_eq, NULL, NULL);
+	}
+	n = 0;
+	ht_walk(t, counting_walker, y);
+	assert(n == amt / 2);
+	assert(ht_count(t) == (unsigned int)(amt / 2));
+
+	ht_destroy(t, NULL, NULL);
+}
+
+
+/*
+ * Make a hash table holding the keys first..first+amt-1.  If fullhash is
+ * NULL, num_hash is used.
+ */
+ht
+make_ht(ht_type type, unsigned int range, fullhash_func fullhash, int first,
+	int amt)
+{
+	ht t;
+	int i;
 	gendata x;
+
+	if (fullhash == NULL)
+		t = ht_create_type(range, num_hash, type);
+	else
+		t = ht_create_full(range, fullhash, type);
+	assert(t != NULL);
+
+	for (i = first; i < first + amt; ++i) {
+		x.num = i;
+		t = ht_insert_uniq(t, x, x, num_eq);
+		assert(t != NULL);
+	}
+
+	return t;
+}
+
+
+/*
+ * Merge a table with the keys amt/2..amt/2+amt-1 into one with the keys
+ * 0..amt-1, so that half of them overlap.
+ */
+void
+stress_test_ht_merge_type(int amt, ht_type btype, ht_type rtype,
+			  unsigned int rrange, fullhash_func rhash)
+{
+	ht base, rest;
+	int i, uniq;
+	gendata x, y;
+
+	for (uniq = 0; uniq < 2; ++uniq) {
+		base = make_ht(btype, 0, num_fullhash, 0, amt);
+		rest = make_ht(rtype, rrange, rhash, amt / 2, amt);
+
+		if (uniq) {
+			assert(ht_merge_uniq(base, rest, num_eq) == base);
+
+			/* The overlapping keys stay behind */
+			assert(ht_count(rest) == (unsigned int)(amt - amt / 2));
+			for (i = amt / 2; i < amt; ++i) {
+				x.num = i;
+				assert(ht_lookup(rest, x, num_eq, &y) != NULL);
+			}
+			ht_destroy(rest, NULL, NULL);
+		} else {
+			assert(ht_merge(base, rest, num_eq, NULL, NULL)
+			       == base);
+		}
+
+		assert(ht_count(base) == (unsigned int)(amt / 2 + amt));
+		for (i = 0; i < amt / 2 + amt; ++i) {
+			x.num = i;
+			assert(ht_lookup(base, x, num_eq, &y) != NULL);
+			assert(y.num == i);
+		}
+		ht_destroy(base, NULL, NULL);
+	}
+}
+
+
+#ifdef GUNE_THREADS
+/*
+ * Merge tables which are big enough to be merged by several threads.  The
+ * table merged in has a small range which never grows, so most of its
+ * buckets hold hash values of more than one thread.
+ */
+void
+stress_test_ht_merge_parallel(void)
+{
+	ht base, rest;
+	int i, n;
+	gendata x, y;
+
+	n = MERGE_PARALLEL_ITEMS;
+	printf("Merging hash tables of %d items with several threads...\n", n);
+
+	base = make_ht(HT_CHAINED, 0, num_fullhash, 0, n);
+	rest = ht_create_full(1021, num_fullhash, HT_CHAINED);
+	assert(rest != NULL);
+	assert(ht_set_load_factor(rest, 0.0, 0.0) == rest);
+	for (i = n / 2; i < n / 2 + n; ++i) {
+		x.num = i;
+		assert(ht_insert_uniq(rest, x, x, num_eq) == rest);
+	}
+	assert(rest->range == 1021 && base->range != rest->range);
+
+	assert(ht_merge(base, rest, num_eq, NULL, NULL) == base);
+	assert(ht_count(base) == (unsigned int)(n / 2 + n));
+	for (i = 0; i < n / 2 + n; ++i) {
+		x.num = i;
+		assert(ht_lookup(base, x, num_eq, &y) != NULL);
+		assert(y.num == i);
+	}
+	ht_destroy(base, NULL, NULL);
+}
+#endif
+
+
+void
+stress_test_ht_merge(int amt)
+{
+	printf("Merging hash tables of %d items...\n", amt);
+	stress_test_ht_merge_type(amt, HT_CHAINED, HT_CHAINED, 0,
+				  num_fullhash);
+	stress_test_ht_merge_type(amt, HT_CHAINED, HT_CHAINED, 3,
+				  num_fullhash);
+	stress_test_ht_merge_type(amt, HT_CHAINED, HT_CHAINED, 0, NULL);
+	stress_test_ht_merge_type(amt, HT_CHAINED, HT_ROBINHOOD, 0,
+				  num_fullhash);
+	stress_test_ht_merge_type(amt, HT_ROBINHOOD, HT_CHAINED, 5,
+				  num_fullhash);
+	stress_test_ht_merge_type(amt, HT_ROBINHOOD, HT_ROBINHOOD, 0, NULL);
+
+#ifdef GUNE_THREADS
+	stress_test_ht_merge_parallel();
+#endif
+}
+
+
+/*
+ * Check tables with a keyed hash, which each have a seed of their own.
+ * Merging two of them has to rehash, and freezing one keeps its seed.
+ */
+void
+stress_test_ht_keyed_type(int amt, ht_type type)
+{
+	hashseed s1, s2;
+	ht t, u;
+	fht f;
+	gendata x, y;
 	int i;
 
-	arr = array_create();
-	assert(array_size(arr) == 0);
+	hash_seed(&s1);
+	hash_seed(&s2);
+	assert(s1.k[0] != s2.k[0] || s1.k[1] != s2.k[1]);
+	x.ptr = "a key";
+	assert(str_keyedhash(x, &s1) == str_keyedhash(x, &s1));
+	assert(str_keyedhash(x, &s1) != str_keyedhash(x, &s2));
 
-	printf("Adding %d items to an array...\n", amt);
+	t = ht_create_keyed(0, num_keyedhash, type);
+	u = ht_create_keyed(0, num_keyedhash, type);
+	assert(t != NULL && u != NULL);
 	for (i = 0; i < amt; ++i) {
 		x.num = i;
-		arr = array_add(arr, x);
-		assert(x.num == array_get_data(arr, (unsigned int)i).num);
-		assert(array_size(arr) == (unsigned int)(i + 1));
+		t = ht_insert_uniq(t, x, x, num_eq);
+		assert(t != NULL);
+		x.num = i + amt;
+		u = ht_insert_uniq(u, x, x, num_eq);
+		assert(u != NULL);
 	}
 
-	printf("Shrinking an array of %d items...\n", amt);
-	for (i = amt - 1; i >= 0; --i) {
-		assert(array_get_data(arr, (unsigned int)i).num == i);
-		arr = array_remove(arr);
-		assert(array_size(arr) == (unsigned int)i);
+	for (i = 0; i < amt; i += 2) {
+		x.num = i;
+		t = ht_delete(t, x, num_eq, NULL, NULL);
+		assert(t != NULL);
 	}
-
-	printf("Filling a pre-grown array of %d items...\n", amt);
-	array_grow(arr, amt);
-	assert(array_size(arr) == (unsigned int)amt);
 	for (i = 0; i < amt; ++i) {
 		x.num = i;
-		arr = array_set_data(arr, (unsigned int)i, x);
-		assert(x.num == array_get_data(arr, (unsigned int)i).num);
+		if (i % 2 == 0)
+			assert(ht_lookup(t, x, num_eq, &y) == NULL);
+		else
+			assert(ht_lookup(t, x, num_eq, &y) != NULL);
+	}
+
+	printf("Merging hash tables with different seeds...\n");
+	t = ht_merge(t, u, num_eq, NULL, NULL);
+	assert(t != NULL);
+	assert(ht_count(t) == (unsigned int)(amt - (amt + 1) / 2 + amt));
+	for (i = amt; i < 2 * amt; ++i) {
+		x.num = i;
+		assert(ht_lookup(t, x, num_eq, &y) != NULL);
+		assert(y.num == i);
+	}
+
+	f = ht_freeze(t);
+	assert(f != NULL);
+	for (i = 1; i < 2 * amt; ++i) {
+		x.num = i;
+		if (i < amt && i % 2 == 0)
+			assert(fht_lookup(f, x, num_eq, &y) == NULL);
+		else
+			assert(fht_lookup(f, x, num_eq, &y) != NULL);
+	}
+	fht_destroy(f, NULL, NULL);
+}
+
+
+/* Numeric equals predicate which counts how often it is called */
+int
+counting_num_eq(gendata n1, gendata n2)
+{
+	++eq_calls;
+	return num_eq(n1, n2);
+}
+
+
+/*
+ * Check a hash table with a Bloom filter gives the same answers as without
+ * one, and that it rules out most misses without comparing keys.
+ */
+void
+stress_test_ht_bloom_type(int amt, ht_type type)
+{
+	ht t, u;
+	gendata x, y, keys[3], out[3];
+	unsigned char found[3];
+	int i, n;
+
+	/* Enough to make the filter be rebuilt a few times */
+	n = amt + 3000;
+
+	t = make_ht(type, 0, NULL, 0, 0);
+	assert(ht_set_bloom(t, 1.0) == NULL);
+	assert(ht_set_bloom(t, -0.5) == NULL);
+	t = ht_set_bloom(t, 0.01);
+	assert(t != NULL);
+	if (type == HT_CHAINED)
+		t = ht_set_rehash_step(t, 1);
+
+	printf("Filling a hash table with a Bloom filter with %d items...\n",
+	       n);
+	for (i = 0; i < n; ++i) {
+		x.num = i;
+		t = ht_insert_uniq(t, x, x, num_eq);
+		assert(t != NULL);
+	}
+	for (i = 0; i < n; ++i) {
+		x.num = i;
+		assert(ht_lookup(t, x, num_eq, &y) != NULL);
+		assert(y.num == i);
+	}
+
+	eq_calls = 0;
+	for (i = n; i < 2 * n; ++i) {
+		x.num = i;
+		assert(ht_lookup(t, x, counting_num_eq, &y) == NULL);
+		assert(ht_delete(t, x, counting_num_eq, NULL, NULL) == NULL);
+	}
+	assert(eq_calls < (unsigned long)n / 10);
+
+	/* Deleted keys stay in the filter, but must not be found */
+	for (i = 0; i < n; i += 2) {
+		x.num = i;
+		t = ht_delete(t, x, num_eq, NULL, NULL);
+		assert(t != NULL);
+	}
+	for (i = 0; i < n; ++i) {
+		x.num = i;
+		if (i % 2 == 0)
+			assert(ht_lookup(t, x, num_eq, &y) == NULL);
+		else
+			assert(ht_lookup(t, x, num_eq, &y) != NULL);
+	}
+
+	keys[0].num = 1;
+	keys[1].num = 2;
+	keys[2].num = 2 * n;
+	assert(ht_lookup_many(t, keys, 3, num_eq, out, found) == 1);
+	assert(found[0] && !found[1] && !found[2]);
+	assert(out[0].num == 1);
+
+	printf("Merging into a hash table with a Bloom filter...\n");
+	u = make_ht(type, 0, NULL, 2 * n, amt);
+	t = ht_merge(t, u, num_eq, NULL, NULL);
+	assert(t != NULL);
+	for (i = 2 * n; i < 2 * n + amt; ++i) {
+		x.num = i;
+		assert(ht_lookup(t, x, num_eq, &y) != NULL);
+	}
+
+	t = ht_set_bloom(t, 0.0);
+	assert(t != NULL && t->filter == NULL);
+	for (i = 1; i < n; i += 2) {
+		x.num = i;
+		assert(ht_lookup(t, x, num_eq, &y) != NULL);
+	}
+	ht_destroy(t, NULL, NULL);
+}
+
+
+void
+stress_test_ht_bloom(int amt)
+{
+	printf("Testing a chained hash table with a Bloom filter...\n");
+	stress_test_ht_bloom_type(amt, HT_CHAINED);
+	printf("Testing an open addressing table with a Bloom filter...\n");
+	stress_test_ht_bloom_type(amt, HT_ROBINHOOD);
+}
+
+
+/*
+ * Check the statistics of a hash table add up.  The lookup counters are
+ * only kept if the library was built with HT_STATS.
+ */
+void
+stress_test_ht_stats_type(int amt, ht_type type)
+{
+	ht_stats_t st;
+	unsigned long total, probes;
+	gendata x, y;
+	ht t;
+	int i;
+
+	printf("Checking the statistics of a hash table with %d items...\n",
+	       amt);
+	t = make_ht(type, 0, NULL, 0, amt);
+	assert(ht_stats(t, &st) == t);
+	assert(st.count == (unsigned int)amt);
+	assert(st.used <= st.count);
+	assert(amt == 0 || st.max_chain > 0 || type == HT_ROBINHOOD);
+
+	for (total = 0, i = 0; i < HT_STATS_HIST; ++i)
+		total += st.chains[i];
+	assert(total == (type == HT_CHAINED ? st.range : st.count));
+
+	eq_calls = 0;
+	for (i = 0; i < 2 * amt; ++i) {
+		x.num = i;
+		if (i < amt)
+			assert(ht_lookup(t, x, counting_num_eq, &y) != NULL);
+		else
+			assert(ht_lookup(t, x, counting_num_eq, &y) == NULL);
+	}
+
+	ht_stats(t, &st);
+	for (probes = 0, i = 0; i < HT_STATS_HIST; ++i)
+		probes += st.probes[i];
+
+	if (st.hits + st.misses > 0) {
+		assert(st.hits == (unsigned long)amt);
+		assert(st.misses == (unsigned long)amt);
+		assert(st.eq_calls == eq_calls);
+		assert(probes == 2 * (unsigned long)amt);
+		assert(amt < 100 || st.rehashes > 0);
+	} else {
+		assert(st.eq_calls == 0 && probes == 0 && st.rehashes == 0);
+	}
+
+	ht_destroy(t, NULL, NULL);
+}
+
+
+void
+stress_test_ht(int amt)
+{
+	printf("Testing a hash table which rehashes all at once...\n");
+	stress_test_ht_type(amt, HT_CHAINED, 0, NULL);
+	printf("Testing a hash table which rehashes incrementally...\n");
+	stress_test_ht_type(amt, HT_CHAINED, 1, NULL);
+	printf("Testing a hash table with a full-width hash...\n");
+	stress_test_ht_type(amt, HT_CHAINED, 1, num_fullhash);
+	printf("Testing an open addressing hash table...\n");
+	stress_test_ht_type(amt, HT_ROBINHOOD, 0, NULL);
+	printf("Testing an open addressing table with a full-width hash...\n");
+	stress_test_ht_type(amt, HT_ROBINHOOD, 0, num_fullhash);
+	printf("Testing a sparse hash table...\n");
+	stress_test_ht_sparse(amt);
+	stress_test_ht_merge(amt);
+	stress_test_ht_bloom(amt);
+	printf("Testing a hash table with a keyed hash...\n");
+	stress_test_ht_keyed_type(amt, HT_CHAINED);
+	printf("Testing an open addressing table with a keyed hash...\n");
+	stress_test_ht_keyed_type(amt, HT_ROBINHOOD);
+	stress_test_ht_stats_type(amt, HT_CHAINED);
+	stress_test_ht_stats_type(amt, HT_ROBINHOOD);
+}
+
+
+void
+stress_test_sht(int amt)
+{
+	sht t;
+	int i;
+	gendata x, y;
+
+	t = sht_create(0, num_hash);
+	assert(sht_empty(t));
+
+	printf("Creating a SIMD hash table with %d items...\n", amt);
+	for (i = 0; i < amt; ++i) {
+		x.num = y.num = i;
+		t = sht_insert_uniq(t, x, y, num_eq);
+
+		assert(!sht_empty(t));
+
+		sht_lookup(t, x, num_eq, &y);
+		assert(x.num == y.num);
+	}
+	assert(t->count == (unsigned int)amt);
+
+	y.ptr = NULL;
+	printf("Walking a SIMD hash table of %d items...\n", amt);
+	sht_walk(t, walker, y);
+
+	printf("Deleting %d items from the SIMD hash table...\n", amt);
+	for (i = 0; i < amt; ++i) {
+		/* Inserting an item that's already there should fail */
+		x.num = i;
+		y.num = i;			/* Value does not matter */
+		assert(sht_insert_uniq(t, x, y, num_eq) == NULL);
+
+		t = sht_delete(t, x, num_eq, NULL, NULL);
+		assert(sht_lookup(t, x, num_eq, &y) == NULL);
+	}
+	assert(sht_empty(t));
+
+	printf("Refilling a SIMD hash table with %d items...\n", amt);
+	for (i = 0; i < amt; ++i) {
+		x.num = y.num = i;
+		t = sht_insert_uniq(t, x, y, num_eq);
+	}
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		assert(sht_lookup(t, x, num_eq, &y) != NULL);
+		assert(x.num == y.num);
+	}
+	sht_destroy(t, NULL, NULL);
+}
+
+
+/* A poor hashing function, which gives every four keys the same value */
+hashval
+coarse_fullhash(gendata key)
+{
+	return (hashval)(key.num / 4);
+}
+
+
+/*
+ * Fill a hash table, freeze it and check all keys can be found.  If
+ * fullhash gives equal values for different keys, the frozen table
+ * can't give each of them a slot of its own.  If fullhash is NULL, the
+ * table uses a keyed hashing function.
+ */
+void
+stress_test_fht_type(int amt, fullhash_func fullhash, ht_type type)
+{
+	ht t;
+	fht f;
+	int i;
+	gendata x, y;
+
+	/* Without a full-width hashing function, use a keyed one */
+	if (fullhash != NULL)
+		t = ht_create_full(0, fullhash, type);
+	else
+		t = ht_create_keyed(0, num_keyedhash, type);
+	for (i = 0; i < amt; ++i) {
+		x.num = y.num = i;
+		t = ht_insert_uniq(t, x, y, num_eq);
+	}
+
+	printf("Freezing a hash table with %d items...\n", amt);
+	f = ht_freeze(t);
+	assert(f != NULL);
+	assert(fht_count(f) == (unsigned int)amt);
+
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		assert(fht_lookup(f, x, num_eq, &y) != NULL);
+		assert(y.num == i);
+	}
+
+	/* Keys which were never inserted */
+	for (i = amt; i < 2 * amt; ++i) {
+		x.num = i;
+		assert(fht_lookup(f, x, num_eq, &y) == NULL);
+	}
+	x.num = -1;
+	assert(fht_lookup(f, x, num_eq, &y) == NULL);
+
+	y.ptr = NULL;
+	printf("Walking a frozen hash table of %d items...\n", amt);
+	fht_walk(f, walker, y);
+
+	fht_destroy(f, NULL, NULL);
+}
+
+
+void
+stress_test_fht(int amt)
+{
+	printf("Testing frozen hash table with unique hash values\n");
+	stress_test_fht_type(amt, num_fullhash, HT_CHAINED);
+	printf("Testing frozen hash table made from an open addressing "
+	       "table\n");
+	stress_test_fht_type(amt, num_fullhash, HT_ROBINHOOD);
+	printf("Testing frozen hash table with keyed hash values\n");
+	stress_test_fht_type(amt, NULL, HT_CHAINED);
+	printf("Testing frozen hash table with colliding hash values\n");
+	stress_test_fht_type(amt, coarse_fullhash, HT_CHAINED);
+	printf("Testing empty frozen hash table\n");
+	stress_test_fht_type(0, num_fullhash, HT_CHAINED);
+}
+
+
+/* The number of values lru_test_free was called on */
+static int lru_freed;
+
+
+/* Free function which counts how many values were freed */
+void
+lru_test_free(void *p)
+{
+	++lru_freed;
+	free(p);
+}
+
+
+/* Size function which uses the integer a value points to as its size */
+size_t
+lru_test_size(gendata key, gendata value)
+{
+	(void)key;
+	return *(int *)value.ptr;
+}
+
+
+/* Make a value which can be freed with lru_test_free */
+gendata
+lru_test_value(int i)
+{
+	gendata v;
+
+	v.ptr = malloc(sizeof(int));
+	assert(v.ptr != NULL);
+	*(int *)v.ptr = i;
+
+	return v;
+}
+
+
+void
+stress_test_lru(int amt)
+{
+	lru c;
+	lru_stats_t st;
+	gendata x, y;
+	int i, n, cap;
+
+	cap = amt / 2 + 1;
+	lru_freed = 0;
+
+	printf("Filling an LRU cache of %d entries with %d items...\n",
+	       cap, amt);
+	c = lru_create(cap, num_fullhash, NULL, NULL, lru_test_free);
+	assert(c != NULL);
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		c = lru_put(c, x, lru_test_value(i), num_eq);
+		assert(c != NULL);
+	}
+	n = amt < cap ? amt : cap;
+	assert(lru_count(c) == (unsigned int)n);
+
+	st = lru_stats(c);
+	assert(st.evictions == (unsigned long)(amt < cap ? 0 : amt - cap));
+	assert(lru_freed == amt - (int)lru_count(c));
+
+	/* The oldest items went first */
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		if (i < amt - cap) {
+			assert(lru_get(c, x, num_eq, &y) == NULL);
+		} else {
+			assert(lru_get(c, x, num_eq, &y) != NULL);
+			assert(*(int *)y.ptr == i);
+		}
+	}
+	st = lru_stats(c);
+	assert(st.hits == lru_count(c));
+	assert(st.misses == (unsigned long)(amt - (int)lru_count(c)));
+
+	printf("Replacing values in an LRU cache...\n");
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		if (lru_peek(c, x, num_eq, &y) != NULL)
+			c = lru_put(c, x, lru_test_value(-i), num_eq);
+	}
+	assert(lru_freed == amt);
+	for (i = amt - cap > 0 ? amt - cap : 0; i < amt; ++i) {
+		x.num = i;
+		assert(lru_peek(c, x, num_eq, &y) != NULL);
+		assert(*(int *)y.ptr == -i);
+	}
+	assert(lru_stats(c).hits == st.hits);
+
+	printf("Emptying an LRU cache...\n");
+	while (lru_count(c) > 1)
+		c = lru_evict(c, num_eq);
+	x.num = amt - 1;
+	assert(lru_peek(c, x, num_eq, &y) != NULL);
+	c = lru_delete(c, x, num_eq);
+	assert(lru_delete(c, x, num_eq) == NULL);
+	assert(lru_evict(c, num_eq) == NULL);
+	assert(lru_count(c) == 0);
+	assert(lru_freed == amt + n);
+	lru_destroy(c);
+
+	printf("Testing recency in an LRU cache...\n");
+	c = lru_create(3, num_fullhash, NULL, NULL, lru_test_free);
+	for (i = 0; i < 3; ++i) {
+		x.num = i;
+		c = lru_put(c, x, lru_test_value(i), num_eq);
+	}
+	/* Using 0 makes 1 the least recently used, peeking doesn't count */
+	x.num = 0;
+	assert(lru_get(c, x, num_eq, &y) != NULL);
+	x.num = 1;
+	assert(lru_peek(c, x, num_eq, &y) != NULL);
+	x.num = 3;
+	c = lru_put(c, x, lru_test_value(3), num_eq);
+	x.num = 1;
+	assert(lru_peek(c, x, num_eq, &y) == NULL);
+	x.num = 0;
+	assert(lru_peek(c, x, num_eq, &y) != NULL);
+	lru_destroy(c);
+	assert(lru_freed == amt + n + 4);
+
+	printf("Testing an LRU cache with sized entries...\n");
+	lru_freed = 0;
+	c = lru_create(amt + 1, num_fullhash, lru_test_size, NULL,
+		       lru_test_free);
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		c = lru_put(c, x, lru_test_value(i % 7 + 1), num_eq);
+		assert(c != NULL);
+		assert(c->used <= c->capacity);
+	}
+
+	/* Entries which don't fit at all are refused */
+	x.num = amt;
+	y = lru_test_value(amt + 2);
+	assert(lru_put(c, x, y, num_eq) == NULL);
+	free(y.ptr);
+
+	/* One entry which takes everything pushes out all others */
+	x.num = 0;
+	c = lru_put(c, x, lru_test_value(amt + 1), num_eq);
+	assert(lru_count(c) == 1);
+	assert(c->used == c->capacity);
+	lru_destroy(c);
+	assert(lru_freed == amt + 1);
+
+	assert(lru_create(0, num_fullhash, NULL, NULL, NULL) == NULL);
+}
+
+
+void
+stress_test_ccache(int amt)
+{
+	ccache c;
+	lru_stats_t st;
+	gendata x, y;
+	int i, cap, puts;
+
+	cap = amt / 2 + 1;
+	lru_freed = 0;
+
+	printf("Filling a CLOCK cache of %d entries with %d items...\n",
+	       cap, amt);
+	c = ccache_create(cap, num_fullhash, NULL, NULL, lru_test_free);
+	assert(c != NULL);
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		c = ccache_put(c, x, lru_test_value(i), num_eq);
+		assert(c != NULL);
+		assert(ccache_count(c) <= (unsigned int)cap);
+	}
+	assert(ccache_count(c) == (unsigned int)(amt < cap ? amt : cap));
+	st = ccache_stats(c);
+	assert(st.evictions == (unsigned long)(amt - (int)ccache_count(c)));
+	assert(lru_freed == (int)st.evictions);
+
+	/* Whatever is still there must have the right value */
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		if (ccache_get(c, x, num_eq, &y) != NULL)
+			assert(*(int *)y.ptr == i);
+	}
+	st = ccache_stats(c);
+	assert(st.hits == ccache_count(c));
+	assert(st.hits + st.misses == (unsigned long)amt);
+
+	printf("Using a CLOCK cache at random...\n");
+	puts = amt;
+	for (i = 0; i < 4 * amt; ++i) {
+		x.num = rand() % (amt + 1);
+		if (ccache_get(c, x, num_eq, &y) != NULL) {
+			assert(*(int *)y.ptr == x.num);
+		} else {
+			c = ccache_put(c, x, lru_test_value(x.num), num_eq);
+			assert(c != NULL);
+			++puts;
+		}
+		if (i % 7 == 0 && ccache_delete(c, x, num_eq) != NULL)
+			assert(ccache_peek(c, x, num_eq, &y) == NULL);
+		assert(ccache_count(c) <= (unsigned int)cap);
+		assert(c->used == ccache_count(c));
+	}
+	assert(lru_freed + (int)ccache_count(c) == puts);
+
+	printf("Replacing values in a CLOCK cache...\n");
+	for (i = 0; i <= amt; ++i) {
+		x.num = i;
+		if (ccache_peek(c, x, num_eq, &y) != NULL) {
+			c = ccache_put(c, x, lru_test_value(-i), num_eq);
+			assert(ccache_peek(c, x, num_eq, &y) != NULL);
+			assert(*(int *)y.ptr == -i);
+			++puts;
+		}
+	}
+	assert(lru_freed + (int)ccache_count(c) == puts);
+
+	printf("Emptying a CLOCK cache...\n");
+	while (ccache_count(c) > 0)
+		c = ccache_evict(c, num_eq);
+	assert(ccache_evict(c, num_eq) == NULL);
+	assert(lru_freed == puts);
+	ccache_destroy(c);
+
+	printf("Testing reference bits in a CLOCK cache...\n");
+	c = ccache_create(3, num_fullhash, NULL, NULL, lru_test_free);
+	for (i = 0; i < 3; ++i) {
+		x.num = i;
+		c = ccache_put(c, x, lru_test_value(i), num_eq);
+	}
+	/* Every entry is referenced, so the hand goes all the way round */
+	x.num = 3;
+	c = ccache_put(c, x, lru_test_value(3), num_eq);
+	x.num = 0;
+	assert(ccache_peek(c, x, num_eq, &y) == NULL);
+
+	/* Using 1 saves it, 2 goes instead */
+	x.num = 1;
+	assert(ccache_get(c, x, num_eq, &y) != NULL);
+	x.num = 4;
+	c = ccache_put(c, x, lru_test_value(4), num_eq);
+	x.num = 2;
+	assert(ccache_peek(c, x, num_eq, &y) == NULL);
+	for (i = 1; i < 5; i += 2) {
+		x.num = i;
+		assert(ccache_peek(c, x, num_eq, &y) != NULL);
+	}
+	x.num = 4;
+	assert(ccache_peek(c, x, num_eq, &y) != NULL);
+	ccache_destroy(c);
+	assert(lru_freed == puts + 5);
+
+	printf("Testing a CLOCK cache with sized entries...\n");
+	lru_freed = 0;
+	c = ccache_create(amt + 1, num_fullhash, lru_test_size, NULL,
+			  lru_test_free);
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		c = ccache_put(c, x, lru_test_value(i % 7 + 1), num_eq);
+		assert(c != NULL);
+		assert(c->used <= c->capacity);
+	}
+
+	x.num = amt;
+	y = lru_test_value(amt + 2);
+	assert(ccache_put(c, x, y, num_eq) == NULL);
+	free(y.ptr);
+
+	x.num = 0;
+	c = ccache_put(c, x, lru_test_value(amt + 1), num_eq);
+	assert(ccache_count(c) == 1);
+	assert(c->used == c->capacity);
+	ccache_destroy(c);
+	assert(lru_freed == amt + 1);
+
+	assert(ccache_create(0, num_fullhash, NULL, NULL, NULL) == NULL);
+}
+
+
+void
+stress_test_ttl(int amt)
+{
+	ttl t;
+	unsigned long *expires, now, reaped;
+	gendata x, y;
+	int i, left;
+
+	if ((expires = malloc(amt * sizeof(unsigned long))) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+
+	printf("Filling an expiring map with %d items...\n", amt);
+	lru_freed = 0;
+	t = ttl_create(num_fullhash, 0, NULL, lru_test_free);
+	assert(t != NULL);
+
+	/* Some expire beyond the reach of the timer wheel */
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		expires[i] = 1 + ((unsigned long)i * i * 7919) % 20000000UL;
+		t = ttl_insert(t, x, lru_test_value(i), expires[i], num_eq);
+		assert(t != NULL);
+	}
+	assert(ttl_count(t) == (unsigned int)amt);
+
+	printf("Reaping an expiring map...\n");
+	now = 0;
+	reaped = 0;
+	left = amt;
+	while (left > 0) {
+		now += rand() % 50000;
+
+		/* Entries which expired are gone before they're reaped */
+		for (i = 0; i < amt; ++i) {
+			x.num = i;
+			if (expires[i] > now) {
+				assert(ttl_lookup(t, x, num_eq, now, &y)
+				       != NULL);
+				assert(*(int *)y.ptr == i);
+			} else {
+				assert(ttl_lookup(t, x, num_eq, now, &y)
+				       == NULL);
+			}
+		}
+
+		reaped += ttl_reap(t, now, num_eq);
+		for (left = 0, i = 0; i < amt; ++i)
+			if (expires[i] > now)
+				++left;
+		assert(reaped == (unsigned long)(amt - left));
+		assert(ttl_count(t) == (unsigned int)left);
+		assert(lru_freed == (int)reaped);
+	}
+
+	/* Times which are already reaped can't be used anymore */
+	x.num = 0;
+	y = lru_test_value(0);
+	assert(ttl_insert(t, x, y, now, num_eq) == NULL);
+	free(y.ptr);
+	assert(ttl_reap(t, now - 1, num_eq) == 0);
+
+	printf("Replacing and deleting entries in an expiring map...\n");
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		t = ttl_insert(t, x, lru_test_value(i), now + 10, num_eq);
+		t = ttl_insert(t, x, lru_test_value(-i), now + 1 + i % 100,
+			       num_eq);
+	}
+	assert(ttl_count(t) == (unsigned int)amt);
+	assert(lru_freed == 2 * amt);
+	for (i = 0; i < amt; i += 2) {
+		x.num = i;
+		t = ttl_delete(t, x, num_eq);
+		assert(ttl_delete(t, x, num_eq) == NULL);
+	}
+	for (left = 0, i = 1; i < amt; i += 2)
+		if (i % 100 >= 50)
+			++left;
+	reaped = ttl_reap(t, now + 50, num_eq);
+	assert(ttl_count(t) == (unsigned int)left);
+	assert(reaped == (unsigned long)(amt / 2 - left));
+	for (i = 1; i < amt; i += 2) {
+		x.num = i;
+		if (i % 100 >= 50) {
+			assert(ttl_lookup(t, x, num_eq, now + 50, &y) != NULL);
+			assert(*(int *)y.ptr == -i);
+		}
+	}
+
+	ttl_destroy(t);
+	assert(lru_freed == 3 * amt);
+	free(expires);
+}
+
+
+/* Orders numbers from high to low, so smap can't tell it from num_cmp */
+int
+reverse_num_cmp(gendata n1, gendata n2)
+{
+	return num_cmp(n2, n1);
+}
+
+
+/* What smap_order_walker has seen so far */
+struct smap_walk_state {
+	cmp_func cmp;		/* The ordering of the keys */
+	int count;		/* The number of keys seen */
+	gendata last;		/* The last key seen */
+};
+
+/* Check that a sorted map walks its keys in order, and count them */
+void
+smap_order_walker(gendata *key, gendata *value, gendata customdata)
+{
+	struct smap_walk_state *st = customdata.ptr;
+
+	assert(value->num == key->num * 3 || value->num == key->num * 3 + 1);
+	assert(st->count == 0 || st->cmp(st->last, *key) < 0);
+	st->last = *key;
+	++st->count;
+}
+
+
+/*
+ * Check the contents of a sorted map of numbers against a table of which
+ * keys from 0 to range are in it, and with which values.
+ */
+void
+smap_check(smap m, cmp_func cmp, int *ref, int range)
+{
+	struct smap_walk_state st;
+	gendata x, y;
+	int i, n = 0;
+
+	for (i = -1; i <= range; ++i) {
+		x.num = i;
+		if (i >= 0 && i < range && ref[i] >= 0) {
+			assert(smap_lookup(m, x, &y) == m);
+			assert(y.num == ref[i]);
+			++n;
+		} else {
+			errno = 0;
+			assert(smap_lookup(m, x, &y) == NULL);
+			assert(errno == EINVAL);
+		}
+	}
+	assert(smap_count(m) == (unsigned int)n);
+
+	st.cmp = cmp;
+	st.count = 0;
+	x.ptr = &st;
+	smap_walk(m, smap_order_walker, x);
+	assert(st.count == n);
+}
+
+
+/*
+ * Insert, look up and delete numbers in sorted maps ordered by num_cmp and
+ * by a function the map knows nothing about, one at a time and in bulk.
+ * Then replace strings, to see that the replaced ones are freed.
+ */
+void
+stress_test_smap(int amt)
+{
+	cmp_func cmps[2] = { num_cmp, reverse_num_cmp };
+	gendata x, y, *keys, *values;
+	int *ref, i, c, range;
+	char buf[32];
+	smap m;
+
+	range = 2 * amt + 1;
+	if ((ref = malloc(range * sizeof(int))) == NULL ||
+	    (keys = malloc((amt + 1) * sizeof(gendata))) == NULL ||
+	    (values = malloc((amt + 1) * sizeof(gendata))) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+
+	for (c = 0; c < 2; ++c) {
+		printf("Inserting %d items into a sorted map...\n", amt);
+		m = smap_create(cmps[c]);
+		assert(m != NULL && smap_count(m) == 0);
+		for (i = 0; i < range; ++i)
+			ref[i] = -1;
+		for (i = 0; i < amt; ++i) {
+			x.num = rand() % range;
+			y.num = x.num * 3 + (ref[x.num] >= 0);
+			assert(smap_insert(m, x, y, NULL, NULL) == m);
+			ref[x.num] = y.num;
+		}
+		smap_check(m, cmps[c], ref, range);
+
+		printf("Deleting the even keys of a sorted map...\n");
+		for (i = 0; i < range; i += 2) {
+			x.num = i;
+			if (ref[i] >= 0) {
+				assert(smap_delete(m, x, NULL, NULL) == m);
+				ref[i] = -1;
+			} else {
+				errno = 0;
+				assert(smap_delete(m, x, NULL, NULL) == NULL);
+				assert(errno == EINVAL);
+			}
+		}
+		smap_check(m, cmps[c], ref, range);
+
+		printf("Inserting %d items into a sorted map at once...\n",
+		       amt);
+		for (i = 0; i < amt; ++i) {
+			keys[i].num = rand() % range;
+			values[i].num = keys[i].num * 3 +
+				(rand() % 2 == 0 || ref[keys[i].num] >= 0);
+			ref[keys[i].num] = values[i].num;
+		}
+		assert(smap_insert_many(m, keys, values, (unsigned int)amt,
+					NULL, NULL) == m);
+		smap_check(m, cmps[c], ref, range);
+
+		/* Point inserts after the bulk insert still work */
+		x.num = range - 1;
+		y.num = x.num * 3;
+		assert(smap_insert(m, x, y, NULL, NULL) == m);
+		ref[x.num] = y.num;
+		smap_check(m, cmps[c], ref, range);
+		smap_destroy(m, NULL, NULL);
+
+		/* Build a new map in one go */
+		m = smap_create(cmps[c]);
+		for (i = 0; i < range; ++i)
+			ref[i] = -1;
+		for (i = 0; i < amt; ++i)
+			ref[keys[i].num] = values[i].num;
+		assert(smap_insert_many(m, keys, values, (unsigned int)amt,
+					NULL, NULL) == m);
+		smap_check(m, cmps[c], ref, range);
+		smap_destroy(m, NULL, NULL);
+	}
+
+	printf("Replacing string keys in a sorted map...\n");
+	m = smap_create(str_cmp);
+	for (i = 0; i < amt; ++i) {
+		sprintf(buf, "%d", rand() % range);
+		keys[i].ptr = str_cpy(buf);
+		values[i].ptr = str_cpy(buf);
+	}
+	assert(smap_insert_many(m, keys, values, (unsigned int)amt, free,
+				free) == m);
+	for (i = 0; i < amt; ++i) {
+		sprintf(buf, "%d", i % range);
+		x.ptr = str_cpy(buf);
+		y.ptr = str_cpy(buf);
+		assert(smap_insert(m, x, y, free, free) == m);
+		x.ptr = buf;
+		assert(smap_lookup(m, x, &y) == m);
+		assert(strcmp(y.ptr, buf) == 0);
+	}
+	for (i = 0; i < amt; i += 2) {
+		sprintf(buf, "%d", i % range);
+		x.ptr = buf;
+		assert(smap_delete(m, x, free, free) == m);
+	}
+	smap_destroy(m, free, free);
+
+	free(ref);
+	free(keys);
+	free(values);
+}
+
+
+#ifdef GUNE_THREADS
+/* Work for one thread of the concurrent hash table test */
+struct cht_test_arg {
+	cht t;			/* The table to work on */
+	int first;		/* The keys of this thread are first..first+amt */
+	int amt;
+};
+
+
+/*
+ * Insert, look up and delete this thread's keys, while other threads do
+ * the same with theirs.
+ */
+void *
+cht_test_thread(void *arg)
+{
+	struct cht_test_arg *a = arg;
+	gendata x, y;
+	int i;
+
+	for (i = a->first; i < a->first + a->amt; ++i) {
+		x.num = y.num = i;
+		assert(cht_insert_uniq(a->t, x, y, num_eq) != NULL);
+		assert(cht_lookup(a->t, x, num_eq, &y) != NULL);
+		assert(x.num == y.num);
+	}
+
+	/* Delete the odd keys again */
+	for (i = a->first; i < a->first + a->amt; ++i) {
+		x.num = i;
+		if (i % 2 == 1)
+			assert(cht_delete(a->t, x, num_eq, NULL, NULL)
+			       != NULL);
+		assert(cht_insert_uniq(a->t, x, x, num_eq) == NULL ||
+		       i % 2 == 1);
+	}
+
+	return NULL;
+}
+
+
+void
+stress_test_cht(int amt)
+{
+	struct cht_test_arg args[CHT_TEST_THREADS];
+	pthread_t threads[CHT_TEST_THREADS];
+	gendata x, y;
+	cht t;
+	int i;
+
+	t = cht_create(0, num_fullhash);
+	assert(t != NULL);
+	assert(cht_empty(t));
+
+	printf("Filling a concurrent hash table from %d threads with %d "
+	       "items each...\n", CHT_TEST_THREADS, amt);
+	for (i = 0; i < CHT_TEST_THREADS; ++i) {
+		args[i].t = t;
+		args[i].first = i * amt;
+		args[i].amt = amt;
+		assert(pthread_create(&threads[i], NULL, cht_test_thread,
+				      &args[i]) == 0);
+	}
+	for (i = 0; i < CHT_TEST_THREADS; ++i)
+		pthread_join(threads[i], NULL);
+
+	/* Odd keys were deleted again, but reinserted by the uniq check */
+	for (i = 0; i < CHT_TEST_THREADS * amt; ++i) {
+		x.num = i;
+		assert(cht_lookup(t, x, num_eq, &y) != NULL);
+		assert(x.num == y.num);
+	}
+
+	y.ptr = NULL;
+	printf("Walking a concurrent hash table...\n");
+	cht_walk(t, walker, y);
+
+	printf("Deleting all items from a concurrent hash table...\n");
+	for (i = 0; i < CHT_TEST_THREADS * amt; ++i) {
+		x.num = i;
+		assert(cht_delete(t, x, num_eq, NULL, NULL) != NULL);
+		assert(cht_lookup(t, x, num_eq, &y) == NULL);
+	}
+	assert(cht_empty(t));
+
+	cht_destroy(t, NULL, NULL);
+}
+
+
+/* Work for one thread of the lock-free hash table test */
+struct lfht_test_arg {
+	lfht t;			/* The table to work on */
+	int first;		/* The keys of this thread are first..first+amt */
+	int amt;
+	int total;		/* The number of keys of all threads together */
+};
+
+
+/* Make a value for the lock-free hash table test */
+int *
+lfht_test_value(int n)
+{
+	int *p;
+
+	assert((p = malloc(sizeof(int))) != NULL);
+	*p = n;
+
+	return p;
+}
+
+
+/*
+ * Insert, replace, look up and delete this thread's keys, while other
+ * threads do the same with theirs.  Only the values of this thread's keys
+ * are dereferenced, since other threads may free theirs at any time.
+ */
+void *
+lfht_test_thread(void *arg)
+{
+	struct lfht_test_arg *a = arg;
+	gendata x, y;
+	int i;
+
+	for (i = a->first; i < a->first + a->amt; ++i) {
+		x.num = i;
+		y.ptr = lfht_test_value(-i);
+		assert(lfht_insert_uniq(a->t, x, y, num_eq) != NULL);
+		assert(lfht_insert_uniq(a->t, x, y, num_eq) == NULL);
+
+		/* Replace the value; the old one is freed by the table */
+		y.ptr = lfht_test_value(i);
+		assert(lfht_insert(a->t, x, y, num_eq) != NULL);
+		assert(lfht_lookup(a->t, x, num_eq, &y) != NULL);
+		assert(*(int *)y.ptr == i);
+
+		/* Look at someone else's keys, which may come and go */
+		x.num = (i * 7) % a->total;
+		lfht_lookup(a->t, x, num_eq, &y);
+	}
+
+	/* Delete the odd keys again */
+	for (i = a->first; i < a->first + a->amt; ++i) {
+		x.num = i;
+		if (i % 2 == 1)
+			assert(lfht_delete(a->t, x, num_eq) != NULL);
+		assert((lfht_lookup(a->t, x, num_eq, &y) == NULL) ==
+		       (i % 2 == 1));
+	}
+
+	return NULL;
+}
+
+
+/* Walker which counts the entries of a lock-free hash table */
+void
+lfht_counting_walker(gendata *key, gendata *value, gendata customdata)
+{
+	assert(key->num == *(int *)value->ptr);
+	++*(int *)customdata.ptr;
+}
+
+
+/* What the deleting walker needs to know */
+struct lfht_walk_state {
+	lfht t;			/* The table being walked */
+	int n;			/* The number of entries visited */
+};
+
+
+/*
+ * Walker which deletes every entry it visits.  This makes lfht_walk start
+ * over after every entry, so it has to skip what it has already seen.
+ */
+void
+lfht_deleting_walker(gendata *key, gendata *value, gendata customdata)
+{
+	struct lfht_walk_state *s = customdata.ptr;
+
+	assert(key->num == *(int *)value->ptr);
+	assert(lfht_delete(s->t, *key, num_eq) != NULL);
+	++s->n;
+}
+
+
+void
+stress_test_lfht(int amt)
+{
+	struct lfht_walk_state ws;
+	struct lfht_test_arg args[CHT_TEST_THREADS];
+	pthread_t threads[CHT_TEST_THREADS];
+	gendata x, y;
+	int i, n;
+	lfht t;
+
+	t = lfht_create(0, num_fullhash, NULL, free);
+	assert(t != NULL);
+	assert(lfht_empty(t));
+
+	printf("Filling a lock-free hash table from %d threads with %d "
+	       "items each...\n", CHT_TEST_THREADS, amt);
+	for (i = 0; i < CHT_TEST_THREADS; ++i) {
+		args[i].t = t;
+		args[i].first = i * amt;
+		args[i].amt = amt;
+		args[i].total = CHT_TEST_THREADS * amt;
+		assert(pthread_create(&threads[i], NULL, lfht_test_thread,
+				      &args[i]) == 0);
+	}
+	for (i = 0; i < CHT_TEST_THREADS; ++i)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < CHT_TEST_THREADS * amt; ++i) {
+		x.num = i;
+		if (i % 2 == 1) {
+			assert(lfht_lookup(t, x, num_eq, &y) == NULL);
+		} else {
+			assert(lfht_lookup(t, x, num_eq, &y) != NULL);
+			assert(*(int *)y.ptr == i);
+		}
+	}
+
+	printf("Walking a lock-free hash table...\n");
+	n = 0;
+	y.ptr = &n;
+	lfht_walk(t, lfht_counting_walker, y);
+	assert(n == (CHT_TEST_THREADS * amt + 1) / 2);
+
+	printf("Deleting all items from a lock-free hash table...\n");
+	for (i = 0; i < CHT_TEST_THREADS * amt; i += 2) {
+		x.num = i;
+		assert(lfht_delete(t, x, num_eq) != NULL);
+		assert(lfht_delete(t, x, num_eq) == NULL);
+	}
+	assert(lfht_empty(t));
+
+	lfht_destroy(t);
+
+	t = lfht_create(0, coarse_fullhash, NULL, free);
+	assert(t != NULL);
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		y.ptr = lfht_test_value(i);
+		assert(lfht_insert_uniq(t, x, y, num_eq) != NULL);
+	}
+
+	printf("Walking a lock-free hash table with colliding hash values, "
+	       "deleting every item...\n");
+	ws.t = t;
+	ws.n = 0;
+	y.ptr = &ws;
+	lfht_walk(t, lfht_deleting_walker, y);
+	assert(ws.n == amt);
+	assert(lfht_empty(t));
+
+	lfht_destroy(t);
+}
+#endif /* GUNE_THREADS */
+
+
+/* Comparison functions for qsort, to check the array sorts against */
+int
+qsort_num_cmp(const void *a, const void *b)
+{
+	return num_cmp(*(const gendata *)a, *(const gendata *)b);
+}
+
+int
+qsort_posnum_cmp(const void *a, const void *b)
+{
+	return posnum_cmp(*(const gendata *)a, *(const gendata *)b);
+}
+
+
+/*
+ * Fill n elements with numbers in one of a few patterns which are known
+ * to be hard on some quicksorts.
+ */
+void
+sort_fill(gendata *xs, int n, int pattern)
+{
+	int i;
+
+	for (i = 0; i < n; ++i) {
+		switch (pattern) {
+		case 0:		/* Random, with negative numbers */
+			xs[i].num = rand() - RAND_MAX / 2;
+			break;
+		case 1:		/* Few distinct */
+			xs[i].num = rand() % 16;
+			break;
+		case 2:		/* Sorted */
+			xs[i].num = i;
+			break;
+		case 3:		/* Reversed */
+			xs[i].num = n - i;
+			break;
+		case 4:		/* Organ pipe */
+			xs[i].num = i < n / 2 ? i : n - i;
+			break;
+		case 5:		/* All equal */
+			xs[i].num = 42;
+			break;
+		default:	/* Sawtooth */
+			xs[i].num = i % 100;
+			break;
+		}
+	}
+
+	/* Sorted except for a few elements */
+	if (pattern == 2 && n > 0)
+		for (i = 0; i < n / 100; ++i)
+			xs[rand() % n].num = rand();
+}
+
+
+/*
+ * Sort arrays large enough to be sorted by several threads, with 4 and 64
+ * threads and with one for each CPU, and check them against qsort.
+ */
+void
+stress_test_array_sort_parallel(int amt)
+{
+	unsigned int threads[3] = { 4, 64, 0 };
+	unsigned int b, n;
+	array_sort_stats_t st;
+	gendata *xs, *ref;
+	array arr;
+	int i, p, t;
+
+	printf("Sorting arrays of %d items in parallel...\n", amt);
+	if ((xs = malloc((amt + 1) * sizeof(gendata))) == NULL ||
+	    (ref = malloc((amt + 1) * sizeof(gendata))) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+
+	arr = array_create();
+	for (p = 0; p < 8; ++p) {
+		sort_fill(xs, amt, p);
+		/* Also sort unsigned numbers which use all the bits */
+		if (p == 7)
+			for (i = 0; i < amt; ++i)
+				xs[i].posnum = (unsigned int)rand() * 65599U ^
+					       (unsigned int)rand();
+		memcpy(ref, xs, amt * sizeof(gendata));
+		qsort(ref, (size_t)amt, sizeof(gendata),
+		      p == 7 ? qsort_posnum_cmp : qsort_num_cmp);
+
+		for (t = 0; t < 3; ++t) {
+			array_resize(arr, 0);
+			arr = array_append_many(arr, xs, (unsigned int)amt);
+			assert(array_sort_parallel(arr, p == 7 ? posnum_cmp :
+						   num_cmp, threads[t]) == arr);
+			assert(array_size(arr) == (unsigned int)amt);
+			for (i = 0; i < amt; ++i)
+				assert(arr->data[i].num == ref[i].num);
+
+			array_resize(arr, 0);
+			arr = array_append_many(arr, xs, (unsigned int)amt);
+			if (p == 7)
+				arr = array_sort_posnum_parallel(arr,
+								 threads[t]);
+			else
+				arr = array_sort_num_parallel(arr, threads[t]);
+			for (i = 0; i < amt; ++i)
+				assert(arr->data[i].num == ref[i].num);
+		}
+	}
+
+	/*
+	 * With only two distinct numbers, most splitters are equal.  The
+	 * numbers equal to them should still be spread over the threads.
+	 */
+	printf("Sorting arrays of %d items with two distinct values in "
+	       "parallel...\n", amt);
+	for (t = 0; t < 2; ++t) {
+		array_resize(arr, 0);
+		for (i = 0; i < amt; ++i) {
+			xs[0].num = rand() % 2;
+			arr = array_add(arr, xs[0]);
+		}
+		assert(array_sort_parallel_stats(arr, num_cmp, threads[t],
+						 &st) == arr);
+		for (i = 1; i < amt; ++i)
+			assert(arr->data[i - 1].num <= arr->data[i].num);
+		assert(st.nthreads >= 1 && st.nthreads <= threads[t]);
+		for (n = 0, b = 0; b < st.nthreads; ++b) {
+			n += st.bucket[b];
+			if (st.nthreads > 2)
+				assert(st.bucket[b] <=
+				       2 * (unsigned int)amt / (st.nthreads - 1));
+		}
+		assert(n == (unsigned int)amt);
+	}
+	array_destroy(arr, NULL);
+
+	free(xs);
+	free(ref);
+}
+
+
+/*
+ * Sort numbers in many patterns with array_sort and the radix sorts, and
+ * check the results against qsort.
+ */
+void
+stress_test_array_sort(int amt)
+{
+	gendata *xs, *ref;
+	array arr;
+	int i, n, p, size;
+
+	printf("Sorting arrays of up to %d items...\n", amt);
+	if ((xs = malloc((amt + 1) * sizeof(gendata))) == NULL ||
+	    (ref = malloc((amt + 1) * sizeof(gendata))) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+
+	/* A few small sizes too, which take the insertion sort paths */
+	for (size = 0; size < 4; ++size) {
+		n = size == 0 ? amt : MIN(amt, size * 10 - 5);
+		for (p = 0; p < 7; ++p) {
+			sort_fill(xs, n, p);
+			memcpy(ref, xs, n * sizeof(gendata));
+			qsort(ref, (size_t)n, sizeof(gendata), qsort_num_cmp);
+
+			arr = array_create();
+			arr = array_append_many(arr, xs, (unsigned int)n);
+			assert(array_sort(arr, num_cmp) == arr);
+			assert(array_size(arr) == (unsigned int)n);
+			for (i = 0; i < n; ++i)
+				assert(arr->data[i].num == ref[i].num);
+
+			array_resize(arr, 0);
+			arr = array_append_many(arr, xs, (unsigned int)n);
+			assert(array_sort_num(arr) == arr);
+			for (i = 0; i < n; ++i)
+				assert(arr->data[i].num == ref[i].num);
+			array_destroy(arr, NULL);
+		}
+	}
+
+	/* Unsigned numbers which use all the bits */
+	for (i = 0; i < amt; ++i)
+		xs[i].posnum = (unsigned int)rand() * 65599U ^
+			       (unsigned int)rand();
+	memcpy(ref, xs, amt * sizeof(gendata));
+	qsort(ref, (size_t)amt, sizeof(gendata), qsort_posnum_cmp);
+
+	arr = array_create();
+	arr = array_append_many(arr, xs, (unsigned int)amt);
+	assert(array_sort_posnum(arr) == arr);
+	for (i = 0; i < amt; ++i)
+		assert(arr->data[i].posnum == ref[i].posnum);
+
+	array_resize(arr, 0);
+	arr = array_append_many(arr, xs, (unsigned int)amt);
+	assert(array_sort(arr, posnum_cmp) == arr);
+	for (i = 0; i < amt; ++i)
+		assert(arr->data[i].posnum == ref[i].posnum);
+	array_destroy(arr, NULL);
+
+	free(xs);
+	free(ref);
+
+	stress_test_array_sort_parallel(amt * 100);
+}
+
+
+void
+stress_test_array(int amt)
+{
+	array arr; /* matey! */
+	gendata x, *xs;
+	int i;
+
+	arr = array_create();
+	assert(array_size(arr) == 0);
+
+	printf("Adding %d items to an array...\n", amt);
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		arr = array_add(arr, x);
+		assert(x.num == array_get_data(arr, (unsigned int)i).num);
+		assert(array_size(arr) == (unsigned int)(i + 1));
+	}
+
+	printf("Shrinking an array of %d items...\n", amt);
+	for (i = amt - 1; i >= 0; --i) {
+		assert(array_get_data(arr, (unsigned int)i).num == i);
+		arr = array_remove(arr);
+		assert(array_size(arr) == (unsigned int)i);
+	}
+
+	printf("Filling a pre-grown array of %d items...\n", amt);
+	array_grow(arr, amt);
+	assert(array_size(arr) == (unsigned int)amt);
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		arr = array_set_data(arr, (unsigned int)i, x);
+		assert(x.num == array_get_data(arr, (unsigned int)i).num);
+	}
+
+	printf("Shrinking an array of %d items...\n", amt);
+	for (i = amt - 1; i >= 0; --i) {
+		assert(array_get_data(arr, (unsigned int)i).num == i);
+		arr = array_shrink(arr, 1);
+
+		assert(array_size(arr) == (unsigned int)i);
+		/* Compactise at funky points */
+		if ((i % COMPACTISE_MODULO) == 0) {
+			arr = array_compact(arr);
+			/* Compactising should not change size */
+			assert(array_size(arr) == (unsigned int)i);
+		}
+	}
+
+	array_destroy(arr, NULL);
+
+	/* Growing a new array a lot at once must make enough room */
+	arr = array_create();
+	arr = array_grow(arr, 3 * amt + 100);
+	assert(arr != NULL);
+	assert(arr->capacity >= (unsigned int)(3 * amt + 100));
+	for (i = 0; i < 3 * amt + 100; ++i) {
+		x.num = i;
+		array_set_data(arr, (unsigned int)i, x);
+	}
+	array_destroy(arr, NULL);
+
+	printf("Appending %d items to an array at once...\n", amt);
+	if ((xs = malloc((amt + 1) * sizeof(gendata))) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	for (i = 0; i < amt; ++i)
+		xs[i].num = i;
+
+	arr = array_create();
+	arr = array_reserve(arr, (unsigned int)amt);
+	assert(arr != NULL && arr->capacity >= (unsigned int)amt);
+	assert(array_size(arr) == 0);
+	arr = array_append_many(arr, xs, 0);
+	assert(arr != NULL && array_size(arr) == 0);
+	arr = array_append_many(arr, xs, (unsigned int)amt);
+	assert(arr != NULL);
+	arr = array_append_many(arr, xs, (unsigned int)(amt / 2));
+	assert(arr != NULL);
+	assert(array_size(arr) == (unsigned int)(amt + amt / 2));
+	for (i = 0; i < amt + amt / 2; ++i)
+		assert(array_get_data(arr, (unsigned int)i).num == i % amt);
+
+	/* The size would wrap around */
+	if (amt > 0) {
+		errno = 0;
+		assert(array_append_many(arr, xs, UINT_MAX) == NULL);
+		assert(errno == ENOMEM);
+		assert(array_size(arr) == (unsigned int)(amt + amt / 2));
+	}
+
+	array_destroy(arr, NULL);
+	free(xs);
+
+	stress_test_array_sort(amt);
+}
+
+
+int
+vec_test_ivec(vec_op op, int a, int b)
+{
+	switch (op) {
+	case VEC_LT:
+		return a < b;
+	case VEC_LE:
+		return a <= b;
+	case VEC_EQ:
+		return a == b;
+	case VEC_NE:
+		return a != b;
+	case VEC_GE:
+		return a >= b;
+	default:
+		return a > b;
+	}
+}
+
+/*
+ * Check the reductions of a vector of signed integers against plain loops.
+ */
+void
+stress_test_ivec(int amt)
+{
+	int vals[4] = { 0, -7, INT_MAX, INT_MIN };
+	int x, m;
+	long sum;
+	unsigned int i, j, n, first;
+	vec_op op;
+	ivec v;
+
+	v = ivec_create(0);
+	assert(v != NULL && ivec_size(v) == 0);
+	assert(ivec_min(v, &m) == NULL && ivec_max(v, &m) == NULL);
+	assert(ivec_find(v, VEC_EQ, vals[0], 0) == 0);
+
+	for (i = 0; i < (unsigned int)amt; ++i) {
+		x = (int)(rand() % 2001) - 1000;
+		v = ivec_push(v, x);
+		assert(v != NULL);
+	}
+	assert(ivec_size(v) == (unsigned int)amt);
+	v = ivec_append(v, vals, 4);
+	assert(v != NULL && ivec_size(v) == (unsigned int)amt + 4);
+
+	for (sum = 0, i = 0; i < v->size; ++i)
+		sum += v->data[i];
+	assert(ivec_sum(v) == sum);
+
+	assert(ivec_min(v, &m) == v);
+	for (i = 0; i < v->size; ++i)
+		assert(m <= v->data[i]);
+	assert(ivec_max(v, &m) == v);
+	for (i = 0; i < v->size; ++i)
+		assert(m >= v->data[i]);
+
+	for (op = VEC_LT; op <= VEC_GT; ++op) {
+		for (j = 0; j < 4; ++j) {
+			for (n = 0, first = v->size, i = 0; i < v->size; ++i)
+				if (vec_test_ivec(op, v->data[i], vals[j])) {
+					++n;
+					first = MIN(first, i);
+				}
+			assert(ivec_count(v, op, vals[j]) == n);
+			assert(ivec_find(v, op, vals[j], 0) == first);
+			if (first < v->size)
+				assert(ivec_find(v, op, vals[j], first + 1)
+				       > first);
+		}
+	}
+	assert(ivec_find(v, VEC_EQ, vals[0], v->size + 1) == v->size);
+
+	ivec_fill(v, vals[1]);
+	assert(ivec_count(v, VEC_EQ, vals[1]) == v->size);
+	/* Sums which don't fit in 32 bits */
+	v = ivec_resize(v, 11);
+	assert(v != NULL);
+#if LONG_MAX > 0x7FFFFFFFL
+	ivec_fill(v, INT_MAX);
+	assert(ivec_sum(v) == 11L * INT_MAX);
+	ivec_fill(v, INT_MIN);
+	assert(ivec_sum(v) == 11L * INT_MIN);
+#endif
+	v = ivec_resize(v, 3);
+	assert(v != NULL && ivec_size(v) == 3);
+	v = ivec_reserve(v, (unsigned int)amt * 2);
+	assert(v != NULL && v->capacity >= (unsigned int)amt * 2);
+	assert(ivec_size(v) == 3);
+
+	ivec_destroy(v);
+}
+
+
+int
+vec_test_uvec(vec_op op, unsigned int a, unsigned int b)
+{
+	switch (op) {
+	case VEC_LT:
+		return a < b;
+	case VEC_LE:
+		return a <= b;
+	case VEC_EQ:
+		return a == b;
+	case VEC_NE:
+		return a != b;
+	case VEC_GE:
+		return a >= b;
+	default:
+		return a > b;
+	}
+}
+
+/*
+ * Check the reductions of a vector of unsigned integers against plain loops.
+ */
+void
+stress_test_uvec(int amt)
+{
+	unsigned int vals[4] = { 0, 7, UINT_MAX, 0x80000000U };
+	unsigned int x, m;
+	unsigned long sum;
+	unsigned int i, j, n, first;
+	vec_op op;
+	uvec v;
+
+	v = uvec_create(0);
+	assert(v != NULL && uvec_size(v) == 0);
+	assert(uvec_min(v, &m) == NULL && uvec_max(v, &m) == NULL);
+	assert(uvec_find(v, VEC_EQ, vals[0], 0) == 0);
+
+	for (i = 0; i < (unsigned int)amt; ++i) {
+		x = (unsigned int)rand() * 2654435761U;
+		v = uvec_push(v, x);
+		assert(v != NULL);
+	}
+	assert(uvec_size(v) == (unsigned int)amt);
+	v = uvec_append(v, vals, 4);
+	assert(v != NULL && uvec_size(v) == (unsigned int)amt + 4);
+
+	for (sum = 0, i = 0; i < v->size; ++i)
+		sum += v->data[i];
+	assert(uvec_sum(v) == sum);
+
+	assert(uvec_min(v, &m) == v);
+	for (i = 0; i < v->size; ++i)
+		assert(m <= v->data[i]);
+	assert(uvec_max(v, &m) == v);
+	for (i = 0; i < v->size; ++i)
+		assert(m >= v->data[i]);
+
+	for (op = VEC_LT; op <= VEC_GT; ++op) {
+		for (j = 0; j < 4; ++j) {
+			for (n = 0, first = v->size, i = 0; i < v->size; ++i)
+				if (vec_test_uvec(op, v->data[i], vals[j])) {
+					++n;
+					first = MIN(first, i);
+				}
+			assert(uvec_count(v, op, vals[j]) == n);
+			assert(uvec_find(v, op, vals[j], 0) == first);
+			if (first < v->size)
+				assert(uvec_find(v, op, vals[j], first + 1)
+				       > first);
+		}
+	}
+	assert(uvec_find(v, VEC_EQ, vals[0], v->size + 1) == v->size);
+
+	uvec_fill(v, vals[1]);
+	assert(uvec_count(v, VEC_EQ, vals[1]) == v->size);
+	/* Sums which don't fit in 32 bits */
+	v = uvec_resize(v, 11);
+	assert(v != NULL);
+	uvec_fill(v, UINT_MAX);
+	assert(uvec_sum(v) == 11UL * UINT_MAX);
+	v = uvec_resize(v, 3);
+	assert(v != NULL && uvec_size(v) == 3);
+	v = uvec_reserve(v, (unsigned int)amt * 2);
+	assert(v != NULL && v->capacity >= (unsigned int)amt * 2);
+	assert(uvec_size(v) == 3);
+
+	uvec_destroy(v);
+}
+
+
+int
+vec_test_lvec(vec_op op, long a, long b)
+{
+	switch (op) {
+	case VEC_LT:
+		return a < b;
+	case VEC_LE:
+		return a <= b;
+	case VEC_EQ:
+		return a == b;
+	case VEC_NE:
+		return a != b;
+	case VEC_GE:
+		return a >= b;
+	default:
+		return a > b;
+	}
+}
+
+/*
+ * Check the reductions of a vector of long integers against plain loops.
+ */
+void
+stress_test_lvec(int amt)
+{
+	long vals[4] = { 0, -7, LONG_MAX / 2, LONG_MIN / 2 };
+	long x, m;
+	long sum;
+	unsigned int i, j, n, first;
+	vec_op op;
+	lvec v;
+
+	v = lvec_create(0);
+	assert(v != NULL && lvec_size(v) == 0);
+	assert(lvec_min(v, &m) == NULL && lvec_max(v, &m) == NULL);
+	assert(lvec_find(v, VEC_EQ, vals[0], 0) == 0);
+
+	for (i = 0; i < (unsigned int)amt; ++i) {
+		x = (long)rand() * (rand() % 2 ? 1 : -1);
+		v = lvec_push(v, x);
+		assert(v != NULL);
+	}
+	assert(lvec_size(v) == (unsigned int)amt);
+	v = lvec_append(v, vals, 4);
+	assert(v != NULL && lvec_size(v) == (unsigned int)amt + 4);
+
+	for (sum = 0, i = 0; i < v->size; ++i)
+		sum += v->data[i];
+	assert(lvec_sum(v) == sum);
+
+	assert(lvec_min(v, &m) == v);
+	for (i = 0; i < v->size; ++i)
+		assert(m <= v->data[i]);
+	assert(lvec_max(v, &m) == v);
+	for (i = 0; i < v->size; ++i)
+		assert(m >= v->data[i]);
+
+	for (op = VEC_LT; op <= VEC_GT; ++op) {
+		for (j = 0; j < 4; ++j) {
+			for (n = 0, first = v->size, i = 0; i < v->size; ++i)
+				if (vec_test_lvec(op, v->data[i], vals[j])) {
+					++n;
+					first = MIN(first, i);
+				}
+			assert(lvec_count(v, op, vals[j]) == n);
+			assert(lvec_find(v, op, vals[j], 0) == first);
+			if (first < v->size)
+				assert(lvec_find(v, op, vals[j], first + 1)
+				       > first);
+		}
+	}
+	assert(lvec_find(v, VEC_EQ, vals[0], v->size + 1) == v->size);
+
+	lvec_fill(v, vals[1]);
+	assert(lvec_count(v, VEC_EQ, vals[1]) == v->size);
+	v = lvec_resize(v, 3);
+	assert(v != NULL && lvec_size(v) == 3);
+	v = lvec_reserve(v, (unsigned int)amt * 2);
+	assert(v != NULL && v->capacity >= (unsigned int)amt * 2);
+	assert(lvec_size(v) == 3);
+
+	lvec_destroy(v);
+}
+
+
+int
+vec_test_dvec(vec_op op, double a, double b)
+{
+	switch (op) {
+	case VEC_LT:
+		return a < b;
+	case VEC_LE:
+		return a <= b;
+	case VEC_EQ:
+		return a == b;
+	case VEC_NE:
+		return a != b;
+	case VEC_GE:
+		return a >= b;
+	default:
+		return a > b;
+	}
+}
+
+/*
+ * Check the reductions of a vector of floating point numbers against plain
+ * loops.
+ */
+void
+stress_test_dvec(int amt)
+{
+	double vals[4] = { 0.0, -0.5, 1e6, -1e6 };
+	double x, m;
+	double sum;
+	unsigned int i, j, n, first;
+	vec_op op;
+	dvec v;
+
+	v = dvec_create(0);
+	assert(v != NULL && dvec_size(v) == 0);
+	assert(dvec_min(v, &m) == NULL && dvec_max(v, &m) == NULL);
+	assert(dvec_find(v, VEC_EQ, vals[0], 0) == 0);
+
+	for (i = 0; i < (unsigned int)amt; ++i) {
+		/* Eighths add up exactly, in any order */
+		x = (double)(rand() % 2001) / 8.0 - 125.0;
+		v = dvec_push(v, x);
+		assert(v != NULL);
+	}
+	assert(dvec_size(v) == (unsigned int)amt);
+	v = dvec_append(v, vals, 4);
+	assert(v != NULL && dvec_size(v) == (unsigned int)amt + 4);
+
+	for (sum = 0, i = 0; i < v->size; ++i)
+		sum += v->data[i];
+	assert(dvec_sum(v) == sum);
+
+	assert(dvec_min(v, &m) == v);
+	for (i = 0; i < v->size; ++i)
+		assert(m <= v->data[i]);
+	assert(dvec_max(v, &m) == v);
+	for (i = 0; i < v->size; ++i)
+		assert(m >= v->data[i]);
+
+	for (op = VEC_LT; op <= VEC_GT; ++op) {
+		for (j = 0; j < 4; ++j) {
+			for (n = 0, first = v->size, i = 0; i < v->size; ++i)
+				if (vec_test_dvec(op, v->data[i], vals[j])) {
+					++n;
+					first = MIN(first, i);
+				}
+			assert(dvec_count(v, op, vals[j]) == n);
+			assert(dvec_find(v, op, vals[j], 0) == first);
+			if (first < v->size)
+				assert(dvec_find(v, op, vals[j], first + 1)
+				       > first);
+		}
+	}
+	assert(dvec_find(v, VEC_EQ, vals[0], v->size + 1) == v->size);
+
+	dvec_fill(v, vals[1]);
+	assert(dvec_count(v, VEC_EQ, vals[1]) == v->size);
+	v = dvec_resize(v, 3);
+	assert(v != NULL && dvec_size(v) == 3);
+	v = dvec_reserve(v, (unsigned int)amt * 2);
+	assert(v != NULL && v->capacity >= (unsigned int)amt * 2);
+	assert(dvec_size(v) == 3);
+
+	dvec_destroy(v);
+}
+
+
+int
+vec_test_bvec(vec_op op, unsigned char a, unsigned char b)
+{
+	switch (op) {
+	case VEC_LT:
+		return a < b;
+	case VEC_LE:
+		return a <= b;
+	case VEC_EQ:
+		return a == b;
+	case VEC_NE:
+		return a != b;
+	case VEC_GE:
+		return a >= b;
+	default:
+		return a > b;
+	}
+}
+
+/*
+ * Check the reductions of a vector of bytes against plain loops.
+ */
+void
+stress_test_bvec(int amt)
+{
+	unsigned char vals[4] = { 0, 7, 128, 255 };
+	unsigned char x, m;
+	unsigned long sum;
+	unsigned int i, j, n, first;
+	vec_op op;
+	bvec v;
+
+	v = bvec_create(0);
+	assert(v != NULL && bvec_size(v) == 0);
+	assert(bvec_min(v, &m) == NULL && bvec_max(v, &m) == NULL);
+	assert(bvec_find(v, VEC_EQ, vals[0], 0) == 0);
+
+	for (i = 0; i < (unsigned int)amt; ++i) {
+		x = (unsigned char)rand();
+		v = bvec_push(v, x);
+		assert(v != NULL);
+	}
+	assert(bvec_size(v) == (unsigned int)amt);
+	v = bvec_append(v, vals, 4);
+	assert(v != NULL && bvec_size(v) == (unsigned int)amt + 4);
+
+	for (sum = 0, i = 0; i < v->size; ++i)
+		sum += v->data[i];
+	assert(bvec_sum(v) == sum);
+
+	assert(bvec_min(v, &m) == v);
+	for (i = 0; i < v->size; ++i)
+		assert(m <= v->data[i]);
+	assert(bvec_max(v, &m) == v);
+	for (i = 0; i < v->size; ++i)
+		assert(m >= v->data[i]);
+
+	for (op = VEC_LT; op <= VEC_GT; ++op) {
+		for (j = 0; j < 4; ++j) {
+			for (n = 0, first = v->size, i = 0; i < v->size; ++i)
+				if (vec_test_bvec(op, v->data[i], vals[j])) {
+					++n;
+					first = MIN(first, i);
+				}
+			assert(bvec_count(v, op, vals[j]) == n);
+			assert(bvec_find(v, op, vals[j], 0) == first);
+			if (first < v->size)
+				assert(bvec_find(v, op, vals[j], first + 1)
+				       > first);
+		}
+	}
+	assert(bvec_find(v, VEC_EQ, vals[0], v->size + 1) == v->size);
+
+	bvec_fill(v, vals[1]);
+	assert(bvec_count(v, VEC_EQ, vals[1]) == v->size);
+	/* A sum which doesn't fit in 32 bits */
+	v = bvec_resize(v, 0x1010102);
+	assert(v != NULL);
+	bvec_fill(v, 255);
+	assert(bvec_sum(v) == 255UL * 0x1010102);
+	v = bvec_resize(v, 3);
+	assert(v != NULL && bvec_size(v) == 3);
+	v = bvec_reserve(v, (unsigned int)amt * 2);
+	assert(v != NULL && v->capacity >= (unsigned int)amt * 2);
+	assert(bvec_size(v) == 3);
+
+	bvec_destroy(v);
+}
+
+
+void
+stress_test_vec(int amt)
+{
+	printf("Testing a vector of %d signed integers...\n", amt);
+	stress_test_ivec(amt);
+	printf("Testing a vector of %d unsigned integers...\n", amt);
+	stress_test_uvec(amt);
+	printf("Testing a vector of %d long integers...\n", amt);
+	stress_test_lvec(amt);
+	printf("Testing a vector of %d floating point numbers...\n", amt);
+	stress_test_dvec(amt);
+	printf("Testing a vector of %d bytes...\n", amt);
+	stress_test_bvec(amt);
+}
+
+
+void
+stress_test_sll(int amt)
+{
+	sll l1;
+	sll l2;
+	gendata x, y;
+	int i;
+
+	l1 = sll_create();
+	l2 = sll_create();
+	assert(sll_empty(l1));
+	assert(sll_empty(l2));
+	printf("Filling two slls with 2 * %d items...\n", amt);
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		l1 = sll_prepend_head(l1, x);
+		l2 = sll_prepend_head(l2, x);
+		assert(!sll_empty(l1));
+		assert(!sll_empty(l2));
+		l1 = sll_append_head(l1, x);
+		l2 = sll_append_head(l2, x);
+		assert(!sll_empty(l1));
+		assert(!sll_empty(l2));
+	}
+	assert(sll_count(l1) == (unsigned int)(2 * amt));
+	assert(sll_count(l2) == (unsigned int)(2 * amt));
+
+	l1 = sll_append(l1, l2);
+	assert(sll_count(l1) == (unsigned int)(4 * amt));
+
+	/* From now on, l2 is `invalid' */
+
+	printf("Removing 2 * 2 * %d items from the appended sll...\n", amt);
+	for (i = 0; i < (2 * amt); ++i) {
+		x = sll_get_data(sll_next(l1));
+		assert(!sll_empty(l1));
+		l1 = sll_remove_next(l1, NULL);
+		y = sll_get_data(l1);
+		assert(!sll_empty(l1));
+		l1 = sll_remove_head(l1, NULL);
+
+		/*
+		 * We have to count backwards in this check, since we're
+		 * using the list like a stack, prepending all the time.
+		 */
+		assert(x.num == amt - (i % amt) - 1);
+		assert(x.num == y.num);
+	}
+	assert(sll_empty(l1));
+	sll_destroy(l1, NULL);
+}
+
+
+void
+stress_test_dll(int amt)
+{
+	dll l1;
+	dll l2;
+	gendata x, y;
+	int i;
+
+	l1 = dll_create();
+	l2 = dll_create();
+	assert(dll_empty(l1));
+	assert(dll_empty(l2));
+
+	printf("Filling two dlls with 2 * %d items...\n", amt);
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		l1 = dll_prepend_head(l1, x);
+		l2 = dll_prepend_head(l2, x);
+		assert(!dll_empty(l1));
+		assert(!dll_empty(l2));
+		l1 = dll_append_head(l1, x);
+		l2 = dll_append_head(l2, x);
+		assert(!dll_empty(l1));
+		assert(!dll_empty(l2));
+	}
+
+	/* Do some funky inserting at a `random' position. */
+	dll_append_head(dll_forward(l1, 1), x);
+	assert(x.num == dll_get_data(dll_forward(l1, 1)).num);
+	dll_remove_head(dll_forward(l1, 2), NULL);
+
+	l1 = dll_append(l1, l2);
+	assert(dll_count(l1) == (unsigned int)(4 * amt));
+
+	/* From now on, l2 is `invalid' */
+
+	printf("Removing 2 * 2 * %d items from the appended dll...\n", amt);
+	for (i = 0; i < (2 * amt); ++i) {
+		assert(!dll_empty(l1));
+		x = dll_get_data(l1);
+		l1 = dll_remove_head(l1, NULL);
+		assert(!dll_empty(l1));
+		y = dll_get_data(l1);
+		l1 = dll_remove_head(l1, NULL);
+
+		/*
+		 * We have to count backwards in this check, since we're
+		 * using the list like a stack, prepending all the time.
+		 */
+		assert(x.num == amt - (i % amt) - 1);
+		assert(x.num == y.num);
+	}
+	assert(dll_empty(l1));
+	dll_destroy(l1, NULL);
+}
+
+
+void
+stress_test_stack(int amt)
+{
+	int i;
+	gendata x, y;
+	stack s;
+	
+	s = stack_create();
+	assert(stack_empty(s));
+
+	/* Fill it up, and remove items again */
+	printf("Filling a stack with %d items...\n", amt);
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		stack_push(s, x);
+		assert(x.num == stack_peek(s).num);
+		assert(!stack_empty(s));
+	}
+	printf("Popping/peeking stack of %d items...\n", amt);
+	for (i = 0; i < amt; ++i) {
+		assert(!stack_empty(s));
+		x = stack_peek(s);
+		y = stack_pop(s);
+
+		assert(x.num == amt - i - 1);
+		assert(x.num == y.num);
+	}
+
+	assert(stack_empty(s));
+
+	/* Now, again, fill up the stack... */
+	printf("Refilling a stack with %d items...\n", amt);
+	for (i = 0; i < amt; ++i)
+		stack_push(s, x);
+
+	assert(!stack_empty(s));
+
+	printf("Destroying a stack with %d items...\n", amt);
+	/* ...and free it */
+	stack_destroy(s, NULL);
+}
+
+
+void
+stress_test_queue(int amt)
+{
+	int i;
+	queue q;
+	gendata x, y;
+
+	q = queue_create();
+	assert(queue_empty(q));
+
+	/* Fill the queue */
+	printf("Enqueueing a queue with %d items...\n", amt);
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		q = queue_enqueue(q, x);
+		assert(!queue_empty(q));
+	}
+	printf("Dequeueing a queue with %d items...\n", amt);
+	for (i = 0; i < amt; ++i) {
+		assert(!queue_empty(q));
+		x = queue_peek(q);
+		y = queue_dequeue(q);
+		assert(x.num == y.num);
+		assert(x.num == i);
+	}
+	assert(queue_empty(q));
+
+	printf("Re-enqueueing a queue with %d items...\n", amt);
+	for (i = 0; i < amt; ++i) {
+		x.num = i;
+		q = queue_enqueue(q, x);
+		assert(!queue_empty(q));
+	}
+	printf("Destroying a queue with %d items...\n", amt);
+	queue_destroy(q, NULL);
+}
+
+
+/* String equals predicate which counts how often it is called */
+int
+counting_str_eq(gendata s1, gendata s2)
+{
+	++eq_calls;
+	return str_eq(s1, s2);
+}
+
+
+/* Seconds of processor time used since start */
+double
+elapsed(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+/*
+ * Make amt string keys.  The keys share a long prefix, like path names
+ * or URLs usually do, which makes comparing them relatively expensive.
+ */
+char **
+bench_keys(int amt, const char *kind)
+{
+	char **keys;
+	int i;
+
+	if ((keys = malloc(amt * sizeof(char *))) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+
+	for (i = 0; i < amt; ++i) {
+		if ((keys[i] = malloc(64)) == NULL) {
+			perror("malloc");
+			exit(1);
+		}
+		sprintf(keys[i], "/usr/local/share/gune/benchmark/%s/%d",
+			kind, i);
+	}
+
+	return keys;
+}
+
+
+void
+bench_free_keys(char **keys, int amt)
+{
+	int i;
+
+	for (i = 0; i < amt; ++i)
+		free(keys[i]);
+	free(keys);
+}
+
+
+/*
+ * Compare the SIMD hash table against both ht engines on string keys.
+ */
+void
+bench_sht(int amt)
+{
+	const char *names[] = { "ht (chained)", "ht (robin hood)",
+				"ht + bloom", "sht" };
+	char **keys, **misses;
+	double insert, hit, miss;
+	unsigned long hit_eq, miss_eq;
+	gendata x, y;
+	clock_t start;
+	int i, kind;
+	ht t = NULL;
+	sht st = NULL;
+
+	keys = bench_keys(amt, "hit");
+	misses = bench_keys(amt, "miss");
+
+	printf("Looking up %d string keys (eq = equals calls per lookup)\n",
+	       amt);
+	printf("%-16s %10s %10s %10s %8s %8s\n", "table", "insert",
+	       "hit", "miss", "hit eq", "miss eq");
+
+	for (kind = 0; kind < 4; ++kind) {
+		start = clock();
+		if (kind < 3) {
+			t = ht_create_type(0, str_hash, kind == 1 ?
+					   HT_ROBINHOOD : HT_CHAINED);
+			if (kind == 2)
+				ht_set_bloom(t, 0.01);
+		} else {
+			st = sht_create(0, str_hash);
+		}
+		for (i = 0; i < amt; ++i) {
+			x.ptr = y.ptr = keys[i];
+			if (kind < 3)
+				ht_insert(t, x, y, str_eq, NULL, NULL);
+			else
+				sht_insert(st, x, y, str_eq, NULL, NULL);
+		}
+		insert = elapsed(start);
+
+		eq_calls = 0;
+		start = clock();
+		for (i = 0; i < amt; ++i) {
+			x.ptr = keys[i];
+			if (kind < 3)
+				ht_lookup(t, x, counting_str_eq, &y);
+			else
+				sht_lookup(st, x, counting_str_eq, &y);
+			assert(y.ptr == keys[i]);
+		}
+		hit = elapsed(start);
+		hit_eq = eq_calls;
+
+		eq_calls = 0;
+		start = clock();
+		for (i = 0; i < amt; ++i) {
+			x.ptr = misses[i];
+			if (kind < 3)
+				assert(ht_lookup(t, x, counting_str_eq, &y)
+				       == NULL);
+			else
+				assert(sht_lookup(st, x, counting_str_eq, &y)
+				       == NULL);
+		}
+		miss = elapsed(start);
+		miss_eq = eq_calls;
+
+		printf("%-16s %9.3fs %9.3fs %9.3fs %8.2f %8.2f\n",
+		       names[kind], insert, hit, miss,
+		       (double)hit_eq / amt, (double)miss_eq / amt);
+
+		if (kind < 3)
+			ht_destroy(t, NULL, NULL);
+		else
+			sht_destroy(st, NULL, NULL);
+	}
+
+	bench_free_keys(keys, amt);
+	bench_free_keys(misses, amt);
+}
+
+
+/*
+ * Compare looking up keys one by one with looking them up in batches.
+ * The keys are looked up in random order, so nearly every lookup misses
+ * the cache once the table is big enough.
+ */
+void
+bench_lookup_many(int amt)
+{
+	const char *names[] = { "ht (chained)", "ht (robin hood)" };
+	gendata *keys, *values;
+	unsigned char *found;
+	double single, many;
+	gendata x, y;
+	clock_t start;
+	int i, j, kind;
+	ht t;
+
+	keys = malloc(amt * sizeof(gendata));
+	values = malloc(amt * sizeof(gendata));
+	found = malloc(amt);
+	if (keys == NULL || values == NULL || found == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+
+	for (i = 0; i < amt; ++i)
+		keys[i].num = i;
+	for (i = amt - 1; i > 0; --i) {
+		j = rand() % (i + 1);
+		x = keys[i];
+		keys[i] = keys[j];
+		keys[j] = x;
+	}
+
+	printf("Looking up %d integer keys in random order\n", amt);
+	printf("%-16s %10s %10s\n", "table", "single", "many");
+
+	for (kind = 0; kind < 2; ++kind) {
+		t = ht_create_full(0, num_fullhash, kind == 0 ?
+				   HT_CHAINED : HT_ROBINHOOD);
+		for (i = 0; i < amt; ++i) {
+			x.num = y.num = i;
+			ht_insert(t, x, y, num_eq, NULL, NULL);
+		}
+
+		start = clock();
+		for (i = 0; i < amt; ++i)
+			ht_lookup(t, keys[i], num_eq, values + i);
+		single = elapsed(start);
+
+		start = clock();
+		i = (int)ht_lookup_many(t, keys, amt, num_eq, values, found);
+		many = elapsed(start);
+		assert(i == amt);
+
+		printf("%-16s %9.3fs %9.3fs\n", names[kind], single, many);
+		ht_destroy(t, NULL, NULL);
+	}
+
+	free(keys);
+	free(values);
+	free(found);
+}
+
+
+/*
+ * Compare lookups in a hash table against the same table after freezing.
+ */
+void
+bench_freeze(int amt)
+{
+	char **keys, **misses, *tmp;
+	double hit[2], miss[2], freeze;
+	gendata x, y;
+	clock_t start;
+	int i, j;
+	ht t;
+	fht f;
+
+	keys = bench_keys(amt, "hit");
+	misses = bench_keys(amt, "miss");
+
+	t = ht_create_full(0, str_fullhash, HT_CHAINED);
+	for (i = 0; i < amt; ++i) {
+		x.ptr = keys[i];
+		y.num = i;
+		ht_insert(t, x, y, str_eq, NULL, NULL);
+	}
+
+	/* Look the keys up in random order, not in the order of insertion */
+	for (i = amt - 1; i > 0; --i) {
+		j = rand() % (i + 1);
+		tmp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = tmp;
+	}
+
+	printf("Looking up %d string keys before and after freezing\n", amt);
+
+	start = clock();
+	for (i = 0; i < amt; ++i) {
+		x.ptr = keys[i];
+		ht_lookup(t, x, str_eq, &y);
+	}
+	hit[0] = elapsed(start);
+
+	start = clock();
+	for (i = 0; i < amt; ++i) {
+		x.ptr = misses[i];
+		ht_lookup(t, x, str_eq, &y);
+	}
+	miss[0] = elapsed(start);
+
+	start = clock();
+	f = ht_freeze(t);
+	freeze = elapsed(start);
+	assert(f != NULL);
+
+	start = clock();
+	for (i = 0; i < amt; ++i) {
+		x.ptr = keys[i];
+		fht_lookup(f, x, str_eq, &y);
+	}
+	hit[1] = elapsed(start);
+
+	start = clock();
+	for (i = 0; i < amt; ++i) {
+		x.ptr = misses[i];
+		fht_lookup(f, x, str_eq, &y);
+	}
+	miss[1] = elapsed(start);
+
+	printf("%-16s %10s %10s\n", "table", "hit", "miss");
+	printf("%-16s %9.3fs %9.3fs\n", "ht (chained)", hit[0], miss[0]);
+	printf("%-16s %9.3fs %9.3fs\n", "fht", hit[1], miss[1]);
+	printf("Freezing took %.3fs\n", freeze);
+
+	fht_destroy(f, NULL, NULL);
+	bench_free_keys(keys, amt);
+	bench_free_keys(misses, amt);
+}
+
+
+/*
+ * Compare an LRU cache against a CLOCK cache holding a tenth of the keys,
+ * with a skewed access pattern so most lookups hit.
+ */
+void
+bench_cache(int amt)
+{
+	int *pattern;
+	double took[2];
+	lru_stats_t st[2];
+	gendata x, y;
+	clock_t start;
+	int i, n, cap;
+	lru l;
+	ccache c;
+
+	cap = amt / 10 + 1;
+	n = 10 * amt;
+	if ((pattern = malloc(n * sizeof(int))) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+
+	/* The product of two uniform numbers favours the low keys */
+	for (i = 0; i < n; ++i)
+		pattern[i] = (int)((double)(rand() % amt) * (rand() % amt) /
+				   amt);
+
+	printf("Doing %d lookups on caches of %d out of %d keys\n", n, cap,
+	       amt);
+
+	l = lru_create(cap, num_fullhash, NULL, NULL, NULL);
+	start = clock();
+	for (i = 0; i < n; ++i) {
+		x.num = pattern[i];
+		if (lru_get(l, x, num_eq, &y) == NULL)
+			lru_put(l, x, x, num_eq);
+	}
+	took[0] = elapsed(start);
+	st[0] = lru_stats(l);
+	lru_destroy(l);
+
+	c = ccache_create(cap, num_fullhash, NULL, NULL, NULL);
+	start = clock();
+	for (i = 0; i < n; ++i) {
+		x.num = pattern[i];
+		if (ccache_get(c, x, num_eq, &y) == NULL)
+			ccache_put(c, x, x, num_eq);
+	}
+	took[1] = elapsed(start);
+	st[1] = ccache_stats(c);
+	ccache_destroy(c);
+
+	printf("%-16s %10s %10s\n", "cache", "time", "hit ratio");
+	printf("%-16s %9.3fs %10.3f\n", "lru", took[0],
+	       (double)st[0].hits / n);
+	printf("%-16s %9.3fs %10.3f\n", "ccache", took[1],
+	       (double)st[1].hits / n);
+
+	free(pattern);
+}
+
+
+/* The byte at a time string hash that str_fullhash used to be */
+hashval
+bench_old_str_hash(gendata key)
+{
+	const char *s = (const char *)key.ptr;
+	hashval h = 0;
+
+	while (*s != '\0')
+		h ^= ((h << 5) + (h >> 2) + (unsigned char)*s++);
+
+	return h;
+}
+
+
+/*
+ * Compare the old byte at a time string hash with str_fullhash and
+ * str_keyedhash on short, medium and long keys.
+ */
+void
+bench_str_hash(int amt)
+{
+	static const int lens[] = { 8, 32, 256 };
+	char *keys;
+	double took[3];
+	clock_t start;
+	hashseed seed;
+	gendata x;
+	hashval sum;
+	int i, l, n;
+
+	/* Repeat the hashing enough that the long keys take some time */
+	n = amt * 10;
+	printf("Hashing %d keys of each length\n", n);
+	printf("%-16s %10s %10s %10s\n", "length", "old", "new", "keyed");
+	hash_seed(&seed);
+
+	if ((keys = malloc(64 * 257)) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+
+	for (l = 0; l < 3; ++l) {
+		/* 64 distinct keys which are cycled through */
+		for (i = 0; i < 64; ++i) {
+			memset(keys + i * 257, 'a' + i % 26, lens[l]);
+			sprintf(keys + i * 257, "%d", i);
+			keys[i * 257 + strlen(keys + i * 257)] = '/';
+			keys[i * 257 + lens[l]] = '\0';
+		}
+
+		sum = 0;
+		start = clock();
+		for (i = 0; i < n; ++i) {
+			x.ptr = keys + (i & 63) * 257;
+			sum += bench_old_str_hash(x);
+		}
+		took[0] = elapsed(start);
+
+		start = clock();
+		for (i = 0; i < n; ++i) {
+			x.ptr = keys + (i & 63) * 257;
+			sum += str_fullhash(x);
+		}
+		took[1] = elapsed(start);
+
+		start = clock();
+		for (i = 0; i < n; ++i) {
+			x.ptr = keys + (i & 63) * 257;
+			sum += str_keyedhash(x, &seed);
+		}
+		took[2] = elapsed(start);
+
+		/* Use the sum so the hashing can't be optimised away */
+		printf("%-16d %9.3fs %9.3fs %9.3fs%s\n", lens[l], took[0],
+		       took[1], took[2], sum == 42 ? " " : "");
+	}
+
+	free(keys);
+}
+
+
+/* The hashes ptr_hash and num_hash used to be */
+unsigned int
+bench_old_ptr_hash(gendata key, unsigned int range)
+{
+	/* LINTED */
+	return (unsigned int)(hashval)key.ptr % range;
+}
+
+
+unsigned int
+bench_old_num_hash(gendata key, unsigned int range)
+{
+	return (unsigned int)(key.num % range);
+}
+
+
+/*
+ * Print which part of the buckets of a table the keys go to with hash, and
+ * the most keys in one bucket.
+ */
+void
+bench_occupancy_row(const char *name, hash_func hash, gendata *keys,
+		    int amt, unsigned int range)
+{
+	unsigned int *load, i, used, most;
+	int n;
+
+	if ((load = calloc(range, sizeof(unsigned int))) == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+
+	for (n = 0; n < amt; ++n)
+		++load[hash(keys[n], range)];
+
+	for (used = most = i = 0; i < range; ++i) {
+		used += (load[i] > 0);
+		most = MAX(most, load[i]);
+	}
+
+	printf("%-24s %10.3f %10u\n", name, (double)used / range, most);
+	free(load);
+}
+
+
+/*
+ * Compare the old and new pointer and integer hashes on keys with the
+ * patterns they usually have: aligned pointers, consecutive numbers and
+ * numbers with a stride.  The tables have a power of two range.
+ */
+void
+bench_occupancy(int amt)
+{
+	static const int strides[] = { 1, 16, 1024 };
+	char name[32];
+	gendata *keys;
+	char *block;
+	double empty;
+	unsigned int range;
+	int i, s;
+
+	/* Tables are between a quarter and half full */
+	for (range = 1; range < (unsigned int)amt * 2; range <<= 1)
+		;
+
+	if ((keys = malloc(amt * sizeof(gendata))) == NULL ||
+	    (block = malloc(amt * 16 + 16)) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+
+	/* The chance a bucket stays empty with a perfectly random hash */
+	for (empty = 1.0, i = 0; i < amt; ++i)
+		empty *= 1.0 - 1.0 / range;
+
+	printf("Hashing %d keys into %u buckets (ideally %.3f are used)\n",
+	       amt, range, 1.0 - empty);
+	printf("%-24s %10s %10s\n", "keys", "used", "most");
+
+	for (s = 0; s < 3; ++s) {
+		for (i = 0; i < amt; ++i)
+			keys[i].num = i * strides[s];
+		sprintf(name, "stride %d, old", strides[s]);
+		bench_occupancy_row(name, bench_old_num_hash, keys, amt,
+				    range);
+		sprintf(name, "stride %d, num_hash", strides[s]);
+		bench_occupancy_row(name, num_hash, keys, amt, range);
+	}
+
+	/* Like the addresses of 16 byte structures in an array */
+	for (i = 0; i < amt; ++i)
+		keys[i].ptr = block + i * 16;
+	bench_occupancy_row("pointers, old", bench_old_ptr_hash, keys, amt,
+			    range);
+	bench_occupancy_row("pointers, ptr_hash", ptr_hash, keys, amt, range);
+
+	free(block);
+	free(keys);
+}
+
+
+/*
+ * Compare ways of loading many elements into an array: one at a time
+ * through array_grow (which is what array_add used to do), with array_add,
+ * and in blocks with array_append_many.
+ */
+void
+bench_array(int amt)
+{
+	gendata block[1024];
+	double took[3];
+	clock_t start;
+	array ar;
+	int i, j, n;
+
+	n = amt * 100;
+	printf("Loading %d elements into an array\n", n);
+	for (i = 0; i < 1024; ++i)
+		block[i].num = i;
+
+	ar = array_create();
+	start = clock();
+	for (i = 0; i < n; ++i) {
+		ar = array_grow(ar, 1);
+		array_set_data(ar, array_size(ar) - 1, block[i & 1023]);
+	}
+	took[0] = elapsed(start);
+	array_destroy(ar, NULL);
+
+	ar = array_create();
+	start = clock();
+	for (i = 0; i < n; ++i)
+		ar = array_add(ar, block[i & 1023]);
+	took[1] = elapsed(start);
+	array_destroy(ar, NULL);
+
+	ar = array_create();
+	start = clock();
+	for (i = 0; i < n; i += j) {
+		j = MIN(n - i, 1024);
+		ar = array_append_many(ar, block, (unsigned int)j);
+	}
+	took[2] = elapsed(start);
+	assert(array_size(ar) == (unsigned int)n);
+	array_destroy(ar, NULL);
+
+	printf("%-20s %9.3fs\n", "array_grow", took[0]);
+	printf("%-20s %9.3fs\n", "array_add", took[1]);
+	printf("%-20s %9.3fs\n", "array_append_many", took[2]);
+}
+
+
+/*
+ * Compare reductions over an array of integers through array_get_data, over
+ * a plain C array with simple loops, and over a typed vector.
+ */
+void
+bench_vec(int amt)
+{
+	double took[3][4];
+	volatile long sink = 0;
+	clock_t start;
+	gendata x;
+	array ar;
+	ivec v;
+	int i, j, r, n, m;
+	long sum;
+
+	n = amt * 10;
+	printf("Reducing %d integers 20 times\n", n);
+
+	ar = array_create();
+	v = ivec_create((unsigned int)n);
+	for (i = 0; i < n; ++i) {
+		x.num = rand() % 1000;
+		ar = array_add(ar, x);
+		v = ivec_push(v, x.num);
+	}
+
+	for (j = 0; j < 4; ++j) {
+		start = clock();
+		for (r = 0; r < 20; ++r) {
+			sum = 0;
+			m = INT_MAX;
+			for (i = 0; i < n; ++i) {
+				x = array_get_data(ar, (unsigned int)i);
+				if (j == 0)
+					sum += x.num;
+				else if (j == 1)
+					m = MIN(m, x.num);
+				else if (j == 2)
+					sum += (x.num < 500);
+				else if (x.num == 1000)
+					break;
+			}
+			sink += sum + m;
+		}
+		took[0][j] = elapsed(start);
+
+		start = clock();
+		for (r = 0; r < 20; ++r) {
+			sum = 0;
+			m = INT_MAX;
+			if (j == 0) {
+				for (i = 0; i < n; ++i)
+					sum += v->data[i];
+			} else if (j == 1) {
+				for (i = 0; i < n; ++i)
+					m = MIN(m, v->data[i]);
+			} else if (j == 2) {
+				for (i = 0; i < n; ++i)
+					sum += (v->data[i] < 500);
+			} else {
+				for (i = 0; i < n; ++i)
+					if (v->data[i] == 1000)
+						break;
+				sum = i;
+			}
+			sink += sum + m;
+		}
+		took[1][j] = elapsed(start);
+
+		start = clock();
+		for (r = 0; r < 20; ++r) {
+			if (j == 0)
+				sink += ivec_sum(v);
+			else if (j == 1)
+				sink += ivec_min(v, &m) == NULL ? 0 : m;
+			else if (j == 2)
+				sink += ivec_count(v, VEC_LT, 500);
+			else
+				sink += ivec_find(v, VEC_EQ, 1000, 0);
+		}
+		took[2][j] = elapsed(start);
 	}
 
-	printf("Shrinking an array of %d items...\n", amt);
-	for (i = amt - 1; i >= 0; --i) {
-		assert(array_get_data(arr, (unsigned int)i).num == i);
-		arr = array_shrink(arr, 1);
+	printf("%-16s %10s %10s %10s %10s\n", "", "sum", "min", "count",
+	       "find");
+	printf("%-16s %9.3fs %9.3fs %9.3fs %9.3fs\n", "array", took[0][0],
+	       took[0][1], took[0][2], took[0][3]);
+	printf("%-16s %9.3fs %9.3fs %9.3fs %9.3fs\n", "plain loop",
+	       took[1][0], took[1][1], took[1][2], took[1][3]);
+	printf("%-16s %9.3fs %9.3fs %9.3fs %9.3fs\n", "ivec", took[2][0],
+	       took[2][1], took[2][2], took[2][3]);
 
-		assert(array_size(arr) == (unsigned int)i);
-		/* Compactise at funky points */
-		if ((i % COMPACTISE_MODULO) == 0) {
-			arr = array_compact(arr);
-			/* Compactising should not change size */
-			assert(array_size(arr) == (unsigned int)i);
+	array_destroy(ar, NULL);
+	ivec_destroy(v);
+}
+
+
+/*
+ * Compare sorting an array of integers with libc's qsort, with array_sort
+ * and with the radix sort of array_sort_num.
+ */
+void
+bench_sort(int amt)
+{
+	double took[3][3];
+	gendata *xs;
+	clock_t start;
+	array ar;
+	int i, j, p, n;
+
+	n = amt * 10;
+	printf("Sorting %d integers\n", n);
+	if ((xs = malloc(n * sizeof(gendata))) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+
+	ar = array_create();
+	for (p = 0; p < 3; ++p) {
+		/* Random, few distinct and sorted with a few changes */
+		sort_fill(xs, n, p);
+		for (j = 0; j < 3; ++j) {
+			array_resize(ar, 0);
+			ar = array_append_many(ar, xs, (unsigned int)n);
+			start = clock();
+			if (j == 0)
+				qsort(ar->data, (size_t)n, sizeof(gendata),
+				      qsort_num_cmp);
+			else if (j == 1)
+				array_sort(ar, num_cmp);
+			else
+				array_sort_num(ar);
+			took[j][p] = elapsed(start);
+			for (i = 1; i < n; ++i)
+				assert(ar->data[i - 1].num <= ar->data[i].num);
 		}
 	}
 
-	array_destroy(arr, NULL);
+	printf("%-16s %10s %10s %10s\n", "", "random", "few", "sorted");
+	printf("%-16s %9.3fs %9.3fs %9.3fs\n", "qsort", took[0][0],
+	       took[0][1], took[0][2]);
+	printf("%-16s %9.3fs %9.3fs %9.3fs\n", "array_sort", took[1][0],
+	       took[1][1], took[1][2]);
+	printf("%-16s %9.3fs %9.3fs %9.3fs\n", "array_sort_num",
+	       took[2][0], took[2][1], took[2][2]);
+
+	array_destroy(ar, NULL);
+	free(xs);
 }
 
 
+/*
+ * Compare a hash table with sorted maps ordered by num_cmp (which smap
+ * compares inline) and by a function it has to call: inserting random keys
+ * one by one, inserting them all at once and looking them all up.
+ */
 void
-stress_test_sll(int amt)
+bench_smap(int amt)
 {
-	sll l1;
-	sll l2;
-	gendata x, y;
-	int i;
+	const char *names[] = { "ht (robin hood)", "smap, num_cmp",
+				"smap, other cmp" };
+	double took[3];
+	gendata *keys, x;
+	clock_t start;
+	int i, j, kind;
+	smap m = NULL;
+	ht t = NULL;
 
-	l1 = sll_create();
-	l2 = sll_create();
-	assert(sll_empty(l1));
-	assert(sll_empty(l2));
-	printf("Filling two slls with 2 * %d items...\n", amt);
-	for (i = 0; i < amt; ++i) {
-		x.num = i;
-		l1 = sll_prepend_head(l1, x);
-		l2 = sll_prepend_head(l2, x);
-		assert(!sll_empty(l1));
-		assert(!sll_empty(l2));
-		l1 = sll_append_head(l1, x);
-		l2 = sll_append_head(l2, x);
-		assert(!sll_empty(l1));
-		assert(!sll_empty(l2));
+	if ((keys = malloc(amt * sizeof(gendata))) == NULL) {
+		perror("malloc");
+		exit(1);
 	}
-	assert(sll_count(l1) == (unsigned int)(2 * amt));
-	assert(sll_count(l2) == (unsigned int)(2 * amt));
+	for (i = 0; i < amt; ++i)
+		keys[i].num = rand();
 
-	l1 = sll_append(l1, l2);
-	assert(sll_count(l1) == (unsigned int)(4 * amt));
+	printf("Inserting and looking up %d random integer keys\n", amt);
+	printf("%-16s %10s %10s %10s\n", "", "insert", "bulk", "lookup");
 
-	/* From now on, l2 is `invalid' */
+	for (kind = 0; kind < 3; ++kind) {
+		for (j = 0; j < 2; ++j) {
+			start = clock();
+			if (kind == 0) {
+				t = ht_create_full(0, num_fullhash,
+						   HT_ROBINHOOD);
+				for (i = 0; i < amt; ++i)
+					ht_insert(t, keys[i], keys[i], num_eq,
+						  NULL, NULL);
+			} else {
+				m = smap_create(kind == 1 ? num_cmp :
+						reverse_num_cmp);
+				if (j == 0)
+					for (i = 0; i < amt; ++i)
+						smap_insert(m, keys[i],
+							    keys[i], NULL,
+							    NULL);
+				else
+					smap_insert_many(m, keys, keys,
+							 (unsigned int)amt,
+							 NULL, NULL);
+			}
+			took[j] = elapsed(start);
+			if (j == 0) {
+				if (kind == 0)
+					ht_destroy(t, NULL, NULL);
+				else
+					smap_destroy(m, NULL, NULL);
+			}
+		}
 
-	printf("Removing 2 * 2 * %d items from the appended sll...\n", amt);
-	for (i = 0; i < (2 * amt); ++i) {
-		x = sll_get_data(sll_next(l1));
-		assert(!sll_empty(l1));
-		l1 = sll_remove_next(l1, NULL);
-		y = sll_get_data(l1);
-		assert(!sll_empty(l1));
-		l1 = sll_remove_head(l1, NULL);
+		start = clock();
+		for (i = 0; i < amt; ++i) {
+			if (kind == 0)
+				ht_lookup(t, keys[i], num_eq, &x);
+			else
+				smap_lookup(m, keys[i], &x);
+			assert(x.num == keys[i].num);
+		}
+		took[2] = elapsed(start);
 
-		/*
-		 * We have to count backwards in this check, since we're
-		 * using the list like a stack, prepending all the time.
-		 */
-		assert(x.num == amt - (i % amt) - 1);
-		assert(x.num == y.num);
+		/* A hash table has no bulk insert */
+		if (kind == 0)
+			printf("%-16s %9.3fs %10s %9.3fs\n", names[kind],
+			       took[0], "-", took[2]);
+		else
+			printf("%-16s %9.3fs %9.3fs %9.3fs\n", names[kind],
+			       took[0], took[1], took[2]);
+
+		if (kind == 0)
+			ht_destroy(t, NULL, NULL);
+		else
+			smap_destroy(m, NULL, NULL);
 	}
-	assert(sll_empty(l1));
-	sll_destroy(l1, NULL);
+
+	free(keys);
+}
+
+
+#ifdef GUNE_THREADS
+/* Work for one thread of the throughput benchmark */
+struct bench_thread_arg {
+	cht ct;			/* The concurrent table, or NULL */
+	lfht lt;		/* The lock-free table, or NULL */
+	ht t;			/* The table behind bench_mutex otherwise */
+	int first;		/* The keys of this thread are first..first+span */
+	int span;
+	int ops;		/* The number of operations to perform */
+};
+
+/* The one big lock around t, like a program without cht would use */
+pthread_mutex_t bench_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* Seconds of wall clock time since the given start time */
+double
+elapsed_wall(struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)(now.tv_sec - start->tv_sec) +
+		(now.tv_nsec - start->tv_nsec) / 1e9;
 }
 
 
+/*
+ * Compare the sequential sorts with the parallel ones on 1, 2, 4 and 8
+ * threads, and on one thread for each CPU.
+ */
 void
-stress_test_dll(int amt)
+bench_sort_parallel(int amt)
 {
-	dll l1;
-	dll l2;
-	gendata x, y;
-	int i;
+	unsigned int threads[5] = { 1, 2, 4, 8, 0 };
+	double took[6][2];
+	struct timespec start;
+	gendata *xs;
+	array ar;
+	int i, j, t, n;
 
-	l1 = dll_create();
-	l2 = dll_create();
-	assert(dll_empty(l1));
-	assert(dll_empty(l2));
+	n = amt * 100;
+	printf("Sorting %d random integers (wall clock time)\n", n);
+	if ((xs = malloc(n * sizeof(gendata))) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	sort_fill(xs, n, 0);
 
-	printf("Filling two dlls with 2 * %d items...\n", amt);
-	for (i = 0; i < amt; ++i) {
-		x.num = i;
-		l1 = dll_prepend_head(l1, x);
-		l2 = dll_prepend_head(l2, x);
-		assert(!dll_empty(l1));
-		assert(!dll_empty(l2));
-		l1 = dll_append_head(l1, x);
-		l2 = dll_append_head(l2, x);
-		assert(!dll_empty(l1));
-		assert(!dll_empty(l2));
+	ar = array_create();
+	for (t = 0; t < 6; ++t) {
+		for (j = 0; j < 2; ++j) {
+			array_resize(ar, 0);
+			ar = array_append_many(ar, xs, (unsigned int)n);
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			if (t == 0 && j == 0)
+				array_sort(ar, num_cmp);
+			else if (t == 0)
+				array_sort_num(ar);
+			else if (j == 0)
+				array_sort_parallel(ar, num_cmp,
+						    threads[t - 1]);
+			else
+				array_sort_num_parallel(ar, threads[t - 1]);
+			took[t][j] = elapsed_wall(&start);
+			for (i = 1; i < n; ++i)
+				assert(ar->data[i - 1].num <= ar->data[i].num);
+		}
 	}
 
-	/* Do some funky inserting at a `random' position. */
-	dll_append_head(dll_forward(l1, 1), x);
-	assert(x.num == dll_get_data(dll_forward(l1, 1)).num);
-	dll_remove_head(dll_forward(l1, 2), NULL);
+	printf("%-16s %10s %10s\n", "", "cmp", "radix");
+	printf("%-16s %9.3fs %9.3fs\n", "sequential", took[0][0],
+	       took[0][1]);
+	for (t = 1; t < 6; ++t) {
+		if (threads[t - 1] == 0)
+			printf("%-16s", "parallel, CPUs");
+		else
+			printf("parallel, %-6u", threads[t - 1]);
+		printf(" %9.3fs %9.3fs\n", took[t][0], took[t][1]);
+	}
 
-	l1 = dll_append(l1, l2);
-	assert(dll_count(l1) == (unsigned int)(4 * amt));
+	array_destroy(ar, NULL);
+	free(xs);
+}
 
-	/* From now on, l2 is `invalid' */
 
-	printf("Removing 2 * 2 * %d items from the appended dll...\n", amt);
-	for (i = 0; i < (2 * amt); ++i) {
-		assert(!dll_empty(l1));
-		x = dll_get_data(l1);
-		l1 = dll_remove_head(l1, NULL);
-		assert(!dll_empty(l1));
-		y = dll_get_data(l1);
-		l1 = dll_remove_head(l1, NULL);
+/*
+ * Perform a read-mostly mix of operations on this thread's keys: nine
+ * lookups to every delete and reinsert.
+ */
+void *
+bench_thread(void *arg)
+{
+	struct bench_thread_arg *a = arg;
+	unsigned int r = (unsigned int)a->first;
+	gendata x, y;
+	int i;
 
-		/*
-		 * We have to count backwards in this check, since we're
-		 * using the list like a stack, prepending all the time.
-		 */
-		assert(x.num == amt - (i % amt) - 1);
-		assert(x.num == y.num);
+	for (i = 0; i < a->ops; ++i) {
+		/* A cheap random number generator, so threads don't share */
+		r = r * 1103515245U + 12345U;
+		x.num = y.num = a->first + (int)((r >> 8) % a->span);
+
+		if (a->ct != NULL) {
+			if (i % 10 == 0) {
+				cht_delete(a->ct, x, num_eq, NULL, NULL);
+				cht_insert(a->ct, x, y, num_eq, NULL, NULL);
+			} else {
+				cht_lookup(a->ct, x, num_eq, &y);
+			}
+		} else if (a->lt != NULL) {
+			if (i % 10 == 0) {
+				lfht_delete(a->lt, x, num_eq);
+				lfht_insert(a->lt, x, y, num_eq);
+			} else {
+				lfht_lookup(a->lt, x, num_eq, &y);
+			}
+		} else {
+			pthread_mutex_lock(&bench_mutex);
+			if (i % 10 == 0) {
+				ht_delete(a->t, x, num_eq, NULL, NULL);
+				ht_insert(a->t, x, y, num_eq, NULL, NULL);
+			} else {
+				ht_lookup(a->t, x, num_eq, &y);
+			}
+			pthread_mutex_unlock(&bench_mutex);
+		}
 	}
-	assert(dll_empty(l1));
-	dll_destroy(l1, NULL);
+
+	return NULL;
 }
 
 
+/*
+ * Compare the throughput of a concurrent hash table with that of an
+ * ordinary one behind a single mutex, using more and more threads on
+ * disjoint keys.  The total amount of work stays the same.
+ */
 void
-stress_test_stack(int amt)
+bench_threads(int amt)
 {
-	int i;
-	gendata x, y;
-	stack s;
-	
-	s = stack_create();
-	assert(stack_empty(s));
+	struct bench_thread_arg args[8];
+	pthread_t threads[8];
+	struct timespec start;
+	double secs[3];
+	int i, kind, nthreads;
+	gendata x;
+	lfht lt = NULL;
+	cht ct = NULL;
+	ht t = NULL;
 
-	/* Fill it up, and remove items again */
-	printf("Filling a stack with %d items...\n", amt);
-	for (i = 0; i < amt; ++i) {
-		x.num = i;
-		stack_push(s, x);
-		assert(x.num == stack_peek(s).num);
-		assert(!stack_empty(s));
-	}
-	printf("Popping/peeking stack of %d items...\n", amt);
-	for (i = 0; i < amt; ++i) {
-		assert(!stack_empty(s));
-		x = stack_peek(s);
-		y = stack_pop(s);
+	printf("Performing %d operations on %d integer keys from several "
+	       "threads\n", 10 * amt, amt);
+	printf("%-8s %16s %16s %16s\n", "threads", "ht + mutex", "cht",
+	       "lfht");
 
-		assert(x.num == amt - i - 1);
-		assert(x.num == y.num);
+	for (nthreads = 1; nthreads <= 8; nthreads *= 2) {
+		for (kind = 0; kind < 3; ++kind) {
+			if (kind == 0)
+				t = ht_create_full(0, num_fullhash,
+						   HT_CHAINED);
+			else if (kind == 1)
+				ct = cht_create(0, num_fullhash);
+			else
+				lt = lfht_create(0, num_fullhash, NULL, NULL);
+			for (i = 0; i < amt; ++i) {
+				x.num = i;
+				if (kind == 0)
+					ht_insert(t, x, x, num_eq, NULL, NULL);
+				else if (kind == 1)
+					cht_insert(ct, x, x, num_eq, NULL,
+						   NULL);
+				else
+					lfht_insert(lt, x, x, num_eq);
+			}
+
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			for (i = 0; i < nthreads; ++i) {
+				args[i].ct = (kind == 1) ? ct : NULL;
+				args[i].lt = (kind == 2) ? lt : NULL;
+				args[i].t = t;
+				args[i].span = amt / nthreads;
+				args[i].first = i * args[i].span;
+				args[i].ops = 10 * amt / nthreads;
+				if (args[i].span == 0)
+					args[i].span = 1;
+				if (pthread_create(&threads[i], NULL,
+						   bench_thread, &args[i])) {
+					perror("pthread_create");
+					exit(1);
+				}
+			}
+			for (i = 0; i < nthreads; ++i)
+				pthread_join(threads[i], NULL);
+			secs[kind] = elapsed_wall(&start);
+
+			if (kind == 0)
+				ht_destroy(t, NULL, NULL);
+			else if (kind == 1)
+				cht_destroy(ct, NULL, NULL);
+			else
+				lfht_destroy(lt);
+		}
+
+		printf("%-8d %10.2f Mop/s %10.2f Mop/s %10.2f Mop/s\n",
+		       nthreads, 10 * amt / secs[0] / 1e6,
+		       10 * amt / secs[1] / 1e6, 10 * amt / secs[2] / 1e6);
 	}
+}
 
-	assert(stack_empty(s));
 
-	/* Now, again, fill up the stack... */
-	printf("Refilling a stack with %d items...\n", amt);
-	for (i = 0; i < amt; ++i)
-		stack_push(s, x);
+/*
+ * Make a hash table of string keys, from keys[first] to keys[first+amt-1].
+ */
+ht
+bench_make_str_ht(char **keys, int first, int amt)
+{
+	ht t;
+	int i;
+	gendata x;
 
-	assert(!stack_empty(s));
+	t = ht_create_full(0, str_fullhash, HT_CHAINED);
+	for (i = first; i < first + amt; ++i) {
+		x.ptr = keys[i];
+		ht_insert(t, x, x, str_eq, NULL, NULL);
+	}
 
-	printf("Destroying a stack with %d items...\n", amt);
-	/* ...and free it */
-	stack_destroy(s, NULL);
+	return t;
 }
 
 
+/*
+ * Compare merging two tables with inserting the elements of one into the
+ * other one by one.
+ */
 void
-stress_test_queue(int amt)
+bench_merge(int amt)
 {
-	int i;
-	queue q;
+	struct timespec start;
+	double inserting, merging;
+	ht_iter_t it;
+	char **keys;
 	gendata x, y;
+	ht base, rest;
 
-	q = queue_create();
-	assert(queue_empty(q));
+	printf("Merging two tables of %d string keys, half overlapping\n",
+	       amt);
+	keys = bench_keys(amt / 2 + amt, "merge");
 
-	/* Fill the queue */
-	printf("Enqueueing a queue with %d items...\n", amt);
-	for (i = 0; i < amt; ++i) {
-		x.num = i;
-		q = queue_enqueue(q, x);
-		assert(!queue_empty(q));
-	}
-	printf("Dequeueing a queue with %d items...\n", amt);
-	for (i = 0; i < amt; ++i) {
-		assert(!queue_empty(q));
-		x = queue_peek(q);
-		y = queue_dequeue(q);
-		assert(x.num == y.num);
-		assert(x.num == i);
-	}
-	assert(queue_empty(q));
+	base = bench_make_str_ht(keys, 0, amt);
+	rest = bench_make_str_ht(keys, amt / 2, amt);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ht_iter_init(rest, &it);
+	while (ht_iter_next(&it, &x, &y))
+		ht_insert(base, x, y, str_eq, NULL, NULL);
+	inserting = elapsed_wall(&start);
+	ht_destroy(base, NULL, NULL);
+	ht_destroy(rest, NULL, NULL);
 
-	printf("Re-enqueueing a queue with %d items...\n", amt);
-	for (i = 0; i < amt; ++i) {
-		x.num = i;
-		q = queue_enqueue(q, x);
-		assert(!queue_empty(q));
-	}
-	printf("Destroying a queue with %d items...\n", amt);
-	queue_destroy(q, NULL);
+	base = bench_make_str_ht(keys, 0, amt);
+	rest = bench_make_str_ht(keys, amt / 2, amt);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	assert(ht_merge(base, rest, str_eq, NULL, NULL) != NULL);
+	merging = elapsed_wall(&start);
+	assert(ht_count(base) == (unsigned int)(amt / 2 + amt));
+	ht_destroy(base, NULL, NULL);
+
+	printf("%-16s %9.3fs\n", "ht_insert", inserting);
+	printf("%-16s %9.3fs\n", "ht_merge", merging);
+
+	bench_free_keys(keys, amt / 2 + amt);
 }
+#endif /* GUNE_THREADS */
 
 
 void
 usage(void)
 {
 	printf("usage: test [-a] [-n num] [-l log] [-s amt | -e lvl | "
-		"-d amt | -q amt | -r amt | -S amt | -A amt | -h amt]\n");
+		"-d amt | -q amt | -r amt | -S amt | -A amt | -h amt | "
+		"-H amt | -F amt | -L amt | -C amt | -t amt | -T amt | "
+		"-f amt | -V amt | -M amt]\n");
+	printf("       test [-B amt] -b name\n");
 	printf("-n num	Perform selected tests `num' times. Default is 10.\n");
 	printf("-a      Perform every test, using %i for `amt'\n", DEFNUM);
 	printf("-s amt	Do a stack stress test on `amt' stack items.\n");
@@ -396,12 +3796,28 @@ usage(void)
 	printf("-q amt  Do a queue stress test.\n");
 	printf("-r amt  Do an array stress test.\n");
 	printf("-S amt  Do a Singly Linked List (sll) stress test.\n");
+	printf("-V amt  Do a typed vector (vec) stress test.\n");
 	printf("-A amt  Do an Association List (alist) stress test.\n");
 	printf("-h amt  Do a Hash Table (ht) stress test.\n");
+	printf("-H amt  Do a SIMD Hash Table (sht) stress test.\n");
+	printf("-F amt  Do a Frozen Hash Table (fht) stress test.\n");
+	printf("-L amt  Do an LRU cache (lru) stress test.\n");
+	printf("-C amt  Do a CLOCK cache (ccache) stress test.\n");
+	printf("-t amt  Do an expiring map (ttl) stress test.\n");
+	printf("-M amt  Do a sorted map (smap) stress test.\n");
+#ifdef GUNE_THREADS
+	printf("-T amt  Do a Concurrent Hash Table (cht) stress test.\n");
+	printf("-f amt  Do a Lock-Free Hash Table (lfht) stress test.\n");
+#endif
 	printf("-e lvl  Print an error on the specified level (0-3).\n");
 	printf("-l log  Use log as a file to write messages to.\n");
 	printf("-c str  Test string copy routines.\n");
 	printf("-v      Gune version we are testing.\n");
+	printf("-b name Run benchmark `name' (sht, many, freeze, cache,\n"
+	       "        strhash, occupancy, array, vec, sort, smap,\n"
+	       "        threads, merge, psort).\n");
+	printf("-B amt  Number of items to benchmark with.  Default is %i.\n",
+		DEFBENCHNUM);
 }
 
 
@@ -410,10 +3826,13 @@ main(int argc, char **argv)
 {
 	extern char *optarg;
 	char *str = NULL;
-	int ch;
+	char *bench = NULL;
+	int ch, bench_num;
 	extern char *malloc_options;
 	int i, loop, stack_test, queue_test, dll_test, sll_test, err_test;
-	int strcat_test, array_test, alist_test, ht_test, idle;
+	int strcat_test, array_test, alist_test, ht_test, sht_test, idle;
+	int cht_test, lfht_test, fht_test, lru_test, ccache_test, ttl_test;
+	int vec_test, smap_test;
 
 	warnlvl wrn = WARN_NOTIFY;
 
@@ -427,8 +3846,11 @@ main(int argc, char **argv)
 
 	/* Default options */
 	stack_test = dll_test = err_test = strcat_test = queue_test = 0;
-	array_test = sll_test = alist_test = ht_test = 0;
+	array_test = sll_test = alist_test = ht_test = sht_test = 0;
+	cht_test = lfht_test = fht_test = 0;
+	lru_test = ccache_test = ttl_test = vec_test = smap_test = 0;
 	loop = DEFLOOPCOUNT;
+	bench_num = DEFBENCHNUM;
 	idle = 1;	/* Set idle, unless a test should be run */
 
 	if (argc <= 1) {
@@ -436,23 +3858,38 @@ main(int argc, char **argv)
 		return 1;
 	}
 
-	while ((ch = getopt(argc, argv, "aA:c:d:e:h:l:n:q:r:s:S:v")) != -1)
+	while ((ch = getopt(argc, argv, "aA:b:B:c:C:d:e:f:F:h:H:l:L:M:n:q:r:s:S:t:T:vV:")) != -1)
 		switch ((char)ch) {
 			case 'a':
 				dll_test = stack_test = queue_test = DEFNUM;
 				array_test = sll_test = alist_test = DEFNUM;
-				ht_test = DEFNUM;
+				ht_test = sht_test = fht_test = DEFNUM;
+				lru_test = ccache_test = ttl_test = DEFNUM;
+				vec_test = smap_test = DEFNUM;
+#ifdef GUNE_THREADS
+				cht_test = lfht_test = DEFNUM;
+#endif
 				idle = 0;
 				break;
 			case 'A':
 				alist_test = atoi(optarg);
 				idle = 0;
 				break;
+			case 'b':
+				bench = optarg;
+				break;
+			case 'B':
+				bench_num = atoi(optarg);
+				break;
 			case 'c':
 				strcat_test = 1;
 				str = optarg;
 				idle = 0;
 				break;
+			case 'C':
+				ccache_test = atoi(optarg);
+				idle = 0;
+				break;
 			case 'd':
 				dll_test = atoi(optarg);
 				idle = 0;
@@ -470,13 +3907,31 @@ main(int argc, char **argv)
 				idle = 0;
 				err_test = 1;
 				break;
+#ifdef GUNE_THREADS
+			case 'f':
+				lfht_test = atoi(optarg);
+				idle = 0;
+				break;
+#endif
+			case 'F':
+				fht_test = atoi(optarg);
+				idle = 0;
+				break;
 			case 'h':
 				ht_test = atoi(optarg);
 				idle = 0;
 				break;
+			case 'H':
+				sht_test = atoi(optarg);
+				idle = 0;
+				break;
 			case 'l':
 				set_logfile(fopen(optarg, "a"));
 				break;
+			case 'L':
+				lru_test = atoi(optarg);
+				idle = 0;
+				break;
 			case 'n':
 				loop = atoi(optarg);
 				break;
@@ -496,6 +3951,16 @@ main(int argc, char **argv)
 				sll_test = atoi(optarg);
 				idle = 0;
 				break;
+			case 't':
+				ttl_test = atoi(optarg);
+				idle = 0;
+				break;
+#ifdef GUNE_THREADS
+			case 'T':
+				cht_test = atoi(optarg);
+				idle = 0;
+				break;
+#endif
 			case 'v':
 				printf("Using the following Gune version...\n");
 				printf("Preprocessor value:     \t%s\n",
@@ -503,11 +3968,54 @@ main(int argc, char **argv)
 				printf("Human-readable notation:\t%s\n",
 					GUNE_VERSION_STRING);
 				return 0;
+			case 'V':
+				vec_test = atoi(optarg);
+				idle = 0;
+				break;
+			case 'M':
+				smap_test = atoi(optarg);
+				idle = 0;
+				break;
 			default:
 				usage();
 				return 1;
 		}
 
+	if (bench != NULL) {
+		if (strcmp(bench, "sht") == 0) {
+			bench_sht(bench_num);
+		} else if (strcmp(bench, "many") == 0) {
+			bench_lookup_many(bench_num);
+		} else if (strcmp(bench, "freeze") == 0) {
+			bench_freeze(bench_num);
+		} else if (strcmp(bench, "cache") == 0) {
+			bench_cache(bench_num);
+		} else if (strcmp(bench, "strhash") == 0) {
+			bench_str_hash(bench_num);
+		} else if (strcmp(bench, "occupancy") == 0) {
+			bench_occupancy(bench_num);
+		} else if (strcmp(bench, "array") == 0) {
+			bench_array(bench_num);
+		} else if (strcmp(bench, "vec") == 0) {
+			bench_vec(bench_num);
+		} else if (strcmp(bench, "sort") == 0) {
+			bench_sort(bench_num);
+		} else if (strcmp(bench, "smap") == 0) {
+			bench_smap(bench_num);
+#ifdef GUNE_THREADS
+		} else if (strcmp(bench, "threads") == 0) {
+			bench_threads(bench_num);
+		} else if (strcmp(bench, "merge") == 0) {
+			bench_merge(bench_num);
+		} else if (strcmp(bench, "psort") == 0) {
+			bench_sort_parallel(bench_num);
+#endif
+		} else {
+			usage();
+			return 1;
+		}
+	}
+
 	/* Perform `n' tests of each kind */
 	if (idle == 0)
 		for (i = 0; i < loop; ++i) {
@@ -520,6 +4028,40 @@ main(int argc, char **argv)
 				printf("\n----> HASH TABLE <----\n");
 				stress_test_ht(ht_test);
 			}
+			if (sht_test > 0) {
+				printf("\n----> SIMD HASH TABLE <----\n");
+				stress_test_sht(sht_test);
+			}
+			if (fht_test > 0) {
+				printf("\n----> FROZEN HASH TABLE <----\n");
+				stress_test_fht(fht_test);
+			}
+			if (lru_test > 0) {
+				printf("\n----> LRU CACHE <----\n");
+				stress_test_lru(lru_test);
+			}
+			if (ccache_test > 0) {
+				printf("\n----> CLOCK CACHE <----\n");
+				stress_test_ccache(ccache_test);
+			}
+			if (ttl_test > 0) {
+				printf("\n----> EXPIRING MAP <----\n");
+				stress_test_ttl(ttl_test);
+			}
+			if (smap_test > 0) {
+				printf("\n----> SORTED MAP <----\n");
+				stress_test_smap(smap_test);
+			}
+#ifdef GUNE_THREADS
+			if (cht_test > 0) {
+				printf("\n----> CONCURRENT HASH TABLE <----\n");
+				stress_test_cht(cht_test);
+			}
+			if (lfht_test > 0) {
+				printf("\n----> LOCK-FREE HASH TABLE <----\n");
+				stress_test_lfht(lfht_test);
+			}
+#endif
 			if (dll_test > 0) {
 				printf("\n----> DLL <----\n");
 				stress_test_dll(dll_test);
@@ -540,6 +4082,10 @@ main(int argc, char **argv)
 				printf("\n----> ARRAY <----\n");
 				stress_test_array(array_test);
 			}
+			if (vec_test > 0) {
+				printf("\n----> TYPED VECTORS <----\n");
+				stress_test_vec(vec_test);
+			}
 			if (strcat_test > 0) {
 				printf("\n----> STR_CAT <----\n");
 				strcat_tester(str);